@@ -45,7 +45,6 @@ project "Reignite"
     "extern/spdlog/include",
     "extern/stb",
     "extern/tinygltf",
-    "extern/tinyobjloader",
     "extern/volk",
   }
 
@@ -79,8 +78,10 @@ project "Reignite"
 
     dll_dest = '"$(SolutionDir)..\\bin\\Debug\\x64\\Reignite\\*.dll"'
     dll_targ = '"$(SolutionDir)..\\bin\\Debug\\x64\\Render\\*.dll"'
+    dll_cook = '"$(SolutionDir)..\\bin\\Debug\\x64\\Cooker\\*.dll"'
     postbuildcommands {
-      'copy /Y ' .. dll_dest .. ' ' .. dll_targ .. ''
+      'copy /Y ' .. dll_dest .. ' ' .. dll_targ .. '',
+      'copy /Y ' .. dll_dest .. ' ' .. dll_cook .. ''
     }
   
   configuration { }
@@ -100,7 +101,7 @@ project "Reignite"
 
   custombuildtask {
     { "project/data/shaders/*.glsl", "project/data/shaders/%(Filename).spv", 
-    { "%(FullPath)" }, { "$(VULKAN_SDK)\\Bin\\glslangValidator %(FullPath) -V -o ../data/shaders/%(Filename).spv" } },
+    { "%(FullPath)", "project/data/shaders/include/pbr_common.glsl", "project/data/shaders/include/visibility_resolve.glsl" }, { "$(VULKAN_SDK)\\Bin\\glslangValidator %(FullPath) -V -o ../data/shaders/%(Filename).spv" } },
   }
 
 project "Render"
@@ -152,6 +153,55 @@ project "Render"
 
   configuration { }
 
+project "Cooker"
+  location "project/Cooker"
+  kind "ConsoleApp"
+  language "C++"
+
+  files {
+    "project/Cooker/src/**.h",
+    "project/Cooker/src/**.cpp",
+  }
+
+  includedirs {
+    "$(VULKAN_SDK)\\Include",
+    "extern/glm/glm",
+    "extern/spdlog/include",
+    "project/Reignite/src",
+  }
+
+  links {
+    "Reignite"
+  }
+
+  configuration "Debug" 
+  
+    targetdir ("bin/Debug/x64/Cooker")
+    objdir ("bin-int/Debug/x64/Cooker")
+
+    defines {
+      "RI_PLATFORM_WINDOWS",
+      "RI_DEBUG"
+    }
+
+    flags {
+      "Symbols"
+    }
+
+  configuration { }
+
+  configuration "configurations:Release" 
+  
+    targetdir ("bin/Release/x64/Cooker")
+    objdir ("bin-int/Release/x64/Cooker")
+
+    defines {
+      "RI_PLATFORM_WINDOWS",
+      "RI_RELEASE"
+    }
+
+  configuration { }
+
 -- //////////////////////////////////////////////////////////////////////////////
 -- // Side Projects /////////////////////////////////////////////////////////////
 -- //////////////////////////////////////////////////////////////////////////////
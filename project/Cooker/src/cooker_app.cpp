@@ -0,0 +1,42 @@
+#include "Reignite/log.h"
+#include "Reignite/asset_pack.h"
+
+
+// Cooks the assets used by the render demo into data/reignite.pack.
+// Paths are relative to the asset folder and must match the ones the
+// runtime asks for.
+
+int main(int argc, char** argv) {
+
+  Reignite::Log::Init();
+
+  std::string output = argc > 1 ? argv[1] : "./../data/reignite.pack";
+
+  Reignite::AssetCooker cooker;
+
+  bool ok = true;
+
+  ok &= cooker.addObj("models/geosphere.obj");
+  ok &= cooker.addObj("models/box.obj");
+  ok &= cooker.addObj("models/bombilla.obj");
+  ok &= cooker.addTerrain(6, 6);
+
+  ok &= cooker.addTexture("textures/red_bricks_albedo.png");
+  ok &= cooker.addTexture("textures/red_bricks_normal.png");
+  ok &= cooker.addTexture("textures/red_bricks_roughness.png");
+  ok &= cooker.addTexture("textures/red_bricks_metallic.png");
+
+  ok &= cooker.addTexture("textures/iron_rust_albedo.png");
+  ok &= cooker.addTexture("textures/iron_rust_normal.png");
+  ok &= cooker.addTexture("textures/iron_rust_roughness.png");
+  ok &= cooker.addTexture("textures/iron_rust_metallic.png");
+
+  ok &= cooker.addTexture("textures/cubemap_yokohama_bc3_unorm.ktx");
+
+  if (!ok) {
+    RI_ERROR("Some assets failed to cook, pack not written");
+    return 1;
+  }
+
+  return cooker.write(output) ? 0 : 1;
+}
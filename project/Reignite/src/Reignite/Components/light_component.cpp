@@ -12,6 +12,7 @@ void Reignite::LightComponents::init(u32 maxSize) {
   type.reserve(maxSize);
   target.reserve(maxSize);
   color.reserve(maxSize);
+  radius.reserve(maxSize);
   view.reserve(maxSize);
   projection.reserve(maxSize);
 }
@@ -24,11 +25,12 @@ void Reignite::LightComponents::clear() {
   type.clear();
   target.clear();
   color.clear();
+  radius.clear();
   view.clear();
   projection.clear();
 }
 
-void Reignite::LightComponents::add(vec3f direction) {
+void Reignite::LightComponents::add(vec3f direction, float range) {
 
   used.push_back(true);
   active.push_back(true);
@@ -36,6 +38,7 @@ void Reignite::LightComponents::add(vec3f direction) {
   type.push_back(RI_LIGHT_TYPE_POINTLIGHT);
   target.push_back(direction);
   color.push_back(vec3f(1.0f));
+  radius.push_back(range);
   view.push_back(mat4f(1.0f));
   projection.push_back(mat4f(1.0f));
 
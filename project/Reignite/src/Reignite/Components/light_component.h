@@ -13,7 +13,7 @@ namespace Reignite {
     void init(u32 maxSize);
     void clear();
 
-    void add(vec3f direction);
+    void add(vec3f direction, float range = 35.0f);
 
     void update();
     
@@ -26,6 +26,7 @@ namespace Reignite {
     std::vector<Type> type;
     std::vector<vec3f> target;
     std::vector<vec3f> color;
+    std::vector<float> radius;    // point lights fade out to nothing at it
     std::vector<mat4f> view;
     std::vector<mat4f> projection;
 
@@ -3,11 +3,45 @@
 #include "../tools.h"
 
 
+Reignite::GeometryResource::GeometryResource(GeometryResource&& other) noexcept {
+
+  *this = std::move(other);
+}
+
+Reignite::GeometryResource& Reignite::GeometryResource::operator=(GeometryResource&& other) noexcept {
+
+  if (this == &other)
+    return *this;
+
+  // Reloading a live resource replaces its buffers
+  vertexBuffer.destroy();
+  indexBuffer.destroy();
+
+  vertices = std::move(other.vertices);
+  indices = std::move(other.indices);
+  vertexSize = other.vertexSize;
+  indicesSize = other.indicesSize;
+  boundsMin = other.boundsMin;
+  boundsMax = other.boundsMax;
+  state = other.state;
+  vertexBuffer = other.vertexBuffer;
+  indexBuffer = other.indexBuffer;
+
+  // The source no longer owns the buffers
+  other.vertexBuffer = {};
+  other.indexBuffer = {};
+
+  return *this;
+}
+
 void Reignite::GeometryResource::init() {
 
   vertexSize = 0;
   indicesSize = 0;
 
+  boundsMin = vec3f(0.0f);
+  boundsMax = vec3f(0.0f);
+
   state = nullptr;
   vertexBuffer = {};
   indexBuffer = {};
@@ -15,18 +49,24 @@ void Reignite::GeometryResource::init() {
 
 void Reignite::GeometryResource::destroy() {
 
-  vertices.clear();
-  indices.clear();
+  releaseCpuData();
 
   vertexBuffer.destroy();
   indexBuffer.destroy();
 }
 
-bool Reignite::GeometryResource::loadObj(std::string file) {
+void Reignite::GeometryResource::releaseCpuData() {
+
+  // clear() would keep the capacity
+  std::vector<Vertex>().swap(vertices);
+  std::vector<u32>().swap(indices);
+}
+
+bool Reignite::GeometryResource::loadObj(std::string file, ThreadPool* workers) {
 
   GeometryResource auxGeometry = {};
-  bool result = Reignite::Tools::LoadObjFile(file, auxGeometry);
-  *this = auxGeometry;
+  bool result = Reignite::Tools::LoadObjFile(file, auxGeometry, workers);
+  *this = std::move(auxGeometry);
 
   return result;
 }
@@ -35,7 +75,25 @@ bool Reignite::GeometryResource::loadTerrain(u32 width, u32 length) {
 
   GeometryResource auxGeometry = {};
   bool result = Reignite::Tools::GenerateTerrain(auxGeometry, width, length);
-  *this = auxGeometry;
+  *this = std::move(auxGeometry);
 
   return result;
+}
+
+void Reignite::GeometryResource::computeBounds() {
+
+  if (vertices.empty()) {
+    boundsMin = vec3f(0.0f);
+    boundsMax = vec3f(0.0f);
+    return;
+  }
+
+  boundsMin = vec3f(vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]);
+  boundsMax = boundsMin;
+
+  for (const Vertex& vertex : vertices) {
+    vec3f position(vertex.position[0], vertex.position[1], vertex.position[2]);
+    boundsMin = glm::min(boundsMin, position);
+    boundsMax = glm::max(boundsMax, position);
+  }
 }
\ No newline at end of file
@@ -13,23 +13,43 @@
 
 namespace Reignite {
 
+  class ThreadPool;
+
+  // Move only, the buffers belong to exactly one owner and a move assignment
+  // destroys the ones it replaces. vertices and indices are a CPU copy that
+  // is usually empty once the buffers exist.
   struct GeometryResource {
 
+    GeometryResource() = default;
+    GeometryResource(GeometryResource&& other) noexcept;
+    GeometryResource& operator=(GeometryResource&& other) noexcept;
+
+    GeometryResource(const GeometryResource&) = delete;
+    GeometryResource& operator=(const GeometryResource&) = delete;
+
     void init();
     void destroy();
 
-    bool loadObj(std::string file);
+    // Frees the CPU copy, the buffers stay
+    void releaseCpuData();
+
+    bool loadObj(std::string file, ThreadPool* workers = nullptr);
     bool loadTerrain(u32 width, u32 lenght);
 
+    void computeBounds();
+
     std::vector<Vertex> vertices;
     std::vector<u32> indices;
-    u32 vertexSize;
-    u32 indicesSize;
+    u32 vertexSize = 0;
+    u32 indicesSize = 0;
+
+    vec3f boundsMin = vec3f(0.0f);
+    vec3f boundsMax = vec3f(0.0f);
 
-    vk::VulkanState* state;
+    vk::VulkanState* state = nullptr;
     vk::Buffer vertexBuffer;
     vk::Buffer indexBuffer;
   };
 }
 
-#endif // _CAMERA_COMPONENT_
\ No newline at end of file
+#endif // _RI_GEOMETRY_RESOURCE_
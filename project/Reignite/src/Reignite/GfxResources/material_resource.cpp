@@ -27,27 +27,11 @@ void Reignite::MaterialResource::destroy() {
 
 }
 
-void Reignite::MaterialResource::update(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout) {
-
-  VkDescriptorSetAllocateInfo allocInfo = vk::initializers::DescriptorSetAllocateInfo(
-    descriptorPool, &descriptorSetLayout, 1);
-
-  VK_CHECK(vkAllocateDescriptorSets(vulkanState->device, &allocInfo, &descriptorSet));
-  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-
-    // Binding 1: Color map
-    /*vk::initializers::WriteDescriptorSet(descriptorSet,
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorMap.descriptor),
-    // Binding 2: Normal map
-    vk::initializers::WriteDescriptorSet(descriptorSet,
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &normalMap.descriptor),
-    // Binding 3: Roughness map
-    vk::initializers::WriteDescriptorSet(descriptorSet,
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &roughness.descriptor),
-    // Binding 4: Metallic map
-    vk::initializers::WriteDescriptorSet(descriptorSet,
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &metallic.descriptor)*/
-  };
-
-  vkUpdateDescriptorSets(vulkanState->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-}
\ No newline at end of file
+void Reignite::MaterialResource::update(vk::DescriptorAllocator& descriptors, VkDescriptorSetLayout descriptorSetLayout,
+  VkDescriptorUpdateTemplate updateTemplate, const void* descriptorData) {
+
+  if (descriptorSet == VK_NULL_HANDLE)
+    VK_CHECK(descriptors.allocate(descriptorSetLayout, &descriptorSet));
+
+  vkUpdateDescriptorSetWithTemplate(vulkanState->device, descriptorSet, updateTemplate, descriptorData);
+}
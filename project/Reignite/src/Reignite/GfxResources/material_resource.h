@@ -9,6 +9,7 @@
 #include "../Vulkan/vulkan_state.h"
 #include "../Vulkan/vulkan_buffer.h"
 #include "../Vulkan/vulkan_texture.h"
+#include "../Vulkan/vulkan_descriptors.h"
 
 
 namespace Reignite {
@@ -18,7 +19,10 @@ namespace Reignite {
     void init();
     void destroy();
 
-    void update(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout);
+    // Allocates the set on first use, then writes it from the packed
+    // descriptors the template was created for
+    void update(vk::DescriptorAllocator& descriptors, VkDescriptorSetLayout descriptorSetLayout,
+      VkDescriptorUpdateTemplate updateTemplate, const void* descriptorData);
 
     std::string name;
     struct PushBlock {
@@ -0,0 +1,215 @@
+#include "vulkan_descriptors.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include "../tools.h"
+#include "../log.h"
+
+#include "vulkan_tools.h"
+#include "vulkan_initializers.h"
+
+
+// Largest pool the allocator grows to, in sets
+static const u32 kMaxSetsPerPool = 4096;
+
+struct CachedSampler {
+  VkDevice device;
+  VkSamplerCreateInfo createInfo;
+  VkSampler sampler;
+};
+
+static std::mutex samplerMutex;
+static std::unordered_multimap<u64, CachedSampler> samplers;
+
+// Everything after pNext is plain 32 bit state without padding
+static const size_t kSamplerStateOffset = offsetof(VkSamplerCreateInfo, flags);
+static const size_t kSamplerStateSize = sizeof(VkSamplerCreateInfo) - kSamplerStateOffset;
+
+VkSampler vk::GetSampler(VkDevice device, const VkSamplerCreateInfo& createInfo) {
+
+  assert(createInfo.pNext == nullptr);
+
+  const u8* state = (const u8*)&createInfo + kSamplerStateOffset;
+  const u64 key = Reignite::Tools::HashBytes(state, kSamplerStateSize, (u64)device);
+
+  std::lock_guard<std::mutex> lock(samplerMutex);
+
+  auto range = samplers.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it) {
+    const u8* cached = (const u8*)&it->second.createInfo + kSamplerStateOffset;
+    if (it->second.device == device && memcmp(cached, state, kSamplerStateSize) == 0)
+      return it->second.sampler;
+  }
+
+  CachedSampler entry = { device, createInfo, VK_NULL_HANDLE };
+  VK_CHECK(vkCreateSampler(device, &createInfo, nullptr, &entry.sampler));
+  samplers.emplace(key, entry);
+
+  return entry.sampler;
+}
+
+void vk::DestroySamplers(VkDevice device) {
+
+  std::lock_guard<std::mutex> lock(samplerMutex);
+
+  for (auto it = samplers.begin(); it != samplers.end();) {
+    if (it->second.device == device) {
+      vkDestroySampler(device, it->second.sampler, nullptr);
+      it = samplers.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+VkResult vk::CreateDescriptorUpdateTemplate(VkDevice device, VkDescriptorSetLayout layout,
+  const std::vector<VkDescriptorUpdateTemplateEntry>& entries, VkDescriptorUpdateTemplate& updateTemplate) {
+
+  VkDescriptorUpdateTemplateCreateInfo createInfo = vk::initializers::DescriptorUpdateTemplateCreateInfo(layout, entries);
+  return vkCreateDescriptorUpdateTemplate(device, &createInfo, nullptr, &updateTemplate);
+}
+
+void vk::DescriptorAllocator::init(VkDevice vkDevice, const std::vector<VkDescriptorPoolSize>& sizesPerSet, u32 sets) {
+
+  device = vkDevice;
+  sizes = sizesPerSet;
+  setsPerPool = sets;
+}
+
+void vk::DescriptorAllocator::destroy() {
+
+  for (VkDescriptorPool pool : pools)
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  for (VkDescriptorPool pool : freePools)
+    vkDestroyDescriptorPool(device, pool, nullptr);
+
+  pools.clear();
+  freePools.clear();
+  layoutSizes.clear();
+}
+
+VkResult vk::DescriptorAllocator::createLayout(const VkDescriptorSetLayoutCreateInfo& createInfo,
+  VkDescriptorSetLayout* layout) {
+
+  VkResult result = vkCreateDescriptorSetLayout(device, &createInfo, nullptr, layout);
+  if (result != VK_SUCCESS)
+    return result;
+
+  std::vector<VkDescriptorPoolSize> counts;
+  for (u32 i = 0; i < createInfo.bindingCount; ++i) {
+
+    const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+    auto count = std::find_if(counts.begin(), counts.end(),
+      [&binding](const VkDescriptorPoolSize& size) { return size.type == binding.descriptorType; });
+
+    if (count == counts.end())
+      counts.push_back({ binding.descriptorType, binding.descriptorCount });
+    else
+      count->descriptorCount += binding.descriptorCount;
+  }
+
+  layoutSizes[*layout] = counts;
+
+  return VK_SUCCESS;
+}
+
+VkResult vk::DescriptorAllocator::allocate(VkDescriptorSetLayout layout, VkDescriptorSet* descriptorSet) {
+
+  // A type outside the mix never fits, however many pools are added
+  const std::vector<VkDescriptorPoolSize>* needed = nullptr;
+  auto known = layoutSizes.find(layout);
+  if (known != layoutSizes.end()) {
+
+    needed = &known->second;
+    for (const VkDescriptorPoolSize& need : *needed) {
+
+      const bool covered = std::any_of(sizes.begin(), sizes.end(),
+        [&need](const VkDescriptorPoolSize& size) { return size.type == need.type && size.descriptorCount > 0; });
+      if (!covered) {
+        RI_ERROR("Descriptor type {} of a set layout is missing from the pool sizes", (u32)need.type);
+        assert(covered);
+        return VK_ERROR_OUT_OF_POOL_MEMORY;
+      }
+    }
+  }
+
+  if (pools.empty()) {
+    VkResult result = grow(needed);
+    if (result != VK_SUCCESS)
+      return result;
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo = vk::initializers::DescriptorSetAllocateInfo(pools.back(), &layout, 1);
+  VkResult result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+
+  if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+    return result;
+
+  // Full, the next pool has room for the expected mix and this set
+  result = grow(needed);
+  if (result != VK_SUCCESS)
+    return result;
+
+  allocInfo.descriptorPool = pools.back();
+  result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+  if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    RI_ERROR("A descriptor set does not fit an empty descriptor pool, its layout needs more than the pool sizes give");
+
+  return result;
+}
+
+void vk::DescriptorAllocator::reset() {
+
+  for (VkDescriptorPool pool : pools) {
+    VK_CHECK(vkResetDescriptorPool(device, pool, 0));
+    freePools.push_back(pool);
+  }
+
+  pools.clear();
+}
+
+VkResult vk::DescriptorAllocator::grow(const std::vector<VkDescriptorPoolSize>* needed) {
+
+  if (!freePools.empty()) {
+    pools.push_back(freePools.back());
+    freePools.pop_back();
+    return VK_SUCCESS;
+  }
+
+  std::vector<VkDescriptorPoolSize> poolSizes = sizes;
+  for (VkDescriptorPoolSize& size : poolSizes)
+    size.descriptorCount *= setsPerPool;
+
+  // A set may need more of a type than the mix gives a whole pool
+  if (needed != nullptr) {
+    for (const VkDescriptorPoolSize& need : *needed) {
+      for (VkDescriptorPoolSize& size : poolSizes) {
+        if (size.type == need.type)
+          size.descriptorCount = (std::max)(size.descriptorCount, need.descriptorCount);
+      }
+    }
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = vk::initializers::DescriptorPoolCreateInfo(poolSizes, setsPerPool);
+
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+  if (result != VK_SUCCESS)
+    return result;
+
+  if (!pools.empty())
+    RI_INFO("Descriptor pool {} added with room for {} sets", pools.size(), setsPerPool);
+
+  pools.push_back(pool);
+
+  // Scenes that outgrow one pool likely outgrow the next, keep the count low
+  setsPerPool = (std::min)(setsPerPool * 2, kMaxSetsPerPool);
+
+  return VK_SUCCESS;
+}
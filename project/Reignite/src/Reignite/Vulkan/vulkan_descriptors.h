@@ -0,0 +1,63 @@
+#ifndef _RI_VULKAN_DESCRIPTORS_
+#define _RI_VULKAN_DESCRIPTORS_ 1
+
+#include <unordered_map>
+#include <vector>
+
+#include <volk.h>
+
+#include "../basic_types.h"
+
+
+namespace vk {
+
+  // Samplers are few and immutable, textures with the same state share one.
+  // The cache owns them, textures never destroy their sampler. Thread safe.
+  VkSampler GetSampler(VkDevice device, const VkSamplerCreateInfo& createInfo);
+  void DestroySamplers(VkDevice device);
+
+  // Template writing a whole set from one packed struct, entries give the
+  // offset of each binding's descriptor info in that struct
+  VkResult CreateDescriptorUpdateTemplate(VkDevice device, VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntry>& entries, VkDescriptorUpdateTemplate& updateTemplate);
+
+  // Hands out descriptor sets from a list of pools, adding one twice as large
+  // when the current one runs out. Sizes are given per set, a pool holds that
+  // mix for each of its sets. Sets are not freed one by one: reset() returns
+  // all of them at once, for allocators holding transient per frame sets.
+  class DescriptorAllocator {
+   public:
+
+    void init(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, u32 setsPerPool);
+    void destroy();
+
+    // Layouts made here are known by their descriptor counts: allocating a
+    // set of one fails loudly when a type is missing from the mix, and a
+    // new pool has room for at least one of its sets
+    VkResult createLayout(const VkDescriptorSetLayoutCreateInfo& createInfo, VkDescriptorSetLayout* layout);
+
+    VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet* descriptorSet);
+    void reset();
+
+    u32 poolCount() const { return (u32)(pools.size() + freePools.size()); }
+
+   private:
+
+    VkResult grow(const std::vector<VkDescriptorPoolSize>* needed);
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPoolSize> sizes;
+    u32 setsPerPool = 0;
+
+    // Descriptors of each type in one set, by layout
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorPoolSize>> layoutSizes;
+
+    // Pools in use, the last one takes new sets. Reset pools wait in freePools.
+    std::vector<VkDescriptorPool> pools;
+    std::vector<VkDescriptorPool> freePools;
+  };
+
+} // end of vk namespace
+
+
+#endif // _RI_VULKAN_DESCRIPTORS_
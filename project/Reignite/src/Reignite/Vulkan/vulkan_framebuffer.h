@@ -118,7 +118,14 @@ namespace vk {
       VK_CHECK(vkCreateImage(vulkanState->device, &imageCreateInfo, nullptr, &attachment.image));
       vkGetImageMemoryRequirements(vulkanState->device, attachment.image, &memReqs);
       memAlloc.allocationSize = memReqs.size;
-      memAlloc.memoryTypeIndex = vulkanState->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+      // Transient attachments may never need memory on tilers, they stay on chip
+      VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      if ((createInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+        vulkanState->hasMemoryType(memReqs.memoryTypeBits, memoryFlags | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+        memoryFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+      memAlloc.memoryTypeIndex = vulkanState->getMemoryType(memReqs.memoryTypeBits, memoryFlags);
       VK_CHECK(vkAllocateMemory(vulkanState->device, &memAlloc, nullptr, &attachment.memory));
       VK_CHECK(vkBindImageMemory(vulkanState->device, attachment.image, attachment.memory, 0));
       
@@ -132,6 +132,7 @@ VkResult CreateGraphicsPipeline(VkDevice device, VkPipeline& pipeline, PipelineC
   graphicsPipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
   graphicsPipelineCreateInfo.pStages = shaderStages.data();
   graphicsPipelineCreateInfo.pVertexInputState = &pipelineInfo.vertexInputState;
+  graphicsPipelineCreateInfo.subpass = pipelineInfo.subpass;
 
   return vkCreateGraphicsPipelines(device, pipelineInfo.pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline);
 }
@@ -51,6 +51,7 @@ struct PipelineCreateInfo {
   VkPipelineDepthStencilStateCreateInfo depthStencilState;
   VkPipelineVertexInputStateCreateInfo vertexInputState;
   VkPipelineCache pipelineCache;
+  u32 subpass = 0;
 };
 
 VkResult CreateGraphicsPipeline(VkDevice device, VkPipeline& pipeline, PipelineCreateInfo& pipelineInfo);
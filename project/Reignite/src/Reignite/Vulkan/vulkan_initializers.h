@@ -271,8 +271,32 @@ namespace initializers {
     return descriptorImageInfo;
   }
 
+  inline VkDescriptorUpdateTemplateEntry DescriptorUpdateTemplateEntry(VkDescriptorType type,
+    u32 binding, size_t offset, u32 descriptorCount = 1, size_t stride = 0) {
+
+    VkDescriptorUpdateTemplateEntry entry = {};
+    entry.dstBinding = binding;
+    entry.descriptorCount = descriptorCount;
+    entry.descriptorType = type;
+    entry.offset = offset;
+    entry.stride = stride;
+    return entry;
+  }
+
+  inline VkDescriptorUpdateTemplateCreateInfo DescriptorUpdateTemplateCreateInfo(
+    VkDescriptorSetLayout descriptorSetLayout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries) {
+
+    VkDescriptorUpdateTemplateCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    createInfo.pDescriptorUpdateEntries = entries.data();
+    createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    createInfo.descriptorSetLayout = descriptorSetLayout;
+    return createInfo;
+  }
+
   inline VkWriteDescriptorSet WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType type, 
-    u32 binding, VkDescriptorBufferInfo* pBufferInfo, u32 descriptorCount = 1) {
+    u32 binding, const VkDescriptorBufferInfo* pBufferInfo, u32 descriptorCount = 1) {
   
     VkWriteDescriptorSet writeDescriptorSet = {};
     writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -285,7 +309,7 @@ namespace initializers {
   }
 
   inline VkWriteDescriptorSet WriteDescriptorSet(VkDescriptorSet dstSet, VkDescriptorType type,
-    u32 binding, VkDescriptorImageInfo* pImageInfo, u32 descriptorCount = 1) {
+    u32 binding, const VkDescriptorImageInfo* pImageInfo, u32 descriptorCount = 1) {
 
     VkWriteDescriptorSet writeDescriptorSet = {};
     writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -461,6 +485,19 @@ namespace initializers {
     return createInfo;
   }
 
+  inline VkComputePipelineCreateInfo ComputePipelineCreateInfo(
+    VkPipelineLayout layout, VkPipelineShaderStageCreateInfo stage, VkPipelineCreateFlags flags = 0) {
+
+    VkComputePipelineCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    createInfo.layout = layout;
+    createInfo.stage = stage;
+    createInfo.flags = flags;
+    createInfo.basePipelineIndex = -1;
+    createInfo.basePipelineHandle = VK_NULL_HANDLE;
+    return createInfo;
+  }
+
   inline VkPushConstantRange PushConstantRange(
     VkShaderStageFlags stageFlags, u32 size, u32 offset) {
 
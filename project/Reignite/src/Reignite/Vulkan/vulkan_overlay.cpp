@@ -18,7 +18,9 @@ vk::Overlay::Overlay() {
   ImGui::StyleColorsDark();
 }
 
-void vk::Overlay::prepareResources() {
+void vk::Overlay::prepareResources(u32 frameCount) {
+
+  frames.resize(frameCount);
 
   ImGuiIO& io = ImGui::GetIO();
 
@@ -226,7 +228,12 @@ void vk::Overlay::preparePipeline(const VkPipelineCache pipelineCache, const VkR
   VK_CHECK(vkCreateGraphicsPipelines(state->device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 }
 
-bool vk::Overlay::update() {
+bool vk::Overlay::update(u32 frame) {
+
+  vk::Buffer& vertexBuffer = frames[frame].vertexBuffer;
+  vk::Buffer& indexBuffer = frames[frame].indexBuffer;
+  s32& vertexCount = frames[frame].vertexCount;
+  s32& indexCount = frames[frame].indexCount;
 
   ImDrawData* imDrawData = ImGui::GetDrawData();
   bool updateCmdBuffers = false;
@@ -275,13 +282,13 @@ bool vk::Overlay::update() {
   return updateCmdBuffers;
 }
 
-void vk::Overlay::draw(const VkCommandBuffer commandBuffer) {
+void vk::Overlay::draw(const VkCommandBuffer commandBuffer, u32 frame) {
 
   ImDrawData* imDrawData = ImGui::GetDrawData();
   int32_t vertexOffset = 0;
   int32_t indexOffset = 0;
 
-  if ((!imDrawData) || (imDrawData->CmdListsCount == 0))
+  if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || (frames[frame].vertexBuffer.buffer == VK_NULL_HANDLE))
     return;
 
   ImGuiIO& io = ImGui::GetIO();
@@ -294,8 +301,8 @@ void vk::Overlay::draw(const VkCommandBuffer commandBuffer) {
   vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
   VkDeviceSize offsets[1] = { 0 };
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-  vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frames[frame].vertexBuffer.buffer, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, frames[frame].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
   for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
 
@@ -326,8 +333,10 @@ void vk::Overlay::resize(u32 width, u32 height) {
 void vk::Overlay::freeResources() {
 
   ImGui::DestroyContext();
-  vertexBuffer.destroy();
-  indexBuffer.destroy();
+  for (FrameBuffers& buffers : frames) {
+    buffers.vertexBuffer.destroy();
+    buffers.indexBuffer.destroy();
+  }
   vkDestroyImageView(state->device, fontView, nullptr);
   vkDestroyImage(state->device, fontImage, nullptr);
   vkFreeMemory(state->device, fontMemory, nullptr);
@@ -351,3 +360,10 @@ bool vk::Overlay::sliderFloat(const char* label, float* value, float min, float
   if (res) { updated = true; }
   return res;
 }
+
+bool vk::Overlay::comboBox(const char* label, s32* index, const std::vector<const char*>& items) {
+
+  bool res = ImGui::Combo(label, index, items.data(), (s32)items.size());
+  if (res) { updated = true; }
+  return res;
+}
@@ -21,27 +21,34 @@ namespace vk {
     Overlay();
     ~Overlay() {}
 
-    void prepareResources();
+    // One set of geometry buffers per frame in flight
+    void prepareResources(u32 frameCount = 1);
     void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass);
 
-    bool update();
-    void draw(const VkCommandBuffer commandBuffer);
+    // Writes the draw data into the buffers of a frame whose previous
+    // submission is done, the draw of the same frame binds them
+    bool update(u32 frame = 0);
+    void draw(const VkCommandBuffer commandBuffer, u32 frame = 0);
     void resize(u32 width, u32 height);
 
     void freeResources();
 
     bool checkBox(const char* label, bool* value);
     bool sliderFloat(const char* label, float* value, float min, float max);
+    bool comboBox(const char* label, s32* index, const std::vector<const char*>& items);
 
     struct PushConstBlock {
       vec2f scale;
       vec2f translate;
     } pushConstBlock;
 
-    vk::Buffer vertexBuffer;
-    vk::Buffer indexBuffer;
-    s32 vertexCount = 0;
-    s32 indexCount = 0;
+    struct FrameBuffers {
+      vk::Buffer vertexBuffer;
+      vk::Buffer indexBuffer;
+      s32 vertexCount = 0;
+      s32 indexCount = 0;
+    };
+    std::vector<FrameBuffers> frames;
 
     std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -61,6 +61,19 @@ u32 vk::VulkanState::getMemoryType(u32 typeBits, VkMemoryPropertyFlags propertie
   throw std::runtime_error("Failed to find suitable memory type!");
 }
 
+bool vk::VulkanState::hasMemoryType(u32 typeBits, VkMemoryPropertyFlags properties) const {
+
+  for (u32 i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+    if ((typeBits & (1 << i)) &&
+      (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
 u32 vk::VulkanState::getQueueFamilyIndex(VkQueueFlagBits queueFlags) {
 
   if (queueFlags & VK_QUEUE_COMPUTE_BIT) {
@@ -199,6 +212,8 @@ VkResult vk::VulkanState::createDevice(VkPhysicalDeviceFeatures enabledFeatures,
 VkResult vk::VulkanState::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
   VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data) {
 
+  std::lock_guard<std::mutex> lock(allocationMutex);
+
   VkBufferCreateInfo bufferCreateInfo = vk::initializers::BufferCreateInfo(usageFlags, size);
   bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer));
@@ -235,6 +250,8 @@ VkResult vk::VulkanState::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPr
 VkResult vk::VulkanState::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
   VkDeviceSize size, vk::Buffer* buffer, void* data) {
 
+  std::lock_guard<std::mutex> lock(allocationMutex);
+
   buffer->device = device;
 
   VkBufferCreateInfo bufferCreateInfo = vk::initializers::BufferCreateInfo(usageFlags, size);
@@ -1,6 +1,7 @@
 #ifndef _RI_VULKAN_STATE_
 #define _RI_VULKAN_STATE_ 1
 
+#include <mutex>
 #include <vector>
 
 #include <volk.h>
@@ -19,6 +20,7 @@ namespace vk {
     ~VulkanState();
 
     u32 getMemoryType(u32 typeBits, VkMemoryPropertyFlags properties);
+    bool hasMemoryType(u32 typeBits, VkMemoryPropertyFlags properties) const;
 
     u32 getQueueFamilyIndex(VkQueueFlagBits queueFlags);
 
@@ -28,6 +30,8 @@ namespace vk {
       void* pNextChain, bool useSwapChain = true, 
       VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 
+    // Buffers may be created from the load workers, creation and allocation
+    // are serialised by allocationMutex
     VkResult createBuffer(
       VkBufferUsageFlags usageFlags,
       VkMemoryPropertyFlags memoryPropertyFlags,
@@ -74,6 +78,8 @@ namespace vk {
 
     VkCommandPool commandPool = VK_NULL_HANDLE;
 
+    std::mutex allocationMutex;
+
     struct {
       u32 graphics;
       u32 compute;
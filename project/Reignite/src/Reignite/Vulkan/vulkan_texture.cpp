@@ -1,11 +1,15 @@
 #include "vulkan_texture.h"
 
+#include <algorithm>
+
 #include "ktx.h"
 #include "ktxvulkan.h"
 
 #include "../tools.h"
+#include "../log.h"
 
 #include "vulkan_state.h"
+#include "vulkan_descriptors.h"
 
 
 void vk::Texture::updateDescriptor() {
@@ -20,12 +24,56 @@ void vk::Texture::destroy() {
   vkDestroyImageView(device, view, nullptr);
   vkDestroyImage(device, image, nullptr);
 
-  if (sampler)
-    vkDestroySampler(device, sampler, nullptr);
+  // The sampler belongs to the shared cache
 
   vkFreeMemory(device, deviceMemory, nullptr);
 }
 
+// Host visible transfer source, returned mapped. Unmap before submitting.
+static u8* createStagingBuffer(VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkDeviceSize size,
+  VkBuffer& stagingBuffer, VkDeviceMemory& stagingMemory) {
+
+  VkMemoryAllocateInfo memAllocInfo = vk::initializers::MemoryAllocateInfo();
+  VkMemoryRequirements memReqs = {};
+
+  VkBufferCreateInfo bufferCreateInfo = vk::initializers::BufferCreateInfo();
+  bufferCreateInfo.size = size;
+  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  VK_CHECK(vkCreateBuffer(vkDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+  vkGetBufferMemoryRequirements(vkDevice, stagingBuffer, &memReqs);
+  memAllocInfo.allocationSize = memReqs.size;
+  memAllocInfo.memoryTypeIndex = findMemoryType(vkPhysDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  VK_CHECK(vkAllocateMemory(vkDevice, &memAllocInfo, nullptr, &stagingMemory));
+  VK_CHECK(vkBindBufferMemory(vkDevice, stagingBuffer, stagingMemory, 0));
+
+  u8* data = nullptr;
+  VK_CHECK(vkMapMemory(vkDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+
+  return data;
+}
+
+u32 vk::Texture2D::MipLevelCount(u32 texWidth, u32 texHeight) {
+
+  u32 levels = 1;
+  for (u32 size = (std::max)(texWidth, texHeight); size > 1; size >>= 1)
+    levels++;
+
+  return levels;
+}
+
+bool vk::Texture2D::SupportsBlitMipmaps(VkPhysicalDevice vkPhysDevice, VkFormat format) {
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(vkPhysDevice, format, &properties);
+
+  const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  return (properties.optimalTilingFeatures & required) == required;
+}
+
 ktxResult loadKTXFile(std::string filename, ktxTexture** target) {
 
   ktxResult result = KTX_SUCCESS;
@@ -160,13 +208,13 @@ void vk::Texture2D::loadFromFile(std::string filename, VkFormat format,
   samplerCreateInfo.mipLodBias = 0.0f;
   samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
   samplerCreateInfo.minLod = 0.0f;
-  // Max level-of-detail should match mip level count
-  samplerCreateInfo.maxLod = (float)mipLevels; // TODO: (useStaging) ? (float)mipLevels : 0.0f;
+  // The view bounds the levels, one sampler serves every chain length
+  samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
   // Only enable anisotropic filtering if enabled on the devicec
   samplerCreateInfo.maxAnisotropy = 16; // TODO: device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
   samplerCreateInfo.anisotropyEnable = 1; // TODO: device->enabledFeatures.samplerAnisotropy;
   samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-  VK_CHECK(vkCreateSampler(vkDevice, &samplerCreateInfo, nullptr, &sampler));
+  sampler = vk::GetSampler(vkDevice, samplerCreateInfo);
 
   VkImageViewCreateInfo viewCreateInfo = {};
   viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -192,61 +240,95 @@ void vk::Texture2D::loadFromFileSTB(std::string filename, VkFormat format,
   bool result = Reignite::Tools::LoadTextureFile(filename, texWidth, texHeight, &texData);
   assert(result);
 
-  device = vkDevice;
-  width = (u32)texWidth;
-  height = (u32)texHeight;
-  mipLevels = 1;
+  const VkDeviceSize bufferSize = (VkDeviceSize)texWidth * texHeight * 4;
 
-  u32 texSize = width * height * 4;
+  if (!SupportsBlitMipmaps(vkPhysDevice, format)) {
 
-  VkFormatProperties formatProperties = {};
-  vkGetPhysicalDeviceFormatProperties(vkPhysDevice, format, &formatProperties);
+    RI_WARN("Format {0} can not be blitted, {1} loaded without mipmaps", (u32)format, filename.c_str());
 
-  VkMemoryAllocateInfo memAllocInfo = vk::initializers::MemoryAllocateInfo();
-  VkMemoryRequirements memReqs = {};
+    u64 mipOffset = 0;
+    loadFromBuffer(texData, bufferSize, format, (u32)texWidth, (u32)texHeight, 1, &mipOffset,
+      vkDevice, vkPhysDevice, vkCmdPool, copyQueue, imageUsageFlags, imageLayout);
 
-  VkCommandBuffer copyCmd = BeginSingleTimeCommands(vkDevice, vkCmdPool);
+    Reignite::Tools::FreeTextureData(texData);
+    return;
+  }
+
+  // Only level 0 is uploaded, the rest of the chain is blitted on the gpu
+  create(format, (u32)texWidth, (u32)texHeight, MipLevelCount((u32)texWidth, (u32)texHeight),
+    vkDevice, vkPhysDevice, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
   VkBuffer stagingBuffer = 0;
   VkDeviceMemory stagingMemory = 0;
+  u8* data = createStagingBuffer(vkDevice, vkPhysDevice, bufferSize, stagingBuffer, stagingMemory);
+  memcpy(data, texData, bufferSize);
+  vkUnmapMemory(vkDevice, stagingMemory);
 
-  VkBufferCreateInfo bufferCreateInfo = vk::initializers::BufferCreateInfo();
-  bufferCreateInfo.size = texSize;
-  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  VK_CHECK(vkCreateBuffer(vkDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+  VkCommandBuffer copyCmd = BeginSingleTimeCommands(vkDevice, vkCmdPool);
 
-  vkGetBufferMemoryRequirements(vkDevice, stagingBuffer, &memReqs);
-  memAllocInfo.allocationSize = memReqs.size;
-  memAllocInfo.memoryTypeIndex = findMemoryType(vkPhysDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  VK_CHECK(vkAllocateMemory(vkDevice, &memAllocInfo, nullptr, &stagingMemory));
-  VK_CHECK(vkBindBufferMemory(vkDevice, stagingBuffer, stagingMemory, 0));
+  VkImageSubresourceRange subresourceRange = {};
+  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresourceRange.baseMipLevel = 0;
+  subresourceRange.levelCount = mipLevels;
+  subresourceRange.layerCount = 1;
 
-  u8* data = nullptr;
-  VK_CHECK(vkMapMemory(vkDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-  memcpy(data, texData, texSize);
+  vk::tools::SetImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+  VkBufferImageCopy bufferCopyRegion = {};
+  bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  bufferCopyRegion.imageSubresource.mipLevel = 0;
+  bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+  bufferCopyRegion.imageSubresource.layerCount = 1;
+  bufferCopyRegion.imageExtent = { width, height, 1 };
+  vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+  recordMipmaps(copyCmd, imageLayout);
+
+  EndSingleTimeCommands(vkDevice, copyCmd, vkCmdPool, copyQueue);
+
+  vkFreeMemory(vkDevice, stagingMemory, nullptr);
+  vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
+
+  Reignite::Tools::FreeTextureData(texData);
+}
+
+void vk::Texture2D::loadFromBuffer(const void* buffer, VkDeviceSize bufferSize, VkFormat format,
+  u32 texWidth, u32 texHeight, u32 texMipLevels, const u64* mipOffsets,
+  VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkCommandPool vkCmdPool,
+  VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout) {
+
+  create(format, texWidth, texHeight, texMipLevels, vkDevice, vkPhysDevice, imageUsageFlags);
+
+  VkBuffer stagingBuffer = 0;
+  VkDeviceMemory stagingMemory = 0;
+  u8* data = createStagingBuffer(vkDevice, vkPhysDevice, bufferSize, stagingBuffer, stagingMemory);
+  memcpy(data, buffer, bufferSize);
   vkUnmapMemory(vkDevice, stagingMemory);
 
-  std::vector<VkBufferImageCopy> bufferCopyRegions = {}; // copy regions for each mip level
+  VkCommandBuffer copyCmd = BeginSingleTimeCommands(vkDevice, vkCmdPool);
 
-  for (u32 i = 0; i < mipLevels; ++i) {
+  recordCopy(copyCmd, stagingBuffer, 0, mipOffsets, imageLayout);
 
-    //ktx_size_t offset;
-    //KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-    //assert(result == KTX_SUCCESS);
+  EndSingleTimeCommands(vkDevice, copyCmd, vkCmdPool, copyQueue);
 
-    VkBufferImageCopy bufferCopyRegion = {};
-    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferCopyRegion.imageSubresource.mipLevel = i;
-    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-    bufferCopyRegion.imageSubresource.layerCount = 1;
-    bufferCopyRegion.imageExtent.width = texWidth >> i;
-    bufferCopyRegion.imageExtent.height = texHeight >> i;
-    bufferCopyRegion.imageExtent.depth = 1;
-    bufferCopyRegion.bufferOffset = 0; //offset;
+  vkFreeMemory(vkDevice, stagingMemory, nullptr);
+  vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
+}
 
-    bufferCopyRegions.push_back(bufferCopyRegion);
-  }
+void vk::Texture2D::create(VkFormat format, u32 texWidth, u32 texHeight, u32 texMipLevels,
+  VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkImageUsageFlags imageUsageFlags) {
+
+  device = vkDevice;
+  width = texWidth;
+  height = texHeight;
+  mipLevels = texMipLevels;
+  layerCount = 1;
+  imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkMemoryAllocateInfo memAllocInfo = vk::initializers::MemoryAllocateInfo();
+  VkMemoryRequirements memReqs = {};
 
   VkImageCreateInfo imageCreateInfo = vk::initializers::ImageCreateInfo();
   imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -272,32 +354,6 @@ void vk::Texture2D::loadFromFileSTB(std::string filename, VkFormat format,
   VK_CHECK(vkAllocateMemory(vkDevice, &memAllocInfo, nullptr, &deviceMemory));
   VK_CHECK(vkBindImageMemory(vkDevice, image, deviceMemory, 0));
 
-  VkImageSubresourceRange subresourceRange = {};
-  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  subresourceRange.baseMipLevel = 0;
-  subresourceRange.levelCount = mipLevels;
-  subresourceRange.layerCount = 1;
-
-  vk::tools::SetImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED,
-    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
-    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
-
-  vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-    static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-
-  this->imageLayout = imageLayout;
-
-  vk::tools::SetImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-    imageLayout, subresourceRange,
-    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
-
-  EndSingleTimeCommands(vkDevice, copyCmd, vkCmdPool, copyQueue);
-
-  vkFreeMemory(vkDevice, stagingMemory, nullptr);
-  vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
-
-  Reignite::Tools::FreeTextureData(texData);
-
   VkSamplerCreateInfo samplerCreateInfo = {};
   samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
@@ -309,13 +365,17 @@ void vk::Texture2D::loadFromFileSTB(std::string filename, VkFormat format,
   samplerCreateInfo.mipLodBias = 0.0f;
   samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
   samplerCreateInfo.minLod = 0.0f;
-  // Max level-of-detail should match mip level count
-  samplerCreateInfo.maxLod = (float)mipLevels; // TODO: (useStaging) ? (float)mipLevels : 0.0f;
-  // Only enable anisotropic filtering if enabled on the devicec
-  samplerCreateInfo.maxAnisotropy = 16; // TODO: device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
-  samplerCreateInfo.anisotropyEnable = 1; // TODO: device->enabledFeatures.samplerAnisotropy;
+  // The view bounds the levels, one sampler serves every chain length
+  samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+  // The render context enables anisotropy whenever the device supports it
+  VkPhysicalDeviceFeatures features;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceFeatures(vkPhysDevice, &features);
+  vkGetPhysicalDeviceProperties(vkPhysDevice, &properties);
+  samplerCreateInfo.maxAnisotropy = features.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
+  samplerCreateInfo.anisotropyEnable = features.samplerAnisotropy;
   samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-  VK_CHECK(vkCreateSampler(vkDevice, &samplerCreateInfo, nullptr, &sampler));
+  sampler = vk::GetSampler(vkDevice, samplerCreateInfo);
 
   VkImageViewCreateInfo viewCreateInfo = {};
   viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -325,13 +385,147 @@ void vk::Texture2D::loadFromFileSTB(std::string filename, VkFormat format,
   viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
   // Linear tiling usually won't support mip maps
   // Only set mip map count if optimal tiling is used
-  viewCreateInfo.subresourceRange.levelCount = mipLevels; // TODO: (useStaging) ? mipLevels : 1;
+  viewCreateInfo.subresourceRange.levelCount = mipLevels;
   viewCreateInfo.image = image;
   VK_CHECK(vkCreateImageView(vkDevice, &viewCreateInfo, nullptr, &view));
 
   updateDescriptor();
 }
 
+void vk::Texture2D::recordCopy(VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset,
+  const u64* mipOffsets, VkImageLayout imageLayout) {
+
+  std::vector<VkBufferImageCopy> bufferCopyRegions = {}; // copy regions for each mip level
+
+  for (u32 i = 0; i < mipLevels; ++i) {
+
+    VkBufferImageCopy bufferCopyRegion = {};
+    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferCopyRegion.imageSubresource.mipLevel = i;
+    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+    bufferCopyRegion.imageSubresource.layerCount = 1;
+    bufferCopyRegion.imageExtent.width = (std::max)(width >> i, 1u);
+    bufferCopyRegion.imageExtent.height = (std::max)(height >> i, 1u);
+    bufferCopyRegion.imageExtent.depth = 1;
+    bufferCopyRegion.bufferOffset = stagingOffset + mipOffsets[i];
+
+    bufferCopyRegions.push_back(bufferCopyRegion);
+  }
+
+  VkImageSubresourceRange subresourceRange = {};
+  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresourceRange.baseMipLevel = 0;
+  subresourceRange.levelCount = mipLevels;
+  subresourceRange.layerCount = 1;
+
+  vk::tools::SetImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+  vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+
+  this->imageLayout = imageLayout;
+
+  vk::tools::SetImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    imageLayout, subresourceRange,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+  updateDescriptor();
+}
+
+void vk::Texture2D::recordMipmaps(VkCommandBuffer cmd, VkImageLayout imageLayout) {
+
+  VkImageSubresourceRange subresourceRange = {};
+  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresourceRange.levelCount = 1;
+  subresourceRange.layerCount = 1;
+
+  for (u32 i = 1; i < mipLevels; ++i) {
+
+    // Previous level becomes the blit source once its own write is done
+    subresourceRange.baseMipLevel = i - 1;
+    vk::tools::SetImageLayout(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1 };
+    blit.srcOffsets[1] = { (s32)(std::max)(width >> (i - 1), 1u), (s32)(std::max)(height >> (i - 1), 1u), 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+    blit.dstOffsets[1] = { (s32)(std::max)(width >> i, 1u), (s32)(std::max)(height >> i, 1u), 1 };
+
+    vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+  }
+
+  this->imageLayout = imageLayout;
+
+  // Every level but the last was left as a blit source
+  if (mipLevels > 1) {
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = mipLevels - 1;
+    vk::tools::SetImageLayout(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      imageLayout, subresourceRange,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+  }
+
+  subresourceRange.baseMipLevel = mipLevels - 1;
+  subresourceRange.levelCount = 1;
+  vk::tools::SetImageLayout(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    imageLayout, subresourceRange,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+  updateDescriptor();
+}
+
+void vk::TextureUploadBatch::add(Texture2D* texture, const void* buffer, VkDeviceSize bufferSize,
+  const u64* mipOffsets, VkImageLayout imageLayout) {
+
+  Upload upload = {};
+  upload.texture = texture;
+  upload.buffer = buffer;
+  upload.size = bufferSize;
+  upload.layout = imageLayout;
+  memcpy(upload.mipOffsets, mipOffsets, texture->mipLevels * sizeof(u64));
+
+  uploads.push_back(upload);
+}
+
+void vk::TextureUploadBatch::submit(VkDevice vkDevice, VkPhysicalDevice vkPhysDevice,
+  VkCommandPool vkCmdPool, VkQueue copyQueue) {
+
+  if (uploads.empty())
+    return;
+
+  // One staging buffer holding every texture, 16 byte aligned per texture
+  std::vector<VkDeviceSize> offsets(uploads.size());
+  VkDeviceSize totalSize = 0;
+  for (u32 i = 0; i < uploads.size(); ++i) {
+    offsets[i] = totalSize;
+    totalSize = (totalSize + uploads[i].size + 15) & ~(VkDeviceSize)15;
+  }
+
+  VkBuffer stagingBuffer = 0;
+  VkDeviceMemory stagingMemory = 0;
+  u8* data = createStagingBuffer(vkDevice, vkPhysDevice, totalSize, stagingBuffer, stagingMemory);
+  for (u32 i = 0; i < uploads.size(); ++i)
+    memcpy(data + offsets[i], uploads[i].buffer, uploads[i].size);
+  vkUnmapMemory(vkDevice, stagingMemory);
+
+  VkCommandBuffer copyCmd = BeginSingleTimeCommands(vkDevice, vkCmdPool);
+
+  for (u32 i = 0; i < uploads.size(); ++i)
+    uploads[i].texture->recordCopy(copyCmd, stagingBuffer, offsets[i], uploads[i].mipOffsets, uploads[i].layout);
+
+  EndSingleTimeCommands(vkDevice, copyCmd, vkCmdPool, copyQueue);
+
+  vkFreeMemory(vkDevice, stagingMemory, nullptr);
+  vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
+
+  uploads.clear();
+}
+
 void vk::TextureCubeMap::loadFromFile(std::string filename, VkFormat format,
   vk::VulkanState* vulkanState, VkQueue copyQueue,
   VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout) {
@@ -340,35 +534,47 @@ void vk::TextureCubeMap::loadFromFile(std::string filename, VkFormat format,
   ktxResult result = loadKTXFile(filename, &ktxTexture);
   assert(result == KTX_SUCCESS);
 
+  // KTX keeps the six faces of a level next to each other
+  u64 mipOffsets[16];
+  u64 mipSizes[16];
+  const u32 levels = (std::min)(ktxTexture->numLevels, 16u);
+
+  for (u32 level = 0; level < levels; level++) {
+
+    ktx_size_t offset;
+    result = ktxTexture_GetImageOffset(ktxTexture, level, 0, 0, &offset);
+    assert(result == KTX_SUCCESS);
+
+    mipOffsets[level] = offset;
+    mipSizes[level] = ktxTexture_GetImageSize(ktxTexture, level) * 6;
+  }
+
+  loadFromBuffer(ktxTexture_GetData(ktxTexture), ktxTexture_GetSize(ktxTexture), format,
+    ktxTexture->baseWidth, ktxTexture->baseHeight, levels, mipOffsets, mipSizes,
+    vulkanState, copyQueue, imageUsageFlags, imageLayout);
+
+  ktxTexture_Destroy(ktxTexture);
+}
+
+void vk::TextureCubeMap::loadFromBuffer(const void* buffer, VkDeviceSize bufferSize, VkFormat format,
+  u32 texWidth, u32 texHeight, u32 texMipLevels, const u64* mipOffsets, const u64* mipSizes,
+  vk::VulkanState* vulkanState, VkQueue copyQueue,
+  VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout) {
+
   this->vulkanState = vulkanState;
-  width = ktxTexture->baseWidth;
-  height = ktxTexture->baseHeight;
-  mipLevels = ktxTexture->numLevels;
-  ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-  ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+  device = vulkanState->device;
+  width = texWidth;
+  height = texHeight;
+  mipLevels = texMipLevels;
+  layerCount = 6;
 
   VkMemoryAllocateInfo memAllocInfo = vk::initializers::MemoryAllocateInfo();
   VkMemoryRequirements memReqs;
 
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingMemory;
-
-  VkBufferCreateInfo bufferCreateInfo = vk::initializers::BufferCreateInfo();
-  bufferCreateInfo.size = ktxTextureSize;
-  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  VK_CHECK(vkCreateBuffer(vulkanState->device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-  vkGetBufferMemoryRequirements(vulkanState->device, stagingBuffer, &memReqs);
-  memAllocInfo.allocationSize = memReqs.size;
-  memAllocInfo.memoryTypeIndex = vulkanState->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-  VK_CHECK(vkAllocateMemory(vulkanState->device, &memAllocInfo, nullptr, &stagingMemory));
-  VK_CHECK(vkBindBufferMemory(vulkanState->device, stagingBuffer, stagingMemory, 0));
-
-  u8 *data;
-  VK_CHECK(vkMapMemory(vulkanState->device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-  memcpy(data, ktxTextureData, ktxTextureSize);
+  u8* data = createStagingBuffer(vulkanState->device, vulkanState->physicalDevice, bufferSize, stagingBuffer, stagingMemory);
+  memcpy(data, buffer, bufferSize);
   vkUnmapMemory(vulkanState->device, stagingMemory);
 
   std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -376,19 +582,15 @@ void vk::TextureCubeMap::loadFromFile(std::string filename, VkFormat format,
   for (u32 face = 0; face < 6; face++) {
     for (u32 level = 0; level < mipLevels; level++) {
 
-      ktx_size_t offset;
-      KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
-      assert(result == KTX_SUCCESS);
-
       VkBufferImageCopy bufferCopyRegion = {};
       bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
       bufferCopyRegion.imageSubresource.mipLevel = level;
       bufferCopyRegion.imageSubresource.baseArrayLayer = face;
       bufferCopyRegion.imageSubresource.layerCount = 1;
-      bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-      bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
+      bufferCopyRegion.imageExtent.width = (std::max)(width >> level, 1u);
+      bufferCopyRegion.imageExtent.height = (std::max)(height >> level, 1u);
       bufferCopyRegion.imageExtent.depth = 1;
-      bufferCopyRegion.bufferOffset = offset;
+      bufferCopyRegion.bufferOffset = mipOffsets[level] + mipSizes[level] / 6 * face;
       bufferCopyRegions.push_back(bufferCopyRegion);
     }
   }
@@ -467,9 +669,9 @@ void vk::TextureCubeMap::loadFromFile(std::string filename, VkFormat format,
   samplerCreateInfo.anisotropyEnable = vulkanState->enabledFeatures.samplerAnisotropy;
   samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
   samplerCreateInfo.minLod = 0.0f;
-  samplerCreateInfo.maxLod = (float)mipLevels;
+  samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
   samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-  VK_CHECK(vkCreateSampler(vulkanState->device, &samplerCreateInfo, nullptr, &sampler));
+  sampler = vk::GetSampler(vulkanState->device, samplerCreateInfo);
 
   VkImageViewCreateInfo viewCreateInfo = vk::initializers::ImageViewCreateInfo();
   viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
@@ -481,7 +683,6 @@ void vk::TextureCubeMap::loadFromFile(std::string filename, VkFormat format,
   viewCreateInfo.image = image;
   VK_CHECK(vkCreateImageView(vulkanState->device, &viewCreateInfo, nullptr, &view));
 
-  ktxTexture_Destroy(ktxTexture);
   vkFreeMemory(vulkanState->device, stagingMemory, nullptr);
   vkDestroyBuffer(vulkanState->device, stagingBuffer, nullptr);
 
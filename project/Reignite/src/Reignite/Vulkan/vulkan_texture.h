@@ -2,6 +2,7 @@
 #define _RI_VULKAN_TEXTURE_ 1
 
 #include <string>
+#include <vector>
 
 #include "../basic_types.h"
 
@@ -47,6 +48,52 @@ namespace vk {
       VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkCommandPool vkCmdPool, VkQueue copyQueue,
       VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
       VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Mip i is read from buffer + mipOffsets[i], levels are tightly packed rows
+    void loadFromBuffer(const void* buffer, VkDeviceSize bufferSize, VkFormat format,
+      u32 texWidth, u32 texHeight, u32 texMipLevels, const u64* mipOffsets,
+      VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkCommandPool vkCmdPool, VkQueue copyQueue,
+      VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Image, memory, view and sampler with undefined contents
+    void create(VkFormat format, u32 texWidth, u32 texHeight, u32 texMipLevels,
+      VkDevice vkDevice, VkPhysicalDevice vkPhysDevice,
+      VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    // Records the staging copy of every mip and the final layout transition
+    void recordCopy(VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset,
+      const u64* mipOffsets, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Blits level i from level i-1. Expects every level in TRANSFER_DST with
+    // level 0 already written, leaves the whole chain in imageLayout
+    void recordMipmaps(VkCommandBuffer cmd, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    static u32 MipLevelCount(u32 texWidth, u32 texHeight);
+    static bool SupportsBlitMipmaps(VkPhysicalDevice vkPhysDevice, VkFormat format);
+  };
+
+  // Uploads many created textures through one staging buffer, one command
+  // buffer and one queue wait. Source buffers must stay alive until submit.
+  class TextureUploadBatch {
+   public:
+
+    void add(Texture2D* texture, const void* buffer, VkDeviceSize bufferSize, const u64* mipOffsets,
+      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    void submit(VkDevice vkDevice, VkPhysicalDevice vkPhysDevice, VkCommandPool vkCmdPool, VkQueue copyQueue);
+
+   private:
+
+    struct Upload {
+      Texture2D* texture;
+      const void* buffer;
+      VkDeviceSize size;
+      u64 mipOffsets[16];
+      VkImageLayout layout;
+    };
+
+    std::vector<Upload> uploads;
   };
 
   class TextureCubeMap : public Texture {
@@ -56,6 +103,13 @@ namespace vk {
       vk::VulkanState* vulkanState, VkQueue copyQueue,
       VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
       VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // Mip i holds the six faces one after another from buffer + mipOffsets[i]
+    void loadFromBuffer(const void* buffer, VkDeviceSize bufferSize, VkFormat format,
+      u32 texWidth, u32 texHeight, u32 texMipLevels, const u64* mipOffsets, const u64* mipSizes,
+      vk::VulkanState* vulkanState, VkQueue copyQueue,
+      VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+      VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
   };
 
 } // end of vk namespace
@@ -0,0 +1,120 @@
+#include "vulkan_upload_ring.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+
+#include "vulkan_state.h"
+#include "vulkan_tools.h"
+#include "vulkan_initializers.h"
+
+
+// Staged buffer data is aligned for any uniform or storage read
+static const VkDeviceSize kWriteAlignment = 16;
+
+void vk::UploadRing::create(VulkanState* state, u32 frameCount, VkDeviceSize bytesPerFrame) {
+
+  frameSize = bytesPerFrame;
+
+  VK_CHECK(state->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    frameSize * frameCount, &staging));
+  VK_CHECK(staging.map());
+
+  begin(0);
+}
+
+void vk::UploadRing::destroy() {
+
+  staging.unmap();
+  staging.destroy();
+
+  copies.clear();
+  written.clear();
+}
+
+void vk::UploadRing::begin(u32 frame) {
+
+  regionBegin = frameSize * frame;
+  used = 0;
+
+  copies.clear();
+  written.clear();
+}
+
+bool vk::UploadRing::write(VkBuffer target, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+
+  // A rewrite lands on the staging of the first one, two copies to the same
+  // range in one command buffer would race
+  auto previous = written.find({ target, offset });
+  if (previous != written.end()) {
+    Copy& copy = copies[previous->second];
+    assert(copy.region.size == size);
+    memcpy((u8*)staging.mapped + copy.region.srcOffset, data, (size_t)size);
+    return true;
+  }
+
+  VkDeviceSize srcOffset;
+  u8* mapped = allocate(size, kWriteAlignment, srcOffset);
+  if (mapped == nullptr)
+    return false;
+
+  memcpy(mapped, data, (size_t)size);
+
+  Copy copy;
+  copy.target = target;
+  copy.region.srcOffset = srcOffset;
+  copy.region.dstOffset = offset;
+  copy.region.size = size;
+
+  written[{ target, offset }] = (u32)copies.size();
+  copies.push_back(copy);
+
+  return true;
+}
+
+u8* vk::UploadRing::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+
+  const VkDeviceSize begin = (used + alignment - 1) / alignment * alignment;
+  if (begin + size > frameSize)
+    return nullptr;
+
+  used = begin + size;
+  offset = regionBegin + begin;
+
+  return (u8*)staging.mapped + offset;
+}
+
+void vk::UploadRing::recordCopies(VkCommandBuffer cmd) {
+
+  if (copies.empty())
+    return;
+
+  // One copy command per target buffer
+  std::sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b) {
+    return std::less<VkBuffer>()(a.target, b.target);
+  });
+
+  std::vector<VkBufferCopy> regions;
+  for (u32 i = 0; i < (u32)copies.size();) {
+
+    const VkBuffer target = copies[i].target;
+    regions.clear();
+    for (; i < (u32)copies.size() && copies[i].target == target; ++i)
+      regions.push_back(copies[i].region);
+
+    vkCmdCopyBuffer(cmd, staging.buffer, target, (u32)regions.size(), regions.data());
+  }
+
+  VkMemoryBarrier barrier = vk::initializers::MemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+    0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  copies.clear();
+  written.clear();
+}
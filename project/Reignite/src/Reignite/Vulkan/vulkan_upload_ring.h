@@ -0,0 +1,65 @@
+#ifndef _RI_VULKAN_UPLOAD_RING_
+#define _RI_VULKAN_UPLOAD_RING_ 1
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <volk.h>
+
+#include "../basic_types.h"
+
+#include "vulkan_buffer.h"
+
+
+namespace vk {
+
+  class VulkanState;
+
+  // Host visible staging memory cut in one region per frame in flight. A
+  // frame writes its uploads into its own region and records the copies
+  // into its own command buffer; the region is reused once the fence of
+  // that frame has signalled, so nothing waits on the queue.
+  class UploadRing {
+   public:
+
+    void create(VulkanState* state, u32 frameCount, VkDeviceSize frameSize);
+    void destroy();
+
+    // Starts writing the region of a frame whose last submission is done
+    void begin(u32 frame);
+
+    // Stages data for a range of a device buffer. Writing the same range
+    // again in a frame only keeps the last data. False when the region is full.
+    bool write(VkBuffer target, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+    // Room for copies the caller records itself, e.g. into images. The
+    // offset is into buffer(), nullptr when the region is full.
+    u8* allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+    // The copies staged by write() and a barrier making them visible to
+    // every later read, before the frame's work
+    void recordCopies(VkCommandBuffer cmd);
+
+    VkBuffer buffer() const { return staging.buffer; }
+    VkDeviceSize frameBytes() const { return frameSize; }
+
+   private:
+
+    struct Copy {
+      VkBuffer target;
+      VkBufferCopy region;
+    };
+
+    vk::Buffer staging;
+    VkDeviceSize frameSize = 0;
+    VkDeviceSize regionBegin = 0;
+    VkDeviceSize used = 0;
+
+    std::vector<Copy> copies;
+    std::map<std::pair<VkBuffer, VkDeviceSize>, u32> written;
+  };
+
+} // end of vk namespace
+
+#endif // _RI_VULKAN_UPLOAD_RING_
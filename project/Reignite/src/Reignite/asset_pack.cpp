@@ -0,0 +1,1115 @@
+#include "asset_pack.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <emmintrin.h>
+#include <volk.h>
+
+#include "ktx.h"
+
+// imgui builds its copy static as well, the atlas packer gets its own
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+#include "tools.h"
+#include "log.h"
+#include "mesh_codec.h"
+#include "texture_codec.h"
+#include "thread_pool.h"
+
+#include "GfxResources/geometry_resource.h"
+
+
+static u64 alignUp(u64 value, u64 alignment) {
+
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Mip filtering happens on linear floats. sRGB texels go through a decode
+// table on the way in and a 12 bit encode table on the way out.
+struct MipTables {
+  float toLinear[256];
+  u8 toSRGB[4096];
+
+  MipTables() {
+    for (u32 i = 0; i < 256; ++i) {
+      const float c = i / 255.0f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (u32 i = 0; i < 4096; ++i) {
+      const float l = i / 4095.0f;
+      const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+      toSRGB[i] = (u8)(c * 255.0f + 0.5f);
+    }
+  }
+};
+
+static const MipTables& mipTables() {
+
+  static const MipTables tables;
+  return tables;
+}
+
+static void decodeLevel(const u8* texels, u32 count, bool srgb, float* level) {
+
+  const MipTables& tables = mipTables();
+
+  for (u32 i = 0; i < count; ++i) {
+    for (u32 c = 0; c < 3; ++c)
+      level[i * 4 + c] = srgb ? tables.toLinear[texels[i * 4 + c]] : texels[i * 4 + c] / 255.0f;
+    level[i * 4 + 3] = texels[i * 4 + 3] / 255.0f;
+  }
+}
+
+static void encodeLevel(const float* level, u32 count, bool srgb, u8* texels) {
+
+  const MipTables& tables = mipTables();
+  const __m128 scale = srgb ? _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f) : _mm_set1_ps(255.0f);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (u32 i = 0; i < count; ++i) {
+
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(level + i * 4), scale);
+    v = _mm_min_ps(_mm_max_ps(v, zero), scale);
+
+    alignas(16) s32 q[4];
+    _mm_store_si128((__m128i*)q, _mm_cvtps_epi32(v));
+
+    for (u32 c = 0; c < 3; ++c)
+      texels[i * 4 + c] = srgb ? tables.toSRGB[q[c]] : (u8)q[c];
+    texels[i * 4 + 3] = (u8)q[3];
+  }
+}
+
+// 2x2 box filter of a float RGBA level, one texel per SSE register. Odd
+// edges clamp and reuse the last row or column.
+static void downsampleLevel(const float* src, u32 w, u32 h, float* dst, u32 nw, u32 nh) {
+
+  const __m128 quarter = _mm_set1_ps(0.25f);
+
+  for (u32 y = 0; y < nh; ++y) {
+
+    const float* row0 = src + (std::min)(y * 2, h - 1) * w * 4;
+    const float* row1 = src + (std::min)(y * 2 + 1, h - 1) * w * 4;
+
+    for (u32 x = 0; x < nw; ++x) {
+
+      const u32 x0 = (std::min)(x * 2, w - 1) * 4;
+      const u32 x1 = (std::min)(x * 2 + 1, w - 1) * 4;
+
+      __m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+      sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+
+      _mm_storeu_ps(dst + (y * nw + x) * 4, _mm_mul_ps(sum, quarter));
+    }
+  }
+}
+
+u64 Reignite::PackKey(const std::string& path) {
+
+  // Keys are built from forward slash relative paths so a full asset path and
+  // its relative form resolve to the same entry
+  std::string key = path;
+  std::replace(key.begin(), key.end(), '\\', '/');
+
+  const std::string root = Tools::GetAssetPath();
+  if (key.compare(0, root.size(), root) == 0)
+    key = key.substr(root.size());
+
+  return Tools::HashBytes(key.data(), key.size());
+}
+
+std::string Reignite::TerrainPath(u32 width, u32 length) {
+
+  return "procedural/terrain_" + std::to_string(width) + "x" + std::to_string(length);
+}
+
+// Runtime ------------------------------------------------------------------
+
+// true when [offset, offset + size) lies inside limit, without overflowing
+static bool rangeFits(u64 offset, u64 size, u64 limit) {
+
+  return offset <= limit && size <= limit - offset;
+}
+
+// Every read through AssetPack::blob stays inside the entry's blob, and the
+// blob inside the file
+static bool entryFits(const Reignite::PackEntry& entry, u64 fileSize) {
+
+  if (!rangeFits(entry.offset, entry.size, fileSize))
+    return false;
+
+  switch (entry.type) {
+  case Reignite::kPackEntryType_Geometry:
+    if (entry.indexOffset > entry.size || entry.vertexStreamSize > entry.indexOffset)
+      return false;
+    // Raw streams are copied by their counts
+    return (entry.flags & Reignite::kPackEntryFlag_MeshCodec) ||
+      ((u64)entry.vertexCount * sizeof(Vertex) <= entry.indexOffset &&
+       (u64)entry.indexCount * sizeof(u32) <= entry.size - entry.indexOffset);
+  case Reignite::kPackEntryType_Texture:
+    if (entry.mipLevels > Reignite::kPackMaxMips)
+      return false;
+    for (u32 mip = 0; mip < entry.mipLevels; ++mip) {
+      if (!rangeFits(entry.mipOffset[mip], entry.mipSize[mip], entry.size))
+        return false;
+    }
+    return true;
+  default:
+    return true;
+  }
+}
+
+struct Reignite::AssetPack::Data {
+
+  Tools::MappedFile file;
+  const PackHeader* header = nullptr;
+  const PackEntry* entries = nullptr;
+};
+
+Reignite::AssetPack::AssetPack() {
+
+  data = new Data();
+}
+
+Reignite::AssetPack::~AssetPack() {
+
+  close();
+
+  delete data;
+}
+
+bool Reignite::AssetPack::open(const std::string& filename) {
+
+  close();
+
+  if (!Tools::MapFile(filename, data->file))
+    return false;
+
+  const Tools::MappedFile& file = data->file;
+  const PackHeader* header = (const PackHeader*)file.data;
+
+  bool valid = file.size >= sizeof(PackHeader) &&
+    header->magic == kPackMagic &&
+    header->version == kPackVersion &&
+    header->fileSize == file.size;
+
+  if (!valid) {
+    RI_WARN("Asset pack {0} is invalid or out of date, ignoring it", filename.c_str());
+    close();
+    return false;
+  }
+
+  // A truncated or corrupted pack is dropped whole, lookups never see it
+  const bool tocFits = header->tocOffset >= sizeof(PackHeader) &&
+    header->tocOffset % alignof(PackEntry) == 0 &&
+    header->tocOffset <= file.size &&
+    header->entryCount <= (file.size - header->tocOffset) / sizeof(PackEntry);
+
+  const PackEntry* entries = (const PackEntry*)(file.data + header->tocOffset);
+  for (u32 i = 0; tocFits && i < header->entryCount; ++i) {
+    if (!entryFits(entries[i], file.size) || (i > 0 && entries[i - 1].key >= entries[i].key)) {
+      RI_WARN("Asset pack {0} entry {1} is out of bounds or out of order, ignoring the pack", filename.c_str(), i);
+      close();
+      return false;
+    }
+  }
+
+  if (!tocFits) {
+    RI_WARN("Asset pack {0} table of contents does not fit the file, ignoring it", filename.c_str());
+    close();
+    return false;
+  }
+
+  data->header = header;
+  data->entries = entries;
+
+  RI_INFO("Asset pack {0} mapped with {1} entries", filename.c_str(), header->entryCount);
+
+  return true;
+}
+
+void Reignite::AssetPack::close() {
+
+  Tools::UnmapFile(data->file);
+  data->header = nullptr;
+  data->entries = nullptr;
+}
+
+bool Reignite::AssetPack::isOpen() const {
+
+  return data->header != nullptr;
+}
+
+const Reignite::PackEntry* Reignite::AssetPack::find(u64 key) const {
+
+  if (!isOpen())
+    return nullptr;
+
+  // Table of contents is sorted by key
+  const PackEntry* first = data->entries;
+  const PackEntry* last = data->entries + data->header->entryCount;
+
+  const PackEntry* entry = std::lower_bound(first, last, key,
+    [](const PackEntry& e, u64 k) { return e.key < k; });
+
+  if (entry == last || entry->key != key)
+    return nullptr;
+
+  return entry;
+}
+
+const Reignite::PackEntry* Reignite::AssetPack::find(const std::string& path) const {
+
+  return find(PackKey(path));
+}
+
+const u8* Reignite::AssetPack::blob(const PackEntry& entry, u64 offset) const {
+
+  return data->file.data + entry.offset + offset;
+}
+
+// Cooker -------------------------------------------------------------------
+
+struct Reignite::AssetCooker::Data {
+
+  std::vector<PackEntry> entries;
+  std::vector<std::vector<u8>> blobs;
+
+  ThreadPool workers;
+};
+
+Reignite::AssetCooker::AssetCooker() {
+
+  data = new Data();
+}
+
+Reignite::AssetCooker::~AssetCooker() {
+
+  delete data;
+}
+
+static bool addEntry(std::vector<Reignite::PackEntry>& entries, std::vector<std::vector<u8>>& blobs,
+  Reignite::PackEntry& entry, std::vector<u8>& blob) {
+
+  for (const Reignite::PackEntry& e : entries) {
+    if (e.key == entry.key) {
+      RI_WARN("Asset key collision, entry skipped");
+      return false;
+    }
+  }
+
+  // Hashed once here, runtime caches key derived data on it
+  entry.size = blob.size();
+  entry.contentHash = Reignite::Tools::HashBytes(blob.data(), blob.size());
+  entries.push_back(entry);
+  blobs.push_back(std::move(blob));
+
+  return true;
+}
+
+bool Reignite::CookGeometry(GeometryResource& geometry, PackEntry& entry, std::vector<u8>& blob) {
+
+  geometry.computeBounds();
+
+  entry = {};
+  entry.type = kPackEntryType_Geometry;
+  entry.vertexCount = (u32)geometry.vertices.size();
+  entry.indexCount = (u32)geometry.indices.size();
+
+  for (u32 i = 0; i < 3; ++i) {
+    entry.boundsMin[i] = geometry.boundsMin[i];
+    entry.boundsMax[i] = geometry.boundsMax[i];
+  }
+
+  std::vector<u8> vertexStream;
+  std::vector<u8> indexStream;
+  MeshCodec::EncodeVertexBuffer(geometry.vertices.data(), entry.vertexCount, sizeof(Vertex), vertexStream);
+  MeshCodec::EncodeIndexBuffer(geometry.indices.data(), entry.indexCount, indexStream);
+
+  entry.flags = kPackEntryFlag_MeshCodec;
+  entry.vertexStreamSize = vertexStream.size();
+  entry.indexOffset = alignUp(vertexStream.size(), kPackAlignment);
+
+  blob.assign(entry.indexOffset + indexStream.size(), 0);
+  memcpy(blob.data(), vertexStream.data(), vertexStream.size());
+  memcpy(blob.data() + entry.indexOffset, indexStream.data(), indexStream.size());
+
+  entry.size = blob.size();
+  return entry.vertexCount != 0;
+}
+
+bool Reignite::DecodeGeometry(const PackEntry& entry, const u8* blob, void* vertices, void* indices) {
+
+  if (!(entry.flags & kPackEntryFlag_MeshCodec)) {
+    memcpy(vertices, blob, entry.vertexCount * sizeof(Vertex));
+    memcpy(indices, blob + entry.indexOffset, entry.indexCount * sizeof(u32));
+    return true;
+  }
+
+  return MeshCodec::DecodeVertexBuffer(vertices, entry.vertexCount, sizeof(Vertex), blob, entry.vertexStreamSize) &&
+    MeshCodec::DecodeIndexBuffer((u32*)indices, entry.indexCount, blob + entry.indexOffset, entry.size - entry.indexOffset);
+}
+
+static bool blockFormat(u32 format, Reignite::TextureCodec::BlockFormat& blockFormat) {
+
+  using namespace Reignite::TextureCodec;
+
+  switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: blockFormat = kBlockFormat_BC1; return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK: blockFormat = kBlockFormat_BC2; return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK: blockFormat = kBlockFormat_BC3; return true;
+    case VK_FORMAT_BC4_UNORM_BLOCK: blockFormat = kBlockFormat_BC4; return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK: blockFormat = kBlockFormat_BC5; return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK: blockFormat = kBlockFormat_BC7; return true;
+    default: return false;
+  }
+}
+
+static bool isSRGB(u32 format) {
+
+  return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+    format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC2_SRGB_BLOCK ||
+    format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+static bool isRGBA8(u32 format) {
+
+  return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+static bool endsWith(const std::string& value, const char* suffix) {
+
+  const size_t length = strlen(suffix);
+  return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+}
+
+u32 Reignite::DefaultTextureFormat(const std::string& path, bool compressionBC) {
+
+  std::string stem = path.substr(0, path.find_last_of('.'));
+
+  if (endsWith(stem, "_normal"))
+    return compressionBC ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+
+  if (endsWith(stem, "_roughness") || endsWith(stem, "_metallic"))
+    return compressionBC ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+
+  if (stem.find("cubemap") != std::string::npos)
+    return compressionBC ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM;
+
+  return compressionBC ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+// RGBA8 levels of a source image, each level holds every layer
+struct SourceLevels {
+  u32 width;
+  u32 height;
+  u32 layers;
+  std::vector<std::vector<u8>> levels;
+};
+
+static bool loadImageLevels(const std::string& filename, bool srgb, SourceLevels& source) {
+
+  void* pixels = nullptr;
+  s32 width, height;
+  if (!Reignite::Tools::LoadTextureFile(filename, width, height, &pixels))
+    return false;
+
+  source.width = (u32)width;
+  source.height = (u32)height;
+  source.layers = 1;
+  source.levels.clear();
+
+  // Each level is box filtered from the previous one in linear space and kept
+  // as floats so rounding does not accumulate
+  u32 w = source.width;
+  u32 h = source.height;
+
+  std::vector<float> level(w * h * 4);
+  std::vector<float> next;
+  decodeLevel((const u8*)pixels, w * h, srgb, level.data());
+
+  source.levels.emplace_back((const u8*)pixels, (const u8*)pixels + (u64)w * h * 4);
+  Reignite::Tools::FreeTextureData(pixels);
+
+  while (source.levels.size() < Reignite::kPackMaxMips && (w > 1 || h > 1)) {
+
+    const u32 nw = (std::max)(w >> 1, 1u);
+    const u32 nh = (std::max)(h >> 1, 1u);
+
+    next.resize(nw * nh * 4);
+    downsampleLevel(level.data(), w, h, next.data(), nw, nh);
+
+    level.swap(next);
+    w = nw;
+    h = nh;
+
+    source.levels.emplace_back((u64)w * h * 4);
+    encodeLevel(level.data(), w * h, srgb, source.levels.back().data());
+  }
+
+  return true;
+}
+
+// KTX files keep their own mips and faces, block compressed ones are decoded
+static bool loadKTXLevels(const std::string& filename, SourceLevels& source) {
+
+  ktxTexture* texture = nullptr;
+  if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS)
+    return false;
+
+  Reignite::TextureCodec::BlockFormat compression = Reignite::TextureCodec::kBlockFormat_BC1;
+  bool supported = true;
+  switch (texture->glInternalformat) {
+    case 0x83F0: // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    case 0x83F1: compression = Reignite::TextureCodec::kBlockFormat_BC1; break;
+    case 0x83F2: compression = Reignite::TextureCodec::kBlockFormat_BC2; break;
+    case 0x83F3: compression = Reignite::TextureCodec::kBlockFormat_BC3; break;
+    case 0x8058: break; // GL_RGBA8
+    default: supported = false; break;
+  }
+
+  if (!supported || texture->numLevels == 0) {
+    RI_ERROR("Unsupported KTX source {0}", filename.c_str());
+    ktxTexture_Destroy(texture);
+    return false;
+  }
+
+  source.width = texture->baseWidth;
+  source.height = texture->baseHeight;
+  source.layers = texture->numFaces;
+  source.levels.clear();
+
+  const u8* data = ktxTexture_GetData(texture);
+  const u32 levelCount = (std::min)(texture->numLevels, Reignite::kPackMaxMips);
+
+  for (u32 level = 0; level < levelCount; ++level) {
+
+    const u32 w = (std::max)(source.width >> level, 1u);
+    const u32 h = (std::max)(source.height >> level, 1u);
+    const u64 faceSize = (u64)w * h * 4;
+
+    source.levels.emplace_back(faceSize * source.layers);
+
+    for (u32 face = 0; face < source.layers; ++face) {
+
+      ktx_size_t offset = 0;
+      ktxTexture_GetImageOffset(texture, level, 0, face, &offset);
+
+      u8* dst = source.levels.back().data() + faceSize * face;
+      if (texture->isCompressed)
+        Reignite::TextureCodec::Decode(compression, data + offset, w, h, dst);
+      else
+        memcpy(dst, data + offset, faceSize);
+    }
+  }
+
+  ktxTexture_Destroy(texture);
+  return true;
+}
+
+bool Reignite::CookTexture(const std::string& filename, u32 format, PackEntry& entry, std::vector<u8>& blob,
+  ThreadPool* workers) {
+
+  TextureCodec::BlockFormat compression;
+  const bool compressed = blockFormat(format, compression);
+  if (!compressed && !isRGBA8(format))
+    return false;
+
+  SourceLevels source;
+  const bool loaded = endsWith(filename, ".ktx") ?
+    loadKTXLevels(filename, source) : loadImageLevels(filename, isSRGB(format), source);
+  if (!loaded)
+    return false;
+
+  entry = {};
+  entry.type = kPackEntryType_Texture;
+  entry.format = format;
+  entry.width = source.width;
+  entry.height = source.height;
+  entry.layers = source.layers;
+
+  blob.clear();
+
+  for (u32 i = 0; i < source.levels.size(); ++i) {
+
+    const u32 w = (std::max)(source.width >> i, 1u);
+    const u32 h = (std::max)(source.height >> i, 1u);
+    const u64 layerSize = compressed ? TextureCodec::EncodedSize(compression, w, h) : (u64)w * h * 4;
+
+    const u64 offset = alignUp(blob.size(), 16);
+    entry.mipOffset[i] = offset;
+    entry.mipSize[i] = layerSize * source.layers;
+    entry.mipLevels++;
+
+    blob.resize(offset + entry.mipSize[i], 0);
+
+    for (u32 layer = 0; layer < source.layers; ++layer) {
+
+      const u8* texels = source.levels[i].data() + (u64)w * h * 4 * layer;
+      u8* dst = blob.data() + offset + layerSize * layer;
+
+      if (compressed)
+        TextureCodec::Encode(compression, texels, w, h, dst, workers);
+      else
+        memcpy(dst, texels, layerSize);
+    }
+  }
+
+  entry.size = blob.size();
+  return true;
+}
+
+// Universal textures keep the bytes of each mip as planes, which LZ finds far
+// more matches in. RGBA8 mips are split per channel and delta coded along the
+// texel order, block compressed mips per byte position of their blocks (the
+// endpoints of neighbouring blocks side by side, then their indices).
+static u32 planeCount(u32 format) {
+
+  Reignite::TextureCodec::BlockFormat compression;
+  return blockFormat(format, compression) ? Reignite::TextureCodec::BlockSize(compression) : 4;
+}
+
+bool Reignite::SupercompressTexture(const PackEntry& entry, const u8* blob, PackEntry& out, std::vector<u8>& outBlob) {
+
+  TextureCodec::BlockFormat compression;
+  const bool compressed = blockFormat(entry.format, compression);
+  if ((!compressed && !isRGBA8(entry.format)) || (entry.flags & kPackEntryFlag_Supercompressed))
+    return false;
+
+  out = entry;
+  out.flags |= kPackEntryFlag_Supercompressed;
+  outBlob.clear();
+
+  const u32 stride = planeCount(entry.format);
+  std::vector<u8> planes;
+
+  for (u32 i = 0; i < entry.mipLevels; ++i) {
+
+    const u64 count = entry.mipSize[i] / stride;
+    const u8* src = blob + entry.mipOffset[i];
+    planes.resize(entry.mipSize[i]);
+
+    for (u32 c = 0; c < stride; ++c) {
+
+      u8* plane = planes.data() + count * c;
+      u8 previous = 0;
+      for (u64 t = 0; t < count; ++t) {
+        const u8 value = src[t * stride + c];
+        plane[t] = compressed ? value : (u8)(value - previous);
+        previous = value;
+      }
+    }
+
+    const u64 offset = alignUp(outBlob.size(), 16);
+    outBlob.resize(offset);
+    MeshCodec::EncodeBytes(planes.data(), (u32)planes.size(), outBlob);
+
+    out.mipOffset[i] = offset;
+    out.mipSize[i] = outBlob.size() - offset;
+  }
+
+  out.size = outBlob.size();
+  return true;
+}
+
+bool Reignite::TranscodeTexture(const PackEntry& entry, const u8* blob, u32 format, PackEntry& out,
+  std::vector<u8>& outBlob, ThreadPool* workers) {
+
+  if (!(entry.flags & kPackEntryFlag_Supercompressed))
+    return false;
+
+  TextureCodec::BlockFormat stored;
+  const bool storedCompressed = blockFormat(entry.format, stored);
+
+  TextureCodec::BlockFormat compression;
+  const bool compressed = blockFormat(format, compression);
+  if (!compressed && !isRGBA8(format))
+    return false;
+
+  const u32 layers = entry.layers != 0 ? entry.layers : 1;
+  const u32 stride = planeCount(entry.format);
+
+  out = entry;
+  out.format = format;
+  out.flags &= ~kPackEntryFlag_Supercompressed;
+  out.layers = layers;
+  outBlob.clear();
+
+  std::vector<u8> planes;
+  std::vector<u8> texels;
+
+  for (u32 i = 0; i < entry.mipLevels; ++i) {
+
+    const u32 w = (std::max)(entry.width >> i, 1u);
+    const u32 h = (std::max)(entry.height >> i, 1u);
+    const u64 storedLayerSize = storedCompressed ? TextureCodec::EncodedSize(stored, w, h) : (u64)w * h * 4;
+    const u64 storedSize = storedLayerSize * layers;
+    const u64 count = storedSize / stride;
+
+    planes.resize(storedSize);
+    if (MeshCodec::DecodeBytes(planes.data(), (u32)planes.size(), blob + entry.mipOffset[i], entry.mipSize[i]) != planes.size())
+      return false;
+
+    // The stored mip, in the stored format
+    const u64 offset = alignUp(outBlob.size(), 16);
+    const bool direct = format == entry.format;
+    u8* dst = nullptr;
+    if (direct) {
+      outBlob.resize(offset + storedSize, 0);
+      dst = outBlob.data() + offset;
+    }
+    else {
+      texels.resize(storedSize);
+      dst = texels.data();
+    }
+
+    for (u32 c = 0; c < stride; ++c) {
+
+      const u8* plane = planes.data() + count * c;
+      u8 value = 0;
+      for (u64 t = 0; t < count; ++t) {
+        value = storedCompressed ? plane[t] : (u8)(value + plane[t]);
+        dst[t * stride + c] = value;
+      }
+    }
+
+    out.mipOffset[i] = offset;
+
+    // Same format on the device, only LZ was undone
+    if (direct) {
+      out.mipSize[i] = storedSize;
+      continue;
+    }
+
+    // Devices without the stored block format get it decoded, re-encoding
+    // into another block format is the slow path
+    if (storedCompressed) {
+      std::vector<u8> decoded((u64)w * h * 4 * layers);
+      for (u32 layer = 0; layer < layers; ++layer) {
+        if (!TextureCodec::Decode(stored, texels.data() + storedLayerSize * layer, w, h, decoded.data() + (u64)w * h * 4 * layer))
+          return false;
+      }
+      texels.swap(decoded);
+    }
+
+    const u64 layerSize = compressed ? TextureCodec::EncodedSize(compression, w, h) : (u64)w * h * 4;
+    out.mipSize[i] = layerSize * layers;
+    outBlob.resize(offset + out.mipSize[i], 0);
+
+    if (!compressed) {
+      memcpy(outBlob.data() + offset, texels.data(), out.mipSize[i]);
+      continue;
+    }
+
+    for (u32 layer = 0; layer < layers; ++layer) {
+      TextureCodec::Encode(compression, texels.data() + (u64)w * h * 4 * layer, w, h,
+        outBlob.data() + offset + layerSize * layer, workers);
+    }
+  }
+
+  out.size = outBlob.size();
+  return true;
+}
+
+// Block encodes every mip and layer of an RGBA8 texture
+static bool encodeTexture(const Reignite::PackEntry& entry, const u8* blob, u32 format, Reignite::PackEntry& out,
+  std::vector<u8>& outBlob, Reignite::ThreadPool* workers) {
+
+  Reignite::TextureCodec::BlockFormat compression;
+  if (!isRGBA8(entry.format) || !blockFormat(format, compression))
+    return false;
+
+  const u32 layers = entry.layers != 0 ? entry.layers : 1;
+
+  out = entry;
+  out.format = format;
+  outBlob.clear();
+
+  for (u32 i = 0; i < entry.mipLevels; ++i) {
+
+    const u32 w = (std::max)(entry.width >> i, 1u);
+    const u32 h = (std::max)(entry.height >> i, 1u);
+    const u64 layerSize = Reignite::TextureCodec::EncodedSize(compression, w, h);
+
+    const u64 offset = alignUp(outBlob.size(), 16);
+    out.mipOffset[i] = offset;
+    out.mipSize[i] = layerSize * layers;
+    outBlob.resize(offset + out.mipSize[i], 0);
+
+    for (u32 layer = 0; layer < layers; ++layer) {
+      Reignite::TextureCodec::Encode(compression, blob + entry.mipOffset[i] + (u64)w * h * 4 * layer, w, h,
+        outBlob.data() + offset + layerSize * layer, workers);
+    }
+  }
+
+  out.size = outBlob.size();
+  return true;
+}
+
+// Atlas regions start on multiples of the coarsest mip footprint and keep a
+// gutter that halves per level down to one texel
+static const u32 kAtlasAlignment = 1 << (Reignite::kAtlasMipLevels - 1);
+static const u32 kAtlasGutter = kAtlasAlignment;
+
+// Rects come in and go out in kAtlasAlignment units, the atlas starts at 256
+// and doubles its shorter side until everything fits
+static bool packAtlas(std::vector<stbrp_rect>& rects, u32& width, u32& height) {
+
+  width = 256;
+  height = 256;
+
+  std::vector<stbrp_node> nodes;
+
+  while (width <= Reignite::kAtlasMaxSize && height <= Reignite::kAtlasMaxSize) {
+
+    const int units = (int)(width / kAtlasAlignment);
+    nodes.resize(units);
+
+    stbrp_context context;
+    stbrp_init_target(&context, units, (int)(height / kAtlasAlignment), nodes.data(), units);
+
+    if (stbrp_pack_rects(&context, rects.data(), (int)rects.size()))
+      return true;
+
+    if (width <= height)
+      width <<= 1;
+    else
+      height <<= 1;
+  }
+
+  return false;
+}
+
+// Copies a region into an atlas level and replicates its edges into the gutter
+static void copyRegion(const u8* src, u32 width, u32 height, u8* dst, u32 dstWidth, u32 x, u32 y, u32 gutter) {
+
+  for (s32 dy = -(s32)gutter; dy < (s32)(height + gutter); ++dy) {
+
+    const u32 sy = (u32)(std::min)((std::max)(dy, 0), (s32)height - 1);
+    u8* row = dst + ((u64)(y + dy) * dstWidth + x - gutter) * 4;
+
+    for (s32 dx = -(s32)gutter; dx < (s32)(width + gutter); ++dx) {
+      const u32 sx = (u32)(std::min)((std::max)(dx, 0), (s32)width - 1);
+      memcpy(row + (dx + gutter) * 4, src + ((u64)sy * width + sx) * 4, 4);
+    }
+  }
+}
+
+static bool remapTexcoords(Reignite::GeometryResource& geometry, const Reignite::PackEntry& region) {
+
+  const float epsilon = 1e-3f;
+
+  for (const Vertex& vertex : geometry.vertices) {
+    for (u32 i = 0; i < 2; ++i) {
+      if (vertex.texcoord[i] < -epsilon || vertex.texcoord[i] > 1.0f + epsilon)
+        return false;
+    }
+  }
+
+  for (Vertex& vertex : geometry.vertices) {
+    for (u32 i = 0; i < 2; ++i)
+      vertex.texcoord[i] = region.uvOffset[i] + vertex.texcoord[i] * region.uvScale[i];
+  }
+
+  return true;
+}
+
+bool Reignite::AssetCooker::addObj(const std::string& path, const std::string& atlasTexture) {
+
+  GeometryResource geometry = {};
+  if (!Tools::LoadObjFile(Tools::GetAssetPath() + path, geometry, &data->workers))
+    return false;
+
+  if (!atlasTexture.empty()) {
+
+    const u64 key = PackKey(atlasTexture);
+    const PackEntry* region = nullptr;
+    for (const PackEntry& e : data->entries) {
+      if (e.key == key && e.type == kPackEntryType_AtlasRegion)
+        region = &e;
+    }
+
+    if (region == nullptr) {
+      RI_ERROR("{0} is not in an atlas, add the atlas before {1}", atlasTexture.c_str(), path.c_str());
+      return false;
+    }
+
+    if (!remapTexcoords(geometry, *region)) {
+      RI_ERROR("{0} has texcoords outside [0, 1] and cannot sample an atlas", path.c_str());
+      return false;
+    }
+  }
+
+  PackEntry entry;
+  std::vector<u8> blob;
+  if (!CookGeometry(geometry, entry, blob))
+    return false;
+
+  entry.key = PackKey(path);
+  return addEntry(data->entries, data->blobs, entry, blob);
+}
+
+bool Reignite::AssetCooker::addTerrain(u32 width, u32 length) {
+
+  GeometryResource geometry = {};
+  if (!Tools::GenerateTerrain(geometry, width, length))
+    return false;
+
+  PackEntry entry;
+  std::vector<u8> blob;
+  if (!CookGeometry(geometry, entry, blob))
+    return false;
+
+  entry.width = width;
+  entry.height = length;
+  entry.key = PackKey(TerrainPath(width, length));
+  return addEntry(data->entries, data->blobs, entry, blob);
+}
+
+bool Reignite::AssetCooker::addTexture(const std::string& path, u32 format) {
+
+  PackEntry entry;
+  std::vector<u8> blob;
+
+  if (format != VK_FORMAT_UNDEFINED) {
+    if (!CookTexture(Tools::GetAssetPath() + path, format, entry, blob, &data->workers))
+      return false;
+  }
+  else {
+    PackEntry cooked;
+    std::vector<u8> cookedBlob;
+    if (!CookTexture(Tools::GetAssetPath() + path, DefaultTextureFormat(path), cooked, cookedBlob, &data->workers) ||
+        !SupercompressTexture(cooked, cookedBlob.data(), entry, blob))
+      return false;
+  }
+
+  entry.key = PackKey(path);
+  return addEntry(data->entries, data->blobs, entry, blob);
+}
+
+bool Reignite::AssetCooker::addAtlas(const std::string& path, const std::vector<std::vector<std::string>>& sets) {
+
+  if (sets.empty() || sets[0].empty())
+    return false;
+
+  const u32 setCount = (u32)sets.size();
+  const u32 slotCount = (u32)sets[0].size();
+
+  for (const std::vector<std::string>& set : sets) {
+
+    if (set.size() != slotCount) {
+      RI_ERROR("Atlas {0} sets have different slot counts", path.c_str());
+      return false;
+    }
+
+    for (u32 slot = 0; slot < slotCount; ++slot) {
+      if (DefaultTextureFormat(set[slot]) != DefaultTextureFormat(sets[0][slot])) {
+        RI_ERROR("Atlas {0} slot {1} mixes formats with {2}", path.c_str(), slot, set[slot].c_str());
+        return false;
+      }
+    }
+  }
+
+  // sources[set * slotCount + slot], loaded on the workers
+  std::vector<SourceLevels> sources(setCount * slotCount);
+  std::vector<u8> loaded(sources.size(), 0);
+
+  data->workers.parallelFor((u32)sources.size(), [&](u32 i) {
+    const std::string& texture = sets[i / slotCount][i % slotCount];
+    loaded[i] = loadImageLevels(Tools::GetAssetPath() + texture, isSRGB(DefaultTextureFormat(texture, false)), sources[i]);
+  });
+
+  std::vector<stbrp_rect> rects(setCount);
+
+  for (u32 set = 0; set < setCount; ++set) {
+
+    const SourceLevels& first = sources[set * slotCount];
+
+    for (u32 slot = 0; slot < slotCount; ++slot) {
+
+      const SourceLevels& source = sources[set * slotCount + slot];
+      const char* texture = sets[set][slot].c_str();
+
+      if (!loaded[set * slotCount + slot])
+        return false;
+
+      if (source.width != first.width || source.height != first.height) {
+        RI_ERROR("Atlas {0}: {1} differs in size from its set", path.c_str(), texture);
+        return false;
+      }
+
+      if ((std::max)(source.width, source.height) > kAtlasMaxTextureSize ||
+          (std::min)(source.width, source.height) < kAtlasAlignment) {
+        RI_ERROR("Atlas {0}: {1} is {2}x{3}, atlased textures are {4} to {5} texels", path.c_str(), texture,
+          source.width, source.height, kAtlasAlignment, kAtlasMaxTextureSize);
+        return false;
+      }
+    }
+
+    rects[set] = {};
+    rects[set].id = (int)set;
+    rects[set].w = (int)((first.width + 2 * kAtlasGutter + kAtlasAlignment - 1) / kAtlasAlignment);
+    rects[set].h = (int)((first.height + 2 * kAtlasGutter + kAtlasAlignment - 1) / kAtlasAlignment);
+  }
+
+  u32 width, height;
+  if (!packAtlas(rects, width, height)) {
+    RI_ERROR("Atlas {0} does not fit in {1}x{1}", path.c_str(), kAtlasMaxSize);
+    return false;
+  }
+
+  for (u32 slot = 0; slot < slotCount; ++slot) {
+
+    PackEntry atlas = {};
+    atlas.type = kPackEntryType_Texture;
+    atlas.format = DefaultTextureFormat(sets[0][slot], false);
+    atlas.width = width;
+    atlas.height = height;
+    atlas.layers = 1;
+
+    // Every level of a region comes from its own mip chain, so neighbours
+    // never bleed into each other
+    std::vector<u8> texels;
+    for (u32 mip = 0; mip < kAtlasMipLevels; ++mip) {
+
+      const u32 levelWidth = width >> mip;
+      const u32 levelHeight = height >> mip;
+
+      const u64 offset = alignUp(texels.size(), 16);
+      atlas.mipOffset[mip] = offset;
+      atlas.mipSize[mip] = (u64)levelWidth * levelHeight * 4;
+      atlas.mipLevels++;
+
+      texels.resize(offset + atlas.mipSize[mip], 0);
+
+      for (u32 set = 0; set < setCount; ++set) {
+
+        const SourceLevels& source = sources[set * slotCount + slot];
+        copyRegion(source.levels[mip].data(), (std::max)(source.width >> mip, 1u), (std::max)(source.height >> mip, 1u),
+          texels.data() + offset, levelWidth,
+          (rects[set].x * kAtlasAlignment + kAtlasGutter) >> mip, (rects[set].y * kAtlasAlignment + kAtlasGutter) >> mip,
+          kAtlasGutter >> mip);
+      }
+    }
+    atlas.size = texels.size();
+
+    // Stored in the block format of its slot like every universal texture.
+    // Blocks of the coarser levels straddle neighbouring gutters, which only
+    // costs those blocks some precision.
+    PackEntry encoded;
+    std::vector<u8> encodedTexels;
+    if (!encodeTexture(atlas, texels.data(), DefaultTextureFormat(sets[0][slot]), encoded, encodedTexels, &data->workers))
+      return false;
+
+    PackEntry entry;
+    std::vector<u8> blob;
+    if (!SupercompressTexture(encoded, encodedTexels.data(), entry, blob))
+      return false;
+
+    entry.key = PackKey(path + "_" + std::to_string(slot));
+    if (!addEntry(data->entries, data->blobs, entry, blob))
+      return false;
+
+    for (u32 set = 0; set < setCount; ++set) {
+
+      const SourceLevels& source = sources[set * slotCount + slot];
+
+      PackEntry region = {};
+      region.key = PackKey(sets[set][slot]);
+      region.type = kPackEntryType_AtlasRegion;
+      region.format = entry.format;
+      region.width = source.width;
+      region.height = source.height;
+      region.atlasKey = entry.key;
+      region.uvScale[0] = (float)source.width / width;
+      region.uvScale[1] = (float)source.height / height;
+      region.uvOffset[0] = (float)(rects[set].x * kAtlasAlignment + kAtlasGutter) / width;
+      region.uvOffset[1] = (float)(rects[set].y * kAtlasAlignment + kAtlasGutter) / height;
+
+      std::vector<u8> empty;
+      if (!addEntry(data->entries, data->blobs, region, empty))
+        return false;
+    }
+  }
+
+  RI_INFO("Atlas {0}: {1} sets of {2} textures in {3}x{4}", path.c_str(), setCount, slotCount, width, height);
+  return true;
+}
+
+bool Reignite::AssetCooker::write(const std::string& filename) {
+
+  // Lay out blobs after the header, then the sorted table of contents
+  u64 cursor = alignUp(sizeof(PackHeader), kPackAlignment);
+  for (u32 i = 0; i < data->entries.size(); ++i) {
+    data->entries[i].offset = cursor;
+    cursor = alignUp(cursor + data->blobs[i].size(), kPackAlignment);
+  }
+
+  std::vector<u32> order(data->entries.size());
+  for (u32 i = 0; i < order.size(); ++i)
+    order[i] = i;
+
+  std::sort(order.begin(), order.end(),
+    [this](u32 a, u32 b) { return data->entries[a].key < data->entries[b].key; });
+
+  PackHeader header = {};
+  header.magic = kPackMagic;
+  header.version = kPackVersion;
+  header.entryCount = (u32)data->entries.size();
+  header.tocOffset = cursor;
+  header.fileSize = cursor + data->entries.size() * sizeof(PackEntry);
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    RI_ERROR("Could not create asset pack {0}", filename.c_str());
+    return false;
+  }
+
+  static const u8 zeros[kPackAlignment] = {};
+
+  u64 written = 0;
+  auto pad = [&](u64 target) {
+    while (written < target) {
+      u64 count = (std::min)(target - written, kPackAlignment);
+      fwrite(zeros, 1, count, file);
+      written += count;
+    }
+  };
+
+  fwrite(&header, sizeof(header), 1, file);
+  written += sizeof(header);
+
+  for (u32 i = 0; i < data->entries.size(); ++i) {
+    pad(data->entries[i].offset);
+    if (!data->blobs[i].empty()) // atlas regions have no blob
+      fwrite(data->blobs[i].data(), 1, data->blobs[i].size(), file);
+    written += data->blobs[i].size();
+  }
+  pad(header.tocOffset);
+
+  for (u32 i : order)
+    fwrite(&data->entries[i], sizeof(PackEntry), 1, file);
+
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+
+  if (!ok) {
+    RI_ERROR("Failed writing asset pack {0}", filename.c_str());
+    return false;
+  }
+
+  RI_INFO("Asset pack {0} written, {1} entries, {2} bytes", filename.c_str(), header.entryCount, header.fileSize);
+  return true;
+}
@@ -0,0 +1,179 @@
+#ifndef _RI_ASSET_PACK_
+#define _RI_ASSET_PACK_ 1
+
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "basic_types.h"
+
+
+namespace Reignite {
+
+  struct GeometryResource;
+  class ThreadPool;
+
+  // Binary layout shared by the cooker and the runtime. Everything is
+  // little endian and every blob starts on a kPackAlignment boundary so it
+  // can be copied straight from the mapping into a staging buffer.
+
+  static const u32 kPackMagic = 0x4B504952; // 'RIPK'
+  static const u32 kPackVersion = 7;
+  static const u64 kPackAlignment = 256;
+  static const u32 kPackMaxMips = 16;
+
+  // Atlases keep a few mips, regions are aligned and padded so each level
+  // still has a one texel gutter of replicated edges
+  static const u32 kAtlasMaxTextureSize = 256;
+  static const u32 kAtlasMaxSize = 4096;
+  static const u32 kAtlasMipLevels = 4;
+
+  enum PackEntryType {
+    kPackEntryType_Geometry = 0,
+    kPackEntryType_Texture = 1,
+    kPackEntryType_AtlasRegion = 2, // small texture living inside an atlas texture
+  };
+
+  enum PackEntryFlags {
+    kPackEntryFlag_MeshCodec = 1 << 0,       // geometry streams use MeshCodec
+    kPackEntryFlag_Supercompressed = 1 << 1, // universal texture, see SupercompressTexture
+  };
+
+  struct PackHeader {
+    u32 magic;
+    u32 version;
+    u32 entryCount;
+    u32 reserved;
+    u64 tocOffset;
+    u64 fileSize;
+  };
+
+  struct PackEntry {
+    u64 key;           // Tools::HashBytes of the asset relative path
+    u32 type;          // PackEntryType
+    u32 format;        // VkFormat for textures, unused for geometry
+    u32 flags;         // PackEntryFlags
+    u32 reserved;
+    u64 offset;        // start of the entry blob in the file
+    u64 size;          // size of the entry blob in bytes
+    u64 contentHash;   // Tools::HashBytes of the blob, set by the cooker
+
+    // Geometry: vertex data at offset, index data at offset + indexOffset.
+    // Generated terrains keep their grid size in width and height.
+    u32 vertexCount;
+    u32 indexCount;
+    u64 indexOffset;
+    u64 vertexStreamSize;
+    float boundsMin[3];
+    float boundsMax[3];
+
+    // Texture: mip i lives at offset + mipOffset[i], layers stored one after
+    // another inside each mip
+    u32 width;
+    u32 height;
+    u32 mipLevels;
+    u32 layers;
+    u64 mipOffset[kPackMaxMips];
+    u64 mipSize[kPackMaxMips];
+
+    // Atlas region: the texture is sampled from the atlas entry atlasKey at
+    // uvOffset + uv * uvScale, meshes cooked against it are already remapped
+    u64 atlasKey;
+    float uvScale[2];
+    float uvOffset[2];
+  };
+
+  u64 PackKey(const std::string& path);
+
+  // Path a generated terrain of width x length is cooked and looked up under
+  std::string TerrainPath(u32 width, u32 length);
+
+  // Processing steps shared by the cooker and the derived data cache. They
+  // fill everything in the entry except key and offset.
+  bool CookGeometry(GeometryResource& geometry, PackEntry& entry, std::vector<u8>& blob);
+  // Sources are images stb can read (full mip chain built here) or KTX files
+  // with their own mips and faces. RGBA8 formats store raw texels,
+  // BC1/2/3/4/5/7 formats are block compressed per mip and layer. Block
+  // encoding is spread over workers when given.
+  bool CookTexture(const std::string& filename, u32 format, PackEntry& entry, std::vector<u8>& blob,
+    ThreadPool* workers = nullptr);
+
+  // Universal textures: the chain in its BC format (DefaultTextureFormat),
+  // encoded once by the cooker and stored as byte planes plus LZ. Transcoding
+  // to that format only undoes the LZ, devices without BC get the blocks
+  // decoded to RGBA8. RGBA8 chains are accepted as well, as delta planes.
+  bool SupercompressTexture(const PackEntry& entry, const u8* blob, PackEntry& out, std::vector<u8>& outBlob);
+  bool TranscodeTexture(const PackEntry& entry, const u8* blob, u32 format, PackEntry& out, std::vector<u8>& outBlob,
+    ThreadPool* workers = nullptr);
+
+  // Format picked from the file name: BC5 for _normal, BC4 for _roughness and
+  // _metallic, BC7 for everything else (sRGB unless it is a cubemap), which is
+  // also the format of the universal texture. Without BC support the RGBA8
+  // format with the same color space.
+  u32 DefaultTextureFormat(const std::string& path, bool compressionBC = true);
+
+  // Expands a geometry blob into vertexCount vertices and indexCount indices
+  bool DecodeGeometry(const PackEntry& entry, const u8* blob, void* vertices, void* indices);
+
+  // Read only view of a cooked pack, the file stays mapped while open
+  class AssetPack {
+   public:
+
+    AssetPack();
+    ~AssetPack();
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const;
+
+    const PackEntry* find(u64 key) const;
+    const PackEntry* find(const std::string& path) const;
+
+    const u8* blob(const PackEntry& entry, u64 offset = 0) const;
+
+   private:
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    struct Data;
+    Data* data;
+  };
+
+  // Offline side: loads sources and writes a pack the runtime can map
+  class REIGNITE_API AssetCooker {
+   public:
+
+    AssetCooker();
+    ~AssetCooker();
+
+    // path is relative to Tools::GetAssetPath() and is also the lookup key.
+    // With atlasTexture the UVs are remapped into that texture's atlas
+    // region, they must stay inside [0, 1] since the region cannot repeat.
+    bool addObj(const std::string& path, const std::string& atlasTexture = "");
+    bool addTerrain(u32 width, u32 length);
+    // format 0 (VK_FORMAT_UNDEFINED) stores a universal texture that every
+    // device can transcode, anything else is stored ready to upload
+    bool addTexture(const std::string& path, u32 format = 0);
+    // Packs small textures into shared universal atlases. Each set is one
+    // material, its textures in slot order (color, normal, ...) and all of
+    // one size up to kAtlasMaxTextureSize. Slot k of every set goes to the
+    // atlas path_k, so slots share a layout and a mesh needs a single remap.
+    // Every texture path gets an atlas region entry.
+    bool addAtlas(const std::string& path, const std::vector<std::vector<std::string>>& sets);
+
+    bool write(const std::string& filename);
+
+   private:
+
+    AssetCooker(const AssetCooker&) = delete;
+    AssetCooker& operator=(const AssetCooker&) = delete;
+
+    struct Data;
+    Data* data;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_ASSET_PACK_
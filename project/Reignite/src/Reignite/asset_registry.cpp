@@ -0,0 +1,105 @@
+#include "asset_registry.h"
+
+#include <cassert>
+
+
+u32 Reignite::AssetRegistry::acquire(u64 key, bool& created) {
+
+  auto found = keys.find(key);
+  if (found != keys.end()) {
+    slots[HandleIndex(found->second)].references++;
+    created = false;
+    return found->second;
+  }
+
+  u32 index;
+  if (!freeSlots.empty()) {
+    index = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else {
+    index = (u32)slots.size();
+    assert(index < kHandleIndexMask);
+    slots.emplace_back();
+  }
+
+  Slot& slot = slots[index];
+  slot.key = key;
+  slot.references = 1;
+  slot.loaded = false;
+
+  const u32 id = MakeHandle(index, slot.generation);
+  keys[key] = id;
+
+  created = true;
+  return id;
+}
+
+void Reignite::AssetRegistry::track(u32 id, std::shared_future<void> load) {
+
+  assert(find(id) != nullptr);
+  slots[HandleIndex(id)].load = std::move(load);
+}
+
+void Reignite::AssetRegistry::setLoaded(u32 id) {
+
+  assert(find(id) != nullptr);
+  slots[HandleIndex(id)].loaded = true;
+  slots[HandleIndex(id)].load = std::shared_future<void>();
+}
+
+bool Reignite::AssetRegistry::isLoaded(u32 id) const {
+
+  const Slot* slot = find(id);
+  return slot != nullptr && slot->loaded;
+}
+
+bool Reignite::AssetRegistry::isPending(u32 id) const {
+
+  const Slot* slot = find(id);
+  return slot != nullptr && slot->load.valid();
+}
+
+void Reignite::AssetRegistry::wait(u32 id) const {
+
+  if (isPending(id))
+    slots[HandleIndex(id)].load.wait();
+}
+
+bool Reignite::AssetRegistry::release(u32 id) {
+
+  assert(isReferenced(id));
+
+  Slot& slot = slots[HandleIndex(id)];
+  if (--slot.references > 0)
+    return false;
+
+  slot.loaded = false;
+  slot.load = std::shared_future<void>();
+  keys.erase(slot.key);
+  return true;
+}
+
+void Reignite::AssetRegistry::recycle(u32 id) {
+
+  assert(find(id) != nullptr && slots[HandleIndex(id)].references == 0);
+
+  Slot& slot = slots[HandleIndex(id)];
+  slot.generation = (slot.generation + 1) & kHandleGenerationMask;
+  freeSlots.push_back(HandleIndex(id));
+}
+
+bool Reignite::AssetRegistry::isReferenced(u32 id) const {
+
+  const Slot* slot = find(id);
+  return slot != nullptr && slot->references > 0;
+}
+
+const Reignite::AssetRegistry::Slot* Reignite::AssetRegistry::find(u32 id) const {
+
+  const u32 index = HandleIndex(id);
+  if (id == kInvalidHandle || index >= slots.size() || slots[index].generation != HandleGeneration(id))
+    return nullptr;
+
+  return &slots[index];
+}
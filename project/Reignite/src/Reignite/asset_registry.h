@@ -0,0 +1,87 @@
+#ifndef _RI_ASSET_REGISTRY_
+#define _RI_ASSET_REGISTRY_ 1
+
+#include <future>
+#include <unordered_map>
+#include <vector>
+
+#include "basic_types.h"
+
+
+namespace Reignite {
+
+  // Handle ids pack a 20 bit slot index with a 12 bit generation. The
+  // generation moves on every time a slot is reused, so a stale handle
+  // never reaches the resource that took its place.
+  static const u32 kHandleIndexBits = 20;
+  static const u32 kHandleIndexMask = (1u << kHandleIndexBits) - 1;
+  static const u32 kHandleGenerationMask = 0xFFF;
+  static const u32 kInvalidHandle = 0xFFFFFFFF;
+
+  inline u32 HandleIndex(u32 id) { return id & kHandleIndexMask; }
+  inline u32 HandleGeneration(u32 id) { return id >> kHandleIndexBits; }
+  inline u32 MakeHandle(u32 index, u32 generation) { return (generation << kHandleIndexBits) | index; }
+
+  // Typed ids, geometry and texture slots can not be mixed up
+  struct GeometryHandle {
+    u32 id = kInvalidHandle;
+    u32 index() const { return HandleIndex(id); }
+    bool valid() const { return id != kInvalidHandle; }
+  };
+
+  struct TextureHandle {
+    u32 id = kInvalidHandle;
+    u32 index() const { return HandleIndex(id); }
+    bool valid() const { return id != kInvalidHandle; }
+  };
+
+  // Slots of loaded assets keyed by the PackKey of their path. Asking for a
+  // key again returns its handle with one more reference and shares the
+  // pending load, so a mesh reused a thousand times loads once. Slots are
+  // handed out and released on the render thread only.
+  class AssetRegistry {
+   public:
+
+    // Handle of key, created tells the caller to start the load and track it
+    u32 acquire(u64 key, bool& created);
+    void track(u32 id, std::shared_future<void> load);
+
+    // Set by the owner once the loaded asset is installed in its slot
+    void setLoaded(u32 id);
+    bool isLoaded(u32 id) const;
+    bool isPending(u32 id) const;
+
+    // Blocks until the load job is done, installing is up to the owner
+    void wait(u32 id) const;
+
+    // Drops a reference, true when it was the last one. The handle reads as
+    // unloaded and the key is forgotten, a later load starts over.
+    bool release(u32 id);
+
+    // Makes a released slot available again under a new generation, once
+    // the owner has destroyed what it held
+    void recycle(u32 id);
+
+    bool isReferenced(u32 id) const;
+    u32 size() const { return (u32)slots.size(); }
+
+   private:
+
+    struct Slot {
+      u64 key = 0;
+      u32 generation = 0;
+      u32 references = 0;
+      bool loaded = false;
+      std::shared_future<void> load;
+    };
+
+    const Slot* find(u32 id) const;
+
+    std::vector<Slot> slots;
+    std::vector<u32> freeSlots;
+    std::unordered_map<u64, u32> keys;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_ASSET_REGISTRY_
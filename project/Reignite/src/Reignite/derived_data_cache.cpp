@@ -0,0 +1,159 @@
+#include "derived_data_cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include "tools.h"
+#include "log.h"
+
+
+static const u32 kCacheMagic = 0x43444952; // 'RIDC'
+static const u32 kCacheVersion = 3;
+
+struct CacheHeader {
+  u32 magic;
+  u32 version;
+  u64 key;
+  u64 size;
+  u64 hash;
+};
+
+bool Reignite::DerivedDataCache::init(const std::string& dir) {
+
+  directory = dir;
+
+  if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+    RI_WARN("Derived data cache disabled, could not create {0}", directory.c_str());
+    enabled = false;
+    return false;
+  }
+
+  enabled = true;
+  return true;
+}
+
+u64 Reignite::DerivedDataCache::key(const std::string& sourceFile, const char* processor,
+  const void* params, u64 paramsSize) const {
+
+  Tools::MappedFile file;
+  if (!Tools::MapFile(sourceFile, file))
+    return 0;
+
+  u64 hash = Tools::HashBytes(file.data, file.size);
+  Tools::UnmapFile(file);
+
+  hash = Tools::HashBytes(processor, strlen(processor), hash);
+  if (params != nullptr)
+    hash = Tools::HashBytes(params, paramsSize, hash);
+
+  return hash != 0 ? hash : 1;
+}
+
+u64 Reignite::DerivedDataCache::key(const char* processor, const void* params, u64 paramsSize) const {
+
+  u64 hash = Tools::HashBytes(processor, strlen(processor));
+  if (params != nullptr)
+    hash = Tools::HashBytes(params, paramsSize, hash);
+
+  return hash != 0 ? hash : 1;
+}
+
+std::string Reignite::DerivedDataCache::filename(u64 key) const {
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.ddc", (unsigned long long)key);
+
+  return directory + name;
+}
+
+bool Reignite::DerivedDataCache::get(u64 key, std::vector<u8>& payload) const {
+
+  if (!enabled || key == 0)
+    return false;
+
+  Tools::MappedFile file;
+  if (!Tools::MapFile(filename(key), file))
+    return false;
+
+  const CacheHeader* header = (const CacheHeader*)file.data;
+
+  bool valid = file.size >= sizeof(CacheHeader) &&
+    header->magic == kCacheMagic &&
+    header->version == kCacheVersion &&
+    header->key == key &&
+    header->size == file.size - sizeof(CacheHeader) &&
+    header->hash == Tools::HashBytes(file.data + sizeof(CacheHeader), header->size);
+
+  if (valid)
+    payload.assign(file.data + sizeof(CacheHeader), file.data + file.size);
+
+  Tools::UnmapFile(file);
+
+  return valid;
+}
+
+bool Reignite::DerivedDataCache::put(u64 key, const void* payload, u64 size) const {
+
+  if (!enabled || key == 0)
+    return false;
+
+  CacheHeader header = {};
+  header.magic = kCacheMagic;
+  header.version = kCacheVersion;
+  header.key = key;
+  header.size = size;
+  header.hash = Tools::HashBytes(payload, size);
+
+  // Write next to the final name and rename, readers never see half a file
+  const std::string target = filename(key);
+  const std::string temp = target + ".tmp";
+
+  FILE* file = fopen(temp.c_str(), "wb");
+  if (file == nullptr)
+    return false;
+
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(payload, 1, size, file);
+
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+
+  if (!ok || !MoveFileExA(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+    DeleteFileA(temp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool Reignite::DerivedDataCache::getEntry(u64 key, PackEntry& entry, std::vector<u8>& blob) const {
+
+  std::vector<u8> payload;
+  if (!get(key, payload) || payload.size() < sizeof(PackEntry))
+    return false;
+
+  memcpy(&entry, payload.data(), sizeof(PackEntry));
+  if (entry.size != payload.size() - sizeof(PackEntry))
+    return false;
+
+  blob.assign(payload.begin() + sizeof(PackEntry), payload.end());
+  return true;
+}
+
+bool Reignite::DerivedDataCache::putEntry(u64 key, const PackEntry& entry, const std::vector<u8>& blob) const {
+
+  std::vector<u8> payload(sizeof(PackEntry) + blob.size());
+  memcpy(payload.data(), &entry, sizeof(PackEntry));
+  if (!blob.empty())
+    memcpy(payload.data() + sizeof(PackEntry), blob.data(), blob.size());
+
+  return put(key, payload.data(), payload.size());
+}
@@ -0,0 +1,45 @@
+#ifndef _RI_DERIVED_DATA_CACHE_
+#define _RI_DERIVED_DATA_CACHE_ 1
+
+#include <string>
+#include <vector>
+
+#include "basic_types.h"
+#include "asset_pack.h"
+
+
+namespace Reignite {
+
+  // Content addressed on-disk cache for processed assets. Keys hash the
+  // source bytes together with the processor name and its parameters, so
+  // editing a source or bumping a processor version simply misses.
+  class DerivedDataCache {
+   public:
+
+    bool init(const std::string& directory);
+
+    // Returns 0 when the source can not be read
+    u64 key(const std::string& sourceFile, const char* processor,
+      const void* params = nullptr, u64 paramsSize = 0) const;
+
+    // For procedural data with no source file
+    u64 key(const char* processor, const void* params, u64 paramsSize) const;
+
+    bool get(u64 key, std::vector<u8>& payload) const;
+    bool put(u64 key, const void* payload, u64 size) const;
+
+    // Payload stored as a PackEntry followed by its blob
+    bool getEntry(u64 key, PackEntry& entry, std::vector<u8>& blob) const;
+    bool putEntry(u64 key, const PackEntry& entry, const std::vector<u8>& blob) const;
+
+   private:
+
+    std::string filename(u64 key) const;
+
+    std::string directory;
+    bool enabled = false;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_DERIVED_DATA_CACHE_
@@ -0,0 +1,399 @@
+#include "forward_plus.h"
+
+#include <array>
+#include <cassert>
+
+#include "log.h"
+#include "tools.h"
+#include "light_clusters.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_framebuffer.h"
+
+
+void Reignite::ForwardPlus::create(vk::VulkanState* state, VkPipelineCache cache, VkRenderPass renderPass,
+  vk::DescriptorAllocator& descriptors, u32 width, u32 height) {
+
+  vulkanState = state;
+  device = state->device;
+  pipelineCache = cache;
+
+  createTargets(width, height);
+
+  // Culling
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, kCullBinding_Depth),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kCullBinding_Camera),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kCullBinding_Lights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kCullBinding_Tiles),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kCullBinding_Peaks)
+  };
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &cullSetLayout));
+
+  // Size of the drawn area, the culling and the composite push it
+  VkPushConstantRange cullPushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(u32) * 2, 0);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&cullSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout));
+
+  VkPipelineShaderStageCreateInfo stage = loadShader(device,
+    Tools::GetAssetPath() + "shaders/forward_lights.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+
+  VkComputePipelineCreateInfo pipelineInfo = vk::initializers::ComputePipelineCreateInfo(cullPipelineLayout, stage);
+  VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline));
+
+  vkDestroyShaderModule(device, stage.module, nullptr);
+
+  VK_CHECK(descriptors.allocate(cullSetLayout, &cullSet));
+
+  // Lighting
+  bindings = {
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kLightingBinding_ShadowLights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kLightingBinding_ShadowMap),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kLightingBinding_PointLights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kLightingBinding_Tiles)
+  };
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &lightingSetLayout));
+
+  VK_CHECK(descriptors.allocate(lightingSetLayout, &lightingSet));
+
+  // Composite
+  VkDescriptorSetLayoutBinding compositeBinding = vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(&compositeBinding, 1);
+  VK_CHECK(descriptors.createLayout(layoutInfo, &compositeSetLayout));
+
+  VkPushConstantRange compositePushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vec2f), 0);
+
+  pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&compositeSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &compositePushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &compositePipelineLayout));
+
+  PipelineCreateInfo compositeInfo;
+  compositeInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  compositeInfo.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  compositeInfo.filenames = { "deferred_pbr.vert", "composite.frag" };
+  compositeInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  compositeInfo.pipelineLayout = compositePipelineLayout;
+  compositeInfo.renderPass = renderPass;
+  compositeInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  compositeInfo.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  compositeInfo.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, compositePipeline, compositeInfo));
+
+  VK_CHECK(descriptors.allocate(compositeSetLayout, &compositeSet));
+
+  writeCompositeDescriptor();
+
+  RI_INFO("Forward+ {}x{}, {}x{} tiles", width, height, tilesX, tilesY);
+}
+
+void Reignite::ForwardPlus::destroy() {
+
+  for (MaterialPipelines& material : materials) {
+    vkDestroyPipeline(device, material.depth, nullptr);
+    vkDestroyPipeline(device, material.forward, nullptr);
+    vkDestroyPipelineLayout(device, material.layout, nullptr);
+  }
+  materials.clear();
+
+  vkDestroyPipeline(device, cullPipeline, nullptr);
+  vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, lightingSetLayout, nullptr);
+
+  vkDestroyPipeline(device, compositePipeline, nullptr);
+  vkDestroyPipelineLayout(device, compositePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, compositeSetLayout, nullptr);
+
+  destroyTargets();
+
+  // The sets go back with the allocator's pools
+  cullSet = VK_NULL_HANDLE;
+  lightingSet = VK_NULL_HANDLE;
+  compositeSet = VK_NULL_HANDLE;
+}
+
+void Reignite::ForwardPlus::resize(u32 width, u32 height) {
+
+  destroyTargets();
+  createTargets(width, height);
+  writeCompositeDescriptor();
+
+  RI_INFO("Forward+ resized to {}x{}, {}x{} tiles", width, height, tilesX, tilesY);
+}
+
+void Reignite::ForwardPlus::setRenderArea(u32 width, u32 height) {
+
+  area = { width, height };
+}
+
+void Reignite::ForwardPlus::createTargets(u32 width, u32 height) {
+
+  // Targets, both sampled: the color by the composite, the depth by the culling
+  targets = new vk::Framebuffer(vulkanState);
+  targets->width = width;
+  targets->height = height;
+  area = { width, height };
+
+  vk::AttachmentCreateInfo attachmentCreateInfo = {};
+  attachmentCreateInfo.width = width;
+  attachmentCreateInfo.height = height;
+  attachmentCreateInfo.layerCount = 1;
+
+  attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  targets->addAttachment(attachmentCreateInfo);
+
+  attachmentCreateInfo.format = VK_FORMAT_D32_SFLOAT;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  targets->addAttachment(attachmentCreateInfo);
+
+  VK_CHECK(targets->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+
+  // Prepass: the depth alone, cleared and left for the culling to sample
+  {
+    std::vector<VkAttachmentDescription> attachments = { targets->attachments[1].description };
+    std::vector<VkAttachmentReference> colorReference;
+    std::vector<VkAttachmentReference> depthReference = { { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL } };
+    VK_CHECK(CreateRenderPass(device, depthRenderPass, colorReference, depthReference, attachments));
+
+    std::vector<VkImageView> views = { targets->attachments[1].view };
+    VK_CHECK(CreateFramebuffer(device, depthFramebuffer, depthRenderPass, width, height, views));
+  }
+
+  // Forward pass: tests against the prepass depth and keeps it
+  VkAttachmentDescription& depth = targets->attachments[1].description;
+  depth.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  VK_CHECK(targets->createRenderPass());
+
+  // Count then indices for each tile, after the grid the shaders index it with
+  tilesX = (width + kTileSize - 1) / kTileSize;
+  tilesY = (height + kTileSize - 1) / kTileSize;
+
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    4 * sizeof(u32) + (VkDeviceSize)tilesX * tilesY * (1 + kMaxLightsPerTile) * sizeof(u32), &tiles));
+}
+
+void Reignite::ForwardPlus::destroyTargets() {
+
+  tiles.destroy();
+
+  // The pipelines made with these render passes work with their replacements
+  vkDestroyFramebuffer(device, depthFramebuffer, nullptr);
+  vkDestroyRenderPass(device, depthRenderPass, nullptr);
+  delete targets;
+  targets = nullptr;
+}
+
+void Reignite::ForwardPlus::writeCompositeDescriptor() {
+
+  VkDescriptorImageInfo color = vk::initializers::DescriptorImageInfo(targets->sampler,
+    targets->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  VkWriteDescriptorSet write = vk::initializers::WriteDescriptorSet(compositeSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &color);
+  vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+void Reignite::ForwardPlus::addMaterial(u32 material, const std::vector<VkDescriptorSetLayout>& setLayouts,
+  PipelineCreateInfo info, bool depthPrepass) {
+
+  if (materials.size() <= material)
+    materials.resize(material + 1);
+
+  MaterialPipelines& pipelines = materials[material];
+  assert(pipelines.forward == VK_NULL_HANDLE);
+
+  std::vector<VkDescriptorSetLayout> layouts = setLayouts;
+  layouts.push_back(lightingSetLayout);
+  pipelines.lightingSet = static_cast<u32>(setLayouts.size());
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(
+    layouts.data(), static_cast<u32>(layouts.size()));
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelines.layout));
+
+  info.pipelineLayout = pipelines.layout;
+  info.pipelineCache = pipelineCache;
+
+  if (depthPrepass) {
+
+    PipelineCreateInfo depthInfo = info;
+    depthInfo.filenames[1] = "depth_only.frag";
+    depthInfo.blendAttachmentStates.clear();
+    depthInfo.renderPass = depthRenderPass;
+    depthInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+      VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+    VK_CHECK(CreateGraphicsPipeline(device, pipelines.depth, depthInfo));
+
+    // Every visible fragment already has its depth, the rest fail the test
+    info.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+      VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  }
+  else {
+    info.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+      VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  }
+
+  info.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  info.renderPass = targets->renderPass;
+
+  VK_CHECK(CreateGraphicsPipeline(device, pipelines.forward, info));
+}
+
+void Reignite::ForwardPlus::writeDescriptors(const VkDescriptorBufferInfo& shadowLights,
+  const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters) {
+
+  VkDescriptorImageInfo depth = vk::initializers::DescriptorImageInfo(targets->sampler,
+    targets->attachments[1].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+    vk::initializers::WriteDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kCullBinding_Depth, &depth),
+    vk::initializers::WriteDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kCullBinding_Camera, &clusters.paramsDescriptor()),
+    vk::initializers::WriteDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kCullBinding_Lights, &clusters.lightsDescriptor()),
+    vk::initializers::WriteDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kCullBinding_Tiles, &tiles.descriptor),
+    vk::initializers::WriteDescriptorSet(cullSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kCullBinding_Peaks, &clusters.peaksDescriptor()),
+
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kLightingBinding_ShadowLights, &shadowLights),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kLightingBinding_ShadowMap, &shadowMap),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kLightingBinding_PointLights, &clusters.lightsDescriptor()),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kLightingBinding_Tiles, &tiles.descriptor)
+  };
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+void Reignite::ForwardPlus::beginDepthPass(VkCommandBuffer cmd) {
+
+  VkClearValue clearValue;
+  clearValue.depthStencil = { 1.0f, 0 };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = depthRenderPass;
+  renderPassBeginInfo.framebuffer = depthFramebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = 1;
+  renderPassBeginInfo.pClearValues = &clearValue;
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void Reignite::ForwardPlus::bindDepth(VkCommandBuffer cmd, u32 material) {
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, materials[material].depth);
+}
+
+void Reignite::ForwardPlus::endDepthPass(VkCommandBuffer cmd) {
+
+  vkCmdEndRenderPass(cmd);
+
+  // Prepass depth to the culling
+  VkImageMemoryBarrier depthBarrier = vk::initializers::ImageMemoryBarrier();
+  depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthBarrier.image = targets->attachments[1].image;
+  depthBarrier.subresourceRange = targets->attachments[1].subresourceRange;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSet, 0, NULL);
+  vkCmdPushConstants(cmd, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(area), &area);
+  vkCmdDispatch(cmd, (area.width + kTileSize - 1) / kTileSize, (area.height + kTileSize - 1) / kTileSize, 1);
+
+  // Tile lists to the forward fragments, which also wait to reuse the depth
+  VkBufferMemoryBarrier tilesBarrier = vk::initializers::BufferMemoryBarrier();
+  tilesBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  tilesBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  tilesBarrier.buffer = tiles.buffer;
+  tilesBarrier.offset = 0;
+  tilesBarrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 1, &tilesBarrier, 0, nullptr);
+}
+
+void Reignite::ForwardPlus::beginForwardPass(VkCommandBuffer cmd) {
+
+  std::array<VkClearValue, 2> clearValues = {};
+  clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+  clearValues[1].depthStencil = { 1.0f, 0 };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = targets->renderPass;
+  renderPassBeginInfo.framebuffer = targets->framebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = static_cast<u32>(clearValues.size());
+  renderPassBeginInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void Reignite::ForwardPlus::bindForward(VkCommandBuffer cmd, u32 material) {
+
+  const MaterialPipelines& pipelines = materials[material];
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.forward);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.layout, pipelines.lightingSet, 1, &lightingSet, 0, NULL);
+}
+
+void Reignite::ForwardPlus::endForwardPass(VkCommandBuffer cmd) {
+
+  vkCmdEndRenderPass(cmd);
+
+  // Color to the composite of the swapchain pass
+  VkImageMemoryBarrier colorBarrier = vk::initializers::ImageMemoryBarrier();
+  colorBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  colorBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  colorBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  colorBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  colorBarrier.image = targets->attachments[0].image;
+  colorBarrier.subresourceRange = targets->attachments[0].subresourceRange;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &colorBarrier);
+}
+
+void Reignite::ForwardPlus::recordComposite(VkCommandBuffer cmd) {
+
+  const vec2f size((float)area.width, (float)area.height);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &compositeSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+  vkCmdPushConstants(cmd, compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(size), &size);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
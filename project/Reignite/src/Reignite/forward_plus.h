@@ -0,0 +1,133 @@
+#ifndef _RI_FORWARD_PLUS_
+#define _RI_FORWARD_PLUS_ 1
+
+#include <vector>
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_impl.h"
+#include "Vulkan/vulkan_buffer.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+  class Framebuffer;
+}
+
+namespace Reignite {
+
+  class LightClusters;
+
+  // Forward+ shading. A depth only pass lays down the scene depth, a compute
+  // pass lists the point lights touching each 16x16 tile between its nearest
+  // and farthest depth, and the scene is drawn once more shading every
+  // fragment with the list of its tile. Only one color target and depth are
+  // written, the composition then copies the color to the screen.
+  class ForwardPlus {
+   public:
+
+    static const u32 kTileSize = 16;
+    static const u32 kMaxLightsPerTile = 128;
+
+    // Set layout of forward_lights.comp: depth, camera, point lights, tile
+    // lists, light peaks
+    enum CullBinding {
+      kCullBinding_Depth = 0,
+      kCullBinding_Camera,
+      kCullBinding_Lights,
+      kCullBinding_Tiles,
+      kCullBinding_Peaks
+    };
+
+    // Lighting set of the forward shaders, bound after the material sets
+    enum LightingBinding {
+      kLightingBinding_ShadowLights = 0,
+      kLightingBinding_ShadowMap,
+      kLightingBinding_PointLights,
+      kLightingBinding_Tiles
+    };
+
+    // Targets of width x height, the composite pipeline draws in renderPass
+    void create(vk::VulkanState* vulkanState, VkPipelineCache pipelineCache, VkRenderPass renderPass,
+      vk::DescriptorAllocator& descriptors, u32 width, u32 height);
+    void destroy();
+
+    // Targets and tile lists for a new size, writeDescriptors has to follow
+    void resize(u32 width, u32 height);
+
+    // Pixels drawn from the top left of the targets, the whole of them after
+    // create or resize. Recorded commands have to be rebuilt.
+    void setRenderArea(u32 width, u32 height);
+
+    // Forward pipeline of a material, from its shaders and set layouts. With
+    // a prepass it is also drawn depth only and shaded on the prepass depth,
+    // without one it is drawn behind everything, like the skybox.
+    void addMaterial(u32 material, const std::vector<VkDescriptorSetLayout>& setLayouts,
+      PipelineCreateInfo info, bool depthPrepass);
+
+    void writeDescriptors(const VkDescriptorBufferInfo& shadowLights, const VkDescriptorImageInfo& shadowMap,
+      const LightClusters& clusters);
+
+    // Depth prepass, ending it lists the lights of every tile
+    void beginDepthPass(VkCommandBuffer cmd);
+    void bindDepth(VkCommandBuffer cmd, u32 material);
+    void endDepthPass(VkCommandBuffer cmd);
+
+    // Forward pass, the material sets before the lighting set are bound by the caller
+    void beginForwardPass(VkCommandBuffer cmd);
+    void bindForward(VkCommandBuffer cmd, u32 material);
+    void endForwardPass(VkCommandBuffer cmd);
+
+    // Full screen draw of the color target inside the swapchain render pass
+    void recordComposite(VkCommandBuffer cmd);
+
+    bool hasMaterial(u32 material) const { return material < materials.size() && materials[material].forward != VK_NULL_HANDLE; }
+    bool hasDepthPass(u32 material) const { return hasMaterial(material) && materials[material].depth != VK_NULL_HANDLE; }
+    VkPipelineLayout pipelineLayout(u32 material) const { return materials[material].layout; }
+
+   private:
+
+    struct MaterialPipelines {
+      VkPipelineLayout layout = VK_NULL_HANDLE;
+      VkPipeline depth = VK_NULL_HANDLE;
+      VkPipeline forward = VK_NULL_HANDLE;
+      u32 lightingSet = 0;
+    };
+
+    void createTargets(u32 width, u32 height);
+    void destroyTargets();
+    void writeCompositeDescriptor();
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    // Color and depth, its render pass is the forward pass
+    vk::Framebuffer* targets = nullptr;
+    VkRenderPass depthRenderPass = VK_NULL_HANDLE;
+    VkFramebuffer depthFramebuffer = VK_NULL_HANDLE;
+    VkExtent2D area = {};
+
+    vk::Buffer tiles;
+    u32 tilesX = 0;
+    u32 tilesY = 0;
+
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet cullSet = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout lightingSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet lightingSet = VK_NULL_HANDLE;
+    std::vector<MaterialPipelines> materials;
+
+    VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout compositePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline compositePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_FORWARD_PLUS_
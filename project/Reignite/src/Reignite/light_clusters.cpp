@@ -0,0 +1,230 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "log.h"
+#include "tools.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_upload_ring.h"
+
+
+// Matches PointLight of the shaders (std430)
+struct GpuPointLight {
+  vec4f position;    // xyz, radius
+  vec4f color;       // rgb, unused
+};
+
+// Matches the ClusterParams uniform block of the shaders (std140)
+struct ClusterParams {
+  mat4f view;
+  mat4f inverseProjection;
+  float depth[4];    // near, far, slice scale, slice bias: slice = log(z) * scale - bias
+  u32 grid[4];       // clusters x, y, z, light count
+};
+
+void Reignite::LightClusters::create(vk::VulkanState* state, VkPipelineCache pipelineCache,
+  vk::DescriptorAllocator& descriptors, u32 maxLights, u32 frameCount) {
+
+  vulkanState = state;
+  device = state->device;
+  capacity = (std::max)(maxLights, 1u);
+  count = 0;
+
+  // Lights and parameters are copied in by every frame, frames in flight
+  // keep reading their own copy until then
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    (VkDeviceSize)capacity * sizeof(GpuPointLight), &lights));
+
+  // Light counts of every cluster, then kMaxLightsPerCluster indices for each
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    (VkDeviceSize)kClusterCount * (1 + kMaxLightsPerCluster) * sizeof(u32), &clusters));
+
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    sizeof(ClusterParams), &params));
+
+  // Written by the culling passes, read back one frame slot at a time
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    4 * sizeof(u32), &peakCounts));
+
+  peakReadback.resize(frameCount);
+  for (vk::Buffer& readback : peakReadback) {
+    VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      peakCounts.size, &readback));
+    VK_CHECK(readback.map());
+    memset(readback.mapped, 0, (size_t)readback.size);
+  }
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Params),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Lights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Clusters),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Peaks)
+  };
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &descriptorSetLayout));
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+  VkPipelineShaderStageCreateInfo stage = {};
+  stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stage.module = vk::tools::loadShader(device, (Tools::GetAssetPath() + "shaders/cluster_lights.comp.spv").c_str());
+  stage.pName = "main";
+  assert(stage.module != VK_NULL_HANDLE);
+
+  VkComputePipelineCreateInfo pipelineInfo = vk::initializers::ComputePipelineCreateInfo(pipelineLayout, stage);
+  VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+  vkDestroyShaderModule(device, stage.module, nullptr);
+
+  VK_CHECK(descriptors.allocate(descriptorSetLayout, &descriptorSet));
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+    vk::initializers::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_Params, &params.descriptor),
+    vk::initializers::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Lights, &lights.descriptor),
+    vk::initializers::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Clusters, &clusters.descriptor),
+    vk::initializers::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Peaks, &peakCounts.descriptor)
+  };
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+  RI_INFO("Light clusters {}x{}x{}, up to {} lights", kClustersX, kClustersY, kClustersZ, capacity);
+}
+
+void Reignite::LightClusters::destroy() {
+
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+  lights.destroy();
+  clusters.destroy();
+  params.destroy();
+  peakCounts.destroy();
+
+  for (vk::Buffer& readback : peakReadback) {
+    readback.unmap();
+    readback.destroy();
+  }
+  peakReadback.clear();
+  memset(peaks, 0, sizeof(peaks));
+
+  // The set goes back with the allocator's pools
+  descriptorSet = VK_NULL_HANDLE;
+  count = 0;
+}
+
+void Reignite::LightClusters::update(u32 lightCount, const vec4f* positions, const vec4f* colors, const float* radii,
+  const mat4f& view, const mat4f& projection, float zNear, float zFar, vk::UploadRing& uploads) {
+
+  if (lights.buffer == VK_NULL_HANDLE)
+    return;
+
+  if (lightCount > capacity)
+    RI_WARN("{} lights, only the first {} are clustered", lightCount, capacity);
+  count = (std::min)(lightCount, capacity);
+
+  std::vector<GpuPointLight> staged(count);
+  for (u32 i = 0; i < count; ++i) {
+    staged[i].position = vec4f(vec3f(positions[i]), radii[i]);
+    staged[i].color = colors[i];
+  }
+
+  if (count > 0)
+    uploads.write(lights.buffer, 0, staged.data(), (VkDeviceSize)count * sizeof(GpuPointLight));
+
+  const float scale = (float)kClustersZ / std::log(zFar / zNear);
+
+  ClusterParams values = {};
+  values.view = view;
+  values.inverseProjection = glm::inverse(projection);
+  values.depth[0] = zNear;
+  values.depth[1] = zFar;
+  values.depth[2] = scale;
+  values.depth[3] = std::log(zNear) * scale;
+  values.grid[0] = kClustersX;
+  values.grid[1] = kClustersY;
+  values.grid[2] = kClustersZ;
+  values.grid[3] = count;
+
+  uploads.write(params.buffer, 0, &values, sizeof(values));
+}
+
+void Reignite::LightClusters::recordCulling(VkCommandBuffer cmd) {
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+  // One group per depth slice, one invocation per cluster of the slice
+  vkCmdDispatch(cmd, 1, 1, kClustersZ);
+
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.buffer = clusters.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Reignite::LightClusters::recordPeaksClear(VkCommandBuffer cmd) {
+
+  vkCmdFillBuffer(cmd, peakCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.buffer = peakCounts.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Reignite::LightClusters::recordPeaksCopy(VkCommandBuffer cmd, u32 frameSlot) {
+
+  // The culling passes ran earlier in the queue, in the offscreen commands
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.buffer = peakCounts.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+  VkBufferCopy region = {};
+  region.size = peakCounts.size;
+  vkCmdCopyBuffer(cmd, peakCounts.buffer, peakReadback[frameSlot].buffer, 1, &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.buffer = peakReadback[frameSlot].buffer;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Reignite::LightClusters::readPeaks(u32 frameSlot) {
+
+  memcpy(peaks, peakReadback[frameSlot].mapped, sizeof(peaks));
+}
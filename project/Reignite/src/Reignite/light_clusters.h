@@ -0,0 +1,104 @@
+#ifndef _RI_LIGHT_CLUSTERS_
+#define _RI_LIGHT_CLUSTERS_ 1
+
+#include <vector>
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_buffer.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+  class UploadRing;
+}
+
+namespace Reignite {
+
+  // Clustered light culling. The view frustum is cut in a grid of cells,
+  // tiles on screen and exponential slices in depth, and a compute pass
+  // lists the point lights whose sphere touches each cell. Shading reads the
+  // list of its cell instead of walking every light in the scene. Lights are
+  // uploaded each frame, so they are free to move.
+  class LightClusters {
+   public:
+
+    static const u32 kClustersX = 16;
+    static const u32 kClustersY = 9;
+    static const u32 kClustersZ = 24;
+    static const u32 kClusterCount = kClustersX * kClustersY * kClustersZ;
+    static const u32 kMaxLightsPerCluster = 128;
+
+    // Bindings of cluster_lights.comp: parameters, lights, cluster lists, peaks
+    enum Binding {
+      kBinding_Params = 0,
+      kBinding_Lights,
+      kBinding_Clusters,
+      kBinding_Peaks
+    };
+
+    // Light lists with a fixed size, the culling passes keep the most lights
+    // that touched one of their cells so overflows can be reported
+    enum Peak {
+      kPeak_Clusters = 0,
+      kPeak_TiledDeferred,
+      kPeak_ForwardPlus,
+      kPeakCount
+    };
+
+    void create(vk::VulkanState* vulkanState, VkPipelineCache pipelineCache,
+      vk::DescriptorAllocator& descriptors, u32 maxLights, u32 frameCount);
+    void destroy();
+
+    // Point lights of the next frame, positions in G-buffer space (y down)
+    // with the radius in w, staged in the frame's uploads. Lights past the
+    // maximum are dropped.
+    void update(u32 count, const vec4f* positions, const vec4f* colors, const float* radii,
+      const mat4f& view, const mat4f& projection, float zNear, float zFar, vk::UploadRing& uploads);
+
+    // Bins the lights, the lists are ready for fragment and compute shaders after it
+    void recordCulling(VkCommandBuffer cmd);
+
+    // Zeroes the peaks before any culling pass of the frame
+    void recordPeaksClear(VkCommandBuffer cmd);
+
+    // Copies the peaks of the frame to the readback of its slot, readPeaks()
+    // takes them once the frame's fence has signalled
+    void recordPeaksCopy(VkCommandBuffer cmd, u32 frameSlot);
+    void readPeaks(u32 frameSlot);
+
+    // Most lights that touched one cell in the last frame read back
+    u32 peakLights(Peak peak) const { return peaks[peak]; }
+
+    const VkDescriptorBufferInfo& lightsDescriptor() const { return lights.descriptor; }
+    const VkDescriptorBufferInfo& clustersDescriptor() const { return clusters.descriptor; }
+    const VkDescriptorBufferInfo& paramsDescriptor() const { return params.descriptor; }
+    const VkDescriptorBufferInfo& peaksDescriptor() const { return peakCounts.descriptor; }
+
+    u32 lightCount() const { return count; }
+    u32 maxLights() const { return capacity; }
+
+   private:
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+
+    vk::Buffer lights;
+    vk::Buffer clusters;
+    vk::Buffer params;
+    vk::Buffer peakCounts;
+    std::vector<vk::Buffer> peakReadback;
+    u32 peaks[kPeakCount] = {};
+    u32 capacity = 0;
+    u32 count = 0;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_LIGHT_CLUSTERS_
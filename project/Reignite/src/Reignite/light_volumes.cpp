@@ -0,0 +1,409 @@
+#include "light_volumes.h"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include "log.h"
+#include "tools.h"
+#include "light_clusters.h"
+
+#include "GfxResources/geometry_resource.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_impl.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_framebuffer.h"
+
+
+void Reignite::LightVolumes::create(vk::VulkanState* state, VkPipelineCache pipelineCache, VkRenderPass compositeRenderPass,
+  vk::DescriptorAllocator& descriptors, vk::FramebufferAttachment& depth, u32 targetWidth, u32 targetHeight) {
+
+  vulkanState = state;
+  device = state->device;
+  width = targetWidth;
+  height = targetHeight;
+  area = { width, height };
+  stencil = depth.hasStencil();
+
+  // The volumes sample the depth they test against, only the stencil is written
+  depthLayout = stencil ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // Light buffer cleared, G-buffer depth kept with the stencil cleared for the marks
+  {
+    std::vector<VkAttachmentDescription> attachments(2);
+
+    attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    attachments[1].format = depth.format;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    std::vector<VkAttachmentReference> colorReference = { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } };
+    std::vector<VkAttachmentReference> depthReference = { { 1, depthLayout } };
+    VK_CHECK(CreateRenderPass(device, renderPass, colorReference, depthReference, attachments));
+  }
+
+  createTargets(depth);
+
+  // Volumes
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kVolumeBinding_Targets + i));
+  }
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kVolumeBinding_ShadowLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, kVolumeBinding_PointLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, kVolumeBinding_View));
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &volumeSetLayout));
+
+  // Proxy center and the scale taking it to a unit sphere
+  VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(vec4f), 0);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&volumeSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &volumePipelineLayout));
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
+    vk::initializers::PipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+
+  VkPipelineRasterizationStateCreateInfo rasterizationState =
+    vk::initializers::PipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE, 0);
+
+  VkPipelineColorBlendAttachmentState blendAttachmentState = vk::initializers::PipelineColorBlendAttachmentState(0, VK_FALSE);
+  VkPipelineColorBlendStateCreateInfo colorBlendState =
+    vk::initializers::PipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+
+  VkPipelineViewportStateCreateInfo viewportState = vk::initializers::PipelineViewportStateCreateInfo(1, 1, 0);
+
+  VkPipelineMultisampleStateCreateInfo multisampleState =
+    vk::initializers::PipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+
+  std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+  VkPipelineDynamicStateCreateInfo dynamicState = vk::initializers::PipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+  // Positions only
+  VkVertexInputBindingDescription vertexInputBinding =
+    vk::initializers::VertexInputBindingDescription(0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX);
+  VkVertexInputAttributeDescription vertexInputAttribute =
+    vk::initializers::VertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+
+  VkPipelineVertexInputStateCreateInfo vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  vertexInputState.vertexBindingDescriptionCount = 1;
+  vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
+  vertexInputState.vertexAttributeDescriptionCount = 1;
+  vertexInputState.pVertexAttributeDescriptions = &vertexInputAttribute;
+
+  std::array<VkPipelineShaderStageCreateInfo, 2> stages;
+  stages[0] = loadShader(device, Tools::GetAssetPath() + "shaders/light_volume.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+  stages[1] = loadShader(device, Tools::GetAssetPath() + "shaders/depth_only.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  VkPipelineDepthStencilStateCreateInfo depthStencilState =
+    vk::initializers::PipelineDepthStencilStateCreateInfo(VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+  VkGraphicsPipelineCreateInfo pipelineCreateInfo = vk::initializers::GraphicsPipelineCreateInfo(volumePipelineLayout, renderPass, 0);
+  pipelineCreateInfo.pVertexInputState = &vertexInputState;
+  pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+  pipelineCreateInfo.pRasterizationState = &rasterizationState;
+  pipelineCreateInfo.pColorBlendState = &colorBlendState;
+  pipelineCreateInfo.pMultisampleState = &multisampleState;
+  pipelineCreateInfo.pViewportState = &viewportState;
+  pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+  pipelineCreateInfo.pDynamicState = &dynamicState;
+  pipelineCreateInfo.stageCount = static_cast<u32>(stages.size());
+  pipelineCreateInfo.pStages = stages.data();
+
+  if (stencil) {
+
+    // Mark: both faces, no color. A back face behind the surface counts up
+    // and a front face behind it counts down, what is left is inside.
+    depthStencilState.stencilTestEnable = VK_TRUE;
+    depthStencilState.back.failOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.back.passOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.back.depthFailOp = VK_STENCIL_OP_INCREMENT_AND_WRAP;
+    depthStencilState.back.compareOp = VK_COMPARE_OP_ALWAYS;
+    depthStencilState.back.compareMask = 0xff;
+    depthStencilState.back.writeMask = 0xff;
+    depthStencilState.back.reference = 0;
+    depthStencilState.front = depthStencilState.back;
+    depthStencilState.front.depthFailOp = VK_STENCIL_OP_DECREMENT_AND_WRAP;
+
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &markPipeline));
+
+    // Shade: the back faces, which are there with the camera inside, on the
+    // marked pixels only, clearing the mark for the next light
+    depthStencilState.depthTestEnable = VK_FALSE;
+    depthStencilState.back.compareOp = VK_COMPARE_OP_NOT_EQUAL;
+    depthStencilState.back.passOp = VK_STENCIL_OP_ZERO;
+    depthStencilState.back.depthFailOp = VK_STENCIL_OP_KEEP;
+    depthStencilState.front = depthStencilState.back;
+  }
+  else {
+
+    // No stencil: back faces behind the surface, pixels in front of the
+    // sphere are shaded too and get nothing from the windowed falloff
+    depthStencilState.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+  }
+
+  vkDestroyShaderModule(device, stages[1].module, nullptr);
+  stages[1] = loadShader(device, Tools::GetAssetPath() + "shaders/light_volume.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+  rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
+
+  blendAttachmentState = vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_TRUE);
+  blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+  blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &shadePipeline));
+
+  vkDestroyShaderModule(device, stages[0].module, nullptr);
+  vkDestroyShaderModule(device, stages[1].module, nullptr);
+
+  VK_CHECK(descriptors.allocate(volumeSetLayout, &volumeSet));
+
+  // Resolve
+  bindings.clear();
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Targets + i));
+  }
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_ShadowLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_ShadowMap));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_LightBuffer));
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &resolveSetLayout));
+
+  pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&resolveSetLayout, 1);
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &resolvePipelineLayout));
+
+  PipelineCreateInfo resolveInfo;
+  resolveInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  resolveInfo.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  resolveInfo.filenames = { "deferred_pbr.vert", "light_resolve.frag" };
+  resolveInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  resolveInfo.pipelineLayout = resolvePipelineLayout;
+  resolveInfo.renderPass = compositeRenderPass;
+  resolveInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  resolveInfo.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  resolveInfo.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, resolvePipeline, resolveInfo));
+
+  VK_CHECK(descriptors.allocate(resolveSetLayout, &resolveSet));
+
+  RI_INFO("Light volumes {}x{}, {}", width, height, stencil ? "stencil marked" : "depth tested, no stencil");
+}
+
+void Reignite::LightVolumes::destroy() {
+
+  vkDestroyPipeline(device, markPipeline, nullptr);
+  vkDestroyPipeline(device, shadePipeline, nullptr);
+  vkDestroyPipelineLayout(device, volumePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, volumeSetLayout, nullptr);
+
+  vkDestroyPipeline(device, resolvePipeline, nullptr);
+  vkDestroyPipelineLayout(device, resolvePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, resolveSetLayout, nullptr);
+
+  destroyTargets();
+  vkDestroyRenderPass(device, renderPass, nullptr);
+
+  // The sets go back with the allocator's pools
+  volumeSet = VK_NULL_HANDLE;
+  resolveSet = VK_NULL_HANDLE;
+}
+
+void Reignite::LightVolumes::resize(vk::FramebufferAttachment& depth, u32 targetWidth, u32 targetHeight) {
+
+  destroyTargets();
+
+  width = targetWidth;
+  height = targetHeight;
+  area = { width, height };
+  createTargets(depth);
+
+  RI_INFO("Light volumes resized to {}x{}", width, height);
+}
+
+void Reignite::LightVolumes::setRenderArea(u32 areaWidth, u32 areaHeight) {
+
+  area = { areaWidth, areaHeight };
+}
+
+void Reignite::LightVolumes::createTargets(vk::FramebufferAttachment& depth) {
+
+  // Lights add up past 1.0, tonemapped by the resolve
+  lightBuffer.create(VK_FORMAT_R16G16B16A16_SFLOAT, width, height, 1, device, vulkanState->physicalDevice,
+    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+  lightBuffer.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  lightBuffer.updateDescriptor();
+
+  // The G-buffer view only has the depth aspect, an attachment needs them all
+  VkImageViewCreateInfo viewInfo = vk::initializers::ImageViewCreateInfo();
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = depth.format;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.layerCount = 1;
+  viewInfo.image = depth.image;
+  VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &depthView));
+
+  std::vector<VkImageView> views = { lightBuffer.view, depthView };
+  VK_CHECK(CreateFramebuffer(device, framebuffer, renderPass, width, height, views));
+}
+
+void Reignite::LightVolumes::destroyTargets() {
+
+  vkDestroyFramebuffer(device, framebuffer, nullptr);
+  vkDestroyImageView(device, depthView, nullptr);
+  lightBuffer.destroy();
+}
+
+void Reignite::LightVolumes::writeDescriptors(const VkDescriptorImageInfo* targets, const VkDescriptorBufferInfo& shadowLights,
+  const VkDescriptorImageInfo& shadowMap, const VkDescriptorBufferInfo& view, const LightClusters& clusters) {
+
+  // Depth first, in the layout it has inside the volume pass
+  VkDescriptorImageInfo volumeDepth = targets[0];
+  volumeDepth.imageLayout = depthLayout;
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(volumeSet,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kVolumeBinding_Targets + i, i == 0 ? &volumeDepth : &targets[i]));
+    writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(resolveSet,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kResolveBinding_Targets + i, &targets[i]));
+  }
+
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(volumeSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kVolumeBinding_ShadowLights, &shadowLights));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(volumeSet,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kVolumeBinding_PointLights, &clusters.lightsDescriptor()));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(volumeSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kVolumeBinding_View, &view));
+
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(resolveSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kResolveBinding_ShadowLights, &shadowLights));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(resolveSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kResolveBinding_ShadowMap, &shadowMap));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(resolveSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kResolveBinding_LightBuffer, &lightBuffer.descriptor));
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+void Reignite::LightVolumes::recordLighting(VkCommandBuffer cmd, const GeometryResource& proxy, u32 lightCount) {
+
+  // G-buffer writes of the pass before, the depth is tested and the stencil written
+  VkMemoryBarrier targetsBarrier = vk::initializers::MemoryBarrier();
+  targetsBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  targetsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  vkCmdPipelineBarrier(cmd,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 1, &targetsBarrier, 0, nullptr, 0, nullptr);
+
+  std::array<VkClearValue, 2> clearValues = {};
+  clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+  clearValues[1].depthStencil = { 1.0f, 0 };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = renderPass;
+  renderPassBeginInfo.framebuffer = framebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = static_cast<u32>(clearValues.size());
+  renderPassBeginInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+  // The proxy is a sphere of its bounds, its faces sit a little inside the
+  // vertices so it is grown to keep them out of the light radius
+  vec3f center = (proxy.boundsMin + proxy.boundsMax) * 0.5f;
+  vec3f extent = (proxy.boundsMax - proxy.boundsMin) * 0.5f;
+  float radius = (std::min)(extent.x, (std::min)(extent.y, extent.z));
+  vec4f scale = vec4f(center, radius > 0.0f ? 1.1f / radius : 0.0f);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, volumePipelineLayout, 0, 1, &volumeSet, 0, NULL);
+  vkCmdPushConstants(cmd, volumePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vec4f), &scale);
+
+  VkDeviceSize offsets[1] = { 0 };
+  vkCmdBindVertexBuffers(cmd, 0, 1, &proxy.vertexBuffer.buffer, offsets);
+  vkCmdBindIndexBuffer(cmd, proxy.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+  // The instance picks the light, the marks of one light are cleared by its own shading
+  if (stencil) {
+
+    for (u32 i = 0; i < lightCount; ++i) {
+
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, markPipeline);
+      vkCmdDrawIndexed(cmd, proxy.indicesSize, 1, 0, 0, i);
+
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadePipeline);
+      vkCmdDrawIndexed(cmd, proxy.indicesSize, 1, 0, 0, i);
+    }
+  }
+  else {
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadePipeline);
+    vkCmdDrawIndexed(cmd, proxy.indicesSize, lightCount, 0, 0, 0);
+  }
+
+  vkCmdEndRenderPass(cmd);
+
+  // Light buffer to the resolve of the swapchain pass
+  VkImageMemoryBarrier lightBarrier = vk::initializers::ImageMemoryBarrier();
+  lightBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  lightBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  lightBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  lightBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  lightBarrier.image = lightBuffer.image;
+  lightBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &lightBarrier);
+}
+
+void Reignite::LightVolumes::recordComposite(VkCommandBuffer cmd) {
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, resolvePipelineLayout, 0, 1, &resolveSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, resolvePipeline);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
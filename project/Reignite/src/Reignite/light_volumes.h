@@ -0,0 +1,105 @@
+#ifndef _RI_LIGHT_VOLUMES_
+#define _RI_LIGHT_VOLUMES_ 1
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_texture.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+  struct FramebufferAttachment;
+}
+
+namespace Reignite {
+
+  class LightClusters;
+  struct GeometryResource;
+
+  // Deferred point lights drawn as their bounding spheres. Each light marks
+  // in stencil the G-buffer pixels inside its sphere, front and back faces
+  // counting depth test failures, then its back faces shade only the marked
+  // pixels, adding to an HDR light buffer and clearing the mark. The cost
+  // follows the screen area of the lights instead of their count. The
+  // composition adds the ambient, tonemaps and applies the shadows.
+  class LightVolumes {
+   public:
+
+    static const u32 kTargetCount = 4;
+
+    // Set layout of light_volume: G-buffer, shadow lights (for the view
+    // position), point lights, camera
+    enum VolumeBinding {
+      kVolumeBinding_Targets = 0,
+      kVolumeBinding_ShadowLights = kVolumeBinding_Targets + kTargetCount,
+      kVolumeBinding_PointLights,
+      kVolumeBinding_View
+    };
+
+    // Set layout of light_resolve.frag: G-buffer, shadow lights, shadow map, light buffer
+    enum ResolveBinding {
+      kResolveBinding_Targets = 0,
+      kResolveBinding_ShadowLights = kResolveBinding_Targets + kTargetCount,
+      kResolveBinding_ShadowMap,
+      kResolveBinding_LightBuffer
+    };
+
+    // Light buffer of the G-buffer size. depth is the G-buffer depth, it has
+    // to be stored by the G-buffer pass; without stencil in its format the
+    // lights fall back to a single depth tested pass of their back faces.
+    void create(vk::VulkanState* vulkanState, VkPipelineCache pipelineCache, VkRenderPass renderPass,
+      vk::DescriptorAllocator& descriptors, vk::FramebufferAttachment& depth, u32 width, u32 height);
+    void destroy();
+
+    // Light buffer for a resized G-buffer, writeDescriptors has to follow
+    void resize(vk::FramebufferAttachment& depth, u32 width, u32 height);
+
+    // Pixels lit from the top left of the G-buffer, the whole of it after
+    // create or resize. Recorded commands have to be rebuilt.
+    void setRenderArea(u32 width, u32 height);
+
+    // targets holds the G-buffer images: depth, normal, albedo, material
+    void writeDescriptors(const VkDescriptorImageInfo* targets, const VkDescriptorBufferInfo& shadowLights,
+      const VkDescriptorImageInfo& shadowMap, const VkDescriptorBufferInfo& view, const LightClusters& clusters);
+
+    // After the G-buffer pass, draws lightCount lights with proxy, a closed
+    // mesh around the origin, leaving the light buffer ready for fragment shaders
+    void recordLighting(VkCommandBuffer cmd, const GeometryResource& proxy, u32 lightCount);
+
+    // Full screen resolve of the light buffer inside the swapchain render pass
+    void recordComposite(VkCommandBuffer cmd);
+
+   private:
+
+    void createTargets(vk::FramebufferAttachment& depth);
+    void destroyTargets();
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    bool stencil = false;
+    VkImageLayout depthLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    u32 width = 0;
+    u32 height = 0;
+    VkExtent2D area = {};
+
+    vk::Texture2D lightBuffer;
+    VkImageView depthView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout volumeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout volumePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline markPipeline = VK_NULL_HANDLE;
+    VkPipeline shadePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet volumeSet = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout resolveSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout resolvePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline resolvePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet resolveSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_LIGHT_VOLUMES_
@@ -0,0 +1,549 @@
+#include "mesh_codec.h"
+
+#include <cstring>
+
+#include <emmintrin.h>
+
+
+// LZ stage --------------------------------------------------------------------
+//
+// Sequences of [token][literal length+][literals][offset u16][match length+].
+// Token high nibble is literal length, low nibble is match length - 4, a nibble
+// of 15 continues in following bytes (255 means keep adding). The last sequence
+// only has literals and ends the stream.
+
+static const u32 kMinMatch = 4;
+static const u32 kLastLiterals = 8;
+static const u32 kMaxOffset = 0xFFFF;
+static const u32 kHashBits = 16;
+
+// Vertices are coded in independent chunks small enough to stay in cache
+static const u32 kVertexChunk = 4096;
+static const u32 kMaxStride = 256;
+
+static u32 read32(const u8* p) {
+
+  u32 value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static void writeLength(std::vector<u8>& out, u32 length) {
+
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back((u8)length);
+}
+
+static void emitSequence(std::vector<u8>& out, const u8* literals, u32 literalLength, u32 offset, u32 matchLength) {
+
+  const u32 matchCode = matchLength - kMinMatch;
+  const u8 token = (u8)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+  out.push_back(token);
+
+  if (literalLength >= 15)
+    writeLength(out, literalLength - 15);
+
+  out.insert(out.end(), literals, literals + literalLength);
+
+  out.push_back((u8)(offset & 0xFF));
+  out.push_back((u8)(offset >> 8));
+
+  if (matchCode >= 15)
+    writeLength(out, matchCode - 15);
+}
+
+static void emitLastLiterals(std::vector<u8>& out, const u8* literals, u32 literalLength) {
+
+  out.push_back((u8)((literalLength < 15 ? literalLength : 15) << 4));
+
+  if (literalLength >= 15)
+    writeLength(out, literalLength - 15);
+
+  out.insert(out.end(), literals, literals + literalLength);
+}
+
+static void lzCompress(const u8* src, u32 size, std::vector<u8>& out) {
+
+  const size_t start = out.size();
+  out.resize(start + sizeof(u32));
+  memcpy(&out[start], &size, sizeof(u32));
+
+  std::vector<u32> table((size_t)1 << kHashBits, 0xFFFFFFFF);
+
+  const u32 limit = size > kLastLiterals + kMinMatch ? size - kLastLiterals : 0;
+
+  u32 anchor = 0;
+  u32 i = 0;
+
+  while (i + kMinMatch <= limit) {
+
+    const u32 sequence = read32(src + i);
+    const u32 hash = (sequence * 2654435761u) >> (32 - kHashBits);
+
+    const u32 candidate = table[hash];
+    table[hash] = i;
+
+    if (candidate != 0xFFFFFFFF && i - candidate <= kMaxOffset && read32(src + candidate) == sequence) {
+
+      u32 length = kMinMatch;
+      while (i + length < limit && src[candidate + length] == src[i + length])
+        ++length;
+
+      emitSequence(out, src + anchor, i - anchor, i - candidate, length);
+
+      i += length;
+      anchor = i;
+    }
+    else {
+      ++i;
+    }
+  }
+
+  emitLastLiterals(out, src + anchor, size - anchor);
+}
+
+static bool readLength(const u8*& ip, const u8* iend, u32& length) {
+
+  u8 byte;
+  do {
+    if (ip >= iend)
+      return false;
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+
+  return true;
+}
+
+// Copies 16 bytes at a time, may write up to 15 bytes past length
+static void wildCopy(u8* dst, const u8* src, u32 length) {
+
+  u8* end = dst + length;
+  do {
+    _mm_storeu_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+    dst += 16;
+    src += 16;
+  } while (dst < end);
+}
+
+// Returns the decompressed size, 0 on malformed input
+static u32 lzDecompress(const u8* data, u64 size, u8* dst, u32 capacity) {
+
+  if (size < sizeof(u32))
+    return 0;
+
+  u32 rawSize;
+  memcpy(&rawSize, data, sizeof(u32));
+  if (rawSize > capacity)
+    return 0;
+
+  const u8* ip = data + sizeof(u32);
+  const u8* iend = data + size;
+  u8* op = dst;
+  u8* oend = dst + rawSize;
+
+  while (ip < iend) {
+
+    const u8 token = *ip++;
+
+    u32 literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(ip, iend, literalLength))
+      return 0;
+
+    if (literalLength > (u32)(iend - ip) || literalLength > (u32)(oend - op))
+      return 0;
+
+    if (ip + literalLength + 16 <= iend && op + literalLength + 16 <= oend)
+      wildCopy(op, ip, literalLength);
+    else
+      memcpy(op, ip, literalLength);
+
+    ip += literalLength;
+    op += literalLength;
+
+    if (ip == iend)
+      break;
+
+    if (iend - ip < 2)
+      return 0;
+
+    const u32 offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+
+    u32 matchLength = token & 15;
+    if (matchLength == 15 && !readLength(ip, iend, matchLength))
+      return 0;
+    matchLength += kMinMatch;
+
+    if (offset == 0 || offset > (u32)(op - dst) || matchLength > (u32)(oend - op))
+      return 0;
+
+    const u8* match = op - offset;
+
+    if (offset >= 16 && op + matchLength + 16 <= oend) {
+      wildCopy(op, match, matchLength);
+    }
+    else if (offset >= 8 && op + matchLength + 8 <= oend) {
+      for (u32 i = 0; i < matchLength; i += 8)
+        memcpy(op + i, match + i, 8);
+    }
+    else if (offset == 1) {
+      memset(op, *match, matchLength);
+    }
+    else {
+      for (u32 i = 0; i < matchLength; ++i)
+        op[i] = match[i];
+    }
+
+    op += matchLength;
+  }
+
+  return op == oend ? rawSize : 0;
+}
+
+static u8* scratch(u64 size) {
+
+  static thread_local std::vector<u8> buffer;
+  if (buffer.size() < size)
+    buffer.resize(size);
+
+  return buffer.data();
+}
+
+void Reignite::MeshCodec::EncodeBytes(const u8* data, u32 size, std::vector<u8>& out) {
+
+  lzCompress(data, size, out);
+}
+
+u32 Reignite::MeshCodec::DecodeBytes(u8* destination, u32 capacity, const u8* data, u64 size) {
+
+  return lzDecompress(data, size, destination, capacity);
+}
+
+// Vertices --------------------------------------------------------------------
+
+void Reignite::MeshCodec::EncodeVertexBuffer(const void* vertices, u32 count, u32 stride, std::vector<u8>& out) {
+
+  const u8* src = (const u8*)vertices;
+
+  out.clear();
+  out.resize(2 * sizeof(u32));
+  memcpy(&out[0], &count, sizeof(u32));
+  memcpy(&out[sizeof(u32)], &stride, sizeof(u32));
+
+  std::vector<u8> planes((size_t)kVertexChunk * stride);
+
+  for (u32 first = 0; first < count; first += kVertexChunk) {
+
+    const u32 chunkCount = count - first < kVertexChunk ? count - first : kVertexChunk;
+    const u8* chunk = src + (size_t)first * stride;
+
+    // Byte planes, each one delta coded along the vertex order
+    for (u32 k = 0; k < stride; ++k) {
+
+      u8* plane = &planes[(size_t)k * chunkCount];
+      u8 previous = 0;
+      for (u32 v = 0; v < chunkCount; ++v) {
+        const u8 value = chunk[(size_t)v * stride + k];
+        plane[v] = (u8)(value - previous);
+        previous = value;
+      }
+    }
+
+    // Chunks are prefixed with their compressed size
+    const size_t sizeOffset = out.size();
+    out.resize(sizeOffset + sizeof(u32));
+
+    lzCompress(planes.data(), chunkCount * stride, out);
+
+    const u32 chunkBytes = (u32)(out.size() - sizeOffset - sizeof(u32));
+    memcpy(&out[sizeOffset], &chunkBytes, sizeof(u32));
+  }
+}
+
+// In register prefix sum of 16 byte deltas, carry holds the running value in
+// every lane and is updated to the last decoded byte
+static __m128i prefixSum(__m128i x, __m128i& carry) {
+
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+  x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+  x = _mm_add_epi8(x, carry);
+
+  // Broadcast byte 15
+  __m128i last = _mm_unpackhi_epi8(x, x);
+  last = _mm_shufflehi_epi16(last, 0xFF);
+  carry = _mm_shuffle_epi32(last, 0xFF);
+
+  return x;
+}
+
+// 16x16 byte transpose, rows become columns
+static void transpose16(__m128i r[16]) {
+
+  __m128i t[16], u[16], v[16];
+
+  for (u32 i = 0; i < 8; ++i) {
+    t[i * 2 + 0] = _mm_unpacklo_epi8(r[i * 2], r[i * 2 + 1]);
+    t[i * 2 + 1] = _mm_unpackhi_epi8(r[i * 2], r[i * 2 + 1]);
+  }
+
+  for (u32 i = 0; i < 4; ++i) {
+    u[i * 4 + 0] = _mm_unpacklo_epi16(t[i * 4 + 0], t[i * 4 + 2]);
+    u[i * 4 + 1] = _mm_unpackhi_epi16(t[i * 4 + 0], t[i * 4 + 2]);
+    u[i * 4 + 2] = _mm_unpacklo_epi16(t[i * 4 + 1], t[i * 4 + 3]);
+    u[i * 4 + 3] = _mm_unpackhi_epi16(t[i * 4 + 1], t[i * 4 + 3]);
+  }
+
+  for (u32 i = 0; i < 2; ++i) {
+    for (u32 j = 0; j < 4; ++j) {
+      v[i * 8 + j * 2 + 0] = _mm_unpacklo_epi32(u[i * 8 + j], u[i * 8 + j + 4]);
+      v[i * 8 + j * 2 + 1] = _mm_unpackhi_epi32(u[i * 8 + j], u[i * 8 + j + 4]);
+    }
+  }
+
+  for (u32 i = 0; i < 8; ++i) {
+    r[i * 2 + 0] = _mm_unpacklo_epi64(v[i], v[i + 8]);
+    r[i * 2 + 1] = _mm_unpackhi_epi64(v[i], v[i + 8]);
+  }
+}
+
+static void decodeVertexChunk(u8* dst, u32 count, u32 stride, const u8* planes) {
+
+  __m128i carry[kMaxStride];
+  for (u32 k = 0; k < stride; ++k)
+    carry[k] = _mm_setzero_si128();
+
+  const u32 blockCount = count / 16;
+
+  // 16 vertices x 16 planes per step, block major so the output is written once
+  for (u32 block = 0; block < blockCount; ++block) {
+    for (u32 group = 0; group < stride; group += 16) {
+
+      const u32 groupPlanes = stride - group < 16 ? stride - group : 16;
+
+      __m128i rows[16];
+      for (u32 k = 0; k < 16; ++k) {
+
+        if (k < groupPlanes) {
+          const u8* plane = planes + (u64)(group + k) * count + block * 16;
+          rows[k] = prefixSum(_mm_loadu_si128((const __m128i*)plane), carry[group + k]);
+        }
+        else {
+          rows[k] = _mm_setzero_si128();
+        }
+      }
+
+      transpose16(rows);
+
+      u8* out = dst + (u64)block * 16 * stride + group;
+      if (groupPlanes == 16) {
+        for (u32 v = 0; v < 16; ++v)
+          _mm_storeu_si128((__m128i*)(out + (u64)v * stride), rows[v]);
+      }
+      else if (groupPlanes == 8) {
+        for (u32 v = 0; v < 16; ++v)
+          _mm_storel_epi64((__m128i*)(out + (u64)v * stride), rows[v]);
+      }
+      else {
+        alignas(16) u8 temp[16];
+        for (u32 v = 0; v < 16; ++v) {
+          _mm_store_si128((__m128i*)temp, rows[v]);
+          memcpy(out + (u64)v * stride, temp, groupPlanes);
+        }
+      }
+    }
+  }
+
+  // Remaining vertices
+  for (u32 k = 0; k < stride; ++k) {
+
+    const u8* plane = planes + (u64)k * count;
+    u8 value = (u8)_mm_cvtsi128_si32(carry[k]);
+    for (u32 v = blockCount * 16; v < count; ++v) {
+      value = (u8)(value + plane[v]);
+      dst[(u64)v * stride + k] = value;
+    }
+  }
+}
+
+bool Reignite::MeshCodec::DecodeVertexBuffer(void* destination, u32 count, u32 stride, const u8* data, u64 size) {
+
+  if (size < 2 * sizeof(u32))
+    return false;
+
+  u32 encodedCount, encodedStride;
+  memcpy(&encodedCount, data, sizeof(u32));
+  memcpy(&encodedStride, data + sizeof(u32), sizeof(u32));
+  if (encodedCount != count || encodedStride != stride || stride == 0 || stride > kMaxStride)
+    return false;
+
+  // Planes of one chunk stay in cache between the LZ and transpose passes
+  u8* planes = scratch((u64)kVertexChunk * stride);
+
+  const u8* ip = data + 2 * sizeof(u32);
+  const u8* iend = data + size;
+  u8* dst = (u8*)destination;
+
+  for (u32 first = 0; first < count; first += kVertexChunk) {
+
+    const u32 chunkCount = count - first < kVertexChunk ? count - first : kVertexChunk;
+
+    u32 chunkBytes;
+    if (iend - ip < (s64)sizeof(u32))
+      return false;
+    memcpy(&chunkBytes, ip, sizeof(u32));
+    ip += sizeof(u32);
+
+    if (chunkBytes > (u64)(iend - ip))
+      return false;
+
+    if (lzDecompress(ip, chunkBytes, planes, chunkCount * stride) != chunkCount * stride)
+      return false;
+
+    decodeVertexChunk(dst + (u64)first * stride, chunkCount, stride, planes);
+    ip += chunkBytes;
+  }
+
+  return ip == iend;
+}
+
+// Indices ---------------------------------------------------------------------
+//
+// One varint code per index. 0 is the high water mark (max index so far + 1, a
+// vertex seen for the first time). 1 to kIndexFifo pick a vertex from a FIFO of
+// the recently added ones, which is where the edges shared with the previous
+// triangles live. The rest is a zigzag delta against the last index.
+
+static const u32 kIndexFifo = 16;
+static const u32 kIndexDeltaBase = 1 + kIndexFifo;
+
+void Reignite::MeshCodec::EncodeIndexBuffer(const u32* indices, u32 count, std::vector<u8>& out) {
+
+  std::vector<u8> varints;
+  varints.reserve(count);
+
+  u32 fifo[kIndexFifo];
+  u32 fifoHead = 0;
+  u32 fifoSize = 0;
+  u32 next = 0;
+  u32 last = 0;
+
+  for (u32 i = 0; i < count; ++i) {
+
+    const u32 index = indices[i];
+
+    u64 code = 0;
+    if (index != next) {
+
+      // Newest first, recent triangles are the likeliest neighbours
+      for (u32 k = 0; k < fifoSize; ++k) {
+        if (fifo[(fifoHead - 1 - k) % kIndexFifo] == index) {
+          code = 1 + k;
+          break;
+        }
+      }
+
+      if (code == 0) {
+        const s32 delta = (s32)(index - last);
+        code = kIndexDeltaBase + (u64)(((u32)delta << 1) ^ (u32)(delta >> 31));
+      }
+    }
+
+    // FIFO hits are already in it
+    if (code == 0 || code >= kIndexDeltaBase) {
+      fifo[fifoHead++ % kIndexFifo] = index;
+      fifoSize = fifoSize < kIndexFifo ? fifoSize + 1 : kIndexFifo;
+    }
+
+    while (code >= 0x80) {
+      varints.push_back((u8)(code | 0x80));
+      code >>= 7;
+    }
+    varints.push_back((u8)code);
+
+    if (index >= next)
+      next = index + 1;
+    last = index;
+  }
+
+  out.clear();
+  out.resize(sizeof(u32));
+  memcpy(&out[0], &count, sizeof(u32));
+
+  lzCompress(varints.data(), (u32)varints.size(), out);
+}
+
+bool Reignite::MeshCodec::DecodeIndexBuffer(u32* destination, u32 count, const u8* data, u64 size) {
+
+  if (size < sizeof(u32))
+    return false;
+
+  u32 encodedCount;
+  memcpy(&encodedCount, data, sizeof(u32));
+  if (encodedCount != count)
+    return false;
+
+  const u32 capacity = count * 5;
+  u8* varints = scratch(capacity);
+  const u32 varintBytes = lzDecompress(data + sizeof(u32), size - sizeof(u32), varints, capacity);
+  if (varintBytes == 0 && count != 0)
+    return false;
+
+  const u8* ip = varints;
+  const u8* iend = varints + varintBytes;
+
+  u32 fifo[kIndexFifo];
+  u32 fifoHead = 0;
+  u32 fifoSize = 0;
+  u32 next = 0;
+  u32 last = 0;
+
+  for (u32 i = 0; i < count; ++i) {
+
+    u64 code = 0;
+    u32 shift = 0;
+    u8 byte;
+    do {
+      if (ip >= iend || shift > 28)
+        return false;
+      byte = *ip++;
+      code |= (u64)(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    u32 index;
+    if (code == 0) {
+      index = next;
+    }
+    else if (code < kIndexDeltaBase) {
+      if (code > fifoSize)
+        return false;
+      index = fifo[(fifoHead - (u32)code) % kIndexFifo];
+    }
+    else {
+      const u64 zigzag = code - kIndexDeltaBase;
+      if (zigzag > 0xFFFFFFFF)
+        return false;
+      const s32 delta = (s32)((u32)zigzag >> 1) ^ -(s32)(zigzag & 1);
+      index = last + (u32)delta;
+    }
+
+    if (code == 0 || code >= kIndexDeltaBase) {
+      fifo[fifoHead++ % kIndexFifo] = index;
+      fifoSize = fifoSize < kIndexFifo ? fifoSize + 1 : kIndexFifo;
+    }
+
+    destination[i] = index;
+
+    if (index >= next)
+      next = index + 1;
+    last = index;
+  }
+
+  return ip == iend;
+}
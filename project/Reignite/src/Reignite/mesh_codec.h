@@ -0,0 +1,35 @@
+#ifndef _RI_MESH_CODEC_
+#define _RI_MESH_CODEC_ 1
+
+#include <vector>
+
+#include "basic_types.h"
+
+
+namespace Reignite {
+namespace MeshCodec {
+
+  // Lossless codec for cooked meshes.
+  // Vertices: per byte plane delta against the previous vertex, planes stored
+  // one after another, then LZ compressed.
+  // Indices: a code per index for a new vertex (max index + 1), a hit in a
+  // FIFO of recent vertices or a zigzag delta, varint, then LZ compressed.
+  // Decoders write straight into the destination, which can be mapped memory.
+
+  void EncodeVertexBuffer(const void* vertices, u32 count, u32 stride, std::vector<u8>& out);
+
+  bool DecodeVertexBuffer(void* destination, u32 count, u32 stride, const u8* data, u64 size);
+
+  void EncodeIndexBuffer(const u32* indices, u32 count, std::vector<u8>& out);
+
+  bool DecodeIndexBuffer(u32* destination, u32 count, const u8* data, u64 size);
+
+  // The LZ stage on its own, for other cooked data. Encode appends to out,
+  // Decode returns the decoded size or 0 on malformed input.
+  void EncodeBytes(const u8* data, u32 size, std::vector<u8>& out);
+
+  u32 DecodeBytes(u8* destination, u32 capacity, const u8* data, u64 size);
+
+}} // end of Reignite::MeshCodec namespace
+
+#endif // _RI_MESH_CODEC_
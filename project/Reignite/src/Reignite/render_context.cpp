@@ -1,7 +1,28 @@
 #include "render_context.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+
 #include "tools.h"
 #include "state.h"
+#include "asset_pack.h"
+#include "asset_registry.h"
+#include "derived_data_cache.h"
+#include "thread_pool.h"
+#include "texture_streamer.h"
+#include "virtual_texture.h"
+#include "light_clusters.h"
+#include "tiled_shading.h"
+#include "forward_plus.h"
+#include "light_volumes.h"
+#include "subpass_deferred.h"
+#include "visibility_buffer.h"
 
 #include "Vulkan/vulkan_overlay.h"
 #include "Vulkan/vulkan_impl.h"
@@ -9,6 +30,8 @@
 #include "Vulkan/vulkan_state.h"
 #include "Vulkan/vulkan_buffer.h"
 #include "Vulkan/vulkan_framebuffer.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_upload_ring.h"
 
 #include "Components/transform_component.h"
 #include "Components/render_component.h"
@@ -21,6 +44,81 @@
 
 namespace Reignite {
 
+  static const char* kAssetPackFile = "reignite.pack";
+  static const char* kDerivedDataCacheDir = "cache/";
+
+  // Bump the version suffix whenever a processor changes its output
+  static const char* kGeometryObjProcessor = "geometry.obj.v3";
+  static const char* kGeometryTerrainProcessor = "geometry.terrain.v3";
+  static const char* kTextureProcessor = "texture.universal.v2";
+  static const char* kTextureTranscodeProcessor = "texture.transcode.v1";
+
+  static const char* kCubemapSource = "textures/cubemap_yokohama_bc3_unorm.ktx";
+
+  // Terrain layers, through the virtual texture when it can take them
+  static const char* kTerrainTextures[] = {
+    "textures/red_bricks_albedo.png",
+    "textures/red_bricks_normal.png",
+    "textures/red_bricks_roughness.png",
+    "textures/red_bricks_metallic.png"
+  };
+
+  // Packed descriptors of a set in binding order, the layout the update
+  // template of that set reads
+  static const u32 kMaterialTextures = 4;
+
+  struct MaterialDescriptors {
+    VkDescriptorImageInfo textures[kMaterialTextures]; // color, normal, roughness, metallic
+  };
+
+  // Depth, octahedral normal, albedo, roughness/metallic/ao. The position
+  // is rebuilt from the depth with the inverse view projection.
+  static const u32 kGBufferTargets = 4;
+
+  struct CompositionDescriptors {
+    VkDescriptorImageInfo targets[kGBufferTargets];    // depth, normal, albedo, material
+    VkDescriptorBufferInfo lights;
+    VkDescriptorImageInfo shadowMap;
+    VkDescriptorBufferInfo pointLights;
+    VkDescriptorBufferInfo clusters;
+    VkDescriptorBufferInfo clusterParams;
+  };
+
+  // Lights with a shadow map layer, the rest only light
+  static const u32 kShadowLights = 3;
+
+  // Frames the host records ahead of the GPU
+  static const u32 kMaxFramesInFlight = 2;
+
+  // Size of the light lists each culling pass fills, by LightClusters::Peak
+  static const u32 kLightListSizes[LightClusters::kPeakCount] = {
+    LightClusters::kMaxLightsPerCluster, TiledShading::kMaxLightsPerTile, ForwardPlus::kMaxLightsPerTile
+  };
+  static const char* kLightListNames[LightClusters::kPeakCount] = { "cluster", "tile", "Forward+ tile" };
+
+  // The render scale moves in steps, every step recreates the targets, and
+  // waits for the frame times at the new size before the next one
+  static const float kRenderScaleStep = 0.05f;
+  static const u32 kRenderScaleSettleFrames = 30;
+
+  inline u32 ScaledExtent(u32 size, float scale) { return (std::max)(1u, (u32)((float)size * scale + 0.5f)); }
+
+  // Loads in flight on the workers, installed in their slot between frames
+  struct GeometryLoad {
+    u32 id;
+    GeometryResource geometry;
+    bool loaded = false;
+    std::shared_future<void> done;
+  };
+
+  struct TextureLoad {
+    u32 id;
+    PackEntry entry;
+    std::vector<u8> blob;
+    const u8* texels = nullptr;
+    std::shared_future<void> done;
+  };
+
   struct Reignite::RenderContext::Data {
 
     RenderContextParams params;
@@ -28,6 +126,111 @@ namespace Reignite {
     std::vector<MaterialResource> materials;
     std::vector<vk::Texture> textures;
 
+    // Slots of geometries and textures by path, with their pending loads
+    AssetRegistry geometryRegistry;
+    AssetRegistry textureRegistry;
+    std::vector<std::unique_ptr<GeometryLoad>> geometryLoads;
+    std::vector<std::unique_ptr<TextureLoad>> textureLoads;
+    bool assetsChanged = false;
+
+    // Released resources wait here until the fence of the last frame
+    // submitted before the release has signalled
+    struct Retired {
+      u64 frame;
+      std::function<void()> destroy;
+    };
+    std::deque<Retired> retired;
+    u64 submittedFrames = 0;
+    u64 completedFrames = 0;
+
+    // The host records a frame while the GPU still runs the previous ones.
+    // Each has its own sync, command buffers and upload region, reused once
+    // its fence says the GPU is done with them.
+    struct Frame {
+      VkFence fence = VK_NULL_HANDLE;
+      VkSemaphore presentComplete = VK_NULL_HANDLE;    // swapchain image acquired
+      VkSemaphore offScreenComplete = VK_NULL_HANDLE;  // uploads and offscreen passes done
+      VkSemaphore renderComplete = VK_NULL_HANDLE;     // composition done, the image can be presented
+      VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+      VkCommandBuffer drawCmdBuffer = VK_NULL_HANDLE;
+      u64 number = 0;
+    };
+    Frame frames[kMaxFramesInFlight];
+    u32 frameIndex = 0;
+    vk::UploadRing uploads;
+
+    GeometryHandle skyboxGeometry;
+    GeometryHandle lightVolumeGeometry;
+
+    // Cooked assets, then cached derived data, then the sources
+    AssetPack pack;
+    DerivedDataCache cache;
+
+    ThreadPool workers;
+
+    // Material textures, only the needed mips are on the GPU
+    TextureStreamer streamer;
+    bool memoryBudget = false;
+
+    // Terrain textures, paged by screen feedback
+    VirtualTexture virtualTexture;
+    bool virtualTexturing = false;
+
+    // Point lights binned per view cluster, the composition shades with them
+    LightClusters lightClusters;
+
+    // Light lists that overflowed, a bit per LightClusters::Peak, warned once
+    u32 lightOverflows = 0;
+
+    // How the scene is lit: the G-buffer in the composition draw with the
+    // clusters, per tile in compute, by light volumes or with the clusters in
+    // a subpass of the G-buffer pass, the scene drawn forward with tile
+    // light lists, or only its triangle ids drawn and shaded with the
+    // clusters. All but the first leave the composition only resolving a
+    // result.
+    enum RenderPath {
+      kRenderPath_Clustered,
+      kRenderPath_Tiled,
+      kRenderPath_ForwardPlus,
+      kRenderPath_LightVolumes,
+      kRenderPath_Subpass,
+      kRenderPath_Visibility
+    };
+    s32 renderPath = kRenderPath_Clustered;
+    TiledShading tiledShading;
+    ForwardPlus forwardPlus;
+    LightVolumes lightVolumes;
+    SubpassDeferred subpassDeferred;
+    VisibilityBuffer visibilityBuffer;
+    bool visibilityDrawsWarned = false;
+
+    // Optional depth only pass before the G-buffer pass, which then tests
+    // EQUAL against its depth and runs the material shaders once per pixel.
+    // Pipelines are by material.
+    bool depthPrepass = false;
+    struct {
+      VkRenderPass depthPass = VK_NULL_HANDLE;
+      VkFramebuffer depthFramebuffer = VK_NULL_HANDLE;
+      VkRenderPass gbufferPass = VK_NULL_HANDLE;
+      std::vector<VkPipeline> depth;
+      std::vector<VkPipeline> gbuffer;
+    } prepass;
+
+    // Dynamic resolution. The G-buffer and the targets of the paths are the
+    // window size times the largest scale, each frame renders width x height
+    // at their top left and the composition upscales it. Unless locked, the
+    // scale follows the GPU time between the frame timestamps.
+    struct {
+      float scale = 1.0f;
+      bool locked = false;
+      u32 width = 0;
+      u32 height = 0;
+      float gpuTime = 0.0f;
+      u32 settleFrames = 0;
+      VkQueryPool timestamps = VK_NULL_HANDLE;
+      u64 timestampMask = ~0ull;
+    } resolution;
+
     // Render state
     bool renderShouldClose = false;
 
@@ -99,15 +302,23 @@ namespace Reignite {
     
     VkSubmitInfo submitInfo;
     
-    std::vector<VkCommandBuffer> commandBuffers;
-    
     VkRenderPass renderPass;
     
     std::vector<VkFramebuffer> framebuffers;
     
     uint32_t currentBuffer = 0;
     
-    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    vk::DescriptorAllocator descriptors;
+
+    // Material sets replaced while frames in flight bound them, by layout
+    std::vector<std::pair<VkDescriptorSetLayout, VkDescriptorSet>> spareSets;
+
+    // Rewrites a whole set from one of the structs above in a single call
+    struct {
+      VkDescriptorUpdateTemplate material = VK_NULL_HANDLE;
+      VkDescriptorUpdateTemplate composition = VK_NULL_HANDLE;
+      VkDescriptorUpdateTemplate uniformBuffer = VK_NULL_HANDLE;  // binding 0, a vk::Buffer descriptor
+    } updateTemplates;
     
     std::vector<VkShaderModule> shaderModules;
     
@@ -115,13 +326,6 @@ namespace Reignite {
     
     VulkanSwapchain swapchain;
 
-    struct {
-      VkSemaphore presentComplete;  // swapchain image presentation
-      VkSemaphore renderComplete;   // commandBuffer submission and execution
-    } semaphores;
-    
-    std::vector<VkFence> waitFences;
-
     vk::VulkanState* vulkanState;
 
     struct {
@@ -167,9 +371,12 @@ namespace Reignite {
 
     struct {
       vec4f viewPos;
-      Light lights[3];
-      u32 numbLights = 3;
+      mat4f inverseViewProjection;
+      Light lights[kShadowLights];
+      u32 numbLights = 0;
       u32 useShadows = 1;
+      u32 padding[2];
+      vec4f renderArea; // pixels rendered, their fraction of the targets
     } uboFragmentLights;
 
     struct {
@@ -205,10 +412,19 @@ namespace Reignite {
     struct {
       vk::Framebuffer* deferred;
       vk::Framebuffer* shadow;
+      vk::Framebuffer* lit = nullptr;
     } defFramebuffers;
 
+    // The clustered path lights the render area of defFramebuffers.lit and
+    // composite.frag upscales it to the screen, like the other paths
+    struct {
+      VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+      VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+      VkPipeline pipeline = VK_NULL_HANDLE;
+      VkDescriptorSet set = VK_NULL_HANDLE;
+    } composite;
+
     VkCommandBuffer offScreenCmdBuffer = VK_NULL_HANDLE;
-    VkSemaphore offScreenSemaphore = VK_NULL_HANDLE;
 
     struct DebugQuad {
       vk::Buffer vertices;
@@ -226,6 +442,8 @@ namespace Reignite {
     const u32 matDeferred       = 1;
     const u32 matShadows        = -1;
     const u32 matDeferredDebug  = 2;
+    const u32 matIron           = 3;
+    const u32 matTerrain        = 4;
     const u32 matShadowsDebug   = 5;
     const u32 matOffScreen      = -2;
   };
@@ -245,40 +463,170 @@ namespace Reignite {
     delete data;
   }
 
-  u32 Reignite::RenderContext::createGeometryResource(GeometryEnum geometry, std::string path) {
+  // Runs on a worker: pack, cache or source into host visible buffers
+  bool Reignite::RenderContext::readGeometry(GeometryEnum geometry, const std::string& path, u32 width, u32 length,
+    bool keepCpuCopy, GeometryResource& current_geometry) {
 
-    GeometryResource current_geometry;
     current_geometry.init();
+    current_geometry.state = data->vulkanState;
+
+    const PackEntry* entry = data->pack.find(path);
+    const u8* blob = nullptr;
+
+    PackEntry cachedEntry;
+    std::vector<u8> cachedBlob;
+
+    // A cooked terrain of another size is not the one asked for
+    if (entry != nullptr && geometry == kGeometryEnum_Terrain && (entry->width != width || entry->height != length))
+      entry = nullptr;
 
-    switch (geometry) {
-    case kGeometryEnum_Square: 
-      //current_geometry = GeometryResourceSquare();
-      break;
-    case kGeometryEnum_Cube:
-      //current_geometry = GeometryResourceCube();
-      break;
-    case kGeometryEnum_Load: 
-      current_geometry.loadObj(path);
-      break;
-    case kGeometryEnum_Terrain: 
-      current_geometry.loadTerrain(6, 6);
-      break;
+    if (entry != nullptr && entry->type == kPackEntryType_Geometry) {
+      // Cooked geometry goes straight from the pack mapping into the buffers
+      blob = data->pack.blob(*entry);
+    }
+    else {
+
+      const u32 terrainSize[2] = { width, length };
+
+      u64 key = 0;
+      if (geometry == kGeometryEnum_Load)
+        key = data->cache.key(path, kGeometryObjProcessor);
+      else if (geometry == kGeometryEnum_Terrain)
+        key = data->cache.key(kGeometryTerrainProcessor, terrainSize, sizeof(terrainSize));
+
+      if (!data->cache.getEntry(key, cachedEntry, cachedBlob)) {
+
+        bool loaded = false;
+        switch (geometry) {
+        case kGeometryEnum_Square: 
+          //current_geometry = GeometryResourceSquare();
+          break;
+        case kGeometryEnum_Cube:
+          //current_geometry = GeometryResourceCube();
+          break;
+        case kGeometryEnum_Load: 
+          loaded = current_geometry.loadObj(path, &data->workers);
+          break;
+        case kGeometryEnum_Terrain: 
+          loaded = current_geometry.loadTerrain(width, length);
+          break;
+        }
+
+        if (!loaded) {
+          RI_ERROR("Could not load geometry {0}", path.c_str());
+          return false;
+        }
+
+        if (!CookGeometry(current_geometry, cachedEntry, cachedBlob)) {
+          RI_ERROR("Could not cook geometry {0}", path.c_str());
+          return false;
+        }
+
+        data->cache.putEntry(key, cachedEntry, cachedBlob);
+
+        // Everything below decodes the cooked blob
+        current_geometry.releaseCpuData();
+      }
+
+      entry = &cachedEntry;
+      blob = cachedBlob.data();
     }
 
     current_geometry.state = data->vulkanState;
+    current_geometry.vertexSize = entry->vertexCount;
+    current_geometry.indicesSize = entry->indexCount;
+    current_geometry.boundsMin = vec3f(entry->boundsMin[0], entry->boundsMin[1], entry->boundsMin[2]);
+    current_geometry.boundsMax = vec3f(entry->boundsMax[0], entry->boundsMax[1], entry->boundsMax[2]);
 
-    VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+    // Also copied into the visibility buffer's geometry pool
+    VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      current_geometry.vertices.size() * sizeof(Vertex),
-      &current_geometry.vertexBuffer, current_geometry.vertices.data()));
+      entry->vertexCount * sizeof(Vertex),
+      &current_geometry.vertexBuffer, nullptr));
 
-    VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+    VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      current_geometry.indices.size() * sizeof(u32),
-      &current_geometry.indexBuffer, current_geometry.indices.data()));
+      entry->indexCount * sizeof(u32),
+      &current_geometry.indexBuffer, nullptr));
+
+    // Decode straight into the mapped buffers. A kept CPU copy is decoded
+    // first and copied, mapped memory is slow to read back.
+    VK_CHECK(current_geometry.vertexBuffer.map());
+    VK_CHECK(current_geometry.indexBuffer.map());
 
-    data->geometries.push_back(current_geometry);
-    return static_cast<u32>(data->geometries.size() - 1);
+    bool decoded;
+    if (keepCpuCopy) {
+
+      current_geometry.vertices.resize(entry->vertexCount);
+      current_geometry.indices.resize(entry->indexCount);
+      decoded = DecodeGeometry(*entry, blob, current_geometry.vertices.data(), current_geometry.indices.data());
+
+      memcpy(current_geometry.vertexBuffer.mapped, current_geometry.vertices.data(), entry->vertexCount * sizeof(Vertex));
+      memcpy(current_geometry.indexBuffer.mapped, current_geometry.indices.data(), entry->indexCount * sizeof(u32));
+    }
+    else {
+      decoded = DecodeGeometry(*entry, blob, current_geometry.vertexBuffer.mapped, current_geometry.indexBuffer.mapped);
+    }
+
+    if (!decoded)
+      RI_ERROR("Could not decode geometry {0}", path.c_str());
+
+    current_geometry.vertexBuffer.unmap();
+    current_geometry.indexBuffer.unmap();
+
+    return decoded;
+  }
+
+  GeometryHandle Reignite::RenderContext::loadGeometry(GeometryEnum geometry, std::string path, bool keepCpuCopy) {
+
+    if (geometry == kGeometryEnum_Terrain) {
+      RI_ERROR("Terrains have a size, load them with loadTerrain");
+      return GeometryHandle();
+    }
+
+    return requestGeometry(geometry, path, 0, 0, keepCpuCopy);
+  }
+
+  GeometryHandle Reignite::RenderContext::loadTerrain(u32 width, u32 length, bool keepCpuCopy) {
+
+    return requestGeometry(kGeometryEnum_Terrain, TerrainPath(width, length), width, length, keepCpuCopy);
+  }
+
+  GeometryHandle Reignite::RenderContext::requestGeometry(GeometryEnum geometry, const std::string& path,
+    u32 width, u32 length, bool keepCpuCopy) {
+
+    GeometryHandle handle;
+    bool created = false;
+    handle.id = data->geometryRegistry.acquire(Tools::HashBytes(&geometry, sizeof(geometry), PackKey(path)), created);
+    if (!created)
+      return handle;
+
+    // The slot stays empty until the load is installed
+    if (handle.index() >= data->geometries.size())
+      data->geometries.resize(handle.index() + 1);
+
+    data->geometries[handle.index()].init();
+    data->geometries[handle.index()].state = data->vulkanState;
+
+    std::unique_ptr<GeometryLoad> load(new GeometryLoad());
+    load->id = handle.id;
+
+    GeometryLoad* target = load.get();
+    load->done = data->workers.submit([this, target, geometry, path, width, length, keepCpuCopy]() {
+      target->loaded = readGeometry(geometry, path, width, length, keepCpuCopy, target->geometry);
+    }).share();
+
+    data->geometryRegistry.track(handle.id, load->done);
+    data->geometryLoads.push_back(std::move(load));
+
+    return handle;
+  }
+
+  GeometryHandle Reignite::RenderContext::createGeometryResource(GeometryEnum geometry, std::string path, bool keepCpuCopy) {
+
+    GeometryHandle handle = loadGeometry(geometry, path, keepCpuCopy);
+    wait(handle);
+    return handle;
   }
 
   u32 Reignite::RenderContext::createMaterialResource() {
@@ -293,14 +641,288 @@ namespace Reignite {
     return static_cast<u32>(data->materials.size() - 1);
   }
 
-  u32 Reignite::RenderContext::createTextureResource(std::string filename) {
+  // Texel data for a source texture in the requested format. Textures cooked
+  // ready to upload are used as they are, everything else starts from the
+  // universal texture (pack, then cache, then a fresh cook) and is transcoded.
+  // Returns a pointer into the pack or into blob, nullptr when the texture
+  // could not be read or processed. Thread safe.
+  static const u8* loadTextureData(const AssetPack& pack, const DerivedDataCache& cache, ThreadPool& workers,
+    const std::string& filename, VkFormat format, PackEntry& entry, std::vector<u8>& blob) {
+
+    // Atlased textures load their whole atlas
+    const PackEntry* packed = pack.find(filename);
+    if (packed != nullptr && packed->type == kPackEntryType_AtlasRegion)
+      packed = pack.find(packed->atlasKey);
+    if (packed != nullptr && packed->type != kPackEntryType_Texture)
+      packed = nullptr;
+
+    if (packed != nullptr && !(packed->flags & kPackEntryFlag_Supercompressed) && packed->format == (u32)format) {
+      entry = *packed;
+      return pack.blob(*packed);
+    }
+
+    PackEntry source;
+    const u8* sourceBlob = nullptr;
+    std::vector<u8> sourceStorage;
+
+    // Identifies the universal texture without hashing it again: the hash
+    // the cooker stored, or the cache key, which already covers the source
+    u64 sourceHash = 0;
+
+    const u32 universalFormat = DefaultTextureFormat(filename);
+
+    if (packed != nullptr && (packed->flags & kPackEntryFlag_Supercompressed)) {
+      source = *packed;
+      sourceBlob = pack.blob(*packed);
+      sourceHash = packed->contentHash;
+    }
+    else {
+
+      const u64 key = cache.key(filename, kTextureProcessor, &universalFormat, sizeof(universalFormat));
+
+      if (!cache.getEntry(key, source, sourceStorage)) {
+
+        PackEntry cooked;
+        std::vector<u8> cookedBlob;
+        if (!CookTexture(filename, universalFormat, cooked, cookedBlob, &workers)) {
+          RI_ERROR("Could not cook texture {0}", filename.c_str());
+          return nullptr;
+        }
+
+        if (!SupercompressTexture(cooked, cookedBlob.data(), source, sourceStorage)) {
+          RI_ERROR("Could not supercompress texture {0}", filename.c_str());
+          return nullptr;
+        }
+
+        cache.putEntry(key, source, sourceStorage);
+      }
+
+      sourceBlob = sourceStorage.data();
+      sourceHash = key;
+    }
+
+    // The universal format only undoes LZ and RGBA8 only decodes the blocks,
+    // a different block format is encoded again and cached
+    u64 key = 0;
+    if (format != (VkFormat)universalFormat && format != (VkFormat)DefaultTextureFormat(filename, false)) {
+
+      const u64 params[2] = { sourceHash, (u64)format };
+      key = cache.key(kTextureTranscodeProcessor, params, sizeof(params));
+
+      if (cache.getEntry(key, entry, blob))
+        return blob.data();
+    }
+
+    if (!TranscodeTexture(source, sourceBlob, format, entry, blob, &workers)) {
+      RI_ERROR("Could not transcode texture {0}", filename.c_str());
+      return nullptr;
+    }
+
+    if (key != 0)
+      cache.putEntry(key, entry, blob);
+
+    return blob.data();
+  }
+
+  // Stands in for a texture that failed to load: one texel per layer, a flat
+  // normal that also reads as an odd albedo
+  static const u8* fallbackTextureData(u32 layers, PackEntry& entry, std::vector<u8>& blob) {
+
+    static const u8 kTexel[4] = { 128, 128, 255, 255 };
+
+    entry = {};
+    entry.type = kPackEntryType_Texture;
+    entry.format = VK_FORMAT_R8G8B8A8_UNORM;
+    entry.width = 1;
+    entry.height = 1;
+    entry.mipLevels = 1;
+    entry.layers = layers;
+    entry.mipSize[0] = sizeof(kTexel) * layers;
+    entry.size = entry.mipSize[0];
+
+    blob.resize(entry.size);
+    for (u32 i = 0; i < layers; ++i)
+      memcpy(blob.data() + i * sizeof(kTexel), kTexel, sizeof(kTexel));
+
+    return blob.data();
+  }
+
+  TextureHandle Reignite::RenderContext::loadTexture(std::string filename) {
+
+    // Atlased files are keyed by their atlas, which is loaded once
+    const PackEntry* region = data->pack.find(filename);
+    const u64 key = region != nullptr && region->type == kPackEntryType_AtlasRegion ? region->atlasKey : PackKey(filename);
+
+    TextureHandle handle;
+    bool created = false;
+    handle.id = data->textureRegistry.acquire(key, created);
+    if (!created)
+      return handle;
+
+    if (handle.index() >= data->textures.size())
+      data->textures.resize(handle.index() + 1);
+
+    data->textures[handle.index()] = vk::Texture();
+
+    std::unique_ptr<TextureLoad> load(new TextureLoad());
+    load->id = handle.id;
+
+    TextureLoad* target = load.get();
+    const VkFormat format = (VkFormat)DefaultTextureFormat(filename, data->enabledFeatures.textureCompressionBC);
+    load->done = data->workers.submit([this, target, filename, format]() {
+      target->texels = loadTextureData(data->pack, data->cache, data->workers, filename, format, target->entry, target->blob);
+      if (target->texels == nullptr)
+        target->texels = fallbackTextureData(1, target->entry, target->blob);
+    }).share();
+
+    data->textureRegistry.track(handle.id, load->done);
+    data->textureLoads.push_back(std::move(load));
+
+    return handle;
+  }
+
+  bool Reignite::RenderContext::isLoaded(GeometryHandle handle) const {
+
+    return data->geometryRegistry.isLoaded(handle.id);
+  }
+
+  bool Reignite::RenderContext::isLoaded(TextureHandle handle) const {
+
+    return data->textureRegistry.isLoaded(handle.id);
+  }
+
+  void Reignite::RenderContext::wait(GeometryHandle handle) {
+
+    data->geometryRegistry.wait(handle.id);
+    updateAssetLoads();
+  }
+
+  void Reignite::RenderContext::wait(TextureHandle handle) {
+
+    data->textureRegistry.wait(handle.id);
+    updateAssetLoads();
+  }
+
+  void Reignite::RenderContext::release(GeometryHandle handle) {
+
+    if (!data->geometryRegistry.release(handle.id))
+      return;
+
+    // Draws stop with the next rebuild, the buffers go once the GPU is done.
+    // A load still running is dropped when it finishes.
+    data->assetsChanged = true;
+    retire([this, handle]() {
+      GeometryResource& geometry = data->geometries[handle.index()];
+      if (geometry.vertexBuffer.buffer != VK_NULL_HANDLE)
+        geometry.destroy();
+      geometry.init();
+      data->geometryRegistry.recycle(handle.id);
+    });
+  }
+
+  void Reignite::RenderContext::release(TextureHandle handle) {
+
+    if (!data->textureRegistry.release(handle.id))
+      return;
+
+    data->streamer.remove(handle.index());
+    retire([this, handle]() {
+      vk::Texture& texture = data->textures[handle.index()];
+      if (texture.image != VK_NULL_HANDLE)
+        texture.destroy();
+      texture = vk::Texture();
+      data->textureRegistry.recycle(handle.id);
+    });
+  }
+
+  void Reignite::RenderContext::retire(std::function<void()> destroy) {
+
+    // The frame being recorded may have copies into it as well, it is the
+    // next one to be submitted
+    data->retired.push_back({ data->submittedFrames + 1, std::move(destroy) });
+  }
+
+  void Reignite::RenderContext::collectRetired() {
+
+    // Each frame fence remembers the frame it was submitted with
+    for (const Data::Frame& frame : data->frames) {
+      if (frame.number > data->completedFrames && vkGetFenceStatus(data->device, frame.fence) == VK_SUCCESS)
+        data->completedFrames = frame.number;
+    }
+
+    while (!data->retired.empty() && data->retired.front().frame <= data->completedFrames) {
+      data->retired.front().destroy();
+      data->retired.pop_front();
+    }
+  }
+
+  TextureHandle Reignite::RenderContext::createTextureResource(std::string filename) {
   
-    vk::Texture2D newTexture;
-    newTexture.loadFromFileSTB(filename.c_str(), VK_FORMAT_R8G8B8A8_SRGB, data->device, data->physicalDevice, data->commandPool, data->queue);
+    return createTextureResources({ filename })[0];
+  }
+
+  std::vector<TextureHandle> Reignite::RenderContext::createTextureResources(const std::vector<std::string>& filenames) {
 
-    data->textures.push_back(newTexture);
+    std::vector<TextureHandle> handles;
+    for (const std::string& filename : filenames)
+      handles.push_back(loadTexture(filename));
 
-    return static_cast<u32>(data->textures.size() - 1);
+    // Their mip tails are copied before the next frame draws
+    for (TextureHandle handle : handles)
+      data->textureRegistry.wait(handle.id);
+
+    updateAssetLoads();
+
+    return handles;
+  }
+
+  void Reignite::RenderContext::updateAssetLoads() {
+
+    // Finished loads go into their slots, unless released in the meantime
+    for (u32 i = 0; i < (u32)data->geometryLoads.size();) {
+
+      GeometryLoad& load = *data->geometryLoads[i];
+      if (load.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++i;
+        continue;
+      }
+
+      // A failed load leaves the slot unloaded, its draws are skipped
+      if (load.loaded && data->geometryRegistry.isReferenced(load.id)) {
+        data->geometries[HandleIndex(load.id)] = std::move(load.geometry);
+        data->geometryRegistry.setLoaded(load.id);
+        data->assetsChanged = true;
+      }
+      else {
+        load.geometry.destroy();
+      }
+
+      data->geometryLoads.erase(data->geometryLoads.begin() + i);
+    }
+
+    // The streamer keeps the texels and starts every texture at its mip tail
+    bool uploads = false;
+    for (u32 i = 0; i < (u32)data->textureLoads.size();) {
+
+      TextureLoad& load = *data->textureLoads[i];
+      if (load.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++i;
+        continue;
+      }
+
+      if (data->textureRegistry.isReferenced(load.id)) {
+        data->streamer.add(HandleIndex(load.id), load.entry, load.texels, std::move(load.blob));
+        data->textureRegistry.setLoaded(load.id);
+        uploads = true;
+      }
+
+      data->textureLoads.erase(data->textureLoads.begin() + i);
+    }
+
+    if (uploads)
+      data->streamer.uploadTails(data->textures, data->frames[data->frameIndex].uploadCmdBuffer, data->uploads);
+
+    collectRetired();
   }
 
   void Reignite::RenderContext::initRenderState() {
@@ -342,7 +964,7 @@ namespace Reignite {
 
         data->lightData.target.push_back({ light->target[i], 0.0f });
         data->lightData.color.push_back({ light->color[i], 0.0f });
-        data->lightData.radius.push_back(35.0f /*light->radius[i]*/);
+        data->lightData.radius.push_back(light->radius[i]);
         data->lightData.view.push_back(light->view[i]);
 
         data->lightData.size++;
@@ -383,22 +1005,212 @@ namespace Reignite {
 
       data->lightData.target[i] = { light->target[compIndex], 0.0f };
       data->lightData.color[i] = { light->color[compIndex], 0.0f };
-      data->lightData.radius[i] = 35.0f/*light->radius[compIndex]*/;
+      data->lightData.radius[i] = light->radius[compIndex];
       data->lightData.view[i] = light->view[compIndex];
     }
   }
 
+  void Reignite::RenderContext::updateTextureStreaming() {
+
+    // Bounding sphere size on screen drives the mips each material needs
+    const float pixelScale = data->projection[1][1] * 0.5f * (float)data->resolution.height;
+
+    for (u32 i = 0; i < data->renderData.size; ++i) {
+
+      if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]))
+        continue;
+
+      const GeometryResource& geometry = data->geometries[HandleIndex(data->renderData.geoId[i])];
+      const mat4f& model = data->renderData.model[i];
+
+      const vec3f center = (geometry.boundsMin + geometry.boundsMax) * 0.5f;
+      const float scale = (std::max)(glm::length(vec3f(model[0])), (std::max)(glm::length(vec3f(model[1])), glm::length(vec3f(model[2]))));
+      const float radius = (std::max)(glm::length(geometry.boundsMax - center) * scale, 0.01f);
+
+      const vec4f viewCenter = data->view * model * vec4f(center, 1.0f);
+      const float distance = (std::max)(glm::length(vec3f(viewCenter)) - radius, 0.01f);
+      const float screenSize = 2.0f * radius * pixelScale / distance;
+
+      for (s32 texture : data->materials[data->renderData.matId[i]].textures)
+        data->streamer.request((u32)texture, screenSize);
+    }
+
+    // Mips are copied by this frame's upload command buffer, before its passes
+    std::vector<u32> changed;
+    std::vector<vk::Texture> replaced;
+    std::vector<VkImageView> views;
+    if (!data->streamer.update(data->textures, data->frames[data->frameIndex].uploadCmdBuffer, data->uploads,
+        changed, replaced, views))
+      return;
+
+    for (vk::Texture& texture : replaced)
+      retire([texture]() mutable { texture.destroy(); });
+
+    for (VkImageView view : views)
+      retire([this, view]() { vkDestroyImageView(data->device, view, nullptr); });
+
+    for (u32 i = 0; i < (u32)data->materials.size(); ++i) {
+
+      const std::vector<s32>& textures = data->materials[i].textures;
+      for (u32 texture : changed) {
+        if (std::find(textures.begin(), textures.end(), (s32)texture) != textures.end()) {
+          updateMaterialDescriptors(i);
+          break;
+        }
+      }
+    }
+
+    // Only the offscreen pass samples material textures
+    buildDeferredCommands();
+  }
+
+  void Reignite::RenderContext::updateMaterialDescriptors(u32 material) {
+
+    MaterialResource& resource = data->materials[material];
+    assert(resource.textures.size() == kMaterialTextures);
+
+    // Binding k samples textures[k]
+    MaterialDescriptors descriptors;
+    for (u32 i = 0; i < kMaterialTextures; ++i)
+      descriptors.textures[i] = data->textures[resource.textures[i]].descriptor;
+
+    // Frames in flight may still bind the current set. The textures go into
+    // another one, the current one is reused once they are done.
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    for (u32 i = 0; i < (u32)data->spareSets.size(); ++i) {
+      if (data->spareSets[i].first == resource.descriptorSetLayout) {
+        descriptorSet = data->spareSets[i].second;
+        data->spareSets.erase(data->spareSets.begin() + i);
+        break;
+      }
+    }
+
+    if (descriptorSet == VK_NULL_HANDLE)
+      VK_CHECK(data->descriptors.allocate(resource.descriptorSetLayout, &descriptorSet));
+
+    vkUpdateDescriptorSetWithTemplate(data->device, descriptorSet, data->updateTemplates.material, &descriptors);
+
+    const VkDescriptorSet previous = resource.descriptorSet;
+    const VkDescriptorSetLayout layout = resource.descriptorSetLayout;
+    resource.descriptorSet = descriptorSet;
+
+    if (previous != VK_NULL_HANDLE)
+      retire([this, layout, previous]() { data->spareSets.push_back({ layout, previous }); });
+  }
+
+  void Reignite::RenderContext::updateCompositionDescriptors() {
+
+    const vk::Framebuffer* deferred = data->defFramebuffers.deferred;
+    const vk::Framebuffer* shadow = data->defFramebuffers.shadow;
+
+    // The depth attachment is the last one
+    CompositionDescriptors descriptors;
+    descriptors.targets[0] = vk::initializers::DescriptorImageInfo(deferred->sampler,
+      deferred->attachments[kGBufferTargets - 1].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    for (u32 i = 1; i < kGBufferTargets; ++i) {
+      descriptors.targets[i] = vk::initializers::DescriptorImageInfo(deferred->sampler,
+        deferred->attachments[i - 1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    descriptors.lights = data->uniformBuffers.fsLights.descriptor;
+    descriptors.shadowMap = vk::initializers::DescriptorImageInfo(shadow->sampler,
+      shadow->attachments[0].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    descriptors.pointLights = data->lightClusters.lightsDescriptor();
+    descriptors.clusters = data->lightClusters.clustersDescriptor();
+    descriptors.clusterParams = data->lightClusters.paramsDescriptor();
+
+    // The debug views and the tiled pass read the same targets
+    for (u32 material : { data->matDeferred, data->matShadowsDebug, data->matDeferredDebug })
+      vkUpdateDescriptorSetWithTemplate(data->device, data->materials[material].descriptorSet, data->updateTemplates.composition, &descriptors);
+
+    const VkDescriptorImageInfo lit = vk::initializers::DescriptorImageInfo(data->defFramebuffers.lit->sampler,
+      data->defFramebuffers.lit->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkWriteDescriptorSet litWrite = vk::initializers::WriteDescriptorSet(data->composite.set,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &lit);
+    vkUpdateDescriptorSets(data->device, 1, &litWrite, 0, NULL);
+
+    data->tiledShading.writeDescriptors(descriptors.targets, descriptors.lights, descriptors.shadowMap, data->lightClusters);
+    data->forwardPlus.writeDescriptors(descriptors.lights, descriptors.shadowMap, data->lightClusters);
+    data->lightVolumes.writeDescriptors(descriptors.targets, descriptors.lights, descriptors.shadowMap,
+      data->uniformBuffers.vsGlobalViewData.descriptor, data->lightClusters);
+    data->subpassDeferred.writeDescriptors(descriptors.lights, descriptors.shadowMap, data->lightClusters);
+    data->visibilityBuffer.writeDescriptors(data->uniformBuffers.vsGlobalViewData.descriptor, descriptors.lights,
+      descriptors.shadowMap, data->lightClusters);
+  }
+
+  void Reignite::RenderContext::updateVisibilityDraws() {
+
+    // The geometries of the drawn objects, each pooled once
+    std::vector<u32> handles;
+    std::vector<const GeometryResource*> pooled;
+    std::vector<u32> poolIndex(data->geometries.size(), ~0u);
+    const u32 drawCount = (std::min)(data->renderData.size, data->visibilityBuffer.maxDraws());
+
+    // Objects past the draw table are not drawn on this path
+    if (drawCount < data->renderData.size && !data->visibilityDrawsWarned) {
+      data->visibilityDrawsWarned = true;
+      RI_WARN("{} objects, the visibility buffer only draws the first {}", data->renderData.size, drawCount);
+    }
+
+    for (u32 i = 0; i < drawCount; ++i) {
+
+      if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->visibilityBuffer.hasMaterial(data->renderData.matId[i]))
+        continue;
+
+      u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+      if (poolIndex[geoIndex] == ~0u) {
+        poolIndex[geoIndex] = (u32)pooled.size();
+        handles.push_back(data->renderData.geoId[i]);
+        pooled.push_back(&data->geometries[geoIndex]);
+      }
+    }
+
+    // Copied with the uploads of the frame that first runs the new commands,
+    // the old pool stays alive for the frames still running the old ones
+    std::vector<vk::Buffer> replaced;
+    VkDescriptorSet replacedSet = VK_NULL_HANDLE;
+    if (data->visibilityBuffer.updateGeometry(handles, pooled, data->frames[data->frameIndex].uploadCmdBuffer,
+      data->descriptors, replaced, replacedSet)) {
+      retire([this, replaced, replacedSet]() mutable {
+        for (vk::Buffer& buffer : replaced)
+          buffer.destroy();
+        if (replacedSet != VK_NULL_HANDLE)
+          data->visibilityBuffer.recycleResolveSet(replacedSet);
+      });
+    }
+
+    for (u32 i = 0; i < drawCount; ++i) {
+
+      if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->visibilityBuffer.hasMaterial(data->renderData.matId[i]))
+        continue;
+
+      data->visibilityBuffer.setDraw(i, poolIndex[HandleIndex(data->renderData.geoId[i])], data->renderData.matId[i]);
+      data->visibilityBuffer.setTransform(i, data->renderData.model[i]);
+    }
+
+    data->visibilityBuffer.uploadDraws(data->uploads);
+  }
+
   void Reignite::RenderContext::buildDeferredCommands() {
 
-    if (data->offScreenCmdBuffer == VK_NULL_HANDLE) {
-      
-      data->offScreenCmdBuffer = data->vulkanState->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+    // Rebuilt whenever streamed textures change. Frames in flight may still
+    // run the previous recording, it is freed once they are done.
+    if (data->offScreenCmdBuffer != VK_NULL_HANDLE) {
+      const VkCommandBuffer previous = data->offScreenCmdBuffer;
+      retire([this, previous]() { vkFreeCommandBuffers(data->device, data->commandPool, 1, &previous); });
     }
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo = vk::initializers::SemaphoreCreateInfo();
-    VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &data->offScreenSemaphore));
+    VkCommandBufferAllocateInfo cmdBufferAllocateInfo =
+      vk::initializers::CommandBufferAllocateInfo(data->commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    VK_CHECK(vkAllocateCommandBuffers(data->device, &cmdBufferAllocateInfo, &data->offScreenCmdBuffer));
+
+    // The visibility resolve reads the drawn geometry from its pool, the
+    // draw table says where. Both change with the loaded geometry.
+    if (data->renderPath == Data::kRenderPath_Visibility)
+      updateVisibilityDraws();
   
+    // Submitted again by every frame, also while the last one still runs it
     VkCommandBufferBeginInfo cmdBufferInfo = vk::initializers::CommandBufferBeginInfo();
+    cmdBufferInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
     VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
     std::array<VkClearValue, 6> clearValues = {};
@@ -417,6 +1229,13 @@ namespace Reignite {
 
     VK_CHECK(vkBeginCommandBuffer(data->offScreenCmdBuffer, &cmdBufferInfo));
 
+    data->lightClusters.recordPeaksClear(data->offScreenCmdBuffer);
+
+    // Light lists for the composition, from this frame's lights and camera
+    if (data->renderPath == Data::kRenderPath_Clustered || data->renderPath == Data::kRenderPath_Subpass ||
+      data->renderPath == Data::kRenderPath_Visibility)
+      data->lightClusters.recordCulling(data->offScreenCmdBuffer);
+
     viewport = vk::initializers::Viewport((float)data->defFramebuffers.shadow->width, (float)data->defFramebuffers.shadow->height, 0.0f, 1.0f);
     vkCmdSetViewport(data->offScreenCmdBuffer, 0, 1, &viewport);
 
@@ -437,7 +1256,10 @@ namespace Reignite {
 
     for (u32 i = 0; i < data->renderData.size; ++i) {
 
-      u32 geoIndex = data->renderData.geoId[i];
+      if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]))
+        continue;
+
+      u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
 
       std::array<VkDescriptorSet, 2> shadowDescSets = {
         data->descriptorSets.perObjectModels[i],
@@ -447,56 +1269,285 @@ namespace Reignite {
       vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->pipelineLayouts.shadows, 0, 2, shadowDescSets.data(), 0, NULL);
       vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, offsets);
       vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      vkCmdDrawIndexed(data->offScreenCmdBuffer, (u32)data->geometries[geoIndex].indices.size(), 1, 0, 0, 0);
+      vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
     }
 
     vkCmdEndRenderPass(data->offScreenCmdBuffer);
 
+    if (data->virtualTexturing)
+      data->virtualTexture.recordFeedbackClear(data->offScreenCmdBuffer);
+
+    // Pass 2: Forward+, depth prepass then the lit scene ->
+    if (data->renderPath == Data::kRenderPath_ForwardPlus) {
+
+      VkDeviceSize forwardOffsets[1] = { 0 };
+
+      data->forwardPlus.beginDepthPass(data->offScreenCmdBuffer);
+
+      for (u32 i = 0; i < data->renderData.size; ++i) {
+
+        u32 matIndex = data->renderData.matId[i];
+        if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->forwardPlus.hasDepthPass(matIndex))
+          continue;
+
+        u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+
+        std::array<VkDescriptorSet, 3> renderDescSets = {
+          data->materials[matIndex].descriptorSet,
+          data->descriptorSets.globalViewData,
+          data->descriptorSets.perObjectModels[i],
+        };
+
+        data->forwardPlus.bindDepth(data->offScreenCmdBuffer, matIndex);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->forwardPlus.pipelineLayout(matIndex), 0, 3, renderDescSets.data(), 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, forwardOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+      }
+
+      data->forwardPlus.endDepthPass(data->offScreenCmdBuffer);
+      data->forwardPlus.beginForwardPass(data->offScreenCmdBuffer);
+
+      if (data->renderSkybox && isLoaded(data->skyboxGeometry)) {
+
+        const GeometryResource& box = data->geometries[data->skyboxGeometry.index()];
+
+        data->forwardPlus.bindForward(data->offScreenCmdBuffer, data->matSkybox);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->forwardPlus.pipelineLayout(data->matSkybox), 0, 1, &data->materials[data->matSkybox].descriptorSet, 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &box.vertexBuffer.buffer, forwardOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, box.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, box.indicesSize, 1, 0, 0, 0);
+      }
+
+      for (u32 i = 0; i < data->renderData.size; ++i) {
+
+        u32 matIndex = data->renderData.matId[i];
+        if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->forwardPlus.hasDepthPass(matIndex))
+          continue;
+
+        u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+
+        std::array<VkDescriptorSet, 3> renderDescSets = {
+          data->materials[matIndex].descriptorSet,
+          data->descriptorSets.globalViewData,
+          data->descriptorSets.perObjectModels[i],
+        };
+
+        data->forwardPlus.bindForward(data->offScreenCmdBuffer, matIndex);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->forwardPlus.pipelineLayout(matIndex), 0, 3, renderDescSets.data(), 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, forwardOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+      }
+
+      data->forwardPlus.endForwardPass(data->offScreenCmdBuffer);
+
+      if (data->virtualTexturing)
+        data->virtualTexture.recordFeedbackBarrier(data->offScreenCmdBuffer);
+
+      VK_CHECK(vkEndCommandBuffer(data->offScreenCmdBuffer));
+      return;
+    }
+
+    // Pass 2: G-buffer and lighting in one render pass ->
+    if (data->renderPath == Data::kRenderPath_Subpass) {
+
+      VkDeviceSize subpassOffsets[1] = { 0 };
+
+      data->subpassDeferred.beginPass(data->offScreenCmdBuffer);
+
+      if (data->renderSkybox && isLoaded(data->skyboxGeometry)) {
+
+        const GeometryResource& box = data->geometries[data->skyboxGeometry.index()];
+
+        data->subpassDeferred.bindMaterial(data->offScreenCmdBuffer, data->matSkybox);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipelineLayout, 0, 1, &data->materials[data->matSkybox].descriptorSet, 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &box.vertexBuffer.buffer, subpassOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, box.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, box.indicesSize, 1, 0, 0, 0);
+      }
+
+      for (u32 i = 0; i < data->renderData.size; ++i) {
+
+        u32 matIndex = data->renderData.matId[i];
+        if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->subpassDeferred.hasMaterial(matIndex))
+          continue;
+
+        u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+
+        std::array<VkDescriptorSet, 3> renderDescSets = {
+          data->materials[matIndex].descriptorSet,
+          data->descriptorSets.globalViewData,
+          data->descriptorSets.perObjectModels[i],
+        };
+
+        data->subpassDeferred.bindMaterial(data->offScreenCmdBuffer, matIndex);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[matIndex].pipelineLayout, 0, 3, renderDescSets.data(), 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, subpassOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+      }
+
+      data->subpassDeferred.recordLighting(data->offScreenCmdBuffer);
+
+      if (data->virtualTexturing)
+        data->virtualTexture.recordFeedbackBarrier(data->offScreenCmdBuffer);
+
+      VK_CHECK(vkEndCommandBuffer(data->offScreenCmdBuffer));
+      return;
+    }
+
+    // Pass 2: Visibility ids, then every material resolved from them ->
+    if (data->renderPath == Data::kRenderPath_Visibility) {
+
+      VkDeviceSize visibilityOffsets[1] = { 0 };
+
+      data->visibilityBuffer.beginVisibilityPass(data->offScreenCmdBuffer, data->descriptorSets.globalViewData);
+
+      for (u32 i = 0; i < data->renderData.size && i < data->visibilityBuffer.maxDraws(); ++i) {
+
+        u32 matIndex = data->renderData.matId[i];
+        if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !data->visibilityBuffer.hasMaterial(matIndex))
+          continue;
+
+        u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+
+        data->visibilityBuffer.bindDraw(data->offScreenCmdBuffer, i, data->descriptorSets.perObjectModels[i]);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, visibilityOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+      }
+
+      data->visibilityBuffer.endVisibilityPass(data->offScreenCmdBuffer);
+      data->visibilityBuffer.beginResolvePass(data->offScreenCmdBuffer);
+
+      if (data->renderSkybox && isLoaded(data->skyboxGeometry)) {
+
+        const GeometryResource& box = data->geometries[data->skyboxGeometry.index()];
+
+        data->visibilityBuffer.bindSkybox(data->offScreenCmdBuffer);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipelineLayout, 0, 1, &data->materials[data->matSkybox].descriptorSet, 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &box.vertexBuffer.buffer, visibilityOffsets);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, box.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, box.indicesSize, 1, 0, 0, 0);
+      }
+
+      // One full screen draw per material, its pixels are found by their draw
+      for (u32 material = 0; material < (u32)data->materials.size(); ++material) {
+
+        if (data->visibilityBuffer.hasMaterial(material))
+          data->visibilityBuffer.recordResolve(data->offScreenCmdBuffer, material, data->materials[material].descriptorSet);
+      }
+
+      data->visibilityBuffer.endResolvePass(data->offScreenCmdBuffer);
+
+      if (data->virtualTexturing)
+        data->virtualTexture.recordFeedbackBarrier(data->offScreenCmdBuffer);
+
+      VK_CHECK(vkEndCommandBuffer(data->offScreenCmdBuffer));
+      return;
+    }
+
+    VkDeviceSize offsets2[1] = { 0 };
+
+    auto hasPrepass = [this](u32 material) {
+      return material < data->prepass.depth.size() && data->prepass.depth[material] != VK_NULL_HANDLE;
+    };
+
+    // Pass 2: Depth prepass of the G-buffer ->
+    if (data->depthPrepass) {
+
+      clearValues[0].depthStencil = { 1.0f, 0 };
+
+      renderPassBeginInfo.renderPass = data->prepass.depthPass;
+      renderPassBeginInfo.framebuffer = data->prepass.depthFramebuffer;
+      renderPassBeginInfo.renderArea.extent = { data->resolution.width, data->resolution.height };
+      renderPassBeginInfo.clearValueCount = 1;
+      renderPassBeginInfo.pClearValues = clearValues.data();
+
+      vkCmdBeginRenderPass(data->offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+      viewport = vk::initializers::Viewport((float)data->resolution.width, (float)data->resolution.height, 0.0f, 1.0f);
+      vkCmdSetViewport(data->offScreenCmdBuffer, 0, 1, &viewport);
+
+      scissor = vk::initializers::Rect2D(data->resolution.width, data->resolution.height, 0, 0);
+      vkCmdSetScissor(data->offScreenCmdBuffer, 0, 1, &scissor);
+
+      for (u32 i = 0; i < data->renderData.size; ++i) {
+
+        u32 matIndex = data->renderData.matId[i];
+        if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]) || !hasPrepass(matIndex))
+          continue;
+
+        u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
+
+        std::array<VkDescriptorSet, 3> renderDescSets = {
+          data->materials[matIndex].descriptorSet,
+          data->descriptorSets.globalViewData,
+          data->descriptorSets.perObjectModels[i],
+        };
+
+        vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->prepass.depth[matIndex]);
+        vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[matIndex].pipelineLayout, 0, 3, renderDescSets.data(), 0, NULL);
+
+        vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, offsets2);
+        vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+      }
+
+      vkCmdEndRenderPass(data->offScreenCmdBuffer);
+
+      // Prepass depth to the tests of the G-buffer pass
+      const vk::FramebufferAttachment& depth = data->defFramebuffers.deferred->attachments[kGBufferTargets - 1];
+
+      VkImageMemoryBarrier depthBarrier = vk::initializers::ImageMemoryBarrier();
+      depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+      depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+      depthBarrier.image = depth.image;
+      depthBarrier.subresourceRange = depth.subresourceRange;
+
+      vkCmdPipelineBarrier(data->offScreenCmdBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+    }
+
     // Pass 2: Deferred calculations ->
 
     clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
     clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
     clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-    clearValues[3].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-    clearValues[4].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-    clearValues[5].depthStencil = { 1.0f, 0 };
+    clearValues[3].depthStencil = { 1.0f, 0 };
 
-    renderPassBeginInfo.renderPass = data->defFramebuffers.deferred->renderPass;
+    renderPassBeginInfo.renderPass = data->depthPrepass ? data->prepass.gbufferPass : data->defFramebuffers.deferred->renderPass;
     renderPassBeginInfo.framebuffer = data->defFramebuffers.deferred->framebuffer;
-    renderPassBeginInfo.renderArea.extent.width = data->defFramebuffers.deferred->width;
-    renderPassBeginInfo.renderArea.extent.height = data->defFramebuffers.deferred->height;
-    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.renderArea.extent = { data->resolution.width, data->resolution.height };
+    renderPassBeginInfo.clearValueCount = kGBufferTargets;
     renderPassBeginInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(data->offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    viewport = vk::initializers::Viewport(
-      (float)data->defFramebuffers.deferred->width, (float)data->defFramebuffers.deferred->height, 0.0f, 1.0f);
+    viewport = vk::initializers::Viewport((float)data->resolution.width, (float)data->resolution.height, 0.0f, 1.0f);
     vkCmdSetViewport(data->offScreenCmdBuffer, 0, 1, &viewport);
 
-    scissor = vk::initializers::Rect2D(
-      data->defFramebuffers.deferred->width, data->defFramebuffers.deferred->height, 0, 0);
+    scissor = vk::initializers::Rect2D(data->resolution.width, data->resolution.height, 0, 0);
     vkCmdSetScissor(data->offScreenCmdBuffer, 0, 1, &scissor);
 
-    VkDeviceSize offsets2[1] = { 0 };
-
-    // Skybox
-    if (data->renderSkybox) {
-
-      vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipeline);
-      vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipelineLayout, 0, 1, &data->materials[data->matSkybox].descriptorSet, 0, NULL);
-      
-      vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[1].vertexBuffer.buffer, offsets2);
-      vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[1].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      
-      vkCmdDrawIndexed(data->offScreenCmdBuffer, (u32)data->geometries[1].indices.size(), 1, 0, 0, 0);
-    }
-
-
     for (u32 i = 0; i < data->renderData.size; ++i) {
 
       u32 matIndex = data->renderData.matId[i];
-      u32 geoIndex = data->renderData.geoId[i];
+      if (!data->geometryRegistry.isLoaded(data->renderData.geoId[i]))
+        continue;
+
+      u32 geoIndex = HandleIndex(data->renderData.geoId[i]);
 
       std::array<VkDescriptorSet, 3> renderDescSets = {
         data->materials[matIndex].descriptorSet,
@@ -504,22 +1555,85 @@ namespace Reignite {
         data->descriptorSets.perObjectModels[i],
       };
 
-      vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[matIndex].pipeline);
+      // Materials without a prepass version still test and write depth
+      VkPipeline pipeline = (data->depthPrepass && hasPrepass(matIndex)) ?
+        data->prepass.gbuffer[matIndex] : data->materials[matIndex].pipeline;
+
+      vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
       vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[matIndex].pipelineLayout, 0, 3, renderDescSets.data(), 0, NULL);
 
       vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &data->geometries[geoIndex].vertexBuffer.buffer, offsets2);
       vkCmdBindIndexBuffer(data->offScreenCmdBuffer, data->geometries[geoIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      vkCmdDrawIndexed(data->offScreenCmdBuffer, (u32)data->geometries[geoIndex].indices.size(), 1, 0, 0, 0);
+      vkCmdDrawIndexed(data->offScreenCmdBuffer, data->geometries[geoIndex].indicesSize, 1, 0, 0, 0);
+    }
+
+    // Skybox last, at the far plane: early depth tests drop every covered pixel
+    if (data->renderSkybox && isLoaded(data->skyboxGeometry)) {
+
+      const GeometryResource& box = data->geometries[data->skyboxGeometry.index()];
+
+      vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipeline);
+      vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matSkybox].pipelineLayout, 0, 1, &data->materials[data->matSkybox].descriptorSet, 0, NULL);
+      
+      vkCmdBindVertexBuffers(data->offScreenCmdBuffer, 0, 1, &box.vertexBuffer.buffer, offsets2);
+      vkCmdBindIndexBuffer(data->offScreenCmdBuffer, box.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+      
+      vkCmdDrawIndexed(data->offScreenCmdBuffer, box.indicesSize, 1, 0, 0, 0);
     }
 
     vkCmdEndRenderPass(data->offScreenCmdBuffer);
 
+    if (data->virtualTexturing)
+      data->virtualTexture.recordFeedbackBarrier(data->offScreenCmdBuffer);
+
+    // Pass 3: Clustered lighting at the render resolution ->
+    if (data->renderPath == Data::kRenderPath_Clustered) {
+
+      VkMemoryBarrier targetsBarrier = vk::initializers::MemoryBarrier();
+      targetsBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      targetsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+      vkCmdPipelineBarrier(data->offScreenCmdBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &targetsBarrier, 0, nullptr, 0, nullptr);
+
+      // Every pixel of the area is written, nothing is cleared
+      renderPassBeginInfo.renderPass = data->defFramebuffers.lit->renderPass;
+      renderPassBeginInfo.framebuffer = data->defFramebuffers.lit->framebuffer;
+      renderPassBeginInfo.clearValueCount = 0;
+      renderPassBeginInfo.pClearValues = nullptr;
+
+      vkCmdBeginRenderPass(data->offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+      vkCmdSetViewport(data->offScreenCmdBuffer, 0, 1, &viewport);
+      vkCmdSetScissor(data->offScreenCmdBuffer, 0, 1, &scissor);
+
+      vkCmdBindDescriptorSets(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferred].pipelineLayout, 0, 1, &data->materials[data->matDeferred].descriptorSet, 0, NULL);
+      vkCmdBindPipeline(data->offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferred].pipeline);
+      vkCmdDraw(data->offScreenCmdBuffer, 6, 1, 0, 0);
+
+      vkCmdEndRenderPass(data->offScreenCmdBuffer);
+    }
+
+    // Pass 3: Tiled lighting ->
+    if (data->renderPath == Data::kRenderPath_Tiled)
+      data->tiledShading.recordShading(data->offScreenCmdBuffer);
+
+    // Pass 3: Light volumes, lights of the build time count ->
+    if (data->renderPath == Data::kRenderPath_LightVolumes && isLoaded(data->lightVolumeGeometry)) {
+      data->lightVolumes.recordLighting(data->offScreenCmdBuffer,
+        data->geometries[data->lightVolumeGeometry.index()], data->lightClusters.lightCount());
+    }
+
     VK_CHECK(vkEndCommandBuffer(data->offScreenCmdBuffer));
   }
 
-  void Reignite::RenderContext::buildCommandBuffers() {
+  void Reignite::RenderContext::recordDrawCommands(u32 frame, u32 image) {
+
+    // Recorded every frame for the acquired image, with the overlay of the frame
+    const VkCommandBuffer cmd = data->frames[frame].drawCmdBuffer;
 
     VkCommandBufferBeginInfo cmdBufferInfo = vk::initializers::CommandBufferBeginInfo();
+    cmdBufferInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     VkClearValue clearValues[2];
     clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
@@ -534,79 +1648,103 @@ namespace Reignite {
     renderPassBeginInfo.clearValueCount = 2;
     renderPassBeginInfo.pClearValues = clearValues;
 
-    for (s32 i = 0; i < data->commandBuffers.size(); ++i) {
-    
-      renderPassBeginInfo.framebuffer = data->framebuffers[i];
+    renderPassBeginInfo.framebuffer = data->framebuffers[image];
 
-      VK_CHECK(vkBeginCommandBuffer(data->commandBuffers[i], &cmdBufferInfo));
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBufferInfo));
 
-      vkCmdBeginRenderPass(data->commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // This frame's page requests, read once its fence has signalled
+    if (data->virtualTexturing)
+      data->virtualTexture.recordFeedbackCopy(cmd, frame);
+    data->lightClusters.recordPeaksCopy(cmd, frame);
 
-      VkViewport viewport = vk::initializers::Viewport((float)state->window->width(), (float)state->window->height(), 0.0f, 1.0f);
-      vkCmdSetViewport(data->commandBuffers[i], 0, 1, &viewport);
+    vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-      VkRect2D scissor = vk::initializers::Rect2D(state->window->width(), state->window->height(), 0, 0);
-      vkCmdSetScissor(data->commandBuffers[i], 0, 1, &scissor);
+    VkViewport viewport = vk::initializers::Viewport((float)state->window->width(), (float)state->window->height(), 0.0f, 1.0f);
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
 
-      VkDeviceSize offsets[1] = { 0 };
+    VkRect2D scissor = vk::initializers::Rect2D(state->window->width(), state->window->height(), 0, 0);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-      if (data->deferredDebug) {
+    VkDeviceSize offsets[1] = { 0 };
 
-        std::array<VkDescriptorSet, 3> descSets = {
-          data->materials[data->matDeferredDebug].descriptorSet,
-          data->descriptorSets.screenViewData,
-          data->descriptorSets.screenModel
-        };
+    if (data->deferredDebug) {
 
-        vkCmdBindDescriptorSets(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferredDebug].pipelineLayout, 0, 3, descSets.data(), 0, NULL);
-        vkCmdBindPipeline(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferredDebug].pipeline);
-        vkCmdBindVertexBuffers(data->commandBuffers[i], 0, 1, &data->debugQuad_Deferred.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(data->commandBuffers[i], data->debugQuad_Deferred.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(data->commandBuffers[i], data->debugQuad_Deferred.indexCount, 1, 0, 0, 1);
-        // Move viewport to display final composition in lower right corner
-        viewport.x = viewport.width * 0.5f;
-        viewport.y = viewport.height * 0.5f;
-        viewport.width = viewport.width * 0.5f;
-        viewport.height = viewport.height * 0.5f;
-        vkCmdSetViewport(data->commandBuffers[i], 0, 1, &viewport);
-      }
+      std::array<VkDescriptorSet, 3> descSets = {
+        data->materials[data->matDeferredDebug].descriptorSet,
+        data->descriptorSets.screenViewData,
+        data->descriptorSets.screenModel
+      };
 
-      // Final result on a full screen quad
-      vkCmdBindDescriptorSets(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferred].pipelineLayout, 0, 1, &data->materials[data->matDeferred].descriptorSet, 0, NULL);
-      vkCmdBindPipeline(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferred].pipeline);
-      vkCmdDraw(data->commandBuffers[i], 6, 1, 0, 0);
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferredDebug].pipelineLayout, 0, 3, descSets.data(), 0, NULL);
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matDeferredDebug].pipeline);
+      vkCmdBindVertexBuffers(cmd, 0, 1, &data->debugQuad_Deferred.vertices.buffer, offsets);
+      vkCmdBindIndexBuffer(cmd, data->debugQuad_Deferred.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+      vkCmdDrawIndexed(cmd, data->debugQuad_Deferred.indexCount, 1, 0, 0, 1);
+      // Move viewport to display final composition in lower right corner
+      viewport.x = viewport.width * 0.5f;
+      viewport.y = viewport.height * 0.5f;
+      viewport.width = viewport.width * 0.5f;
+      viewport.height = viewport.height * 0.5f;
+      vkCmdSetViewport(cmd, 0, 1, &viewport);
+    }
 
-      if (data->shadowsDebug) {
+    // Final result on a full screen quad
+    if (data->renderPath == Data::kRenderPath_Tiled) {
+      data->tiledShading.recordComposite(cmd);
+    }
+    else if (data->renderPath == Data::kRenderPath_ForwardPlus) {
+      data->forwardPlus.recordComposite(cmd);
+    }
+    else if (data->renderPath == Data::kRenderPath_LightVolumes) {
+      data->lightVolumes.recordComposite(cmd);
+    }
+    else if (data->renderPath == Data::kRenderPath_Subpass) {
+      data->subpassDeferred.recordComposite(cmd);
+    }
+    else if (data->renderPath == Data::kRenderPath_Visibility) {
+      data->visibilityBuffer.recordComposite(cmd);
+    }
+    else {
+      const vec2f size((float)data->resolution.width, (float)data->resolution.height);
 
-        std::array<VkDescriptorSet, 3> descSets = {
-          data->materials[data->matShadowsDebug].descriptorSet,
-          data->descriptorSets.screenViewData,
-          data->descriptorSets.screenModel
-        };
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->composite.pipelineLayout, 0, 1, &data->composite.set, 0, NULL);
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->composite.pipeline);
+      vkCmdPushConstants(cmd, data->composite.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(size), &size);
+      vkCmdDraw(cmd, 6, 1, 0, 0);
+    }
 
-        vkCmdBindDescriptorSets(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matShadowsDebug].pipelineLayout, 0, 3, descSets.data(), 0, NULL);
-        vkCmdBindPipeline(data->commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matShadowsDebug].pipeline);
-        vkCmdBindVertexBuffers(data->commandBuffers[i], 0, 1, &data->debugQuad_Shadows.vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(data->commandBuffers[i], data->debugQuad_Shadows.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(data->commandBuffers[i], 6, 3 /*Lighs*/, 0, 0, 0);
-      }
+    if (data->shadowsDebug) {
 
-      // Draw UI call should be here
-      {
-        const VkViewport viewport = vk::initializers::Viewport((float)state->window->width(), (float)state->window->height(), 0.0f, 1.0f);
-        const VkRect2D scissor = vk::initializers::Rect2D(state->window->width(), state->window->height(), 0, 0);
-        vkCmdSetViewport(data->commandBuffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(data->commandBuffers[i], 0, 1, &scissor);
+      std::array<VkDescriptorSet, 3> descSets = {
+        data->materials[data->matShadowsDebug].descriptorSet,
+        data->descriptorSets.screenViewData,
+        data->descriptorSets.screenModel
+      };
 
-        data->overlay.draw(data->commandBuffers[i]);
-      }
-      // UI draw calls
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matShadowsDebug].pipelineLayout, 0, 3, descSets.data(), 0, NULL);
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, data->materials[data->matShadowsDebug].pipeline);
+      vkCmdBindVertexBuffers(cmd, 0, 1, &data->debugQuad_Shadows.vertices.buffer, offsets);
+      vkCmdBindIndexBuffer(cmd, data->debugQuad_Shadows.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+      vkCmdDrawIndexed(cmd, 6, 3 /*Lighs*/, 0, 0, 0);
+    }
 
-      vkCmdEndRenderPass(data->commandBuffers[i]);
+    // Draw UI call should be here
+    {
+      const VkViewport viewport = vk::initializers::Viewport((float)state->window->width(), (float)state->window->height(), 0.0f, 1.0f);
+      const VkRect2D scissor = vk::initializers::Rect2D(state->window->width(), state->window->height(), 0, 0);
+      vkCmdSetViewport(cmd, 0, 1, &viewport);
+      vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-      VK_CHECK(vkEndCommandBuffer(data->commandBuffers[i]));
+      data->overlay.draw(cmd, frame);
     }
+    // UI draw calls
+
+    vkCmdEndRenderPass(cmd);
 
+    if (data->resolution.timestamps != VK_NULL_HANDLE)
+      vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, data->resolution.timestamps, 2 * frame + 1);
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
   }
 
   void Reignite::RenderContext::windowResize() {
@@ -629,29 +1767,44 @@ namespace Reignite {
 
     setupFramebuffer();
 
-    // update overlay
-
-    // Recreate command buffers
-    destroyCommandBuffers();
-    createCommandBuffers();
-    buildCommandBuffers();
+    // The targets follow the window at the same render scale
+    resizeRenderTargets();
 
-    vkDeviceWaitIdle(data->device);
+    // update overlay
 
     // update aspect ratio
   }
 
   void Reignite::RenderContext::drawScene() {
 
+    Data::Frame& frame = data->frames[data->frameIndex];
+
     updateRenderState();
+
+    // The fence of this frame slot has signalled, so have its timestamps. A
+    // new scale goes to the uniforms below.
+    updateRenderScale();
+    updateLightOverflows();
+
     updateUniformBufferDeferredMatrices();
     updateUniformBufferDeferredLights();
     updateUniformBuffersScreen();
 
+    updateAssetLoads();
+    if (data->assetsChanged) {
+      data->assetsChanged = false;
+      buildDeferredCommands();
+    }
+
+    updateTextureStreaming();
+
+    if (data->virtualTexturing)
+      data->virtualTexture.update(data->frameIndex, frame.uploadCmdBuffer, data->uploads);
+
     // prepare frame
     {
       VkResult result = data->swapchain.acquireNextImage(
-        data->semaphores.presentComplete, &data->currentBuffer);
+        frame.presentComplete, &data->currentBuffer);
 
       if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
         // TODO: window resize
@@ -661,28 +1814,45 @@ namespace Reignite {
       }
     }
 
+    recordDrawCommands(data->frameIndex, data->currentBuffer);
+
+    // Everything staged this frame lands before its passes read it
+    data->uploads.recordCopies(frame.uploadCmdBuffer);
+    VK_CHECK(vkEndCommandBuffer(frame.uploadCmdBuffer));
+
     // submiting config
     {
-      data->submitInfo.pWaitSemaphores = &data->semaphores.presentComplete;
-      data->submitInfo.pSignalSemaphores = &data->offScreenSemaphore;
+      std::array<VkCommandBuffer, 2> offScreenCmdBuffers = { frame.uploadCmdBuffer, data->offScreenCmdBuffer };
 
-      data->submitInfo.commandBufferCount = 1;
-      data->submitInfo.pCommandBuffers = &data->offScreenCmdBuffer;
+      data->submitInfo.pWaitSemaphores = &frame.presentComplete;
+      data->submitInfo.pSignalSemaphores = &frame.offScreenComplete;
+
+      data->submitInfo.commandBufferCount = static_cast<u32>(offScreenCmdBuffers.size());
+      data->submitInfo.pCommandBuffers = offScreenCmdBuffers.data();
       VK_CHECK(vkQueueSubmit(data->queue, 1, &data->submitInfo, VK_NULL_HANDLE));
 
-      data->submitInfo.pWaitSemaphores = &data->offScreenSemaphore;
-      data->submitInfo.pSignalSemaphores = &data->semaphores.renderComplete;
+      data->submitInfo.pWaitSemaphores = &frame.offScreenComplete;
+      data->submitInfo.pSignalSemaphores = &frame.renderComplete;
 
-      data->submitInfo.pCommandBuffers = &data->commandBuffers[data->currentBuffer];
-      VK_CHECK(vkQueueSubmit(data->queue, 1, &data->submitInfo, VK_NULL_HANDLE));
+      // The frame fence tells the deletion queue and the next use of this
+      // slot when the frame is done
+      VK_CHECK(vkResetFences(data->device, 1, &frame.fence));
+
+      data->submitInfo.commandBufferCount = 1;
+      data->submitInfo.pCommandBuffers = &frame.drawCmdBuffer;
+      VK_CHECK(vkQueueSubmit(data->queue, 1, &data->submitInfo, frame.fence));
+      frame.number = ++data->submittedFrames;
     }
 
     // submit frame
     {
       VkResult result = data->swapchain.queuePresent(data->queue, 
-        data->currentBuffer, data->semaphores.renderComplete);
+        data->currentBuffer, frame.renderComplete);
 
-      if (!((result = VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
+      // Only waits when the GPU is kMaxFramesInFlight frames behind
+      beginFrame((data->frameIndex + 1) % kMaxFramesInFlight);
+
+      if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
           // window resize
@@ -692,10 +1862,37 @@ namespace Reignite {
           VK_CHECK(result);
         }
       }
+    }
+
+  }
 
-      VK_CHECK(vkQueueWaitIdle(data->queue));
-    }
+  void Reignite::RenderContext::beginFrame(u32 index) {
+
+    data->frameIndex = index;
+    Data::Frame& frame = data->frames[index];
+
+    VK_CHECK(vkWaitForFences(data->device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+    collectRetired();
 
+    data->uploads.begin(index);
+
+    VkCommandBufferBeginInfo cmdBufferInfo = vk::initializers::CommandBufferBeginInfo();
+    cmdBufferInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(frame.uploadCmdBuffer, &cmdBufferInfo));
+
+    // Frames share the G-buffer and the path targets, the previous frame
+    // finishes with them before this one starts
+    VkMemoryBarrier barrier = vk::initializers::MemoryBarrier();
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(frame.uploadCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // The GPU frame starts here for the render scale, it ends after the composition
+    if (data->resolution.timestamps != VK_NULL_HANDLE) {
+      vkCmdResetQueryPool(frame.uploadCmdBuffer, data->resolution.timestamps, 2 * index, 2);
+      vkCmdWriteTimestamp(frame.uploadCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, data->resolution.timestamps, 2 * index);
+    }
   }
 
   void Reignite::RenderContext::drawOverlay() {
@@ -729,38 +1926,63 @@ namespace Reignite {
       ImGui::TextUnformatted(state->window->title().c_str());
       ImGui::TextUnformatted(data->physicalDeviceNames[0].c_str());
       ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / state->lastFrame), state->lastFrame);
+      ImGui::Text("%u lights", data->lightClusters.lightCount());
+
+      // Busiest light list of the path against its size, light volumes have none
+      s32 peak = -1;
+      if (data->renderPath == Data::kRenderPath_Tiled)
+        peak = LightClusters::kPeak_TiledDeferred;
+      else if (data->renderPath == Data::kRenderPath_ForwardPlus)
+        peak = LightClusters::kPeak_ForwardPlus;
+      else if (data->renderPath != Data::kRenderPath_LightVolumes)
+        peak = LightClusters::kPeak_Clusters;
+      if (peak >= 0)
+        ImGui::Text("Busiest %s %u/%u lights", kLightListNames[peak],
+          data->lightClusters.peakLights((LightClusters::Peak)peak), kLightListSizes[peak]);
 
       ImGui::PushItemWidth(110.0f * data->overlay.scale);
 
-      if (data->overlay.checkBox("Render Debug Targets", &data->deferredDebug)) {
-        buildCommandBuffers();
-        updateUniformBuffersScreen();
+      if (data->overlay.comboBox("Lighting", &data->renderPath, { "Clustered", "Tiled compute", "Forward+", "Light volumes", "Single pass", "Visibility buffer" })) {
+        buildDeferredCommands();
       }
 
-      if (data->overlay.checkBox("Render Debug Shadows", &data->shadowsDebug)) {
-        buildCommandBuffers();
-        updateUniformBuffersScreen();
+      if (data->overlay.checkBox("Depth prepass", &data->depthPrepass))
+        buildDeferredCommands();
+
+      ImGui::Text("Render scale %.2f (%ux%u), %.2f ms GPU", data->resolution.scale,
+        data->resolution.width, data->resolution.height, data->resolution.gpuTime);
+
+      // Locked, only the slider moves the scale, e.g. to benchmark one resolution
+      if (data->overlay.checkBox("Lock render scale", &data->resolution.locked))
+        data->resolution.settleFrames = 0;
+
+      if (data->resolution.locked && data->overlay.sliderFloat("Render scale", &data->resolution.scale,
+        data->params.min_render_scale, data->params.max_render_scale)) {
+        data->resolution.scale = std::round(data->resolution.scale / kRenderScaleStep) * kRenderScaleStep;
+        data->resolution.scale = (std::min)((std::max)(data->resolution.scale, data->params.min_render_scale),
+          data->params.max_render_scale);
+        updateRenderArea();
       }
 
-      if (data->overlay.checkBox("Render skybox", &data->renderSkybox)) {
-        buildCommandBuffers();
+      if (data->overlay.checkBox("Render Debug Targets", &data->deferredDebug))
+        updateUniformBuffersScreen();
+
+      if (data->overlay.checkBox("Render Debug Shadows", &data->shadowsDebug))
+        updateUniformBuffersScreen();
+
+      if (data->overlay.checkBox("Render skybox", &data->renderSkybox))
         updateUniformBuffersScreen();
-      }
 
       if (data->overlay.checkBox("Render shadows", &data->renderShadows)) {
         data->uboFragmentLights.useShadows = !data->uboFragmentLights.useShadows;
         updateUniformBufferDeferredLights();
       }
 
-      if (data->overlay.checkBox("Render UI Demo", &data->renderUIDemo)) {
-        buildCommandBuffers();
+      if (data->overlay.checkBox("Render UI Demo", &data->renderUIDemo))
         updateUniformBuffersScreen();
-      }
 
-      if (data->overlay.sliderFloat("Camera Mov Speed", &state->compSystem->camera()->movementSpeed, 1.0f, 10.0f)) {
-        buildCommandBuffers();
+      if (data->overlay.sliderFloat("Camera Mov Speed", &state->compSystem->camera()->movementSpeed, 1.0f, 10.0f))
         updateUniformBuffersScreen();
-      }
 
       ImGui::PopItemWidth();
 
@@ -772,29 +1994,57 @@ namespace Reignite {
 
       ImGui::Render();
 
-      if (data->overlay.update() || data->overlay.updated) {
-        buildCommandBuffers();
-        data->overlay.updated = false;
-      }
+      // Into the buffers of the next frame, drawScene records its draw
+      data->overlay.update(data->frameIndex);
+      data->overlay.updated = false;
     }
 
   }
 
-  void Reignite::RenderContext::createCommandBuffers() {
+  void Reignite::RenderContext::createFrames() {
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = vk::initializers::SemaphoreCreateInfo();
+
+    // Signaled, the first wait on each slot returns at once
+    VkFenceCreateInfo fenceCreateInfo =
+      vk::initializers::FenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+
+    for (Data::Frame& frame : data->frames) {
 
-    data->commandBuffers.resize(data->swapchain.imageCount);
-    VkCommandBufferAllocateInfo cmdBuffAllocateInfo =
-      vk::initializers::CommandBufferAllocateInfo(data->commandPool,
-        VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<u32>(data->commandBuffers.size()));
+      VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+      VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &frame.offScreenComplete));
+      VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+      VK_CHECK(vkCreateFence(data->device, &fenceCreateInfo, nullptr, &frame.fence));
+
+      std::array<VkCommandBuffer, 2> cmdBuffers;
+      VkCommandBufferAllocateInfo cmdBuffAllocateInfo =
+        vk::initializers::CommandBufferAllocateInfo(data->commandPool,
+          VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<u32>(cmdBuffers.size()));
     
-    VK_CHECK(vkAllocateCommandBuffers(data->device, &cmdBuffAllocateInfo, data->commandBuffers.data()));
+      VK_CHECK(vkAllocateCommandBuffers(data->device, &cmdBuffAllocateInfo, cmdBuffers.data()));
+      frame.uploadCmdBuffer = cmdBuffers[0];
+      frame.drawCmdBuffer = cmdBuffers[1];
+      frame.number = 0;
+    }
+
+    data->uploads.create(data->vulkanState, kMaxFramesInFlight, data->params.upload_buffer_size);
   }
 
-  void Reignite::RenderContext::destroyCommandBuffers() {
+  void Reignite::RenderContext::destroyFrames() {
+
+    for (Data::Frame& frame : data->frames) {
+
+      std::array<VkCommandBuffer, 2> cmdBuffers = { frame.uploadCmdBuffer, frame.drawCmdBuffer };
+      vkFreeCommandBuffers(data->device, data->commandPool, static_cast<u32>(cmdBuffers.size()), cmdBuffers.data());
+
+      vkDestroySemaphore(data->device, frame.presentComplete, nullptr);
+      vkDestroySemaphore(data->device, frame.offScreenComplete, nullptr);
+      vkDestroySemaphore(data->device, frame.renderComplete, nullptr);
+      vkDestroyFence(data->device, frame.fence, nullptr);
+      frame = Data::Frame();
+    }
 
-    vkFreeCommandBuffers(data->device, data->commandPool, 
-      static_cast<uint32_t>(data->commandBuffers.size()), 
-      data->commandBuffers.data());
+    data->uploads.destroy();
   }
 
   void Reignite::RenderContext::setupDepthStencil() {
@@ -852,6 +2102,208 @@ namespace Reignite {
 
   }
 
+  void Reignite::RenderContext::createGBuffer(u32 width, u32 height) {
+
+    data->defFramebuffers.deferred = new vk::Framebuffer(data->vulkanState);
+
+    data->defFramebuffers.deferred->width = width;
+    data->defFramebuffers.deferred->height = height;
+
+    vk::AttachmentCreateInfo attachmentCreateInfo = {};
+    attachmentCreateInfo.width = width;
+    attachmentCreateInfo.height = height;
+    attachmentCreateInfo.layerCount = 1;
+    attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    // Octahedral normal, RG16F is a color attachment format on every device
+    attachmentCreateInfo.format = VK_FORMAT_R16G16_SFLOAT;
+    data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+
+    // Albedo
+    attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+
+    // Roughness, metallic, ambient occlusion
+    attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+
+    VkFormat attDepthFormat;
+    VkBool32 validDepthFormat = vk::tools::GetSupportedDepthFormat(data->physicalDevice, &attDepthFormat);
+    assert(validDepthFormat);
+
+    // Sampled for the positions, the light volumes also test against it
+    attachmentCreateInfo.format = attDepthFormat;
+    attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+
+    VK_CHECK(data->defFramebuffers.deferred->createSampler(
+      VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+
+    VK_CHECK(data->defFramebuffers.deferred->createRenderPass());
+
+    // Depth prepass: the G-buffer depth alone, cleared and stored. The
+    // render passes only depend on the formats, they are made once.
+    vk::FramebufferAttachment& depth = data->defFramebuffers.deferred->attachments[kGBufferTargets - 1];
+    if (data->prepass.depthPass == VK_NULL_HANDLE) {
+      std::vector<VkAttachmentDescription> attachments = { depth.description };
+      std::vector<VkAttachmentReference> colorReference;
+      std::vector<VkAttachmentReference> depthReference = { { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL } };
+      VK_CHECK(CreateRenderPass(data->device, data->prepass.depthPass, colorReference, depthReference, attachments));
+    }
+
+    // G-buffer pass after it, compatible with the G-buffer framebuffer, keeping the prepass depth
+    if (data->prepass.gbufferPass == VK_NULL_HANDLE) {
+      std::vector<VkAttachmentDescription> attachments;
+      std::vector<VkAttachmentReference> colorReference;
+      for (u32 i = 0; i < kGBufferTargets - 1; ++i) {
+        attachments.push_back(data->defFramebuffers.deferred->attachments[i].description);
+        colorReference.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+      }
+
+      attachments.push_back(depth.description);
+      attachments.back().loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      attachments.back().initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+      std::vector<VkAttachmentReference> depthReference = { { kGBufferTargets - 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL } };
+      VK_CHECK(CreateRenderPass(data->device, data->prepass.gbufferPass, colorReference, depthReference, attachments));
+    }
+
+    std::vector<VkImageView> views = { depth.view };
+    VK_CHECK(CreateFramebuffer(data->device, data->prepass.depthFramebuffer, data->prepass.depthPass, width, height, views));
+
+    // Clustered lighting output, every rendered pixel is written
+    data->defFramebuffers.lit = new vk::Framebuffer(data->vulkanState);
+    data->defFramebuffers.lit->width = width;
+    data->defFramebuffers.lit->height = height;
+
+    attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    data->defFramebuffers.lit->addAttachment(attachmentCreateInfo);
+    data->defFramebuffers.lit->attachments[0].description.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    VK_CHECK(data->defFramebuffers.lit->createSampler(
+      VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+    VK_CHECK(data->defFramebuffers.lit->createRenderPass());
+
+    RI_INFO("G-buffer {}x{}, render scale up to {:.2f}", width, height, data->params.max_render_scale);
+  }
+
+  void Reignite::RenderContext::resizeRenderTargets() {
+
+    // Only on a window resize, with the device idle. A scale step only moves
+    // the render area inside the targets.
+    const u32 width = ScaledExtent(state->window->width(), data->params.max_render_scale);
+    const u32 height = ScaledExtent(state->window->height(), data->params.max_render_scale);
+    if (width != data->defFramebuffers.deferred->width || height != data->defFramebuffers.deferred->height) {
+
+      // The pipelines made with the old render passes work with the new ones
+      vkDestroyFramebuffer(data->device, data->prepass.depthFramebuffer, nullptr);
+      delete data->defFramebuffers.deferred;
+      delete data->defFramebuffers.lit;
+      createGBuffer(width, height);
+
+      data->tiledShading.resize(width, height);
+      data->forwardPlus.resize(width, height);
+      data->lightVolumes.resize(data->defFramebuffers.deferred->attachments[kGBufferTargets - 1], width, height);
+      data->subpassDeferred.resize(*data->defFramebuffers.deferred);
+      data->visibilityBuffer.resize(width, height);
+
+      // The terrain writes its requests per screen pixel block
+      if (data->virtualTexturing) {
+        data->virtualTexture.resizeFeedback(width, height);
+        data->virtualTexture.writeDescriptors(data->materials[data->matTerrain].descriptorSet);
+      }
+
+      // Every set reading the targets changes, the draw commands of the next
+      // frame bind them
+      updateCompositionDescriptors();
+    }
+
+    updateRenderArea();
+  }
+
+  void Reignite::RenderContext::updateRenderArea() {
+
+    // Top left of the targets at the current scale
+    const vk::Framebuffer* deferred = data->defFramebuffers.deferred;
+    const u32 width = (std::min)(ScaledExtent(state->window->width(), data->resolution.scale), deferred->width);
+    const u32 height = (std::min)(ScaledExtent(state->window->height(), data->resolution.scale), deferred->height);
+
+    data->resolution.width = width;
+    data->resolution.height = height;
+
+    data->tiledShading.setRenderArea(width, height);
+    data->forwardPlus.setRenderArea(width, height);
+    data->lightVolumes.setRenderArea(width, height);
+    data->subpassDeferred.setRenderArea(width, height);
+    data->visibilityBuffer.setRenderArea(width, height);
+
+    // Passes record their area, the light uniforms of the next frame hand it
+    // to the shaders; nothing in flight is touched
+    buildDeferredCommands();
+  }
+
+  void Reignite::RenderContext::updateLightOverflows() {
+
+    // Peaks of the last frame of this slot, lights past a list are not shaded
+    data->lightClusters.readPeaks(data->frameIndex);
+
+    for (u32 i = 0; i < LightClusters::kPeakCount; ++i) {
+
+      const u32 peak = data->lightClusters.peakLights((LightClusters::Peak)i);
+      if (peak <= kLightListSizes[i] || (data->lightOverflows & (1u << i)))
+        continue;
+
+      data->lightOverflows |= 1u << i;
+      RI_WARN("{} lights touch one {}, only {} are shaded", peak, kLightListNames[i], kLightListSizes[i]);
+    }
+  }
+
+  void Reignite::RenderContext::updateRenderScale() {
+
+    // The last frame of this slot is done, its timestamps too
+    const u32 frame = data->frameIndex;
+    if (data->resolution.timestamps == VK_NULL_HANDLE || data->frames[frame].number == 0)
+      return;
+
+    u64 timestamps[2];
+    if (vkGetQueryPoolResults(data->device, data->resolution.timestamps, 2 * frame, 2, sizeof(timestamps), timestamps,
+      sizeof(u64), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+      return;
+
+    // Averaged, a single slow frame does not move the scale. Only the valid
+    // bits count, the difference wraps with them.
+    const u64 ticks = (timestamps[1] - timestamps[0]) & data->resolution.timestampMask;
+    const float gpuTime = (float)ticks * data->deviceProperties.limits.timestampPeriod * 1e-6f;
+    if (data->resolution.settleFrames++ == 0)
+      data->resolution.gpuTime = gpuTime;
+    else
+      data->resolution.gpuTime += (gpuTime - data->resolution.gpuTime) * 0.1f;
+
+    if (data->resolution.locked || data->resolution.settleFrames < kRenderScaleSettleFrames)
+      return;
+
+    // Over the target the scale drops at once, under it grows only with
+    // some headroom left and one step at a time, so it does not flip
+    // between two steps. The cost follows the pixels, the scale squared.
+    const float target = data->params.target_frame_time;
+    const float time = data->resolution.gpuTime;
+    if (time <= target && time >= target * 0.8f)
+      return;
+
+    float scale = data->resolution.scale * std::sqrt(target * 0.9f / time);
+    scale = std::round(scale / kRenderScaleStep) * kRenderScaleStep;
+    scale = (std::min)(scale, data->resolution.scale + kRenderScaleStep);
+    scale = (std::min)((std::max)(scale, data->params.min_render_scale), data->params.max_render_scale);
+    if (std::abs(scale - data->resolution.scale) < kRenderScaleStep * 0.5f)
+      return;
+
+    data->resolution.scale = scale;
+    data->resolution.settleFrames = 0;
+
+    updateRenderArea();
+  }
+
   void RenderContext::updateUniformBuffersScreen() {
 
     if(data->deferredDebug) {
@@ -862,7 +2314,7 @@ namespace Reignite {
     }
 
     data->uboScreenVS.view = mat4f(1.0f);
-    memcpy(data->uniformBuffers.vsFullScreen.mapped, &data->uboScreenVS, sizeof(data->uboScreenVS));
+    data->uploads.write(data->uniformBuffers.vsFullScreen.buffer, 0, &data->uboScreenVS, sizeof(data->uboScreenVS));
   }
    
   void RenderContext::updateUniformBufferDeferredMatrices() {
@@ -877,16 +2329,16 @@ namespace Reignite {
     data->skyboxUboVS.model = glm::rotate(data->skyboxUboVS.model, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     data->skyboxUboVS.model = glm::rotate(data->skyboxUboVS.model, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-    memcpy(data->uniformBuffers.skybox.mapped, &data->skyboxUboVS, sizeof(data->skyboxUboVS));
+    data->uploads.write(data->uniformBuffers.skybox.buffer, 0, &data->skyboxUboVS, sizeof(data->skyboxUboVS));
 
     // Camera data
     data->uboOffscreenVS.projection = data->projection;
     data->uboOffscreenVS.view = data->view;
 
     data->uboModelVS.model_matrix = mat4f(1.0f);
-    memcpy(data->uniformBuffers.vsScreenModel.mapped, &data->uboModelVS, sizeof(data->uboModelVS));
+    data->uploads.write(data->uniformBuffers.vsScreenModel.buffer, 0, &data->uboModelVS, sizeof(data->uboModelVS));
 
-    memcpy(data->uniformBuffers.vsGlobalViewData.mapped, &data->uboOffscreenVS, sizeof(data->uboOffscreenVS));
+    data->uploads.write(data->uniformBuffers.vsGlobalViewData.buffer, 0, &data->uboOffscreenVS, sizeof(data->uboOffscreenVS));
 
     // Per-object data
     for (u32 i = 0; i < data->renderData.size; ++i) {
@@ -895,14 +2347,27 @@ namespace Reignite {
 
       data->uboModelVS.model_matrix = data->renderData.model[i];
 
-      memcpy(data->uniformBuffers.perObjectModels[i].mapped, &data->uboModelVS, sizeof(data->uboModelVS));
+      data->uploads.write(data->uniformBuffers.perObjectModels[i].buffer, 0, &data->uboModelVS, sizeof(data->uboModelVS));
+
+      if (data->renderPath == Data::kRenderPath_Visibility && i < data->visibilityBuffer.maxDraws())
+        data->visibilityBuffer.setTransform(i, data->renderData.model[i]);
     }
+
+    if (data->renderPath == Data::kRenderPath_Visibility)
+      data->visibilityBuffer.uploadDraws(data->uploads);
   }
 
   void RenderContext::updateUniformBufferDeferredLights() {
 
+    // Every light goes to the clusters, the first ones also cast shadows
+    const Camera* camera = state->compSystem->camera();
+    data->lightClusters.update(data->lightData.size, data->lightData.position.data(), data->lightData.color.data(),
+      data->lightData.radius.data(), data->view, data->projection, camera->Znear, camera->Zfar, data->uploads);
+
+    data->uboFragmentLights.numbLights = (std::min)(data->lightData.size, kShadowLights);
+
     // Lights ubo data updating
-    for (u32 i = 0; i < data->lightData.size; ++i) {
+    for (u32 i = 0; i < data->uboFragmentLights.numbLights; ++i) {
 
       data->uboFragmentLights.lights[i].color = data->lightData.color[i];
       data->uboFragmentLights.lights[i].position = data->lightData.position[i];
@@ -916,7 +2381,7 @@ namespace Reignite {
     float zFar = 64.0f;
     float lightFOV = 100.0f;
 
-    for (u32 i = 0; i < 3; ++i) {
+    for (u32 i = 0; i < kShadowLights; ++i) {
 
       glm::mat4 shadowProj = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, zFar);
       glm::mat4 shadowView = glm::lookAt(glm::vec3(data->uboFragmentLights.lights[i].position), glm::vec3(data->uboFragmentLights.lights[i].target), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -930,46 +2395,106 @@ namespace Reignite {
     data->uboShadowGS.instancePos[1] = glm::vec4(-4.0f, 0.0, -4.0f, 0.0f);
     data->uboShadowGS.instancePos[2] = glm::vec4(4.0f, 0.0, -4.0f, 0.0f);
 
-    memcpy(data->uniformBuffers.gsShadows.mapped, &data->uboShadowGS, sizeof(data->uboShadowGS));
+    data->uploads.write(data->uniformBuffers.gsShadows.buffer, 0, &data->uboShadowGS, sizeof(data->uboShadowGS));
 
-    // Current view position
+    // Pixels rendered, and the part of the targets they cover
+    const vk::Framebuffer* deferred = data->defFramebuffers.deferred;
+    data->uboFragmentLights.renderArea = vec4f((float)data->resolution.width, (float)data->resolution.height,
+      (float)data->resolution.width / (float)deferred->width, (float)data->resolution.height / (float)deferred->height);
+
+    // Current view position, and the way back from depth to world position
     data->uboFragmentLights.viewPos = glm::vec4(state->compSystem->camera()->position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+    data->uboFragmentLights.inverseViewProjection = glm::inverse(data->projection * data->view);
 
-    memcpy(data->uniformBuffers.fsLights.mapped, &data->uboFragmentLights, sizeof(data->uboFragmentLights));
+    data->uploads.write(data->uniformBuffers.fsLights.buffer, 0, &data->uboFragmentLights, sizeof(data->uboFragmentLights));
   }
 
-  void RenderContext::loadResources() {
-    
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/red_bricks_albedo.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/red_bricks_normal.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/red_bricks_roughness.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/red_bricks_metallic.png");
-    
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/iron_rust_albedo.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/iron_rust_normal.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/iron_rust_roughness.png");
-    createTextureResource(Reignite::Tools::GetAssetPath() + "textures/iron_rust_metallic.png");
+  bool Reignite::RenderContext::createVirtualTexture() {
 
-    std::string filename;
-    VkFormat format;
-    if (data->deviceFeatures.textureCompressionBC) {
-      filename = "textures/cubemap_yokohama_bc3_unorm.ktx";
-      format = VK_FORMAT_BC2_UNORM_BLOCK;
-    }
-    else if (data->deviceFeatures.textureCompressionASTC_LDR) {
-      filename = "textures/cubemap_yokohama_astc_8x8_unorm.ktx";
-      format = VK_FORMAT_ASTC_8x8_UNORM_BLOCK;
-    }
-    else if (data->deviceFeatures.textureCompressionETC2) {
-      filename = "textures/cubemap_yokohama_etc2_unorm.ktx";
-      format = VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK;
+    const std::string path = Reignite::Tools::GetAssetPath();
+    const u32 count = sizeof(kTerrainTextures) / sizeof(kTerrainTextures[0]);
+
+    std::vector<PackEntry> entries(count);
+    std::vector<std::vector<u8>> blobs(count);
+    std::vector<const u8*> texels(count);
+
+    // Pages are cut from plain RGBA8 mip chains
+    data->workers.parallelFor(count, [&](u32 i) {
+      const std::string file = path + kTerrainTextures[i];
+      const VkFormat format = (VkFormat)DefaultTextureFormat(file, false);
+      texels[i] = loadTextureData(data->pack, data->cache, data->workers, file, format, entries[i], blobs[i]);
+      if (texels[i] == nullptr)
+        texels[i] = fallbackTextureData(1, entries[i], blobs[i]);
+    });
+
+    data->virtualTexture.init(data->vulkanState, &data->workers, kMaxFramesInFlight);
+
+    bool created = true;
+    for (u32 i = 0; i < count && created; ++i)
+      created = data->virtualTexture.addLayer(entries[i], texels[i], std::move(blobs[i]));
+
+    // Its feedback covers the largest G-buffer the render scale can reach
+    created = created && data->virtualTexture.create(ScaledExtent(state->window->width(), data->params.max_render_scale),
+      ScaledExtent(state->window->height(), data->params.max_render_scale),
+      data->frames[data->frameIndex].uploadCmdBuffer, data->uploads);
+
+    if (!created) {
+      data->virtualTexture.destroy();
+      RI_WARN("Terrain falls back to regular textures");
     }
-    else {
-      assert(!"Compressed texture format not supported");
+
+    return created;
+  }
+
+  void RenderContext::loadResources() {
+    
+    const std::string path = Reignite::Tools::GetAssetPath();
+    const bool compressionBC = data->enabledFeatures.textureCompressionBC == VK_TRUE;
+
+    // The cubemap is transcoded on a worker while the material textures load
+    const std::string cubemapFile = path + kCubemapSource;
+    const VkFormat cubemapFormat = (VkFormat)DefaultTextureFormat(cubemapFile, compressionBC);
+    PackEntry cubemapEntry;
+    std::vector<u8> cubemapBlob;
+    const u8* cubemapTexels = nullptr;
+
+    std::future<void> cubemapJob = data->workers.submit([&]() {
+      cubemapTexels = loadTextureData(data->pack, data->cache, data->workers, cubemapFile, cubemapFormat,
+        cubemapEntry, cubemapBlob);
+      if (cubemapTexels != nullptr && cubemapEntry.layers != 6) {
+        RI_ERROR("{0} has {1} faces, a cubemap needs 6", cubemapFile.c_str(), cubemapEntry.layers);
+        cubemapTexels = nullptr;
+      }
+      if (cubemapTexels == nullptr)
+        cubemapTexels = fallbackTextureData(6, cubemapEntry, cubemapBlob);
+    });
+
+    // Binding 0: Color map, 1: Normal map, 2: Roughness map, 3: Metallic map
+    const std::vector<TextureHandle> ironTextures = createTextureResources({
+      path + "textures/iron_rust_albedo.png",
+      path + "textures/iron_rust_normal.png",
+      path + "textures/iron_rust_roughness.png",
+      path + "textures/iron_rust_metallic.png"
+    });
+    for (TextureHandle handle : ironTextures)
+      data->materials[data->matIron].textures.push_back((s32)handle.index());
+
+    // The virtual texture was set up before the terrain layout
+    if (!data->virtualTexturing) {
+
+      std::vector<std::string> terrainTextures;
+      for (const char* file : kTerrainTextures)
+        terrainTextures.push_back(path + file);
+
+      for (TextureHandle handle : createTextureResources(terrainTextures))
+        data->materials[data->matTerrain].textures.push_back((s32)handle.index());
     }
 
-    data->cubeMap.loadFromFile(Reignite::Tools::GetAssetPath() + filename, 
-      format, data->vulkanState, data->queue);
+    cubemapJob.get();
+
+    data->cubeMap.loadFromBuffer(cubemapTexels, cubemapEntry.size, (VkFormat)cubemapEntry.format,
+      cubemapEntry.width, cubemapEntry.height, cubemapEntry.mipLevels, cubemapEntry.mipOffset, cubemapEntry.mipSize,
+      data->vulkanState, data->queue);
   }
 
   void Reignite::RenderContext::initialize(const std::shared_ptr<State> s, const RenderContextParams& params) {
@@ -1008,6 +2533,12 @@ namespace Reignite {
       data->enabledFeatures.samplerAnisotropy = VK_TRUE;
     }
 
+    // Virtual texture feedback is written from the G-buffer fragment shader
+    if (data->deviceFeatures.fragmentStoresAndAtomics) {
+      data->enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+      data->virtualTexturing = true;
+    }
+
     if (data->deviceFeatures.textureCompressionBC) {
       data->enabledFeatures.textureCompressionBC = VK_TRUE;
     }
@@ -1019,6 +2550,13 @@ namespace Reignite {
     }
 
     data->vulkanState = new vk::VulkanState(data->physicalDevice);
+
+    // Lets the texture streamer size its budget from what the driver grants
+    if (data->vulkanState->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+      data->enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      data->memoryBudget = true;
+    }
+
     VkResult res = data->vulkanState->createDevice(data->enabledFeatures, data->enabledDeviceExtensions, data->deviceCreatepNextChain);
     if (res != VK_SUCCESS) {
       assert(res == VK_SUCCESS);
@@ -1034,16 +2572,11 @@ namespace Reignite {
 
     data->swapchain.connect(data->instance, data->physicalDevice, data->device);
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo = vk::initializers::SemaphoreCreateInfo();
-    VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &data->semaphores.presentComplete));
-    VK_CHECK(vkCreateSemaphore(data->device, &semaphoreCreateInfo, nullptr, &data->semaphores.renderComplete));
-
+    // The semaphores of the frame are set at submit
     data->submitInfo = vk::initializers::SubmitInfo();
     data->submitInfo.pWaitDstStageMask = &data->submitPipelineStages;
     data->submitInfo.waitSemaphoreCount = 1;
-    data->submitInfo.pWaitSemaphores = &data->semaphores.presentComplete;
     data->submitInfo.signalSemaphoreCount = 1;
-    data->submitInfo.pSignalSemaphores = &data->semaphores.renderComplete;
 
     // init swapchain
     data->swapchain.initSurface((void*)GetModuleHandle(0), (void*)glfwGetWin32Window((GLFWwindow*)state->window->currentWindow()));
@@ -1059,14 +2592,8 @@ namespace Reignite {
     u32 auxHeight = (u32)state->window->height(); // TODO: Modify window size to u32 type
     data->swapchain.create(&auxWidth, &auxHeight);
 
-    createCommandBuffers();
- 
-    // create sync primitives
-    VkFenceCreateInfo fenceCreateInfo =
-      vk::initializers::FenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-    data->waitFences.resize(data->commandBuffers.size());
-    for (auto& fence : data->waitFences)
-      VK_CHECK(vkCreateFence(data->device, &fenceCreateInfo, nullptr, &fence));
+    // Sync, command buffers and upload regions of the frames in flight
+    createFrames();
 
     setupDepthStencil();
 
@@ -1117,7 +2644,7 @@ namespace Reignite {
         loadShader(data->device, Reignite::Tools::GetAssetPath() + "shaders/ui.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
         loadShader(data->device, Reignite::Tools::GetAssetPath() + "shaders/ui.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
       };
-      data->overlay.prepareResources();
+      data->overlay.prepareResources(kMaxFramesInFlight);
       data->overlay.preparePipeline(data->pipelineCache, data->renderPass);
     }
     
@@ -1143,48 +2670,41 @@ namespace Reignite {
       data->vertices.inputState.pVertexAttributeDescriptions = data->vertices.attributeDescriptions.data();
     }
 
-    // Setup deferred framebuffer (G-Buffer)
+    // Setup deferred framebuffer (G-Buffer), the window size times the largest render scale
     {
-      data->defFramebuffers.deferred = new vk::Framebuffer(data->vulkanState);
-
-      data->defFramebuffers.deferred->width = 2048;
-      data->defFramebuffers.deferred->height = 2048;
-
-      vk::AttachmentCreateInfo attachmentCreateInfo = {};
-      attachmentCreateInfo.width = 2048;
-      attachmentCreateInfo.height = 2048;
-      attachmentCreateInfo.layerCount = 1;
-      attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-      attachmentCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+      data->resolution.scale = (std::min)((std::max)(params.render_scale, params.min_render_scale), params.max_render_scale);
+      data->resolution.locked = params.target_frame_time <= 0.0f;
 
-      attachmentCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
+      createGBuffer(ScaledExtent(state->window->width(), params.max_render_scale),
+        ScaledExtent(state->window->height(), params.max_render_scale));
 
-      attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
-
-      attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
-
-      attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
-
-      VkFormat attDepthFormat;
-      VkBool32 validDepthFormat = vk::tools::GetSupportedDepthFormat(data->physicalDevice, &attDepthFormat);
-      assert(validDepthFormat);
-      
-      attachmentCreateInfo.format = attDepthFormat;
-      attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-      data->defFramebuffers.deferred->addAttachment(attachmentCreateInfo);
-
-      VK_CHECK(data->defFramebuffers.deferred->createSampler(
-        VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+      // The paths follow once they exist, see the end
+      data->resolution.width = ScaledExtent(state->window->width(), data->resolution.scale);
+      data->resolution.height = ScaledExtent(state->window->height(), data->resolution.scale);
+    }
 
-      VK_CHECK(data->defFramebuffers.deferred->createRenderPass());
+    // Timestamps around the GPU frame, they drive the render scale. The
+    // family of the graphics queue has to write them, every one does with
+    // timestampComputeAndGraphics; without it only those with valid bits.
+    const u32 timestampBits =
+      data->vulkanState->queueFamilyProperties[data->vulkanState->queueFamilyIndices.graphics].timestampValidBits;
+    if (timestampBits != 0) {
+      data->resolution.timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+
+      VkQueryPoolCreateInfo queryPoolInfo = {};
+      queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      queryPoolInfo.queryCount = 2 * kMaxFramesInFlight;
+      VK_CHECK(vkCreateQueryPool(data->device, &queryPoolInfo, nullptr, &data->resolution.timestamps));
+    }
+    else {
+      data->resolution.locked = true;
+      RI_WARN("No graphics queue timestamps, the render scale stays at {:.2f}", data->resolution.scale);
     }
 
+    // Uploads staged from here on go with the first frame
+    beginFrame(0);
+
     // setup shadow framebuffer
     {
       data->defFramebuffers.shadow = new vk::Framebuffer(data->vulkanState);
@@ -1205,51 +2725,42 @@ namespace Reignite {
       VK_CHECK(data->defFramebuffers.shadow->createRenderPass());
     }
 
-    // Prepare UniformBuffers
+    // Prepare UniformBuffers, written through the frame uploads
     {
       if (data->uniformBuffers.perObjectModels.size() < data->renderData.size)
         data->uniformBuffers.perObjectModels.resize(data->renderData.size);
 
       for (u32 i = 0; i < data->renderData.size; ++i) {
 
-        VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
           sizeof(data->uboModelVS), &data->uniformBuffers.perObjectModels[i]));
-
-        VK_CHECK(data->uniformBuffers.perObjectModels[i].map());
       }
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->uboOffscreenVS), &data->uniformBuffers.vsGlobalViewData));
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->uboModelVS), &data->uniformBuffers.vsScreenModel));
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->uboScreenVS), &data->uniformBuffers.vsFullScreen));
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->uboFragmentLights), &data->uniformBuffers.fsLights));
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->uboShadowGS), &data->uniformBuffers.gsShadows));
 
-      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_CHECK(data->vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         sizeof(data->skyboxUboVS), &data->uniformBuffers.skybox));
 
-      VK_CHECK(data->uniformBuffers.vsGlobalViewData.map());
-      VK_CHECK(data->uniformBuffers.vsScreenModel.map());
-      VK_CHECK(data->uniformBuffers.vsFullScreen.map());
-      VK_CHECK(data->uniformBuffers.fsLights.map());
-      VK_CHECK(data->uniformBuffers.gsShadows.map());
-      VK_CHECK(data->uniformBuffers.skybox.map());
-
       //data->uboOffscreenVS.instancePos[1] = glm::vec4(-7.0f, 0.0, -4.0f, 0.0f);
       //data->uboOffscreenVS.instancePos[2] = glm::vec4(4.0f, 0.0, -6.0f, 0.0f);
 
@@ -1259,11 +2770,20 @@ namespace Reignite {
     
     // Initialize graphic resources
     {
-      // Generate Engine Resources ->
-      createGeometryResource(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/geosphere.obj");
-      createGeometryResource(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/box.obj");
-      createGeometryResource(kGeometryEnum_Terrain);
-      createGeometryResource(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/bombilla.obj");
+      // Optional, written by the Cooker project
+      data->pack.open(Reignite::Tools::GetAssetPath() + kAssetPackFile);
+      data->cache.init(Reignite::Tools::GetAssetPath() + kDerivedDataCacheDir);
+
+      // Decided before the terrain layout and pipelines are made
+      if (data->virtualTexturing)
+        data->virtualTexturing = createVirtualTexture();
+
+      // Generate Engine Resources -> loaded on the workers while the
+      // pipelines are built, installed before the first frame
+      data->lightVolumeGeometry = loadGeometry(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/geosphere.obj");
+      data->skyboxGeometry = loadGeometry(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/box.obj");
+      loadTerrain(6, 6);
+      loadGeometry(kGeometryEnum_Load, Reignite::Tools::GetAssetPath() + "models/bombilla.obj");
 
       createMaterialResource(); // skybox
       createMaterialResource(); // deferred
@@ -1275,6 +2795,22 @@ namespace Reignite {
       createMaterialResource(); // shadows debug temp
     }
 
+    // Setup descriptor allocator, an average set of the scene. Every type a
+    // set layout uses has to be in the mix, e.g. the input attachments of the
+    // single pass lighting, even when that path is never selected. The set
+    // layouts are made through it, so a type left out is reported by name.
+    {
+      std::vector<VkDescriptorPoolSize> sizesPerSet = {
+        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
+        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, SubpassDeferred::kTargetCount)
+      };
+
+      data->descriptors.init(data->device, sizesPerSet, 64);
+    }
+
     // Setup DescriptorSetLayout
     {
       std::vector<VkDescriptorSetLayoutBinding> modelSetLayoutBindings = {
@@ -1287,13 +2823,13 @@ namespace Reignite {
         modelSetLayoutBindings.data(), static_cast<u32>(modelSetLayoutBindings.size()));
 
       // Per-object model set layout
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &modelDescriptorSetLayoutCI, nullptr, &data->modelDescriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(modelDescriptorSetLayoutCI, &data->modelDescriptorSetLayout));
 
       // View/Proj data set layout
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &modelDescriptorSetLayoutCI, nullptr, &data->viewDescriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(modelDescriptorSetLayoutCI, &data->viewDescriptorSetLayout));
 
       // Shadow data set layout
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &modelDescriptorSetLayoutCI, nullptr, &data->shadowDescriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(modelDescriptorSetLayoutCI, &data->shadowDescriptorSetLayout));
 
       std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 
@@ -1337,11 +2873,83 @@ namespace Reignite {
       VkDescriptorSetLayoutCreateInfo descriptorLayout = vk::initializers::DescriptorSetLayoutCreateInfo(
         setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
 
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &descriptorLayout, nullptr, &data->materials[data->matDeferred].descriptorSetLayout));
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &descriptorLayout, nullptr, &data->materials[data->matDeferredDebug].descriptorSetLayout));
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &descriptorLayout, nullptr, &data->materials[3].descriptorSetLayout));
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &descriptorLayout, nullptr, &data->materials[4].descriptorSetLayout));
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &descriptorLayout, nullptr, &data->materials[data->matShadowsDebug].descriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(descriptorLayout, &data->materials[data->matIron].descriptorSetLayout));
+
+      // The terrain material samples through the virtual texture when available
+      if (data->virtualTexturing) {
+
+        std::vector<VkDescriptorSetLayoutBinding> virtualTextureBindings = VirtualTexture::DescriptorSetLayoutBindings();
+        VkDescriptorSetLayoutCreateInfo virtualTextureLayout = vk::initializers::DescriptorSetLayoutCreateInfo(
+          virtualTextureBindings.data(), static_cast<uint32_t>(virtualTextureBindings.size()));
+
+        VK_CHECK(data->descriptors.createLayout(virtualTextureLayout, &data->materials[data->matTerrain].descriptorSetLayout));
+      }
+      else {
+        VK_CHECK(data->descriptors.createLayout(descriptorLayout, &data->materials[data->matTerrain].descriptorSetLayout));
+      }
+
+      // Composition and its debug views: the G-buffer, the shadow casting
+      // lights and their map, then the clustered point lights
+      std::vector<VkDescriptorSetLayoutBinding> compositionLayoutBindings;
+      for (u32 i = 0; i < kGBufferTargets; ++i) {
+        compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, i));
+      }
+      // Binding 4 : Fragment shader uniform buffer
+      compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4));
+      // Binding 5 : Shadow map
+      compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5));
+      // Binding 6 : Point lights
+      compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6));
+      // Binding 7 : Light lists of the clusters
+      compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7));
+      // Binding 8 : Cluster grid parameters
+      compositionLayoutBindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8));
+
+      VkDescriptorSetLayoutCreateInfo compositionLayout = vk::initializers::DescriptorSetLayoutCreateInfo(
+        compositionLayoutBindings.data(), static_cast<uint32_t>(compositionLayoutBindings.size()));
+
+      VK_CHECK(data->descriptors.createLayout(compositionLayout, &data->materials[data->matDeferred].descriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(compositionLayout, &data->materials[data->matDeferredDebug].descriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(compositionLayout, &data->materials[data->matShadowsDebug].descriptorSetLayout));
+
+      // Update templates. Sets of layouts with an identical definition share them.
+      std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+      for (u32 i = 0; i < kMaterialTextures; ++i) {
+        templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          i, offsetof(MaterialDescriptors, textures) + i * sizeof(VkDescriptorImageInfo)));
+      }
+      VK_CHECK(vk::CreateDescriptorUpdateTemplate(data->device, data->materials[data->matIron].descriptorSetLayout,
+        templateEntries, data->updateTemplates.material));
+
+      templateEntries.clear();
+      for (u32 i = 0; i < kGBufferTargets; ++i) {
+        templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          i, offsetof(CompositionDescriptors, targets) + i * sizeof(VkDescriptorImageInfo)));
+      }
+      templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        4, offsetof(CompositionDescriptors, lights)));
+      templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        5, offsetof(CompositionDescriptors, shadowMap)));
+      templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        6, offsetof(CompositionDescriptors, pointLights)));
+      templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        7, offsetof(CompositionDescriptors, clusters)));
+      templateEntries.push_back(vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        8, offsetof(CompositionDescriptors, clusterParams)));
+      VK_CHECK(vk::CreateDescriptorUpdateTemplate(data->device, data->materials[data->matDeferred].descriptorSetLayout,
+        templateEntries, data->updateTemplates.composition));
+
+      templateEntries = {
+        vk::initializers::DescriptorUpdateTemplateEntry(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, 0)
+      };
+      VK_CHECK(vk::CreateDescriptorUpdateTemplate(data->device, data->modelDescriptorSetLayout,
+        templateEntries, data->updateTemplates.uniformBuffer));
 
       std::array<VkDescriptorSetLayout, 2> descSetLayouts = {
         data->materials[data->matDeferred].descriptorSetLayout, data->modelDescriptorSetLayout,
@@ -1352,6 +2960,20 @@ namespace Reignite {
 
       VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[data->matDeferred].pipelineLayout));
 
+      // Composite of the clustered lighting, the rendered size goes to the bicubic filter
+      VkDescriptorSetLayoutBinding compositeBinding = vk::initializers::DescriptorSetLayoutBinding(
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+      VkDescriptorSetLayoutCreateInfo compositeLayout = vk::initializers::DescriptorSetLayoutCreateInfo(&compositeBinding, 1);
+      VK_CHECK(data->descriptors.createLayout(compositeLayout, &data->composite.setLayout));
+
+      VkPushConstantRange compositeRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vec2f), 0);
+
+      pPipelineLayoutCreateInfo = vk::initializers::PipelineLayoutCreateInfo(&data->composite.setLayout, 1);
+      pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+      pPipelineLayoutCreateInfo.pPushConstantRanges = &compositeRange;
+      VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->composite.pipelineLayout));
+
       std::array<VkDescriptorSetLayout, 3> descSetLayouts2 = {
         data->materials[data->matDeferred].descriptorSetLayout, data->viewDescriptorSetLayout, data->modelDescriptorSetLayout,
       };
@@ -1359,10 +2981,19 @@ namespace Reignite {
       pPipelineLayoutCreateInfo = vk::initializers::PipelineLayoutCreateInfo(descSetLayouts2.data(), 3);
       
       VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[data->matDeferredDebug].pipelineLayout));
-      VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[3].pipelineLayout));
-      VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[4].pipelineLayout));
       VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[data->matShadowsDebug].pipelineLayout));
 
+      // Scene materials: own textures, then view and model
+      for (u32 material : { data->matIron, data->matTerrain }) {
+
+        std::array<VkDescriptorSetLayout, 3> materialSetLayouts = {
+          data->materials[material].descriptorSetLayout, data->viewDescriptorSetLayout, data->modelDescriptorSetLayout,
+        };
+
+        pPipelineLayoutCreateInfo = vk::initializers::PipelineLayoutCreateInfo(materialSetLayouts.data(), 3);
+        VK_CHECK(vkCreatePipelineLayout(data->device, &pPipelineLayoutCreateInfo, nullptr, &data->materials[material].pipelineLayout));
+      }
+
       // Shadow pipeline layout
       std::array<VkDescriptorSetLayout, 2> shadowDescSetLayouts = {
         data->modelDescriptorSetLayout, data->shadowDescriptorSetLayout,
@@ -1388,7 +3019,7 @@ namespace Reignite {
       VkDescriptorSetLayoutCreateInfo skyboxDescSetLayoutCI = vk::initializers::DescriptorSetLayoutCreateInfo(
           skyboxSetLayoutBindings.data(), static_cast<u32>(skyboxSetLayoutBindings.size()));
 
-      VK_CHECK(vkCreateDescriptorSetLayout(data->device, &skyboxDescSetLayoutCI, nullptr, &data->materials[data->matSkybox].descriptorSetLayout));
+      VK_CHECK(data->descriptors.createLayout(skyboxDescSetLayoutCI, &data->materials[data->matSkybox].descriptorSetLayout));
 
       VkPipelineLayoutCreateInfo skyboxPipelineLayoutCI =
         vk::initializers::PipelineLayoutCreateInfo(&data->materials[data->matSkybox].descriptorSetLayout, 1);
@@ -1396,6 +3027,20 @@ namespace Reignite {
       VK_CHECK(vkCreatePipelineLayout(data->device, &skyboxPipelineLayoutCI, nullptr, &data->materials[data->matSkybox].pipelineLayout));
     }
 
+    data->lightClusters.create(data->vulkanState, data->pipelineCache, data->descriptors, data->params.max_lights,
+      kMaxFramesInFlight);
+    data->tiledShading.create(data->vulkanState, data->queue, data->pipelineCache, data->renderPass, data->descriptors,
+      data->defFramebuffers.deferred->width, data->defFramebuffers.deferred->height);
+    data->forwardPlus.create(data->vulkanState, data->pipelineCache, data->renderPass, data->descriptors,
+      data->defFramebuffers.deferred->width, data->defFramebuffers.deferred->height);
+    data->lightVolumes.create(data->vulkanState, data->pipelineCache, data->renderPass, data->descriptors,
+      data->defFramebuffers.deferred->attachments[kGBufferTargets - 1], data->defFramebuffers.deferred->width, data->defFramebuffers.deferred->height);
+    data->subpassDeferred.create(data->vulkanState, data->pipelineCache, data->renderPass, data->descriptors,
+      *data->defFramebuffers.deferred);
+    data->visibilityBuffer.create(data->vulkanState, data->pipelineCache, data->renderPass, data->descriptors,
+      data->viewDescriptorSetLayout, data->modelDescriptorSetLayout, data->defFramebuffers.deferred->width,
+      data->defFramebuffers.deferred->height, data->params.max_geometries);
+
     // Prepare Pipelines
     {
       std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentState = {
@@ -1414,13 +3059,21 @@ namespace Reignite {
       customPipelineCreateInfo.filenames = { "deferred_pbr.vert", "deferred_pbr.frag" };
       customPipelineCreateInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
       customPipelineCreateInfo.pipelineLayout = data->materials[data->matDeferred].pipelineLayout;
-      customPipelineCreateInfo.renderPass = data->renderPass;
-      customPipelineCreateInfo.depthStencilState = depthStencilState;
+      customPipelineCreateInfo.renderPass = data->defFramebuffers.lit->renderPass;
+      customPipelineCreateInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+        VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
       customPipelineCreateInfo.vertexInputState = emptyInputState;
       customPipelineCreateInfo.pipelineCache = data->pipelineCache;
 
       VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matDeferred].pipeline, customPipelineCreateInfo));
 
+      customPipelineCreateInfo.filenames = { "deferred_pbr.vert", "composite.frag" };
+      customPipelineCreateInfo.pipelineLayout = data->composite.pipelineLayout;
+      customPipelineCreateInfo.renderPass = data->renderPass;
+      customPipelineCreateInfo.depthStencilState = depthStencilState;
+
+      VK_CHECK(CreateGraphicsPipeline(data->device, data->composite.pipeline, customPipelineCreateInfo));
+
       customPipelineCreateInfo.filenames = { "debug_shadows.vert", "debug_shadows.frag" };
       customPipelineCreateInfo.pipelineLayout = data->materials[data->matShadowsDebug].pipelineLayout;
       customPipelineCreateInfo.vertexInputState = data->vertices.inputState;
@@ -1434,8 +3087,6 @@ namespace Reignite {
       VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matDeferredDebug].pipeline, customPipelineCreateInfo));
 
       std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates = {
-        vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
-        vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
         vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
         vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE),
         vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE)
@@ -1443,13 +3094,68 @@ namespace Reignite {
 
       customPipelineCreateInfo.blendAttachmentStates = blendAttachmentStates;
       customPipelineCreateInfo.filenames = { "mrt.vert", "mrt.frag" };
-      customPipelineCreateInfo.pipelineLayout = data->materials[3].pipelineLayout;
+      customPipelineCreateInfo.pipelineLayout = data->materials[data->matIron].pipelineLayout;
       customPipelineCreateInfo.renderPass = data->defFramebuffers.deferred->renderPass;
 
-      VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[3].pipeline, customPipelineCreateInfo));
+      VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matIron].pipeline, customPipelineCreateInfo));
+
+      customPipelineCreateInfo.pipelineLayout = data->materials[data->matTerrain].pipelineLayout;
+      if (data->virtualTexturing)
+        customPipelineCreateInfo.filenames = { "mrt.vert", "mrt_vt.frag" };
+
+      VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matTerrain].pipeline, customPipelineCreateInfo));
+
+      // Depth prepass versions: the depth alone, then the G-buffer only
+      // where its depth is the prepass one. The vertex shader keeps the
+      // positions invariant between both.
+      data->prepass.depth.resize(data->materials.size(), VK_NULL_HANDLE);
+      data->prepass.gbuffer.resize(data->materials.size(), VK_NULL_HANDLE);
+
+      for (u32 material : { data->matIron, data->matTerrain }) {
+
+        PipelineCreateInfo prepassInfo = customPipelineCreateInfo;
+        prepassInfo.pipelineLayout = data->materials[material].pipelineLayout;
+        prepassInfo.filenames = { "mrt.vert", "depth_only.frag" };
+        prepassInfo.blendAttachmentStates.clear();
+        prepassInfo.renderPass = data->prepass.depthPass;
+
+        VK_CHECK(CreateGraphicsPipeline(data->device, data->prepass.depth[material], prepassInfo));
+
+        prepassInfo.filenames = { "mrt.vert", (material == data->matTerrain && data->virtualTexturing) ? "mrt_vt.frag" : "mrt.frag" };
+        prepassInfo.blendAttachmentStates = customPipelineCreateInfo.blendAttachmentStates;
+        prepassInfo.renderPass = data->prepass.gbufferPass;
+        prepassInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+          VK_TRUE, VK_FALSE, VK_COMPARE_OP_EQUAL);
+
+        VK_CHECK(CreateGraphicsPipeline(data->device, data->prepass.gbuffer[material], prepassInfo));
+      }
+
+      // The same G-buffer pipelines for the first subpass of the single pass path
+      for (u32 material : { data->matIron, data->matTerrain }) {
+
+        customPipelineCreateInfo.pipelineLayout = data->materials[material].pipelineLayout;
+        customPipelineCreateInfo.filenames = { "mrt.vert",
+          (material == data->matTerrain && data->virtualTexturing) ? "mrt_vt.frag" : "mrt.frag" };
+
+        data->subpassDeferred.addMaterial(material, customPipelineCreateInfo);
+      }
+
+      // Forward+ versions, the same material sets then the lighting set
+      for (u32 material : { data->matIron, data->matTerrain }) {
+
+        customPipelineCreateInfo.filenames = { "mrt.vert",
+          (material == data->matTerrain && data->virtualTexturing) ? "forward_vt.frag" : "forward.frag" };
+
+        data->forwardPlus.addMaterial(material, { data->materials[material].descriptorSetLayout,
+          data->viewDescriptorSetLayout, data->modelDescriptorSetLayout }, customPipelineCreateInfo, true);
+      }
+
+      // Visibility buffer resolves
+      for (u32 material : { data->matIron, data->matTerrain }) {
 
-      customPipelineCreateInfo.pipelineLayout = data->materials[4].pipelineLayout;
-      VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[4].pipeline, customPipelineCreateInfo));
+        data->visibilityBuffer.addMaterial(material, data->materials[material].descriptorSetLayout,
+          (material == data->matTerrain && data->virtualTexturing) ? "visibility_resolve_vt.frag" : "visibility_resolve.frag");
+      }
 
       // skybox
       depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
@@ -1475,7 +3181,20 @@ namespace Reignite {
       customPipelineCreateInfo.depthStencilState = depthStencilState;
       customPipelineCreateInfo.vertexInputState = vertexInputState;
 
-      VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matSkybox].pipeline, customPipelineCreateInfo));
+      // Drawn last in the G-buffer pass, only where nothing is in front of the far plane
+      {
+        PipelineCreateInfo skyboxInfo = customPipelineCreateInfo;
+        skyboxInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+          VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+        VK_CHECK(CreateGraphicsPipeline(data->device, data->materials[data->matSkybox].pipeline, skyboxInfo));
+      }
+      data->subpassDeferred.addMaterial(data->matSkybox, customPipelineCreateInfo);
+
+      customPipelineCreateInfo.filenames = { "skybox.vert", "skybox_forward.frag" };
+      data->forwardPlus.addMaterial(data->matSkybox, { data->materials[data->matSkybox].descriptorSetLayout },
+        customPipelineCreateInfo, false);
+      data->visibilityBuffer.addSkybox(customPipelineCreateInfo);
 
       // Shadow mapping
       VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
@@ -1558,65 +3277,25 @@ namespace Reignite {
       VK_CHECK(vkCreateGraphicsPipelines(data->device, data->pipelineCache, 1, &pipelineCreateInfo, nullptr, &data->pipelines.shadowPass));
     }
 
-    // Setup DescriptorPool
-    {
-      std::vector<VkDescriptorPoolSize> poolSizes = {
-        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 12),
-        vk::initializers::DescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
-      };
-
-      VK_CHECK(CreateDescriptorPool(data->device, data->descriptorPool, poolSizes));
-    }
-
     // load resources
+    data->streamer.init(data->device, data->physicalDevice, data->params.texture_budget, data->memoryBudget);
+
     loadResources();
 
     //for (u32 i = 0; i < data->materials.size(); i++) {
-      //data->materials[i].update(data->descriptorPool, data->materials[3].descriptorSetLayout);
-
-    VkDescriptorSetAllocateInfo allocInfo = vk::initializers::DescriptorSetAllocateInfo(
-      data->descriptorPool, &data->materials[3].descriptorSetLayout, 1);
-
-    VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->materials[3].descriptorSet));
-    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-
-      // Binding 1: Color map
-      vk::initializers::WriteDescriptorSet(data->materials[3].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &data->textures[4].descriptor),
-      // Binding 2: Normal map
-      vk::initializers::WriteDescriptorSet(data->materials[3].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &data->textures[5].descriptor),
-      // Binding 3: Roughness map
-      vk::initializers::WriteDescriptorSet(data->materials[3].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &data->textures[6].descriptor),
-      // Binding 4: Metallic map
-      vk::initializers::WriteDescriptorSet(data->materials[3].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &data->textures[7].descriptor)
-    };
+      //data->materials[i].update(data->descriptors, data->materials[3].descriptorSetLayout, data->updateTemplates.material, &descriptors);
 
-    vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
-    allocInfo = vk::initializers::DescriptorSetAllocateInfo(
-      data->descriptorPool, &data->materials[4].descriptorSetLayout, 1);
-
-    VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->materials[4].descriptorSet));
-    writeDescriptorSets = {
-
-      // Binding 1: Color map
-      vk::initializers::WriteDescriptorSet(data->materials[4].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &data->textures[0].descriptor),
-        // Binding 2: Normal map
-      vk::initializers::WriteDescriptorSet(data->materials[4].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &data->textures[1].descriptor),
-      // Binding 3: Roughness map
-      vk::initializers::WriteDescriptorSet(data->materials[4].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &data->textures[2].descriptor),
-      // Binding 4: Metallic map
-      vk::initializers::WriteDescriptorSet(data->materials[4].descriptorSet,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &data->textures[3].descriptor)
-    };
+    for (u32 material : { data->matIron, data->matTerrain }) {
 
-    vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+      if (material == data->matTerrain && data->virtualTexturing) {
+        VK_CHECK(data->descriptors.allocate(data->materials[material].descriptorSetLayout,
+          &data->materials[material].descriptorSet));
+        data->virtualTexture.writeDescriptors(data->materials[material].descriptorSet);
+      }
+      else {
+        updateMaterialDescriptors(material);
+      }
+    }
 
     //}
 
@@ -1624,199 +3303,55 @@ namespace Reignite {
 
     // Setup DescriptorSet
     {
-      VkDescriptorSetAllocateInfo allocInfo = vk::initializers::DescriptorSetAllocateInfo(
-          data->descriptorPool, &data->materials[data->matDeferred].descriptorSetLayout, 1);
-
-      VkDescriptorImageInfo texDescriptorPosition =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.deferred->sampler,
-          data->defFramebuffers.deferred->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-      VkDescriptorImageInfo texDescriptorNormal =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.deferred->sampler,
-          data->defFramebuffers.deferred->attachments[1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-      VkDescriptorImageInfo texDescriptorAlbedo =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.deferred->sampler,
-          data->defFramebuffers.deferred->attachments[2].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-      VkDescriptorImageInfo texDescriptorRoughness =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.deferred->sampler,
-          data->defFramebuffers.deferred->attachments[3].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-      VkDescriptorImageInfo texDescriptorMetallic =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.deferred->sampler,
-          data->defFramebuffers.deferred->attachments[4].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      VkDescriptorSetLayout deferredLayout = data->materials[data->matDeferred].descriptorSetLayout;
 
-      VkDescriptorImageInfo texDescriptorShadowMap =
-        vk::initializers::DescriptorImageInfo(data->defFramebuffers.shadow->sampler,
-          data->defFramebuffers.shadow->attachments[0].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-
-      // deferred
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->materials[data->matDeferred].descriptorSet));
-
-      std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-        // Binding 0 : Position texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptorPosition),
-        // Binding 1 : Normals texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorNormal),
-        // Binding 2 : Albedo texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorAlbedo),
-        // Binding 3 : Roughness texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorRoughness),
-        // Binding 4 : metallic texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorMetallic),
-        // Binding 5 : Fragment shader uniform buffer
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &data->uniformBuffers.fsLights.descriptor),
-        // Binding 6 : Shadow map
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferred].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
-      };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
-      // shadow debug
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->materials[data->matShadowsDebug].descriptorSet));
-
-      writeDescriptorSets = {
-        // Binding 0 : Position texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptorPosition),
-        // Binding 1 : Normals texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorNormal),
-        // Binding 2 : Albedo texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorAlbedo),
-        // Binding 3 : Roughness texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorRoughness),
-        // Binding 4 : metallic texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorMetallic),
-        // Binding 5 : Fragment shader uniform buffer
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &data->uniformBuffers.fsLights.descriptor),
-        // Binding 6 : Shadow map
-        vk::initializers::WriteDescriptorSet(data->materials[data->matShadowsDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
-    };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
-
-      // debug
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->materials[data->matDeferredDebug].descriptorSet));
-
-      writeDescriptorSets = {
-        // Binding 0 : Position texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptorPosition),
-        // Binding 1 : Normals texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorNormal),
-        // Binding 2 : Albedo texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorAlbedo),
-        // Binding 3 : Roughness texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorRoughness),
-        // Binding 4 : metallic texture target
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &texDescriptorMetallic),
-        // Binding 5 : Fragment shader uniform buffer
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &data->uniformBuffers.fsLights.descriptor),
-        // Binding 6 : Shadow map
-        vk::initializers::WriteDescriptorSet(data->materials[data->matDeferredDebug].descriptorSet,
-          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &texDescriptorShadowMap),
-    };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+      VK_CHECK(data->descriptors.allocate(deferredLayout, &data->materials[data->matDeferred].descriptorSet));
+      VK_CHECK(data->descriptors.allocate(deferredLayout, &data->materials[data->matShadowsDebug].descriptorSet));
+      VK_CHECK(data->descriptors.allocate(deferredLayout, &data->materials[data->matDeferredDebug].descriptorSet));
+      VK_CHECK(data->descriptors.allocate(data->composite.setLayout, &data->composite.set));
 
+      updateCompositionDescriptors();
 
       // Per-Object descriptor sets
       if (data->descriptorSets.perObjectModels.size() < data->renderData.size)
         data->descriptorSets.perObjectModels.resize(data->renderData.size);
       
-      VkDescriptorSetAllocateInfo modelAllocInfo =
-        vk::initializers::DescriptorSetAllocateInfo(
-          data->descriptorPool, &data->modelDescriptorSetLayout, 1);
-
-      std::vector<VkWriteDescriptorSet> modelWriteDescSet = {};
       for (u32 i = 0; i < data->renderData.size; ++i) {
 
-        VK_CHECK(vkAllocateDescriptorSets(data->device, &modelAllocInfo, &data->descriptorSets.perObjectModels[i]));
-
-        modelWriteDescSet = {
-          vk::initializers::WriteDescriptorSet(data->descriptorSets.perObjectModels[i],
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &data->uniformBuffers.perObjectModels[i].descriptor),
-        };
-
-        vkUpdateDescriptorSets(data->device, static_cast<u32>(modelWriteDescSet.size()), modelWriteDescSet.data(), 0, NULL);
+        VK_CHECK(data->descriptors.allocate(data->modelDescriptorSetLayout, &data->descriptorSets.perObjectModels[i]));
+        vkUpdateDescriptorSetWithTemplate(data->device, data->descriptorSets.perObjectModels[i],
+          data->updateTemplates.uniformBuffer, &data->uniformBuffers.perObjectModels[i].descriptor);
       }
 
       // 3D global view data descriptor set
-      VkDescriptorSetAllocateInfo viewAllocInfo =
-        vk::initializers::DescriptorSetAllocateInfo(
-          data->descriptorPool, &data->viewDescriptorSetLayout, 1);
-
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &viewAllocInfo, &data->descriptorSets.globalViewData));
-
-      modelWriteDescSet = {
-        vk::initializers::WriteDescriptorSet(data->descriptorSets.globalViewData,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &data->uniformBuffers.vsGlobalViewData.descriptor),
-      };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(modelWriteDescSet.size()), modelWriteDescSet.data(), 0, NULL);
+      VK_CHECK(data->descriptors.allocate(data->viewDescriptorSetLayout, &data->descriptorSets.globalViewData));
+      vkUpdateDescriptorSetWithTemplate(data->device, data->descriptorSets.globalViewData,
+        data->updateTemplates.uniformBuffer, &data->uniformBuffers.vsGlobalViewData.descriptor);
 
       // 2D screen view datadescripor set
 
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &viewAllocInfo, &data->descriptorSets.screenViewData));
-
-      modelWriteDescSet = {
-        vk::initializers::WriteDescriptorSet(data->descriptorSets.screenViewData,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &data->uniformBuffers.vsFullScreen.descriptor),
-      };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(modelWriteDescSet.size()), modelWriteDescSet.data(), 0, NULL);
+      VK_CHECK(data->descriptors.allocate(data->viewDescriptorSetLayout, &data->descriptorSets.screenViewData));
+      vkUpdateDescriptorSetWithTemplate(data->device, data->descriptorSets.screenViewData,
+        data->updateTemplates.uniformBuffer, &data->uniformBuffers.vsFullScreen.descriptor);
 
       // Screen model descriptor set
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &modelAllocInfo, &data->descriptorSets.screenModel));
-
-      modelWriteDescSet = {
-        vk::initializers::WriteDescriptorSet(data->descriptorSets.screenModel,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &data->uniformBuffers.vsScreenModel.descriptor),
-      };
-
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(modelWriteDescSet.size()), modelWriteDescSet.data(), 0, NULL);
+      VK_CHECK(data->descriptors.allocate(data->modelDescriptorSetLayout, &data->descriptorSets.screenModel));
+      vkUpdateDescriptorSetWithTemplate(data->device, data->descriptorSets.screenModel,
+        data->updateTemplates.uniformBuffer, &data->uniformBuffers.vsScreenModel.descriptor);
 
       // Shadow mapping descriptor set
-      allocInfo = vk::initializers::DescriptorSetAllocateInfo(
-        data->descriptorPool, &data->shadowDescriptorSetLayout, 1);
-
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &allocInfo, &data->descriptorSets.shadow));
-      writeDescriptorSets = {
-        vk::initializers::WriteDescriptorSet(data->descriptorSets.shadow,
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &data->uniformBuffers.gsShadows.descriptor),
-      };
-      vkUpdateDescriptorSets(data->device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+      VK_CHECK(data->descriptors.allocate(data->shadowDescriptorSetLayout, &data->descriptorSets.shadow));
+      vkUpdateDescriptorSetWithTemplate(data->device, data->descriptorSets.shadow,
+        data->updateTemplates.uniformBuffer, &data->uniformBuffers.gsShadows.descriptor);
 
       // Sky box descriptor set
-      VkDescriptorSetAllocateInfo skyboxAllocInfo = vk::initializers::DescriptorSetAllocateInfo(
-        data->descriptorPool, &data->materials[data->matSkybox].descriptorSetLayout, 1);
-
       VkDescriptorImageInfo textureDescriptor = vk::initializers::DescriptorImageInfo(
         data->cubeMap.sampler, data->cubeMap.view, data->cubeMap.imageLayout);
 
-      VK_CHECK(vkAllocateDescriptorSets(data->device, &skyboxAllocInfo, &data->materials[data->matSkybox].descriptorSet));
+      VK_CHECK(data->descriptors.allocate(data->materials[data->matSkybox].descriptorSetLayout,
+        &data->materials[data->matSkybox].descriptorSet));
 
-      writeDescriptorSets = {
+      std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
         // Binding 0 : Vertex shader uniform buffer
         vk::initializers::WriteDescriptorSet(
           data->materials[data->matSkybox].descriptorSet,
@@ -1832,21 +3367,72 @@ namespace Reignite {
       vkUpdateDescriptorSets(data->device, (u32)writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
     }
 
-    buildCommandBuffers();
-    buildDeferredCommands();
+    // The scene geometry started loading with the device, the first frame draws it
+    for (const std::unique_ptr<GeometryLoad>& load : data->geometryLoads)
+      load->done.wait();
+
+    updateAssetLoads();
+    data->assetsChanged = false;
+
+    // Sets the area of every path and records the commands
+    updateRenderArea();
   }
 
   void Reignite::RenderContext::shutdown() {
 
     VK_CHECK(vkDeviceWaitIdle(data->device)); // Wait for possible running events from the loop to finish
 
+    // Loads still running create buffers on the device
+    for (const std::unique_ptr<GeometryLoad>& load : data->geometryLoads)
+      load->done.wait();
+    for (const std::unique_ptr<TextureLoad>& load : data->textureLoads)
+      load->done.wait();
+
+    for (Data::Retired& resource : data->retired)
+      resource.destroy();
+    data->retired.clear();
+
+    if (data->offScreenCmdBuffer != VK_NULL_HANDLE)
+      vkFreeCommandBuffers(data->device, data->commandPool, 1, &data->offScreenCmdBuffer);
+    destroyFrames();
+
+    if (data->virtualTexturing)
+      data->virtualTexture.destroy();
+
+    data->visibilityBuffer.destroy();
+    data->subpassDeferred.destroy();
+    data->lightVolumes.destroy();
+    data->forwardPlus.destroy();
+    data->tiledShading.destroy();
+    data->lightClusters.destroy();
+
+    vkDestroyPipeline(data->device, data->composite.pipeline, nullptr);
+    vkDestroyPipelineLayout(data->device, data->composite.pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(data->device, data->composite.setLayout, nullptr);
+    delete data->defFramebuffers.lit;
+
+    for (VkPipeline pipeline : data->prepass.depth)
+      vkDestroyPipeline(data->device, pipeline, nullptr);
+    for (VkPipeline pipeline : data->prepass.gbuffer)
+      vkDestroyPipeline(data->device, pipeline, nullptr);
+    vkDestroyFramebuffer(data->device, data->prepass.depthFramebuffer, nullptr);
+    vkDestroyRenderPass(data->device, data->prepass.depthPass, nullptr);
+    vkDestroyRenderPass(data->device, data->prepass.gbufferPass, nullptr);
+
+    vkDestroyQueryPool(data->device, data->resolution.timestamps, nullptr);
+
     vkDestroyCommandPool(data->device, data->commandPool, 0);
 
     //DestroyImage(data->device, data->colorImage);
     //DestroyImage(data->device, data->depthImage);
     //destroySwapchain(data->device, data->swapchain);
 
-    vkDestroyDescriptorPool(data->device, data->descriptorPool, nullptr);
+    vkDestroyDescriptorUpdateTemplate(data->device, data->updateTemplates.material, nullptr);
+    vkDestroyDescriptorUpdateTemplate(data->device, data->updateTemplates.composition, nullptr);
+    vkDestroyDescriptorUpdateTemplate(data->device, data->updateTemplates.uniformBuffer, nullptr);
+
+    data->descriptors.destroy();
+    vk::DestroySamplers(data->device);
 
     //vkDestroyDescriptorSetLayout(data->device, data->descriptorSetLayout, nullptr);
 
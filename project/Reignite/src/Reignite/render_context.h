@@ -1,16 +1,20 @@
 #ifndef _RI_RENDER_CONTEXT_H_
 #define _RI_RENDER_CONTEXT_H_ 1
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "core.h"
 #include "basic_types.h"
+#include "asset_registry.h"
 
 
 namespace Reignite {
 
   struct State;
+  struct GeometryResource;
 
   class DisplayList;
 
@@ -20,6 +24,24 @@ namespace Reignite {
     u32 max_materials = 128;
     u32 max_textures = 128;
     u32 max_framebuffers = 128;
+
+    // Point lights shaded per frame, the rest are dropped
+    u32 max_lights = 4096;
+
+    // Bytes for streamed texture mips, 0 derives it from the device
+    u64 texture_budget = 0;
+
+    // Host staging for the uploads of one frame (uniforms, lights, streamed
+    // mips and pages), there is one per frame in flight
+    u64 upload_buffer_size = 32ull << 20;
+
+    // G-buffer size as a fraction of the window. The GPU time of every frame
+    // moves it between the bounds to stay under the target, in milliseconds;
+    // a target of 0 keeps the starting scale.
+    float render_scale = 1.0f;
+    float min_render_scale = 0.5f;
+    float max_render_scale = 1.0f;
+    float target_frame_time = 16.6f;
   };
 
   class REIGNITE_API RenderContext {
@@ -35,15 +57,39 @@ namespace Reignite {
     RenderContext(const std::shared_ptr<State> state);
     ~RenderContext();
 
-    u32 createGeometryResource(GeometryEnum geometry, std::string path = "");
+    // Non blocking. A path maps to the same handle while it is referenced,
+    // the load runs on the workers and is installed between frames. Nothing
+    // is drawn with a geometry until it is loaded. Geometry only keeps its
+    // CPU copy of vertices and indices when asked to (e.g. to build a BVH),
+    // the first load of a path decides.
+    GeometryHandle loadGeometry(GeometryEnum geometry, std::string path = "", bool keepCpuCopy = false);
+    // Generated terrain of width x length cells, cooked ones come from the pack
+    GeometryHandle loadTerrain(u32 width, u32 length, bool keepCpuCopy = false);
+    TextureHandle loadTexture(std::string filename);
+
+    bool isLoaded(GeometryHandle handle) const;
+    bool isLoaded(TextureHandle handle) const;
+
+    // Blocks until the handle is loaded, call between frames
+    void wait(GeometryHandle handle);
+    void wait(TextureHandle handle);
+
+    // The last reference frees the resource once the frames in flight that
+    // may use it are done, the handle goes stale right away
+    void release(GeometryHandle handle);
+    void release(TextureHandle handle);
+
+    // Blocking loads. Textures load in parallel and upload with the next frame,
+    // atlased files share the handle of their atlas.
+    GeometryHandle createGeometryResource(GeometryEnum geometry, std::string path = "", bool keepCpuCopy = false);
     u32 createMaterialResource();
-    u32 createTextureResource(std::string filename);
+    TextureHandle createTextureResource(std::string filename);
+    std::vector<TextureHandle> createTextureResources(const std::vector<std::string>& filenames);
 
     void initRenderState();
     void updateRenderState();
 
     void buildDeferredCommands();
-    void buildCommandBuffers();
 
     void windowResize();
 
@@ -52,18 +98,36 @@ namespace Reignite {
 
    private:
 
-    void createCommandBuffers();
-    void destroyCommandBuffers();
-
+    void createFrames();
+    void destroyFrames();
+    void beginFrame(u32 frame);
+    void recordDrawCommands(u32 frame, u32 image);
 
     void setupDepthStencil();
     void setupFramebuffer();
+    void createGBuffer(u32 width, u32 height);
+    void resizeRenderTargets();
+    void updateRenderArea();
+    void updateRenderScale();
+    void updateLightOverflows();
 
     void updateUniformBuffersScreen();
     void updateUniformBufferDeferredMatrices();
     void updateUniformBufferDeferredLights();
-
+    void updateTextureStreaming();
+    void updateAssetLoads();
+    void retire(std::function<void()> destroy);
+    void collectRetired();
+    GeometryHandle requestGeometry(GeometryEnum geometry, const std::string& path, u32 width, u32 length,
+      bool keepCpuCopy);
+    bool readGeometry(GeometryEnum geometry, const std::string& path, u32 width, u32 length, bool keepCpuCopy,
+      GeometryResource& result);
+
+    bool createVirtualTexture();
     void loadResources();
+    void updateMaterialDescriptors(u32 material);
+    void updateCompositionDescriptors();
+    void updateVisibilityDraws();
 
     void initialize(const std::shared_ptr<State> state, const RenderContextParams& params = RenderContextParams());
     void shutdown();
@@ -0,0 +1,348 @@
+#include "subpass_deferred.h"
+
+#include <array>
+#include <cassert>
+
+#include "log.h"
+#include "tools.h"
+#include "light_clusters.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_framebuffer.h"
+
+
+void Reignite::SubpassDeferred::create(vk::VulkanState* state, VkPipelineCache cache, VkRenderPass renderPass,
+  vk::DescriptorAllocator& descriptors, const vk::Framebuffer& gbuffer) {
+
+  vulkanState = state;
+  device = state->device;
+  pipelineCache = cache;
+
+  createTargets(gbuffer);
+
+  // Lighting
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+      VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_Targets + i));
+  }
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_ShadowLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_ShadowMap));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_PointLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_Clusters));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_ClusterParams));
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &lightingSetLayout));
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&lightingSetLayout, 1);
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &lightingPipelineLayout));
+
+  PipelineCreateInfo lightingInfo;
+  lightingInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  lightingInfo.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  lightingInfo.filenames = { "deferred_pbr.vert", "deferred_subpass.frag" };
+  lightingInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  lightingInfo.pipelineLayout = lightingPipelineLayout;
+  lightingInfo.renderPass = targets->renderPass;
+  lightingInfo.subpass = 1;
+  lightingInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  lightingInfo.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  lightingInfo.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, lightingPipeline, lightingInfo));
+
+  VK_CHECK(descriptors.allocate(lightingSetLayout, &lightingSet));
+
+  // Composite
+  VkDescriptorSetLayoutBinding compositeBinding = vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(&compositeBinding, 1);
+  VK_CHECK(descriptors.createLayout(layoutInfo, &compositeSetLayout));
+
+  // Size of the drawn area for the bicubic filter
+  VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vec2f), 0);
+
+  pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&compositeSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &compositePipelineLayout));
+
+  PipelineCreateInfo compositeInfo = lightingInfo;
+  compositeInfo.filenames = { "deferred_pbr.vert", "composite.frag" };
+  compositeInfo.pipelineLayout = compositePipelineLayout;
+  compositeInfo.renderPass = renderPass;
+  compositeInfo.subpass = 0;
+  compositeInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+  VK_CHECK(CreateGraphicsPipeline(device, compositePipeline, compositeInfo));
+
+  VK_CHECK(descriptors.allocate(compositeSetLayout, &compositeSet));
+
+  writeTargetDescriptors();
+
+  RI_INFO("Single pass deferred {}x{}", targets->width, targets->height);
+}
+
+void Reignite::SubpassDeferred::destroy() {
+
+  for (VkPipeline pipeline : materials)
+    vkDestroyPipeline(device, pipeline, nullptr);
+  materials.clear();
+
+  vkDestroyPipeline(device, lightingPipeline, nullptr);
+  vkDestroyPipelineLayout(device, lightingPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, lightingSetLayout, nullptr);
+
+  vkDestroyPipeline(device, compositePipeline, nullptr);
+  vkDestroyPipelineLayout(device, compositePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, compositeSetLayout, nullptr);
+
+  // Also destroys the render pass and framebuffer made for it
+  delete targets;
+  targets = nullptr;
+
+  // The sets go back with the allocator's pools
+  lightingSet = VK_NULL_HANDLE;
+  compositeSet = VK_NULL_HANDLE;
+}
+
+void Reignite::SubpassDeferred::resize(const vk::Framebuffer& gbuffer) {
+
+  // The pipelines made with the render pass work with its replacement
+  delete targets;
+  createTargets(gbuffer);
+  writeTargetDescriptors();
+
+  RI_INFO("Single pass deferred resized to {}x{}", targets->width, targets->height);
+}
+
+void Reignite::SubpassDeferred::setRenderArea(u32 width, u32 height) {
+
+  area = { width, height };
+}
+
+void Reignite::SubpassDeferred::createTargets(const vk::Framebuffer& gbuffer) {
+
+  u32 width = gbuffer.width;
+  u32 height = gbuffer.height;
+
+  targets = new vk::Framebuffer(vulkanState);
+  targets->width = width;
+  targets->height = height;
+  area = { width, height };
+
+  vk::AttachmentCreateInfo attachmentCreateInfo = {};
+  attachmentCreateInfo.width = width;
+  attachmentCreateInfo.height = height;
+  attachmentCreateInfo.layerCount = 1;
+
+  // G-buffer: written and read inside the pass only, never stored
+  for (u32 i = 0; i < kTargetCount; ++i) {
+
+    const vk::FramebufferAttachment& source = gbuffer.attachments[i];
+    bool depth = (source.subresourceRange.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+
+    attachmentCreateInfo.format = source.format;
+    attachmentCreateInfo.usage = (depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    targets->addAttachment(attachmentCreateInfo);
+  }
+
+  // Lit color, every pixel is written by the lighting subpass
+  attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  colorIndex = targets->addAttachment(attachmentCreateInfo);
+  targets->attachments[colorIndex].description.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+  VK_CHECK(targets->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+
+  // Two subpasses over the same attachments
+  {
+    const u32 depthIndex = kTargetCount - 1;
+
+    std::vector<VkAttachmentDescription> attachments;
+    for (const vk::FramebufferAttachment& attachment : targets->attachments)
+      attachments.push_back(attachment.description);
+
+    std::vector<VkAttachmentReference> gbufferReferences;
+    for (u32 i = 0; i < depthIndex; ++i)
+      gbufferReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+    VkAttachmentReference depthReference = { depthIndex, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    // Inputs in the order of the shader bindings, depth first
+    std::vector<VkAttachmentReference> inputReferences = { { depthIndex, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL } };
+    for (u32 i = 0; i < depthIndex; ++i)
+      inputReferences.push_back({ i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    VkAttachmentReference colorReference = { colorIndex, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    std::array<VkSubpassDescription, 2> subpasses = {};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = static_cast<u32>(gbufferReferences.size());
+    subpasses[0].pColorAttachments = gbufferReferences.data();
+    subpasses[0].pDepthStencilAttachment = &depthReference;
+
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = static_cast<u32>(inputReferences.size());
+    subpasses[1].pInputAttachments = inputReferences.data();
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &colorReference;
+
+    std::array<VkSubpassDependency, 3> dependencies;
+
+    // The lit color was read by the previous composite
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // Each pixel reads only its own G-buffer texel, by region keeps it on the tile
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = 1;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // Lit color to the composite of the swapchain pass
+    dependencies[2].srcSubpass = 1;
+    dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[2].dependencyFlags = 0;
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.pAttachments = attachments.data();
+    renderPassCreateInfo.attachmentCount = static_cast<u32>(attachments.size());
+    renderPassCreateInfo.subpassCount = static_cast<u32>(subpasses.size());
+    renderPassCreateInfo.pSubpasses = subpasses.data();
+    renderPassCreateInfo.dependencyCount = static_cast<u32>(dependencies.size());
+    renderPassCreateInfo.pDependencies = dependencies.data();
+    VK_CHECK(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &targets->renderPass));
+
+    std::vector<VkImageView> views;
+    for (const vk::FramebufferAttachment& attachment : targets->attachments)
+      views.push_back(attachment.view);
+    VK_CHECK(CreateFramebuffer(device, targets->framebuffer, targets->renderPass, width, height, views));
+  }
+}
+
+void Reignite::SubpassDeferred::writeTargetDescriptors() {
+
+  // Inputs of the lighting subpass
+  {
+    std::array<VkDescriptorImageInfo, kTargetCount> inputs;
+    inputs[0] = vk::initializers::DescriptorImageInfo(VK_NULL_HANDLE,
+      targets->attachments[kTargetCount - 1].view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    for (u32 i = 1; i < kTargetCount; ++i) {
+      inputs[i] = vk::initializers::DescriptorImageInfo(VK_NULL_HANDLE,
+        targets->attachments[i - 1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+    for (u32 i = 0; i < kTargetCount; ++i) {
+      writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(lightingSet,
+        VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, kBinding_Targets + i, &inputs[i]));
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+  }
+
+  // Lit color of the composite
+  VkDescriptorImageInfo color = vk::initializers::DescriptorImageInfo(targets->sampler,
+    targets->attachments[colorIndex].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  VkWriteDescriptorSet write = vk::initializers::WriteDescriptorSet(compositeSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &color);
+  vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+void Reignite::SubpassDeferred::addMaterial(u32 material, PipelineCreateInfo info) {
+
+  if (materials.size() <= material)
+    materials.resize(material + 1, VK_NULL_HANDLE);
+
+  assert(materials[material] == VK_NULL_HANDLE);
+
+  info.renderPass = targets->renderPass;
+  info.subpass = 0;
+  info.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, materials[material], info));
+}
+
+void Reignite::SubpassDeferred::writeDescriptors(const VkDescriptorBufferInfo& shadowLights,
+  const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters) {
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_ShadowLights, &shadowLights),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kBinding_ShadowMap, &shadowMap),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_PointLights, &clusters.lightsDescriptor()),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Clusters, &clusters.clustersDescriptor()),
+    vk::initializers::WriteDescriptorSet(lightingSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_ClusterParams, &clusters.paramsDescriptor())
+  };
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+void Reignite::SubpassDeferred::beginPass(VkCommandBuffer cmd) {
+
+  std::array<VkClearValue, kTargetCount> clearValues = {};
+  for (u32 i = 0; i < kTargetCount - 1; ++i)
+    clearValues[i].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+  clearValues[kTargetCount - 1].depthStencil = { 1.0f, 0 };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = targets->renderPass;
+  renderPassBeginInfo.framebuffer = targets->framebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = static_cast<u32>(clearValues.size());
+  renderPassBeginInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void Reignite::SubpassDeferred::bindMaterial(VkCommandBuffer cmd, u32 material) {
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, materials[material]);
+}
+
+void Reignite::SubpassDeferred::recordLighting(VkCommandBuffer cmd) {
+
+  vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipelineLayout, 0, 1, &lightingSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+
+  vkCmdEndRenderPass(cmd);
+}
+
+void Reignite::SubpassDeferred::recordComposite(VkCommandBuffer cmd) {
+
+  const vec2f size((float)area.width, (float)area.height);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &compositeSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+  vkCmdPushConstants(cmd, compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(size), &size);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
@@ -0,0 +1,104 @@
+#ifndef _RI_SUBPASS_DEFERRED_
+#define _RI_SUBPASS_DEFERRED_ 1
+
+#include <vector>
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_impl.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+  class Framebuffer;
+}
+
+namespace Reignite {
+
+  class LightClusters;
+
+  // Deferred shading in a single render pass. The first subpass fills a
+  // G-buffer of transient attachments, the second reads it back through
+  // input attachments and shades with the clustered lights. Only the lit
+  // color is stored: on tiled GPUs the G-buffer never leaves the chip and,
+  // with lazily allocated memory, never gets any. The composition then
+  // copies the color to the screen.
+  class SubpassDeferred {
+   public:
+
+    static const u32 kTargetCount = 4;
+
+    // Set layout of deferred_subpass.frag: G-buffer inputs, shadow lights,
+    // shadow map, point lights, clusters, cluster parameters
+    enum Binding {
+      kBinding_Targets = 0,
+      kBinding_ShadowLights = kBinding_Targets + kTargetCount,
+      kBinding_ShadowMap,
+      kBinding_PointLights,
+      kBinding_Clusters,
+      kBinding_ClusterParams
+    };
+
+    // Attachments in the formats and size of gbuffer, its color targets then
+    // its depth, so the G-buffer shaders write them unchanged. The composite
+    // pipeline draws in renderPass.
+    void create(vk::VulkanState* vulkanState, VkPipelineCache pipelineCache, VkRenderPass renderPass,
+      vk::DescriptorAllocator& descriptors, const vk::Framebuffer& gbuffer);
+    void destroy();
+
+    // Attachments in the new size of gbuffer, the pipelines are kept
+    void resize(const vk::Framebuffer& gbuffer);
+
+    // Pixels drawn from the top left of the attachments, the whole of them
+    // after create or resize. Recorded commands have to be rebuilt.
+    void setRenderArea(u32 width, u32 height);
+
+    // G-buffer pipeline of a material for the first subpass, from the info of its own
+    void addMaterial(u32 material, PipelineCreateInfo info);
+
+    void writeDescriptors(const VkDescriptorBufferInfo& shadowLights, const VkDescriptorImageInfo& shadowMap,
+      const LightClusters& clusters);
+
+    // G-buffer subpass, the material sets are bound by the caller
+    void beginPass(VkCommandBuffer cmd);
+    void bindMaterial(VkCommandBuffer cmd, u32 material);
+
+    // Lighting subpass, ends the render pass
+    void recordLighting(VkCommandBuffer cmd);
+
+    // Full screen draw of the lit color inside the swapchain render pass
+    void recordComposite(VkCommandBuffer cmd);
+
+    bool hasMaterial(u32 material) const { return material < materials.size() && materials[material] != VK_NULL_HANDLE; }
+
+   private:
+
+    void createTargets(const vk::Framebuffer& gbuffer);
+    void writeTargetDescriptors();
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    // Normal, albedo, material, depth, then the lit color
+    vk::Framebuffer* targets = nullptr;
+    VkExtent2D area = {};
+    u32 colorIndex = 0;
+
+    std::vector<VkPipeline> materials;
+
+    VkDescriptorSetLayout lightingSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout lightingPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline lightingPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet lightingSet = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout compositePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline compositePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_SUBPASS_DEFERRED_
@@ -0,0 +1,645 @@
+#include "texture_codec.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <emmintrin.h>
+
+#include "thread_pool.h"
+
+
+// Shared block helpers ---------------------------------------------------------
+//
+// A block is kept as 4 channels x 16 texels of floats so the index search can
+// test 4 texels against one palette entry per SSE instruction.
+
+struct Block {
+  alignas(16) float c[4][16];
+};
+
+static void fetchBlock(const u8* rgba, u32 width, u32 height, u32 bx, u32 by, Block& block) {
+
+  for (u32 y = 0; y < 4; ++y) {
+
+    const u32 sy = (std::min)(by * 4 + y, height - 1);
+
+    for (u32 x = 0; x < 4; ++x) {
+
+      const u32 sx = (std::min)(bx * 4 + x, width - 1);
+      const u8* texel = rgba + ((u64)sy * width + sx) * 4;
+
+      for (u32 c = 0; c < 4; ++c)
+        block.c[c][y * 4 + x] = texel[c];
+    }
+  }
+}
+
+static float horizontalSum(__m128 v) {
+
+  v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtss_f32(v);
+}
+
+// Picks the nearest palette entry for every texel, returns the weighted error
+static float selectIndices(const Block& block, const float (*palette)[4], u32 paletteCount,
+  const float weights[4], u8 indices[16]) {
+
+  __m128 total = _mm_setzero_ps();
+
+  for (u32 group = 0; group < 16; group += 4) {
+
+    __m128 texel[4];
+    for (u32 c = 0; c < 4; ++c)
+      texel[c] = _mm_load_ps(block.c[c] + group);
+
+    __m128 best = _mm_set1_ps(FLT_MAX);
+    __m128 bestIndex = _mm_setzero_ps();
+
+    for (u32 k = 0; k < paletteCount; ++k) {
+
+      __m128 error = _mm_setzero_ps();
+      for (u32 c = 0; c < 4; ++c) {
+        const __m128 d = _mm_sub_ps(texel[c], _mm_set1_ps(palette[k][c]));
+        error = _mm_add_ps(error, _mm_mul_ps(_mm_mul_ps(d, d), _mm_set1_ps(weights[c])));
+      }
+
+      const __m128 closer = _mm_cmplt_ps(error, best);
+      best = _mm_min_ps(error, best);
+      bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)k)), _mm_andnot_ps(closer, bestIndex));
+    }
+
+    total = _mm_add_ps(total, best);
+
+    alignas(16) s32 index[4];
+    _mm_store_si128((__m128i*)index, _mm_cvttps_epi32(bestIndex));
+    for (u32 i = 0; i < 4; ++i)
+      indices[group + i] = (u8)index[i];
+  }
+
+  return horizontalSum(total);
+}
+
+// Principal axis of the block through power iteration, returns the extremes
+// of the texel projections on it
+static void principalEndpoints(const Block& block, u32 channels, float e0[4], float e1[4]) {
+
+  float mean[4] = {};
+  for (u32 c = 0; c < channels; ++c) {
+    for (u32 i = 0; i < 16; ++i)
+      mean[c] += block.c[c][i];
+    mean[c] /= 16.0f;
+  }
+
+  float covariance[4][4] = {};
+  for (u32 i = 0; i < 16; ++i) {
+    for (u32 a = 0; a < channels; ++a) {
+      for (u32 b = a; b < channels; ++b)
+        covariance[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+    }
+  }
+  for (u32 a = 0; a < channels; ++a) {
+    for (u32 b = 0; b < a; ++b)
+      covariance[a][b] = covariance[b][a];
+  }
+
+  // Start from the covariance row of the widest channel, never orthogonal to
+  // the principal axis unless the block is flat
+  u32 widest = 0;
+  for (u32 a = 1; a < channels; ++a) {
+    if (covariance[a][a] > covariance[widest][widest])
+      widest = a;
+  }
+
+  float axis[4] = {};
+  for (u32 a = 0; a < channels; ++a)
+    axis[a] = covariance[widest][a];
+  for (u32 iteration = 0; iteration < 8; ++iteration) {
+
+    float next[4] = {};
+    float length = 0.0f;
+    for (u32 a = 0; a < channels; ++a) {
+      for (u32 b = 0; b < channels; ++b)
+        next[a] += covariance[a][b] * axis[b];
+      length = (std::max)(length, fabsf(next[a]));
+    }
+
+    if (length < 1e-6f)
+      break;
+
+    for (u32 a = 0; a < channels; ++a)
+      axis[a] = next[a] / length;
+  }
+
+  float minProjection = FLT_MAX;
+  float maxProjection = -FLT_MAX;
+  for (u32 i = 0; i < 16; ++i) {
+
+    float projection = 0.0f;
+    for (u32 c = 0; c < channels; ++c)
+      projection += (block.c[c][i] - mean[c]) * axis[c];
+
+    minProjection = (std::min)(minProjection, projection);
+    maxProjection = (std::max)(maxProjection, projection);
+  }
+
+  float axisLength = 0.0f;
+  for (u32 c = 0; c < channels; ++c)
+    axisLength += axis[c] * axis[c];
+  if (axisLength < 1e-6f)
+    axisLength = 1.0f;
+
+  for (u32 c = 0; c < 4; ++c) {
+    e0[c] = c < channels ? (std::min)((std::max)(mean[c] + axis[c] * minProjection / axisLength, 0.0f), 255.0f) : 255.0f;
+    e1[c] = c < channels ? (std::min)((std::max)(mean[c] + axis[c] * maxProjection / axisLength, 0.0f), 255.0f) : 255.0f;
+  }
+}
+
+// Least squares endpoints for fixed indices, t[i] is the weight of e1 for
+// texel i. Returns false when every texel sits on the same weight.
+static bool refineEndpoints(const Block& block, u32 channels, const float t[16], float e0[4], float e1[4]) {
+
+  float a = 0.0f, b = 0.0f, c = 0.0f;
+  float x0[4] = {}, x1[4] = {};
+
+  for (u32 i = 0; i < 16; ++i) {
+
+    const float s = 1.0f - t[i];
+    a += s * s;
+    b += s * t[i];
+    c += t[i] * t[i];
+
+    for (u32 ch = 0; ch < channels; ++ch) {
+      x0[ch] += s * block.c[ch][i];
+      x1[ch] += t[i] * block.c[ch][i];
+    }
+  }
+
+  const float det = a * c - b * b;
+  if (fabsf(det) < 1e-6f)
+    return false;
+
+  for (u32 ch = 0; ch < channels; ++ch) {
+    e0[ch] = (std::min)((std::max)((c * x0[ch] - b * x1[ch]) / det, 0.0f), 255.0f);
+    e1[ch] = (std::min)((std::max)((a * x1[ch] - b * x0[ch]) / det, 0.0f), 255.0f);
+  }
+
+  return true;
+}
+
+static void writeBits(u8* block, u32& bit, u32 value, u32 count) {
+
+  for (u32 i = 0; i < count; ++i, ++bit) {
+    if (value & (1u << i))
+      block[bit >> 3] |= (u8)(1u << (bit & 7));
+  }
+}
+
+// BC1 --------------------------------------------------------------------------
+
+static u16 packRGB565(const float color[4]) {
+
+  const u32 r = (u32)(color[0] * 31.0f / 255.0f + 0.5f);
+  const u32 g = (u32)(color[1] * 63.0f / 255.0f + 0.5f);
+  const u32 b = (u32)(color[2] * 31.0f / 255.0f + 0.5f);
+  return (u16)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(u16 packed, float color[4]) {
+
+  const u32 r = (packed >> 11) & 31;
+  const u32 g = (packed >> 5) & 63;
+  const u32 b = packed & 31;
+  color[0] = (float)((r << 3) | (r >> 2));
+  color[1] = (float)((g << 2) | (g >> 4));
+  color[2] = (float)((b << 3) | (b >> 2));
+  color[3] = 0.0f;
+}
+
+// Palette order of the 4 color mode: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+static const float kBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+static float evaluateBC1(const Block& block, u16 c0, u16 c1, u8 indices[16]) {
+
+  static const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+
+  float e0[4], e1[4];
+  unpackRGB565(c0, e0);
+  unpackRGB565(c1, e1);
+
+  float palette[4][4];
+  for (u32 k = 0; k < 4; ++k) {
+    for (u32 c = 0; c < 4; ++c)
+      palette[k][c] = e0[c] + (e1[c] - e0[c]) * kBC1Weights[k];
+  }
+
+  return selectIndices(block, palette, 4, weights, indices);
+}
+
+static void encodeBC1(const Block& block, u8* out) {
+
+  float e0[4], e1[4];
+  principalEndpoints(block, 3, e0, e1);
+
+  u16 c0 = packRGB565(e1);
+  u16 c1 = packRGB565(e0);
+  u8 indices[16];
+  float error = evaluateBC1(block, c0, c1, indices);
+
+  for (u32 iteration = 0; iteration < 2 && error > 0.0f; ++iteration) {
+
+    float t[16];
+    for (u32 i = 0; i < 16; ++i)
+      t[i] = kBC1Weights[indices[i]];
+
+    float r0[4] = {}, r1[4] = {};
+    if (!refineEndpoints(block, 3, t, r0, r1))
+      break;
+
+    u8 refinedIndices[16];
+    const u16 r0Packed = packRGB565(r0);
+    const u16 r1Packed = packRGB565(r1);
+    const float refinedError = evaluateBC1(block, r0Packed, r1Packed, refinedIndices);
+    if (refinedError >= error)
+      break;
+
+    c0 = r0Packed;
+    c1 = r1Packed;
+    error = refinedError;
+    memcpy(indices, refinedIndices, sizeof(indices));
+  }
+
+  // c0 > c1 selects the 4 color mode, swapping the endpoints flips the indices
+  static const u8 kSwapped[4] = { 1, 0, 3, 2 };
+  if (c0 < c1) {
+    std::swap(c0, c1);
+    for (u32 i = 0; i < 16; ++i)
+      indices[i] = kSwapped[indices[i]];
+  }
+  else if (c0 == c1) {
+    memset(indices, 0, sizeof(indices));
+  }
+
+  u32 packedIndices = 0;
+  for (u32 i = 0; i < 16; ++i)
+    packedIndices |= (u32)indices[i] << (i * 2);
+
+  memcpy(out, &c0, 2);
+  memcpy(out + 2, &c1, 2);
+  memcpy(out + 4, &packedIndices, 4);
+}
+
+// BC4 --------------------------------------------------------------------------
+
+static void encodeBC4(const Block& block, u32 channel, u8* out) {
+
+  float low = 255.0f, high = 0.0f;
+  for (u32 i = 0; i < 16; ++i) {
+    low = (std::min)(low, block.c[channel][i]);
+    high = (std::max)(high, block.c[channel][i]);
+  }
+
+  // 8 value mode, a0 > a1. Palette index 0 is a0, 1 is a1 and 2..7 step from
+  // a0 towards a1.
+  const u8 a0 = (u8)high;
+  const u8 a1 = (u8)low;
+
+  u64 packedIndices = 0;
+
+  if (a0 > a1) {
+
+    float palette[8][4] = {};
+    palette[0][0] = a0;
+    palette[1][0] = a1;
+    for (u32 k = 2; k < 8; ++k)
+      palette[k][0] = ((8 - k) * a0 + (k - 1) * a1) / 7.0f;
+
+    Block single;
+    memcpy(single.c[0], block.c[channel], sizeof(single.c[0]));
+    memset(single.c[1], 0, sizeof(single.c) - sizeof(single.c[0]));
+
+    static const float weights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    u8 indices[16];
+    selectIndices(single, palette, 8, weights, indices);
+
+    for (u32 i = 0; i < 16; ++i)
+      packedIndices |= (u64)indices[i] << (i * 3);
+  }
+
+  out[0] = a0;
+  out[1] = a1;
+  for (u32 i = 0; i < 6; ++i)
+    out[2 + i] = (u8)(packedIndices >> (i * 8));
+}
+
+// BC7 mode 6 -------------------------------------------------------------------
+//
+// 7 bit RGBA endpoints, one p-bit per endpoint appended as the lowest bit and
+// 4 bit indices interpolating with the weights below (out of 64).
+
+static const u32 kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Endpoints {
+  u32 q[2][4];  // 7 bit values
+  u32 p[2];     // p-bits
+};
+
+static float evaluateBC7(const Block& block, const float e0[4], const float e1[4], BC7Endpoints& endpoints, u8 indices[16]) {
+
+  static const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+  float bestError = FLT_MAX;
+
+  // Try every p-bit pair, each shifts the reachable 8 bit values by one
+  for (u32 p0 = 0; p0 < 2; ++p0) {
+    for (u32 p1 = 0; p1 < 2; ++p1) {
+
+      BC7Endpoints candidate;
+      candidate.p[0] = p0;
+      candidate.p[1] = p1;
+
+      u32 full[2][4];
+      for (u32 c = 0; c < 4; ++c) {
+        candidate.q[0][c] = (u32)(std::min)((std::max)((e0[c] - p0) * 0.5f + 0.5f, 0.0f), 127.0f);
+        candidate.q[1][c] = (u32)(std::min)((std::max)((e1[c] - p1) * 0.5f + 0.5f, 0.0f), 127.0f);
+        full[0][c] = (candidate.q[0][c] << 1) | p0;
+        full[1][c] = (candidate.q[1][c] << 1) | p1;
+      }
+
+      float palette[16][4];
+      for (u32 k = 0; k < 16; ++k) {
+        for (u32 c = 0; c < 4; ++c)
+          palette[k][c] = (float)(((64 - kBC7Weights[k]) * full[0][c] + kBC7Weights[k] * full[1][c] + 32) >> 6);
+      }
+
+      u8 candidateIndices[16];
+      const float error = selectIndices(block, palette, 16, weights, candidateIndices);
+      if (error < bestError) {
+        bestError = error;
+        endpoints = candidate;
+        memcpy(indices, candidateIndices, 16);
+      }
+    }
+  }
+
+  return bestError;
+}
+
+static void encodeBC7(const Block& block, u8* out) {
+
+  float e0[4], e1[4];
+  principalEndpoints(block, 4, e0, e1);
+
+  BC7Endpoints endpoints;
+  u8 indices[16];
+  float error = evaluateBC7(block, e0, e1, endpoints, indices);
+
+  for (u32 iteration = 0; iteration < 2 && error > 0.0f; ++iteration) {
+
+    float t[16];
+    for (u32 i = 0; i < 16; ++i)
+      t[i] = kBC7Weights[indices[i]] / 64.0f;
+
+    float r0[4], r1[4];
+    if (!refineEndpoints(block, 4, t, r0, r1))
+      break;
+
+    BC7Endpoints refined;
+    u8 refinedIndices[16];
+    const float refinedError = evaluateBC7(block, r0, r1, refined, refinedIndices);
+    if (refinedError >= error)
+      break;
+
+    endpoints = refined;
+    error = refinedError;
+    memcpy(indices, refinedIndices, sizeof(indices));
+  }
+
+  // The anchor texel index is stored with 3 bits, its top bit must be zero
+  if (indices[0] & 8) {
+    for (u32 c = 0; c < 4; ++c)
+      std::swap(endpoints.q[0][c], endpoints.q[1][c]);
+    std::swap(endpoints.p[0], endpoints.p[1]);
+    for (u32 i = 0; i < 16; ++i)
+      indices[i] = 15 - indices[i];
+  }
+
+  memset(out, 0, 16);
+  u32 bit = 0;
+
+  writeBits(out, bit, 1u << 6, 7);
+  for (u32 c = 0; c < 4; ++c) {
+    writeBits(out, bit, endpoints.q[0][c], 7);
+    writeBits(out, bit, endpoints.q[1][c], 7);
+  }
+  writeBits(out, bit, endpoints.p[0], 1);
+  writeBits(out, bit, endpoints.p[1], 1);
+
+  writeBits(out, bit, indices[0], 3);
+  for (u32 i = 1; i < 16; ++i)
+    writeBits(out, bit, indices[i], 4);
+}
+
+// BC2 alpha ----------------------------------------------------------------------
+
+static void encodeBC2Alpha(const Block& block, u8* out) {
+
+  u64 alpha = 0;
+  for (u32 i = 0; i < 16; ++i)
+    alpha |= (u64)((u32)(block.c[3][i] * 15.0f / 255.0f + 0.5f)) << (i * 4);
+
+  memcpy(out, &alpha, 8);
+}
+
+// Decoders ---------------------------------------------------------------------
+
+static void decodeBC1(const u8* in, u8* texels, bool fourColor) {
+
+  u16 c0, c1;
+  u32 indices;
+  memcpy(&c0, in, 2);
+  memcpy(&c1, in + 2, 2);
+  memcpy(&indices, in + 4, 4);
+
+  float e0[4], e1[4];
+  unpackRGB565(c0, e0);
+  unpackRGB565(c1, e1);
+
+  u8 palette[4][4];
+  for (u32 c = 0; c < 3; ++c) {
+    palette[0][c] = (u8)e0[c];
+    palette[1][c] = (u8)e1[c];
+    if (fourColor || c0 > c1) {
+      palette[2][c] = (u8)((2 * (u32)e0[c] + (u32)e1[c]) / 3);
+      palette[3][c] = (u8)(((u32)e0[c] + 2 * (u32)e1[c]) / 3);
+    }
+    else {
+      palette[2][c] = (u8)(((u32)e0[c] + (u32)e1[c]) / 2);
+      palette[3][c] = 0;
+    }
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = fourColor || c0 > c1 ? 255 : 0;
+
+  for (u32 i = 0; i < 16; ++i)
+    memcpy(texels + i * 4, palette[(indices >> (i * 2)) & 3], 4);
+}
+
+static void decodeBC4(const u8* in, u8* texels, u32 channel) {
+
+  const u32 a0 = in[0];
+  const u32 a1 = in[1];
+
+  u8 palette[8];
+  palette[0] = (u8)a0;
+  palette[1] = (u8)a1;
+  if (a0 > a1) {
+    for (u32 k = 2; k < 8; ++k)
+      palette[k] = (u8)(((8 - k) * a0 + (k - 1) * a1) / 7);
+  }
+  else {
+    for (u32 k = 2; k < 6; ++k)
+      palette[k] = (u8)(((6 - k) * a0 + (k - 1) * a1) / 5);
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  u64 indices = 0;
+  for (u32 i = 0; i < 6; ++i)
+    indices |= (u64)in[2 + i] << (i * 8);
+
+  for (u32 i = 0; i < 16; ++i)
+    texels[i * 4 + channel] = palette[(indices >> (i * 3)) & 7];
+}
+
+static void decodeBC2Alpha(const u8* in, u8* texels) {
+
+  u64 alpha;
+  memcpy(&alpha, in, 8);
+
+  for (u32 i = 0; i < 16; ++i)
+    texels[i * 4 + 3] = (u8)(((alpha >> (i * 4)) & 15) * 17);
+}
+
+static u32 readBits(const u8* block, u32& bit, u32 count) {
+
+  u32 value = 0;
+  for (u32 i = 0; i < count; ++i, ++bit)
+    value |= (u32)((block[bit >> 3] >> (bit & 7)) & 1) << i;
+  return value;
+}
+
+// Mode 6 only, the one encodeBC7 writes. Blocks in other modes return false.
+static bool decodeBC7(const u8* in, u8* texels) {
+
+  if ((in[0] & 0x7F) != (1u << 6))
+    return false;
+
+  u32 bit = 7;
+  u32 full[2][4];
+  for (u32 c = 0; c < 4; ++c) {
+    full[0][c] = readBits(in, bit, 7) << 1;
+    full[1][c] = readBits(in, bit, 7) << 1;
+  }
+  const u32 p0 = readBits(in, bit, 1);
+  const u32 p1 = readBits(in, bit, 1);
+  for (u32 c = 0; c < 4; ++c) {
+    full[0][c] |= p0;
+    full[1][c] |= p1;
+  }
+
+  for (u32 i = 0; i < 16; ++i) {
+    const u32 weight = kBC7Weights[readBits(in, bit, i == 0 ? 3 : 4)];
+    for (u32 c = 0; c < 4; ++c)
+      texels[i * 4 + c] = (u8)(((64 - weight) * full[0][c] + weight * full[1][c] + 32) >> 6);
+  }
+
+  return true;
+}
+
+// Encoder entry points -------------------------------------------------------
+
+u32 Reignite::TextureCodec::BlockSize(BlockFormat format) {
+
+  return format == kBlockFormat_BC1 || format == kBlockFormat_BC4 ? 8 : 16;
+}
+
+u64 Reignite::TextureCodec::EncodedSize(BlockFormat format, u32 width, u32 height) {
+
+  return (u64)((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+}
+
+void Reignite::TextureCodec::Encode(BlockFormat format, const u8* rgba, u32 width, u32 height, u8* out,
+  ThreadPool* workers) {
+
+  const u32 blocksX = (width + 3) / 4;
+  const u32 blocksY = (height + 3) / 4;
+  const u32 blockSize = BlockSize(format);
+
+  auto encodeRow = [=](u32 by) {
+
+    Block block;
+    u8* dst = out + (u64)by * blocksX * blockSize;
+
+    for (u32 bx = 0; bx < blocksX; ++bx, dst += blockSize) {
+
+      fetchBlock(rgba, width, height, bx, by, block);
+
+      switch (format) {
+        case kBlockFormat_BC1: encodeBC1(block, dst); break;
+        case kBlockFormat_BC2: encodeBC2Alpha(block, dst); encodeBC1(block, dst + 8); break;
+        case kBlockFormat_BC3: encodeBC4(block, 3, dst); encodeBC1(block, dst + 8); break;
+        case kBlockFormat_BC4: encodeBC4(block, 0, dst); break;
+        case kBlockFormat_BC5: encodeBC4(block, 0, dst); encodeBC4(block, 1, dst + 8); break;
+        case kBlockFormat_BC7: encodeBC7(block, dst); break;
+      }
+    }
+  };
+
+  if (workers != nullptr && blocksY > 1) {
+    workers->parallelFor(blocksY, encodeRow);
+  }
+  else {
+    for (u32 by = 0; by < blocksY; ++by)
+      encodeRow(by);
+  }
+}
+
+bool Reignite::TextureCodec::Decode(BlockFormat format, const u8* blocks, u32 width, u32 height, u8* rgba) {
+
+  const u32 blocksX = (width + 3) / 4;
+  const u32 blocksY = (height + 3) / 4;
+  const u32 blockSize = BlockSize(format);
+
+  for (u32 by = 0; by < blocksY; ++by) {
+    for (u32 bx = 0; bx < blocksX; ++bx, blocks += blockSize) {
+
+      u8 texels[64];
+      memset(texels, 0, sizeof(texels));
+
+      switch (format) {
+        case kBlockFormat_BC1: decodeBC1(blocks, texels, false); break;
+        case kBlockFormat_BC2: decodeBC1(blocks + 8, texels, true); decodeBC2Alpha(blocks, texels); break;
+        case kBlockFormat_BC3: decodeBC1(blocks + 8, texels, true); decodeBC4(blocks, texels, 3); break;
+        case kBlockFormat_BC4: decodeBC4(blocks, texels, 0); break;
+        case kBlockFormat_BC5: decodeBC4(blocks, texels, 0); decodeBC4(blocks + 8, texels, 1); break;
+        case kBlockFormat_BC7: if (!decodeBC7(blocks, texels)) return false; break;
+      }
+
+      // Single and dual channel formats read back as opaque
+      if (format == kBlockFormat_BC4 || format == kBlockFormat_BC5) {
+        for (u32 i = 0; i < 16; ++i)
+          texels[i * 4 + 3] = 255;
+      }
+
+      const u32 rows = (std::min)(4u, height - by * 4);
+      const u32 columns = (std::min)(4u, width - bx * 4);
+      for (u32 y = 0; y < rows; ++y)
+        memcpy(rgba + (((u64)by * 4 + y) * width + bx * 4) * 4, texels + y * 16, columns * 4);
+    }
+  }
+
+  return true;
+}
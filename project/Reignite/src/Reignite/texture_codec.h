@@ -0,0 +1,45 @@
+#ifndef _RI_TEXTURE_CODEC_
+#define _RI_TEXTURE_CODEC_ 1
+
+#include "basic_types.h"
+
+
+namespace Reignite {
+
+  class ThreadPool;
+
+namespace TextureCodec {
+
+  // Block compression encoders for cooked textures. Every format works on 4x4
+  // texel blocks, partial blocks at the edges replicate the last row/column.
+  // BC1: RGB, 8 bytes per block.
+  // BC2: explicit 4 bit alpha plus BC1 color, 16 bytes.
+  // BC3: BC1 color plus a BC4 alpha block, 16 bytes.
+  // BC4: single channel (red), 8 bytes.
+  // BC5: two BC4 blocks for red and green, 16 bytes. Used for normal maps.
+  // BC7: mode 6 only (single subset RGBA, 4 bit indices), 16 bytes.
+  enum BlockFormat {
+    kBlockFormat_BC1,
+    kBlockFormat_BC2,
+    kBlockFormat_BC3,
+    kBlockFormat_BC4,
+    kBlockFormat_BC5,
+    kBlockFormat_BC7
+  };
+
+  u32 BlockSize(BlockFormat format);
+  u64 EncodedSize(BlockFormat format, u32 width, u32 height);
+
+  // Encodes an RGBA8 image into out, which must hold EncodedSize bytes.
+  // Block rows are spread over the workers when a pool is given.
+  void Encode(BlockFormat format, const u8* rgba, u32 width, u32 height, u8* out,
+    ThreadPool* workers = nullptr);
+
+  // Decodes blocks back to RGBA8, for legacy compressed sources and for
+  // devices without BC support. BC7 decodes mode 6 only and returns false on
+  // blocks in any other mode.
+  bool Decode(BlockFormat format, const u8* blocks, u32 width, u32 height, u8* rgba);
+
+}} // end of Reignite::TextureCodec namespace
+
+#endif // _RI_TEXTURE_CODEC_
@@ -0,0 +1,444 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "log.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_tools.h"
+
+
+// Largest dimension of the mip tail that is always resident
+static const u32 kTailSize = 64;
+
+// Textures refined per update, spreads the uploads over frames
+static const u32 kMaxRefinesPerUpdate = 2;
+
+// Staging offsets suit every texel block size
+static const VkDeviceSize kMipAlignment = 16;
+
+// How often the driver budget is queried
+static const u64 kBudgetRefreshFrames = 60;
+
+void Reignite::TextureStreamer::init(VkDevice vkDevice, VkPhysicalDevice vkPhysDevice,
+  u64 budgetBytes, bool memoryBudgetExtension) {
+
+  device = vkDevice;
+  physicalDevice = vkPhysDevice;
+
+  memoryBudget = memoryBudgetExtension;
+  fixedBudget = budgetBytes != 0;
+  budget = budgetBytes;
+
+  refreshBudget();
+
+  RI_INFO("Texture streaming budget {} MB ({})", budget >> 20,
+    fixedBudget ? "fixed" : memoryBudget ? "VK_EXT_memory_budget" : "heap size");
+}
+
+void Reignite::TextureStreamer::add(u32 texture, const PackEntry& entry, const u8* texels, std::vector<u8>&& storage) {
+
+  assert(entry.layers <= 1 && entry.mipLevels > 0);
+
+  if (texture >= streams.size())
+    streams.resize(texture + 1);
+
+  Stream& stream = streams[texture];
+  stream = Stream();
+  stream.entry = entry;
+  stream.texels = texels;
+  stream.storage = std::move(storage);
+  stream.used = true;
+
+  stream.tailMip = entry.mipLevels - 1;
+  for (u32 mip = 0; mip < entry.mipLevels; ++mip) {
+    if ((std::max)(entry.width >> mip, entry.height >> mip) <= kTailSize) {
+      stream.tailMip = mip;
+      break;
+    }
+  }
+
+  // A texture no larger than the tail is its own full chain
+  stream.full = stream.tailMip == 0;
+  stream.loadedMip = stream.tailMip;
+  stream.residentMip = stream.tailMip;
+  stream.requestedMip = stream.tailMip;
+  stream.targetMip = stream.tailMip;
+}
+
+void Reignite::TextureStreamer::remove(u32 texture) {
+
+  if (texture >= streams.size() || !streams[texture].used)
+    return;
+
+  if (!streams[texture].pending)
+    resident -= cost(streams[texture], streams[texture].residentMip);
+  streams[texture] = Stream();
+}
+
+void Reignite::TextureStreamer::uploadTails(std::vector<vk::Texture>& textures, VkCommandBuffer cmd, vk::UploadRing& uploads) {
+
+  createTails(textures, cmd, uploads, nullptr);
+}
+
+void Reignite::TextureStreamer::createTails(std::vector<vk::Texture>& textures, VkCommandBuffer cmd,
+  vk::UploadRing& uploads, std::vector<u32>* created) {
+
+  if (textures.size() < streams.size())
+    textures.resize(streams.size(), vk::Texture());
+
+  std::vector<VkBufferImageCopy> regions;
+  for (u32 i = 0; i < (u32)streams.size(); ++i) {
+
+    Stream& stream = streams[i];
+    if (!stream.used || !stream.pending)
+      continue;
+
+    const PackEntry& entry = stream.entry;
+    regions.clear();
+    if (stage(stream, stream.tailMip, stream.tailMip, entry.mipLevels, uploads, regions) != stream.tailMip)
+      continue;
+
+    vk::Texture2D tail;
+    tail.create((VkFormat)entry.format, (std::max)(entry.width >> stream.tailMip, 1u),
+      (std::max)(entry.height >> stream.tailMip, 1u), entry.mipLevels - stream.tailMip, device, physicalDevice);
+    record(cmd, uploads.buffer(), tail, regions);
+
+    textures[i] = tail;
+    stream.pending = false;
+    resident += cost(stream, stream.tailMip);
+
+    if (created != nullptr)
+      created->push_back(i);
+  }
+}
+
+void Reignite::TextureStreamer::request(u32 texture, float screenSize) {
+
+  if (texture >= streams.size() || !streams[texture].used)
+    return;
+
+  Stream& stream = streams[texture];
+
+  // One texel per pixel when the texture spans the object once
+  const float ratio = (float)(std::max)(stream.entry.width, stream.entry.height) / (std::max)(screenSize, 1.0f);
+  u32 mip = ratio > 1.0f ? (u32)std::floor(std::log2(ratio)) : 0;
+  mip = (std::min)(mip, stream.tailMip);
+
+  stream.requestedMip = (std::min)(stream.requestedMip, mip);
+  stream.lastRequest = frame;
+}
+
+bool Reignite::TextureStreamer::update(std::vector<vk::Texture>& textures, VkCommandBuffer cmd, vk::UploadRing& uploads,
+  std::vector<u32>& changed, std::vector<vk::Texture>& replaced, std::vector<VkImageView>& views) {
+
+  changed.clear();
+
+  if (!fixedBudget && frame % kBudgetRefreshFrames == 0)
+    refreshBudget();
+
+  // Tails the ring had no room for when they were added
+  createTails(textures, cmd, uploads, &changed);
+
+  std::vector<u32> order;
+  u64 total = resident;
+  const bool evicting = resident > budget;
+
+  for (Stream& stream : streams)
+    stream.targetMip = stream.residentMip;
+
+  // Over budget: drop mips finer than needed, least recently requested first
+  if (evicting) {
+
+    for (u32 i = 0; i < (u32)streams.size(); ++i) {
+      if (streams[i].used && !streams[i].pending && streams[i].residentMip < streams[i].requestedMip)
+        order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [this](u32 a, u32 b) {
+      return streams[a].lastRequest < streams[b].lastRequest;
+    });
+
+    for (u32 id : order) {
+
+      if (total <= budget)
+        break;
+
+      // Moving the view within the chain frees nothing
+      Stream& stream = streams[id];
+      const u64 freed = cost(stream, stream.targetMip) - cost(stream, stream.requestedMip);
+      if (freed == 0)
+        continue;
+
+      total -= freed;
+      stream.targetMip = stream.requestedMip;
+    }
+  }
+
+  // Still over: send the largest chains back to their tails
+  while (total > budget) {
+
+    Stream* largest = nullptr;
+    for (Stream& stream : streams) {
+      if (stream.used && !stream.pending && stream.targetMip < stream.tailMip &&
+          (largest == nullptr || cost(stream, stream.targetMip) > cost(*largest, largest->targetMip)))
+        largest = &stream;
+    }
+
+    if (largest == nullptr)
+      break;
+
+    total -= cost(*largest, largest->targetMip) - cost(*largest, largest->tailMip);
+    largest->targetMip = largest->tailMip;
+  }
+
+  // Refine the biggest shortfalls first, as far as the budget allows. Skipped
+  // while evicting so freed memory is not immediately refilled.
+  order.clear();
+  for (u32 i = 0; i < (u32)streams.size() && !evicting; ++i) {
+    if (streams[i].used && !streams[i].pending && streams[i].requestedMip < streams[i].targetMip)
+      order.push_back(i);
+  }
+
+  std::sort(order.begin(), order.end(), [this](u32 a, u32 b) {
+    return streams[a].targetMip - streams[a].requestedMip > streams[b].targetMip - streams[b].requestedMip;
+  });
+
+  u32 refined = 0;
+  for (u32 id : order) {
+
+    if (refined == kMaxRefinesPerUpdate)
+      break;
+
+    Stream& stream = streams[id];
+    for (u32 mip = stream.requestedMip; mip < stream.targetMip; ++mip) {
+
+      const u64 grown = total - cost(stream, stream.targetMip) + cost(stream, mip);
+      if (grown <= budget) {
+        total = grown;
+        stream.targetMip = mip;
+        ++refined;
+        break;
+      }
+    }
+  }
+
+  // What the ring could not take this frame stays at its current mip
+  resident = 0;
+  for (u32 i = 0; i < (u32)streams.size(); ++i) {
+
+    Stream& stream = streams[i];
+    if (!stream.used || stream.pending)
+      continue;
+
+    if (stream.targetMip != stream.residentMip && apply(stream, textures[i], cmd, uploads, replaced, views))
+      changed.push_back(i);
+
+    stream.requestedMip = stream.tailMip;
+    resident += cost(stream, stream.full ? 0 : stream.tailMip);
+  }
+
+  ++frame;
+
+  return !changed.empty();
+}
+
+u64 Reignite::TextureStreamer::bytes(const Stream& stream, u32 mip) const {
+
+  u64 size = 0;
+  for (u32 i = mip; i < stream.entry.mipLevels; ++i)
+    size += stream.entry.mipSize[i];
+
+  return size;
+}
+
+u64 Reignite::TextureStreamer::cost(const Stream& stream, u32 mip) const {
+
+  // Anything finer than the tail keeps the whole chain allocated
+  return bytes(stream, mip < stream.tailMip ? 0 : stream.tailMip);
+}
+
+bool Reignite::TextureStreamer::apply(Stream& stream, vk::Texture& texture, VkCommandBuffer cmd,
+  vk::UploadRing& uploads, std::vector<vk::Texture>& replaced, std::vector<VkImageView>& views) {
+
+  const PackEntry& entry = stream.entry;
+  std::vector<VkBufferImageCopy> regions;
+
+  // Back to the tail, a tail sized image frees the chain
+  if (stream.targetMip >= stream.tailMip && stream.full && stream.tailMip > 0) {
+
+    if (stage(stream, stream.tailMip, stream.tailMip, entry.mipLevels, uploads, regions) != stream.tailMip)
+      return false;
+
+    vk::Texture2D tail;
+    tail.create((VkFormat)entry.format, (std::max)(entry.width >> stream.tailMip, 1u),
+      (std::max)(entry.height >> stream.tailMip, 1u), entry.mipLevels - stream.tailMip, device, physicalDevice);
+    record(cmd, uploads.buffer(), tail, regions);
+
+    replaced.push_back(texture);
+    texture = tail;
+
+    stream.full = false;
+    stream.loadedMip = stream.tailMip;
+    stream.residentMip = stream.tailMip;
+    return true;
+  }
+
+  // First refine past the tail, the chain is allocated once
+  if (!stream.full) {
+
+    const u32 staged = stage(stream, 0, stream.targetMip, entry.mipLevels, uploads, regions);
+    if (staged >= stream.tailMip)
+      return false;
+
+    vk::Texture2D chain;
+    chain.create((VkFormat)entry.format, entry.width, entry.height, entry.mipLevels, device, physicalDevice);
+    record(cmd, uploads.buffer(), chain, regions);
+
+    // Never bound, the clamped view takes its place
+    vkDestroyImageView(device, chain.view, nullptr);
+    chain.view = createView(stream, chain.image, staged);
+    chain.updateDescriptor();
+
+    replaced.push_back(texture);
+    texture = chain;
+
+    stream.full = true;
+    stream.loadedMip = staged;
+    stream.residentMip = staged;
+    return true;
+  }
+
+  // Within the chain only the missing levels are copied, evicted ones keep
+  // their texels and only leave the view
+  u32 base = (std::min)(stream.targetMip, stream.tailMip);
+  if (base < stream.loadedMip) {
+    base = stage(stream, 0, base, stream.loadedMip, uploads, regions);
+    if (!regions.empty())
+      record(cmd, uploads.buffer(), texture, regions);
+    stream.loadedMip = base;
+  }
+
+  if (base == stream.residentMip)
+    return false;
+
+  views.push_back(texture.view);
+  texture.view = createView(stream, texture.image, base);
+  texture.updateDescriptor();
+
+  stream.residentMip = base;
+  return true;
+}
+
+u32 Reignite::TextureStreamer::stage(Stream& stream, u32 base, u32 first, u32 end, vk::UploadRing& uploads,
+  std::vector<VkBufferImageCopy>& regions) {
+
+  const PackEntry& entry = stream.entry;
+
+  // Coarse to fine, whatever fits is usable on its own
+  u32 staged = end;
+  for (u32 mip = end; mip-- > first;) {
+
+    if (entry.mipSize[mip] > uploads.frameBytes() && !stream.oversized) {
+      RI_WARN("Texture mip {} ({} MB) is larger than the upload buffer, raise upload_buffer_size", mip, entry.mipSize[mip] >> 20);
+      stream.oversized = true;
+    }
+
+    VkDeviceSize offset;
+    u8* mapped = uploads.allocate(entry.mipSize[mip], kMipAlignment, offset);
+    if (mapped == nullptr)
+      break;
+
+    memcpy(mapped, stream.texels + entry.mipOffset[mip], (size_t)entry.mipSize[mip]);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = offset;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - base, 0, 1 };
+    region.imageExtent = { (std::max)(entry.width >> mip, 1u), (std::max)(entry.height >> mip, 1u), 1 };
+    regions.push_back(region);
+
+    staged = mip;
+  }
+
+  return staged;
+}
+
+void Reignite::TextureStreamer::record(VkCommandBuffer cmd, VkBuffer staging, vk::Texture& texture,
+  const std::vector<VkBufferImageCopy>& regions) {
+
+  // Regions run coarse to fine over adjacent levels, none of them in a view yet
+  VkImageSubresourceRange subresourceRange = {};
+  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresourceRange.baseMipLevel = regions.back().imageSubresource.mipLevel;
+  subresourceRange.levelCount = (u32)regions.size();
+  subresourceRange.layerCount = 1;
+
+  vk::tools::SetImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  vkCmdCopyBufferToImage(cmd, staging, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    (u32)regions.size(), regions.data());
+
+  vk::tools::SetImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+  texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  texture.updateDescriptor();
+}
+
+VkImageView Reignite::TextureStreamer::createView(const Stream& stream, VkImage image, u32 baseMip) const {
+
+  // The base level clamps sampling to the resident mips
+  VkImageViewCreateInfo viewCreateInfo = vk::initializers::ImageViewCreateInfo();
+  viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewCreateInfo.format = (VkFormat)stream.entry.format;
+  viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+  viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMip, stream.entry.mipLevels - baseMip, 0, 1 };
+  viewCreateInfo.image = image;
+
+  VkImageView view;
+  VK_CHECK(vkCreateImageView(device, &viewCreateInfo, nullptr, &view));
+
+  return view;
+}
+
+void Reignite::TextureStreamer::refreshBudget() {
+
+  if (fixedBudget)
+    return;
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  properties.pNext = memoryBudget ? &budgetProperties : nullptr;
+
+  vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+  u64 available = 0;
+  for (u32 i = 0; i < properties.memoryProperties.memoryHeapCount; ++i) {
+
+    const VkMemoryHeap& heap = properties.memoryProperties.memoryHeaps[i];
+    if (!(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+      continue;
+
+    if (memoryBudget) {
+      const u64 limit = budgetProperties.heapBudget[i];
+      const u64 usage = budgetProperties.heapUsage[i];
+      available += limit > usage ? limit - usage : 0;
+    }
+    else {
+      available += heap.size;
+    }
+  }
+
+  // Half of what the driver grants this process, our own textures included.
+  // Without the extension a quarter of the heaps leaves room for targets,
+  // buffers and other applications.
+  budget = memoryBudget ? (resident + available) / 2 : available / 4;
+}
@@ -0,0 +1,99 @@
+#ifndef _RI_TEXTURE_STREAMER_
+#define _RI_TEXTURE_STREAMER_ 1
+
+#include <vector>
+
+#include "basic_types.h"
+#include "asset_pack.h"
+
+#include "Vulkan/vulkan_texture.h"
+#include "Vulkan/vulkan_upload_ring.h"
+
+
+namespace Reignite {
+
+  // Mip streaming for material textures. The whole chain stays in system
+  // memory, the GPU only holds the mips asked for by what is on screen.
+  // Textures start with their mip tail, finer mips are uploaded as objects
+  // get closer and dropped again, least recently needed first, whenever the
+  // resident set goes over the budget.
+  //
+  // The first refine past the tail allocates the full chain once, later
+  // ones only copy the missing levels and move the base level of the view.
+  // Copies are recorded into the frame's upload command buffer from the
+  // upload ring, coarse to fine, as many as fit; nothing waits on the queue.
+  class TextureStreamer {
+   public:
+
+    // A budget of 0 derives one from the device local heaps, using
+    // VK_EXT_memory_budget when it was enabled on the device
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, u64 budget, bool memoryBudgetExtension);
+
+    // Texels may point into storage or into the mapped asset pack
+    void add(u32 texture, const PackEntry& entry, const u8* texels, std::vector<u8>&& storage);
+
+    // Forgets a texture, its image is destroyed by the caller
+    void remove(u32 texture);
+
+    // Creates the mip tail of every added texture, the copies are recorded
+    // into cmd. Tails that do not fit in the ring follow with update().
+    void uploadTails(std::vector<vk::Texture>& textures, VkCommandBuffer cmd, vk::UploadRing& uploads);
+
+    // Asks for the mip matching an on-screen size in pixels, the finest
+    // request of the frame wins
+    void request(u32 texture, float screenSize);
+
+    // Moves residency towards this frame's requests and clears them.
+    // Textures with a new view are listed in changed, the images and views
+    // they replace go to replaced and views for the caller to retire once no
+    // frame in flight uses them.
+    bool update(std::vector<vk::Texture>& textures, VkCommandBuffer cmd, vk::UploadRing& uploads,
+      std::vector<u32>& changed, std::vector<vk::Texture>& replaced, std::vector<VkImageView>& views);
+
+    u64 residentBytes() const { return resident; }
+    u64 budgetBytes() const { return budget; }
+
+   private:
+
+    struct Stream {
+      PackEntry entry;
+      const u8* texels = nullptr;
+      std::vector<u8> storage;
+
+      bool used = false;
+      bool pending = true;   // tail not created yet
+      bool full = false;     // the image holds the whole chain, not just the tail
+      bool oversized = false;
+      u32 tailMip = 0;
+      u32 loadedMip = 0;     // finest level with texels, the view may start lower
+      u32 residentMip = 0;
+      u32 requestedMip = 0;
+      u32 targetMip = 0;
+      u64 lastRequest = 0;
+    };
+
+    u64 bytes(const Stream& stream, u32 mip) const;
+    u64 cost(const Stream& stream, u32 mip) const;
+    void createTails(std::vector<vk::Texture>& textures, VkCommandBuffer cmd, vk::UploadRing& uploads, std::vector<u32>* created);
+    bool apply(Stream& stream, vk::Texture& texture, VkCommandBuffer cmd, vk::UploadRing& uploads,
+      std::vector<vk::Texture>& replaced, std::vector<VkImageView>& views);
+    u32 stage(Stream& stream, u32 base, u32 first, u32 end, vk::UploadRing& uploads, std::vector<VkBufferImageCopy>& regions);
+    void record(VkCommandBuffer cmd, VkBuffer staging, vk::Texture& texture, const std::vector<VkBufferImageCopy>& regions);
+    VkImageView createView(const Stream& stream, VkImage image, u32 baseMip) const;
+    void refreshBudget();
+
+    std::vector<Stream> streams;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+    bool memoryBudget = false;
+    bool fixedBudget = false;
+    u64 budget = 0;
+    u64 resident = 0;
+    u64 frame = 0;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_TEXTURE_STREAMER_
@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct Reignite::ThreadPool::Data {
+
+  std::vector<std::thread> workers;
+  std::deque<std::packaged_task<void()>> tasks;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stop = false;
+};
+
+Reignite::ThreadPool::ThreadPool(u32 threadCount) {
+
+  data = new Data();
+
+  if (threadCount == 0) {
+    const u32 hardware = std::thread::hardware_concurrency();
+    threadCount = hardware > 1 ? hardware - 1 : 1;
+  }
+
+  data->workers.reserve(threadCount);
+  for (u32 i = 0; i < threadCount; ++i) {
+    data->workers.emplace_back([pool = data]() {
+
+      for (;;) {
+
+        std::packaged_task<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(pool->mutex);
+          pool->wake.wait(lock, [pool]() { return pool->stop || !pool->tasks.empty(); });
+
+          if (pool->stop && pool->tasks.empty())
+            return;
+
+          task = std::move(pool->tasks.front());
+          pool->tasks.pop_front();
+        }
+
+        task();
+      }
+    });
+  }
+}
+
+Reignite::ThreadPool::~ThreadPool() {
+
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->stop = true;
+  }
+  data->wake.notify_all();
+
+  for (auto& worker : data->workers)
+    worker.join();
+
+  delete data;
+}
+
+std::future<void> Reignite::ThreadPool::submit(std::function<void()> task) {
+
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> future = packaged.get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(data->mutex);
+    data->tasks.push_back(std::move(packaged));
+  }
+  data->wake.notify_one();
+
+  return future;
+}
+
+void Reignite::ThreadPool::parallelFor(u32 count, const std::function<void(u32)>& task) {
+
+  if (count == 0)
+    return;
+
+  // Indices are claimed dynamically so uneven tasks balance out. The caller
+  // only waits for the indices, not for the helpers, so a parallelFor issued
+  // from inside a worker can not deadlock on helpers stuck in the queue.
+  struct Loop {
+    std::atomic<u32> next;
+    std::atomic<u32> remaining;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+
+  std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+  loop->next = 0;
+  loop->remaining = count;
+
+  const std::function<void(u32)>* body = &task;
+  auto work = [loop, body, count]() {
+    for (u32 i = loop->next++; i < count; i = loop->next++) {
+      (*body)(i);
+      if (--loop->remaining == 0) {
+        std::lock_guard<std::mutex> lock(loop->mutex);
+        loop->finished.notify_all();
+      }
+    }
+  };
+
+  const u32 helpers = (std::min)(count - 1, threadCount());
+  for (u32 i = 0; i < helpers; ++i)
+    submit(work);
+
+  work();
+
+  std::unique_lock<std::mutex> lock(loop->mutex);
+  loop->finished.wait(lock, [&loop]() { return loop->remaining == 0; });
+}
+
+u32 Reignite::ThreadPool::threadCount() const {
+
+  return (u32)data->workers.size();
+}
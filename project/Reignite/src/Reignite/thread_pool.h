@@ -0,0 +1,38 @@
+#ifndef _RI_THREAD_POOL_
+#define _RI_THREAD_POOL_ 1
+
+#include <functional>
+#include <future>
+
+#include "basic_types.h"
+
+
+namespace Reignite {
+
+  // Fixed set of worker threads pulling tasks from a shared queue
+  class ThreadPool {
+   public:
+
+    // 0 uses one worker per hardware thread minus the caller
+    ThreadPool(u32 threadCount = 0);
+    ~ThreadPool();
+
+    std::future<void> submit(std::function<void()> task);
+
+    // Runs task(0..count-1) and blocks, the caller works too
+    void parallelFor(u32 count, const std::function<void(u32)>& task);
+
+    u32 threadCount() const;
+
+   private:
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    struct Data;
+    Data* data;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_THREAD_POOL_
@@ -0,0 +1,222 @@
+#include "tiled_shading.h"
+
+#include <vector>
+
+#include "log.h"
+#include "tools.h"
+#include "light_clusters.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_impl.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+
+
+void Reignite::TiledShading::create(vk::VulkanState* state, VkQueue graphicsQueue, VkPipelineCache pipelineCache,
+  VkRenderPass renderPass, vk::DescriptorAllocator& descriptors, u32 width, u32 height) {
+
+  vulkanState = state;
+  device = state->device;
+  queue = graphicsQueue;
+
+  createOutput(width, height);
+
+  // Shading
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Targets + i));
+  }
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_ShadowLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_ShadowMap));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_PointLights));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Camera));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Output));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, kBinding_Peaks));
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &shadingSetLayout));
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&shadingSetLayout, 1);
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &shadingPipelineLayout));
+
+  VkPipelineShaderStageCreateInfo stage = loadShader(device,
+    Tools::GetAssetPath() + "shaders/tiled_deferred.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+
+  VkComputePipelineCreateInfo pipelineInfo = vk::initializers::ComputePipelineCreateInfo(shadingPipelineLayout, stage);
+  VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &shadingPipeline));
+
+  vkDestroyShaderModule(device, stage.module, nullptr);
+
+  VK_CHECK(descriptors.allocate(shadingSetLayout, &shadingSet));
+
+  // Composite
+  VkDescriptorSetLayoutBinding compositeBinding = vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(&compositeBinding, 1);
+  VK_CHECK(descriptors.createLayout(layoutInfo, &compositeSetLayout));
+
+  // Size of the rendered area for the bicubic filter
+  VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vec2f), 0);
+
+  pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&compositeSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &compositePipelineLayout));
+
+  PipelineCreateInfo compositeInfo;
+  compositeInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  compositeInfo.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  compositeInfo.filenames = { "deferred_pbr.vert", "composite.frag" };
+  compositeInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  compositeInfo.pipelineLayout = compositePipelineLayout;
+  compositeInfo.renderPass = renderPass;
+  compositeInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  compositeInfo.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  compositeInfo.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, compositePipeline, compositeInfo));
+
+  VK_CHECK(descriptors.allocate(compositeSetLayout, &compositeSet));
+
+  VkWriteDescriptorSet write = vk::initializers::WriteDescriptorSet(compositeSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &output.descriptor);
+  vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+  RI_INFO("Tiled shading {}x{}, {}x{} tiles", width, height,
+    (width + kTileSize - 1) / kTileSize, (height + kTileSize - 1) / kTileSize);
+}
+
+void Reignite::TiledShading::createOutput(u32 width, u32 height) {
+
+  // Written by the compute pass and sampled by the composite, it stays in GENERAL
+  output.create(VK_FORMAT_R8G8B8A8_UNORM, width, height, 1, device, vulkanState->physicalDevice,
+    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+  VkCommandBuffer cmd = vulkanState->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+  VkImageMemoryBarrier barrier = vk::initializers::ImageMemoryBarrier();
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.image = output.image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  vulkanState->flushCommandBuffer(cmd, queue);
+
+  output.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  output.updateDescriptor();
+
+  area = { width, height };
+}
+
+void Reignite::TiledShading::destroy() {
+
+  vkDestroyPipeline(device, shadingPipeline, nullptr);
+  vkDestroyPipelineLayout(device, shadingPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, shadingSetLayout, nullptr);
+
+  vkDestroyPipeline(device, compositePipeline, nullptr);
+  vkDestroyPipelineLayout(device, compositePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, compositeSetLayout, nullptr);
+
+  output.destroy();
+
+  // The sets go back with the allocator's pools
+  shadingSet = VK_NULL_HANDLE;
+  compositeSet = VK_NULL_HANDLE;
+}
+
+void Reignite::TiledShading::resize(u32 width, u32 height) {
+
+  output.destroy();
+  createOutput(width, height);
+
+  VkWriteDescriptorSet write = vk::initializers::WriteDescriptorSet(compositeSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &output.descriptor);
+  vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+  RI_INFO("Tiled shading resized to {}x{}", width, height);
+}
+
+void Reignite::TiledShading::setRenderArea(u32 width, u32 height) {
+
+  area = { width, height };
+}
+
+void Reignite::TiledShading::writeDescriptors(const VkDescriptorImageInfo* targets, const VkDescriptorBufferInfo& shadowLights,
+  const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters) {
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+  for (u32 i = 0; i < kTargetCount; ++i) {
+    writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kBinding_Targets + i, &targets[i]));
+  }
+
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_ShadowLights, &shadowLights));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kBinding_ShadowMap, &shadowMap));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_PointLights, &clusters.lightsDescriptor()));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_Camera, &clusters.paramsDescriptor()));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kBinding_Output, &output.descriptor));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(shadingSet,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Peaks, &clusters.peaksDescriptor()));
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+void Reignite::TiledShading::recordShading(VkCommandBuffer cmd) {
+
+  // G-buffer and shadow map writes of the render passes before
+  VkMemoryBarrier targetsBarrier = vk::initializers::MemoryBarrier();
+  targetsBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  targetsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  vkCmdPipelineBarrier(cmd,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &targetsBarrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, shadingPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, shadingPipelineLayout, 0, 1, &shadingSet, 0, NULL);
+  vkCmdDispatch(cmd, (area.width + kTileSize - 1) / kTileSize, (area.height + kTileSize - 1) / kTileSize, 1);
+
+  VkImageMemoryBarrier outputBarrier = vk::initializers::ImageMemoryBarrier();
+  outputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  outputBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  outputBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  outputBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  outputBarrier.image = output.image;
+  outputBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &outputBarrier);
+}
+
+void Reignite::TiledShading::recordComposite(VkCommandBuffer cmd) {
+
+  const vec2f size((float)area.width, (float)area.height);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &compositeSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+  vkCmdPushConstants(cmd, compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(size), &size);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
@@ -0,0 +1,87 @@
+#ifndef _RI_TILED_SHADING_
+#define _RI_TILED_SHADING_ 1
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_texture.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+}
+
+namespace Reignite {
+
+  class LightClusters;
+
+  // Tiled deferred shading in compute. Each 16x16 tile of the G-buffer finds
+  // its depth range, culls the point lights against it in shared memory and
+  // shades its pixels into a storage image; tiles with only sky skip all the
+  // lighting. The composition then only copies that image to the screen.
+  class TiledShading {
+   public:
+
+    static const u32 kTileSize = 16;
+    static const u32 kMaxLightsPerTile = 256;
+    static const u32 kTargetCount = 4;
+
+    // Set layout of tiled_deferred.comp: G-buffer, shadow lights, shadow
+    // map, point lights, camera, output, light peaks
+    enum Binding {
+      kBinding_Targets = 0,
+      kBinding_ShadowLights = kBinding_Targets + kTargetCount,
+      kBinding_ShadowMap,
+      kBinding_PointLights,
+      kBinding_Camera,
+      kBinding_Output,
+      kBinding_Peaks
+    };
+
+    // Output of the G-buffer size, the composite pipeline draws in renderPass
+    void create(vk::VulkanState* vulkanState, VkQueue queue, VkPipelineCache pipelineCache, VkRenderPass renderPass,
+      vk::DescriptorAllocator& descriptors, u32 width, u32 height);
+    void destroy();
+
+    // New output for a resized G-buffer, writeDescriptors has to follow
+    void resize(u32 width, u32 height);
+
+    // Pixels rendered from the top left of the G-buffer, the whole of it
+    // after create or resize. Recorded commands have to be rebuilt.
+    void setRenderArea(u32 width, u32 height);
+
+    // targets holds the G-buffer images: depth, normal, albedo, material
+    void writeDescriptors(const VkDescriptorImageInfo* targets, const VkDescriptorBufferInfo& shadowLights,
+      const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters);
+
+    // After the G-buffer pass, leaves the output ready for fragment shaders
+    void recordShading(VkCommandBuffer cmd);
+
+    // Full screen draw of the output inside the swapchain render pass
+    void recordComposite(VkCommandBuffer cmd);
+
+   private:
+
+    void createOutput(u32 width, u32 height);
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+
+    vk::Texture2D output;
+    VkExtent2D area = {};
+
+    VkDescriptorSetLayout shadingSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout shadingPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline shadingPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet shadingSet = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout compositePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline compositePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_TILED_SHADING_
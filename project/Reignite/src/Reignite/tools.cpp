@@ -1,14 +1,22 @@
 #include "tools.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <tiny_gltf.h>
 
+#include <cmath>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
 #include "log.h"
+#include "thread_pool.h"
 
 #include "Vulkan/vulkan_impl.h"
 
@@ -16,124 +24,270 @@
 #define EXE_PATH 0
 
 
-const std::string Reignite::Tools::GetAssetPath() {
-#if EXE_PATH
-  return "./../../../../project/data/";
-#else
-  return "./../data/";
-#endif
-}
+// Obj parsing helpers
 
-bool Reignite::Tools::LoadTextureFile(std::string filename, s32& width, s32& height, void** data) {
+static const u64 kObjMinChunkSize = 1 << 20;
 
-  s32 texChannels;
-  *data = stbi_load(filename.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
-  assert(*data);
+static const s32 kObjMissingIndex = INT32_MIN;
+static const s32 kObjInvalidIndex = INT32_MAX;
 
-  return true;
-}
+static const u8 kObjRelativePosition = 1 << 0;
+static const u8 kObjRelativeTexcoord = 1 << 1;
+static const u8 kObjRelativeNormal = 1 << 2;
 
-void Reignite::Tools::FreeTextureData(void* textureData) {
+struct ObjChunk {
+  const char* begin = nullptr;
+  const char* end = nullptr;
 
-  if (nullptr == textureData) {
-    RI_ERROR("Pointer does not hold any texture information");
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> texcoords;
+
+  // Three raw indices (v, vt, vn) per triangle corner
+  std::vector<s32> corners;
+  std::vector<u8> relative;
+};
+
+// Runs fn(0..count-1) on the pool, or in order when there is none
+template<typename F>
+static void parallelFor(Reignite::ThreadPool* workers, u32 count, F&& fn) {
+
+  if (workers != nullptr && count > 1) {
+    workers->parallelFor(count, fn);
     return;
   }
 
-  stbi_image_free(textureData);
+  for (u32 i = 0; i < count; ++i)
+    fn(i);
 }
 
-bool Reignite::Tools::LoadGltfFile(std::string filename, GeometryResource& geometry) {
+static const char* skipLine(const char* c, const char* end) {
 
-  bool store_original_json_for_extras_and_extensions = false;
+  while (c < end && *c != '\n')
+    ++c;
 
-  tinygltf::Model model;
-  tinygltf::TinyGLTF gltf_ctx;
-  std::string err;
-  std::string warn;
+  return c < end ? c + 1 : end;
+}
 
-  std::string ext = "gltf";
+static const char* skipSpaces(const char* c, const char* end) {
 
-  gltf_ctx.SetStoreOriginalJSONForExtrasAndExtensions(store_original_json_for_extras_and_extensions);
+  while (c < end && (*c == ' ' || *c == '\t'))
+    ++c;
 
-  bool ret = false;
-  if (ext.compare("glb") == 0) {
-    ret = gltf_ctx.LoadBinaryFromFile(&model, &err, &warn, filename.c_str());
+  return c;
+}
+
+static const char* parseInt(const char* c, const char* end, s32& value) {
+
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) {
+    negative = *c == '-';
+    ++c;
   }
-  else {
-    ret = gltf_ctx.LoadASCIIFromFile(&model, &err, &warn, filename.c_str());
+
+  s32 result = 0;
+  while (c < end && *c >= '0' && *c <= '9') {
+    result = result * 10 + (*c - '0');
+    ++c;
   }
 
-  if (!warn.empty()) { printf("Warn: %s\n", warn.c_str()); }
+  value = negative ? -result : result;
+  return c;
+}
 
-  if (!err.empty()) { printf("Err: %s\n", err.c_str()); }
+static const char* parseFloat(const char* c, const char* end, float& value) {
 
-  if (!ret) {
-    printf("Failed to parse glTF\n");
-    return false;
+  static const double kPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+  };
+
+  c = skipSpaces(c, end);
+
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+')) {
+    negative = *c == '-';
+    ++c;
   }
 
-  // gltf parsing
+  double result = 0.0;
+  while (c < end && *c >= '0' && *c <= '9') {
+    result = result * 10.0 + (*c - '0');
+    ++c;
+  }
 
-  return true;
-}
+  if (c < end && *c == '.') {
+    ++c;
 
-bool Reignite::Tools::LoadObjFile(std::string filename, GeometryResource& geometry) {
+    double fraction = 0.0;
+    s32 digits = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+      if (digits < 20) {
+        fraction = fraction * 10.0 + (*c - '0');
+        ++digits;
+      }
+      ++c;
+    }
 
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string warn;
-  std::string err;
+    result += fraction / kPowers[digits];
+  }
 
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str());
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    s32 exponent = 0;
+    c = parseInt(c + 1, end, exponent);
 
-  if (!warn.empty())
-    RI_WARN("WARNING: {0}\n", warn.c_str());
+    if (exponent < 0)
+      result /= exponent >= -20 ? kPowers[-exponent] : std::pow(10.0, -exponent);
+    else
+      result *= exponent <= 20 ? kPowers[exponent] : std::pow(10.0, exponent);
+  }
 
-  if (!err.empty()) {
-    RI_ERROR("ERROR: {0}\n", err.c_str());
-    return false;
+  value = (float)(negative ? -result : result);
+  return c;
+}
+
+// Stores an obj index either absolute (1-based in file) or relative to the chunk
+static const char* parseFaceIndex(const char* c, const char* end, s32 localCount, s32& index, bool& relative) {
+
+  relative = false;
+  if (c >= end || !(*c == '-' || (*c >= '0' && *c <= '9'))) {
+    index = kObjMissingIndex;
+    return c;
   }
 
-  bool containsUV = false;
+  s32 value = 0;
+  c = parseInt(c, end, value);
 
-  // obj parsing TODO: Implement vertex deduplication
-  for(const auto& shape : shapes) {
-    for (const auto& index : shape.mesh.indices) {
+  if (value > 0) {
+    index = value - 1;
+  }
+  else if (value < 0) {
+    index = localCount + value;
+    relative = true;
+  }
+  else {
+    index = kObjInvalidIndex;
+  }
 
-      Vertex vertex = {};
-      vec3f current_vertex = vec3f(attrib.vertices[3 * index.vertex_index + 0],
-        attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2]);
-      vec3f normalized_vertex = glm::normalize(current_vertex);
+  return c;
+}
 
-      vertex.position[0] = normalized_vertex.x * 0.5f;
-      vertex.position[1] = normalized_vertex.y * 0.5f;
-      vertex.position[2] = normalized_vertex.z * 0.5f;
+static void parseObjChunk(ObjChunk& chunk) {
+
+  // Rough guess so most chunks never reallocate
+  const size_t estimate = (chunk.end - chunk.begin) / 32;
+  chunk.positions.reserve(estimate);
+  chunk.corners.reserve(estimate * 3);
+  chunk.relative.reserve(estimate);
+
+  std::vector<s32> face;
+  std::vector<u8> faceRelative;
+
+  const char* end = chunk.end;
+  const char* c = chunk.begin;
+
+  while (c < end) {
+
+    c = skipSpaces(c, end);
+    if (c >= end)
+      break;
 
-      vertex.normal[0] = attrib.normals[3 * index.normal_index + 0];
-      vertex.normal[1] = attrib.normals[3 * index.normal_index + 1];
-      vertex.normal[2] = attrib.normals[3 * index.normal_index + 2];
+    if (c[0] == 'v' && c + 1 < end) {
 
-      if (attrib.texcoords.size() != 0) {
-        containsUV = true;
-        vertex.texcoord[0] = attrib.texcoords[2 * index.texcoord_index + 0];
-        vertex.texcoord[1] = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+      if (c[1] == ' ' || c[1] == '\t') {
+        float x, y, z;
+        c = parseFloat(c + 1, end, x);
+        c = parseFloat(c, end, y);
+        c = parseFloat(c, end, z);
+        chunk.positions.push_back(x);
+        chunk.positions.push_back(y);
+        chunk.positions.push_back(z);
+      }
+      else if (c[1] == 'n') {
+        float x, y, z;
+        c = parseFloat(c + 2, end, x);
+        c = parseFloat(c, end, y);
+        c = parseFloat(c, end, z);
+        chunk.normals.push_back(x);
+        chunk.normals.push_back(y);
+        chunk.normals.push_back(z);
+      }
+      else if (c[1] == 't') {
+        float u, v;
+        c = parseFloat(c + 2, end, u);
+        c = parseFloat(c, end, v);
+        chunk.texcoords.push_back(u);
+        chunk.texcoords.push_back(v);
+      }
+    }
+    else if (c[0] == 'f' && c + 1 < end && (c[1] == ' ' || c[1] == '\t')) {
+
+      face.clear();
+      faceRelative.clear();
+
+      const s32 positionCount = (s32)chunk.positions.size() / 3;
+      const s32 texcoordCount = (s32)chunk.texcoords.size() / 2;
+      const s32 normalCount = (s32)chunk.normals.size() / 3;
+
+      c = skipSpaces(c + 1, end);
+      while (c < end && *c != '\n' && *c != '\r' && *c != '#') {
+
+        s32 v = kObjMissingIndex, vt = kObjMissingIndex, vn = kObjMissingIndex;
+        bool rv = false, rvt = false, rvn = false;
+
+        c = parseFaceIndex(c, end, positionCount, v, rv);
+        if (c < end && *c == '/') {
+          c = parseFaceIndex(c + 1, end, texcoordCount, vt, rvt);
+          if (c < end && *c == '/')
+            c = parseFaceIndex(c + 1, end, normalCount, vn, rvn);
+        }
+
+        // Skip anything we could not understand to avoid stalling on bad input
+        while (c < end && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r')
+          ++c;
+        c = skipSpaces(c, end);
+
+        face.push_back(v);
+        face.push_back(vt);
+        face.push_back(vn);
+        faceRelative.push_back((rv ? kObjRelativePosition : 0) |
+          (rvt ? kObjRelativeTexcoord : 0) | (rvn ? kObjRelativeNormal : 0));
       }
 
-      geometry.vertices.push_back(vertex);
-      geometry.indices.push_back((u32)geometry.indices.size());
+      // Triangle fan
+      const size_t cornerCount = faceRelative.size();
+      for (size_t k = 1; k + 1 < cornerCount; ++k) {
+
+        const size_t triangle[3] = { 0, k, k + 1 };
+        for (size_t t : triangle) {
+          chunk.corners.push_back(face[t * 3 + 0]);
+          chunk.corners.push_back(face[t * 3 + 1]);
+          chunk.corners.push_back(face[t * 3 + 2]);
+          chunk.relative.push_back(faceRelative[t]);
+        }
+      }
     }
+
+    c = skipLine(c, end);
   }
+}
 
-  geometry.vertexSize = (u32)geometry.vertices.size();
-  geometry.indicesSize = (u32)geometry.indices.size();
+static s64 resolveObjIndex(s32 index, bool relative, u32 base) {
 
-  if (!containsUV)
-    return true;
+  if (index == kObjMissingIndex)
+    return -1;
+
+  if (relative) {
+    s64 resolved = (s64)base + index;
+    return resolved >= 0 ? resolved : INT64_MAX;
+  }
+
+  return index;
+}
 
-  // calculate tangents from obj received data
-  for (u32 i = 0; i < geometry.indices.size(); i += 3) {
+static void calculateTangents(Reignite::GeometryResource& geometry, u32 first, u32 last) {
+
+  for (u32 i = first; i + 2 < last; i += 3) {
 
     u32 i0 = geometry.indices[i];
     u32 i1 = geometry.indices[i + 1];
@@ -183,6 +337,284 @@ bool Reignite::Tools::LoadObjFile(std::string filename, GeometryResource& geomet
     geometry.vertices[i2].tangent[1] = tangent.y;
     geometry.vertices[i2].tangent[2] = tangent.z;
   }
+}
+
+
+const std::string Reignite::Tools::GetAssetPath() {
+#if EXE_PATH
+  return "./../../../../project/data/";
+#else
+  return "./../data/";
+#endif
+}
+
+bool Reignite::Tools::MapFile(std::string filename, MappedFile& file) {
+
+  file = MappedFile();
+
+  HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(handle, &size)) {
+    CloseHandle(handle);
+    return false;
+  }
+
+  file.fileHandle = handle;
+  file.size = (u64)size.QuadPart;
+
+  // Empty files can not be mapped, leave data null
+  if (file.size == 0)
+    return true;
+
+  HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    UnmapFile(file);
+    return false;
+  }
+
+  file.mappingHandle = mapping;
+  file.data = (const u8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (file.data == nullptr) {
+    UnmapFile(file);
+    return false;
+  }
+
+  return true;
+}
+
+void Reignite::Tools::UnmapFile(MappedFile& file) {
+
+  if (file.data != nullptr)
+    UnmapViewOfFile(file.data);
+
+  if (file.mappingHandle != nullptr)
+    CloseHandle(file.mappingHandle);
+
+  if (file.fileHandle != nullptr)
+    CloseHandle(file.fileHandle);
+
+  file = MappedFile();
+}
+
+u64 Reignite::Tools::HashBytes(const void* data, u64 size, u64 seed) {
+
+  const u8* bytes = (const u8*)data;
+
+  u64 hash = seed;
+  for (u64 i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+
+  return hash;
+}
+
+bool Reignite::Tools::LoadTextureFile(std::string filename, s32& width, s32& height, void** data) {
+
+  s32 texChannels;
+  *data = stbi_load(filename.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
+  assert(*data);
+
+  return true;
+}
+
+void Reignite::Tools::FreeTextureData(void* textureData) {
+
+  if (nullptr == textureData) {
+    RI_ERROR("Pointer does not hold any texture information");
+    return;
+  }
+
+  stbi_image_free(textureData);
+}
+
+bool Reignite::Tools::LoadGltfFile(std::string filename, GeometryResource& geometry) {
+
+  bool store_original_json_for_extras_and_extensions = false;
+
+  tinygltf::Model model;
+  tinygltf::TinyGLTF gltf_ctx;
+  std::string err;
+  std::string warn;
+
+  std::string ext = "gltf";
+
+  gltf_ctx.SetStoreOriginalJSONForExtrasAndExtensions(store_original_json_for_extras_and_extensions);
+
+  bool ret = false;
+  if (ext.compare("glb") == 0) {
+    ret = gltf_ctx.LoadBinaryFromFile(&model, &err, &warn, filename.c_str());
+  }
+  else {
+    ret = gltf_ctx.LoadASCIIFromFile(&model, &err, &warn, filename.c_str());
+  }
+
+  if (!warn.empty()) { printf("Warn: %s\n", warn.c_str()); }
+
+  if (!err.empty()) { printf("Err: %s\n", err.c_str()); }
+
+  if (!ret) {
+    printf("Failed to parse glTF\n");
+    return false;
+  }
+
+  // gltf parsing
+
+  return true;
+}
+
+bool Reignite::Tools::LoadObjFile(std::string filename, GeometryResource& geometry, ThreadPool* workers) {
+
+  MappedFile file;
+  if (!MapFile(filename, file)) {
+    RI_ERROR("ERROR: Could not open obj file {0}\n", filename.c_str());
+    return false;
+  }
+
+  const char* text = reinterpret_cast<const char*>(file.data);
+  const char* textEnd = text + file.size;
+
+  // Split the file into line aligned chunks of at least kObjMinChunkSize,
+  // a file smaller than that is one chunk. Chunks never outnumber the pool
+  // threads plus the caller, which helps with the work.
+  u64 chunkLimit = workers != nullptr ? workers->threadCount() + 1 : 1;
+  u64 chunkTarget = file.size / kObjMinChunkSize;
+  if (chunkTarget > chunkLimit)
+    chunkTarget = chunkLimit;
+  if (chunkTarget == 0)
+    chunkTarget = 1;
+
+  const u64 chunkSize = file.size / chunkTarget;
+
+  std::vector<ObjChunk> chunks;
+  chunks.reserve(chunkTarget);
+
+  // Cuts move forward to the next line, the remainder folds into the last
+  // chunk once it would fall under chunkSize
+  const char* chunkBegin = text;
+  while (chunkBegin < textEnd || chunks.empty()) {
+
+    const char* chunkEnd = textEnd;
+    if ((u64)(textEnd - chunkBegin) >= chunkSize * 2)
+      chunkEnd = skipLine(chunkBegin + chunkSize, textEnd);
+
+    chunks.emplace_back();
+    chunks.back().begin = chunkBegin;
+    chunks.back().end = chunkEnd;
+    chunkBegin = chunkEnd;
+  }
+
+  const u32 chunkCount = (u32)chunks.size();
+
+  // Pass 1: parse every chunk into its own local streams
+  parallelFor(workers, chunkCount, [&chunks](u32 i) { parseObjChunk(chunks[i]); });
+
+  // Prefix sums so every chunk knows where its data lands in the merged output
+  std::vector<u32> positionBase(chunkCount), normalBase(chunkCount), texcoordBase(chunkCount), cornerBase(chunkCount);
+  u32 positionCount = 0, normalCount = 0, texcoordCount = 0, cornerCount = 0;
+
+  for (u32 i = 0; i < chunkCount; ++i) {
+
+    positionBase[i] = positionCount;
+    normalBase[i] = normalCount;
+    texcoordBase[i] = texcoordCount;
+    cornerBase[i] = cornerCount;
+
+    positionCount += (u32)chunks[i].positions.size() / 3;
+    normalCount += (u32)chunks[i].normals.size() / 3;
+    texcoordCount += (u32)chunks[i].texcoords.size() / 2;
+    cornerCount += (u32)chunks[i].corners.size() / 3;
+  }
+
+  const bool containsUV = texcoordCount != 0;
+
+  std::vector<float> positions(positionCount * 3);
+  std::vector<float> normals(normalCount * 3);
+  std::vector<float> texcoords(texcoordCount * 2);
+
+  geometry.vertices.resize(cornerCount);
+  geometry.indices.resize(cornerCount);
+
+  // Pass 2: gather attribute streams into the preallocated arrays
+  parallelFor(workers, chunkCount, [&](u32 i) {
+
+    const ObjChunk& chunk = chunks[i];
+    if (!chunk.positions.empty())
+      memcpy(&positions[positionBase[i] * 3], chunk.positions.data(), chunk.positions.size() * sizeof(float));
+    if (!chunk.normals.empty())
+      memcpy(&normals[normalBase[i] * 3], chunk.normals.data(), chunk.normals.size() * sizeof(float));
+    if (!chunk.texcoords.empty())
+      memcpy(&texcoords[texcoordBase[i] * 2], chunk.texcoords.data(), chunk.texcoords.size() * sizeof(float));
+  });
+
+  // Pass 3: resolve face corners into vertices and compute tangents per chunk range
+  std::vector<u8> chunkValid(chunkCount, 1);
+
+  parallelFor(workers, chunkCount, [&](u32 i) {
+
+    const ObjChunk& chunk = chunks[i];
+    const u32 count = (u32)chunk.corners.size() / 3;
+
+    for (u32 c = 0; c < count; ++c) {
+
+      const u32 vertexIndex = cornerBase[i] + c;
+      const u8 relative = chunk.relative[c];
+
+      s64 v = resolveObjIndex(chunk.corners[c * 3 + 0], relative & kObjRelativePosition, positionBase[i]);
+      s64 vt = resolveObjIndex(chunk.corners[c * 3 + 1], relative & kObjRelativeTexcoord, texcoordBase[i]);
+      s64 vn = resolveObjIndex(chunk.corners[c * 3 + 2], relative & kObjRelativeNormal, normalBase[i]);
+
+      if (v < 0 || v >= positionCount || vt >= texcoordCount || vn >= normalCount) {
+        chunkValid[i] = 0;
+        return;
+      }
+
+      Vertex& vertex = geometry.vertices[vertexIndex];
+
+      vec3f current_vertex = vec3f(positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]);
+      vec3f normalized_vertex = glm::normalize(current_vertex);
+
+      vertex.position[0] = normalized_vertex.x * 0.5f;
+      vertex.position[1] = normalized_vertex.y * 0.5f;
+      vertex.position[2] = normalized_vertex.z * 0.5f;
+
+      if (vn >= 0) {
+        vertex.normal[0] = normals[3 * vn + 0];
+        vertex.normal[1] = normals[3 * vn + 1];
+        vertex.normal[2] = normals[3 * vn + 2];
+      }
+
+      if (containsUV && vt >= 0) {
+        vertex.texcoord[0] = texcoords[2 * vt + 0];
+        vertex.texcoord[1] = 1.0f - texcoords[2 * vt + 1];
+      }
+
+      geometry.indices[vertexIndex] = vertexIndex;
+    }
+
+    // calculate tangents from obj received data
+    if (containsUV)
+      calculateTangents(geometry, cornerBase[i], cornerBase[i] + count);
+  });
+
+  UnmapFile(file);
+
+  for (u32 i = 0; i < chunkCount; ++i) {
+
+    if (!chunkValid[i]) {
+      RI_ERROR("ERROR: Face index out of range in obj file {0}\n", filename.c_str());
+      geometry.vertices.clear();
+      geometry.indices.clear();
+      return false;
+    }
+  }
+
+  geometry.vertexSize = (u32)geometry.vertices.size();
+  geometry.indicesSize = (u32)geometry.indices.size();
 
   return true;
 }
@@ -235,56 +667,7 @@ bool Reignite::Tools::GenerateTerrain(GeometryResource& geometry,
   geometry.indicesSize = (u32)geometry.indices.size();
 
   // Tangent calculation
-  for (u32 i = 0; i < geometry.indices.size(); i += 3) {
-
-    u32 i0 = geometry.indices[i];
-    u32 i1 = geometry.indices[i + 1];
-    u32 i2 = geometry.indices[i + 2];
-
-    vec3f v0(
-      geometry.vertices[i0].position[0], 
-      geometry.vertices[i0].position[1], 
-      geometry.vertices[i0].position[2]);
-    
-    vec3f v1(
-      geometry.vertices[i1].position[0], 
-      geometry.vertices[i1].position[1], 
-      geometry.vertices[i1].position[2]);
-    
-    vec3f v2(
-      geometry.vertices[i2].position[0], 
-      geometry.vertices[i2].position[1], 
-      geometry.vertices[i2].position[2]);
-
-    vec2f uv0(geometry.vertices[i0].texcoord[0], geometry.vertices[i0].texcoord[1]);
-    vec2f uv1(geometry.vertices[i1].texcoord[0], geometry.vertices[i1].texcoord[1]);
-    vec2f uv2(geometry.vertices[i2].texcoord[0], geometry.vertices[i2].texcoord[1]);
-
-    vec3f deltaPos1 = v1 - v0;
-    vec3f deltaPos2 = v2 - v0;
-
-    vec2f deltaUV1 = uv1 - uv0;
-    vec2f deltaUV2 = uv2 - uv0;
-
-    float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-    if (std::isnan(r) || std::isinf(r)) 
-      r = 0.0f;
-
-    vec3f tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
-    //vec3f bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
-
-    geometry.vertices[i0].tangent[0] = tangent.x;
-    geometry.vertices[i0].tangent[1] = tangent.y;
-    geometry.vertices[i0].tangent[2] = tangent.z;
-
-    geometry.vertices[i1].tangent[0] = tangent.x;
-    geometry.vertices[i1].tangent[1] = tangent.y;
-    geometry.vertices[i1].tangent[2] = tangent.z;
-
-    geometry.vertices[i2].tangent[0] = tangent.x;
-    geometry.vertices[i2].tangent[1] = tangent.y;
-    geometry.vertices[i2].tangent[2] = tangent.z;
-  }
+  calculateTangents(geometry, 0, geometry.indicesSize);
 
   return true;
 }
\ No newline at end of file
@@ -9,17 +9,37 @@
 
 
 namespace Reignite {
+
+  class ThreadPool;
+
 namespace Tools {
 
   const std::string GetAssetPath();
 
+  // Read-only view of a whole file mapped into the address space
+  struct MappedFile {
+    const u8* data = nullptr;
+    u64 size = 0;
+
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+  };
+
+  bool MapFile(std::string filename, MappedFile& file);
+
+  void UnmapFile(MappedFile& file);
+
+  // 64 bit FNV-1a, chain calls by passing the previous hash as seed
+  u64 HashBytes(const void* data, u64 size, u64 seed = 14695981039346656037ull);
+
   bool LoadTextureFile(std::string filename, s32& width, s32& height, void** data);
 
   void FreeTextureData(void* textureData);
 
   bool LoadGltfFile(std::string filename, GeometryResource& geometry);
 
-  bool LoadObjFile(std::string filename, GeometryResource& geometry);
+  // Parses chunks of the file on the workers when given
+  bool LoadObjFile(std::string filename, GeometryResource& geometry, ThreadPool* workers = nullptr);
 
   bool GenerateTerrain(GeometryResource& geometry, u32 width, u32 lenght, void(*HeigthFunction)() = nullptr);
 
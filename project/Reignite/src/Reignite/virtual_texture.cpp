@@ -0,0 +1,627 @@
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+#include "log.h"
+#include "thread_pool.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_upload_ring.h"
+
+
+// Feedback entries and page keys: x in bits 0-11, y in 12-23, mip in 24-27
+static const u32 kFeedbackValid = 1u << 31;
+static const u32 kNoPage = 0xffffffff;
+static const u32 kNoSlot = 0xffffffff;
+
+// Pages being cut on the workers at once, coarsest requests go first
+static const u32 kMaxPendingPages = 32;
+
+// Cache texels per screen pixel, leaves room for magnified and sloped surfaces
+static const float kCacheOverdraw = 2.0f;
+
+static const u32 kPageStride = Reignite::VirtualTexture::kPageSize + 2 * Reignite::VirtualTexture::kPageBorder;
+static const u64 kPageBytes = (u64)kPageStride * kPageStride * 4;
+
+// Matches the VirtualTexture uniform block of mrt_vt.frag (std140)
+struct VirtualTextureParams {
+  float size[4];     // virtual width, height, page size, page border
+  float cache[4];    // 1 / cache size in texels, page stride, tail mip, unused
+  u32 feedback[4];   // width, scale, offset x, offset y
+};
+
+static u32 pageKey(u32 x, u32 y, u32 mip) {
+
+  return x | (y << 12) | (mip << 24);
+}
+
+std::vector<VkDescriptorSetLayoutBinding> Reignite::VirtualTexture::DescriptorSetLayoutBindings() {
+
+  std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+  for (u32 i = 0; i < kMaxLayers; ++i) {
+    bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_Cache + i));
+  }
+
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_PageTable));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_Feedback));
+  bindings.push_back(vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kBinding_Params));
+
+  return bindings;
+}
+
+void Reignite::VirtualTexture::init(vk::VulkanState* state, ThreadPool* pool, u32 frameCount) {
+
+  vulkanState = state;
+  device = state->device;
+  workers = pool;
+
+  readback.resize(frameCount);
+  readbackFrame.assign(frameCount, 0);
+}
+
+bool Reignite::VirtualTexture::addLayer(const PackEntry& entry, const u8* texels, std::vector<u8>&& storage) {
+
+  if (layers.size() >= kMaxLayers) {
+    RI_ERROR("Virtual texture takes at most {} layers", kMaxLayers);
+    return false;
+  }
+
+  if (entry.format != VK_FORMAT_R8G8B8A8_UNORM && entry.format != VK_FORMAT_R8G8B8A8_SRGB) {
+    RI_ERROR("Virtual texture layers must be RGBA8");
+    return false;
+  }
+
+  layers.emplace_back();
+  Layer& layer = layers.back();
+  layer.entry = entry;
+  layer.texels = texels;
+  layer.storage = std::move(storage);
+
+  return true;
+}
+
+bool Reignite::VirtualTexture::create(u32 screenWidth, u32 screenHeight, VkCommandBuffer cmd, vk::UploadRing& uploads) {
+
+  if (layers.empty()) {
+    RI_ERROR("Virtual texture without layers");
+    return false;
+  }
+
+  const PackEntry& base = layers[0].entry;
+  for (const Layer& layer : layers) {
+    if (layer.entry.width != base.width || layer.entry.height != base.height || layer.entry.mipLevels != base.mipLevels) {
+      RI_ERROR("Virtual texture layers must share size and mip count");
+      return false;
+    }
+  }
+
+  if ((base.width & (base.width - 1)) != 0 || (base.height & (base.height - 1)) != 0) {
+    RI_ERROR("Virtual texture size {}x{} is not a power of two", base.width, base.height);
+    return false;
+  }
+
+  pagesX = (std::max)(base.width / kPageSize, 1u);
+  pagesY = (std::max)(base.height / kPageSize, 1u);
+
+  // The tail is the first mip that fits in a single page
+  tailMip = 0;
+  while (pagesAt(tailMip, pagesX) > 1 || pagesAt(tailMip, pagesY) > 1)
+    ++tailMip;
+
+  if (tailMip >= base.mipLevels) {
+    RI_ERROR("Virtual texture needs its mips down to one page, has {} of {}", base.mipLevels, tailMip + 1);
+    return false;
+  }
+
+  // Every level points at the tail in slot 0 to begin with
+  levelOffsets.resize(tailMip + 1);
+  u32 tableSize = 0;
+  for (u32 mip = 0; mip <= tailMip; ++mip) {
+    levelOffsets[mip] = tableSize;
+    tableSize += pagesAt(mip, pagesX) * pagesAt(mip, pagesY);
+  }
+  table.assign(tableSize, slotEntry(0, tailMip));
+
+  VkDeviceSize tableOffset;
+  VkDeviceSize tailOffset;
+  u8* tableStaging = uploads.allocate((VkDeviceSize)tableSize * sizeof(u32), 16, tableOffset);
+  u8* tailStaging = uploads.allocate((VkDeviceSize)layers.size() * kPageBytes, 16, tailOffset);
+  if (tableStaging == nullptr || tailStaging == nullptr) {
+    RI_ERROR("Virtual texture tail does not fit in the upload buffer");
+    return false;
+  }
+
+  const u32 tail = pageKey(0, 0, tailMip);
+  std::vector<u8> tailTexels;
+  buildPage(tail, tailTexels);
+  memcpy(tailStaging, tailTexels.data(), tailTexels.size());
+  memcpy(tableStaging, table.data(), table.size() * sizeof(u32));
+
+  const float side = std::sqrt(kCacheOverdraw * screenWidth * screenHeight) / kPageSize;
+  cacheSide = (std::min)((std::max)((u32)std::ceil(side), 4u), 32u);
+
+  for (Layer& layer : layers) {
+    layer.cache.create((VkFormat)layer.entry.format, cacheSide * kPageStride, cacheSide * kPageStride, 1,
+      device, vulkanState->physicalDevice);
+  }
+
+  pageTable.create(VK_FORMAT_R8G8B8A8_UINT, pagesX, pagesY, tailMip + 1, device, vulkanState->physicalDevice);
+
+  createFeedback(screenWidth, screenHeight);
+
+  // Written by every update, before the frame that reads them
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    sizeof(VirtualTextureParams), &params));
+
+  // Slot 0 holds the mip tail for good, every lookup falls back to it
+  slots.assign(cacheSide * cacheSide, { kNoPage, 0 });
+  slots[0] = { tail, ~0ull };
+  resident[tail] = 0;
+
+  // The unmapped slots are left undefined, they are never sampled
+  std::vector<VkBufferImageCopy> regions(1);
+  for (u32 l = 0; l < (u32)layers.size(); ++l) {
+
+    regions[0] = {};
+    regions[0].bufferOffset = tailOffset + l * kPageBytes;
+    regions[0].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    regions[0].imageExtent = { kPageStride, kPageStride, 1 };
+
+    recordUpload(cmd, uploads.buffer(), layers[l].cache, VK_IMAGE_LAYOUT_UNDEFINED, regions);
+  }
+
+  regions.resize(tailMip + 1);
+  for (u32 mip = 0; mip <= tailMip; ++mip) {
+
+    regions[mip] = {};
+    regions[mip].bufferOffset = tableOffset + (VkDeviceSize)levelOffsets[mip] * sizeof(u32);
+    regions[mip].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+    regions[mip].imageExtent = { pagesAt(mip, pagesX), pagesAt(mip, pagesY), 1 };
+  }
+
+  recordUpload(cmd, uploads.buffer(), pageTable, VK_IMAGE_LAYOUT_UNDEFINED, regions);
+
+  RI_INFO("Virtual texture {}x{}, {} pages cache, {}x{} feedback", base.width, base.height,
+    cacheSide * cacheSide, feedbackWidth, feedbackHeight);
+
+  return true;
+}
+
+void Reignite::VirtualTexture::destroy() {
+
+  for (auto& job : pending)
+    job.second->done.wait();
+  pending.clear();
+
+  for (Layer& layer : layers) {
+    if (layer.cache.image != VK_NULL_HANDLE)
+      layer.cache.destroy();
+  }
+  layers.clear();
+
+  if (pageTable.image != VK_NULL_HANDLE)
+    pageTable.destroy();
+  pageTable = vk::Texture2D();
+  table.clear();
+
+  destroyFeedback();
+  params.destroy();
+
+  resident.clear();
+  slots.clear();
+}
+
+void Reignite::VirtualTexture::resizeFeedback(u32 screenWidth, u32 screenHeight) {
+
+  destroyFeedback();
+  createFeedback(screenWidth, screenHeight);
+
+  RI_INFO("Virtual texture feedback resized to {}x{}", feedbackWidth, feedbackHeight);
+}
+
+void Reignite::VirtualTexture::createFeedback(u32 screenWidth, u32 screenHeight) {
+
+  feedbackWidth = (screenWidth + kFeedbackScale - 1) / kFeedbackScale;
+  feedbackHeight = (screenHeight + kFeedbackScale - 1) / kFeedbackScale;
+  const VkDeviceSize feedbackSize = (VkDeviceSize)feedbackWidth * feedbackHeight * sizeof(u32);
+
+  // Cleared by every G-buffer pass before it is written
+  VK_CHECK(vulkanState->createBuffer(
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, feedbackSize, &feedback));
+
+  for (u32 i = 0; i < (u32)readback.size(); ++i) {
+    VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, feedbackSize, &readback[i]));
+    VK_CHECK(readback[i].map());
+    readbackFrame[i] = 0;
+  }
+}
+
+void Reignite::VirtualTexture::destroyFeedback() {
+
+  feedback.destroy();
+  for (vk::Buffer& buffer : readback) {
+    buffer.unmap();
+    buffer.destroy();
+  }
+}
+
+void Reignite::VirtualTexture::writeDescriptors(VkDescriptorSet descriptorSet) {
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+  for (u32 i = 0; i < (u32)layers.size(); ++i) {
+    writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(descriptorSet,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kBinding_Cache + i, &layers[i].cache.descriptor));
+  }
+
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(descriptorSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kBinding_PageTable, &pageTable.descriptor));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(descriptorSet,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kBinding_Feedback, &feedback.descriptor));
+  writeDescriptorSets.push_back(vk::initializers::WriteDescriptorSet(descriptorSet,
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kBinding_Params, &params.descriptor));
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+void Reignite::VirtualTexture::recordFeedbackClear(VkCommandBuffer cmd) {
+
+  // The previous frame's copy to its readback has to finish reading first
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.buffer = feedback.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+  vkCmdFillBuffer(cmd, feedback.buffer, 0, VK_WHOLE_SIZE, 0);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Reignite::VirtualTexture::recordFeedbackBarrier(VkCommandBuffer cmd) {
+
+  // Covers the copy of the frame's own command buffer, later in the queue
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.buffer = feedback.buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Reignite::VirtualTexture::recordFeedbackCopy(VkCommandBuffer cmd, u32 frameSlot) {
+
+  VkBufferCopy region = {};
+  region.size = feedback.size;
+  vkCmdCopyBuffer(cmd, feedback.buffer, readback[frameSlot].buffer, 1, &region);
+
+  VkBufferMemoryBarrier barrier = vk::initializers::BufferMemoryBarrier();
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.buffer = readback[frameSlot].buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+    0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+  readbackFrame[frameSlot] = frame;
+}
+
+void Reignite::VirtualTexture::update(u32 frameSlot, VkCommandBuffer cmd, vk::UploadRing& uploads) {
+
+  if (slots.empty())
+    return;
+
+  ++frame;
+
+  // Requests of the last frame of this slot. A page keeps its ancestors in
+  // use too, they are what the page table falls back to.
+  std::unordered_set<u32> seen;
+  std::vector<u32> missing;
+
+  const u32* requests = (const u32*)readback[frameSlot].mapped;
+  const u32 requestCount = readbackFrame[frameSlot] != 0 ? feedbackWidth * feedbackHeight : 0;
+
+  for (u32 i = 0; i < requestCount; ++i) {
+
+    if (!(requests[i] & kFeedbackValid))
+      continue;
+
+    u32 x = requests[i] & 0xfff;
+    u32 y = (requests[i] >> 12) & 0xfff;
+    u32 mip = (requests[i] >> 24) & 0xf;
+    if (mip > tailMip || x >= pagesAt(mip, pagesX) || y >= pagesAt(mip, pagesY))
+      continue;
+
+    for (; mip <= tailMip; ++mip, x >>= 1, y >>= 1) {
+
+      const u32 key = pageKey(x, y, mip);
+      if (!seen.insert(key).second)
+        break;
+
+      auto slot = resident.find(key);
+      if (slot != resident.end())
+        slots[slot->second].lastUsed = (std::max)(slots[slot->second].lastUsed, frame);
+      else if (pending.find(key) == pending.end())
+        missing.push_back(key);
+    }
+  }
+
+  // Map the pages the workers finished into the least recently used slots.
+  // Room for every table texel is taken first, so a mapped page always has
+  // its table texels copied along.
+  std::vector<std::unique_ptr<PageJob>> finished;
+  std::vector<std::vector<VkBufferImageCopy>> pageRegions(layers.size());
+  std::vector<Region> dirty(tailMip + 1, { ~0u, ~0u, 0, 0 });
+
+  VkDeviceSize tableOffset = 0;
+  u8* tableStaging = nullptr;
+
+  for (auto job = pending.begin(); job != pending.end();) {
+
+    if (job->second->done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++job;
+      continue;
+    }
+
+    u32 victim = kNoSlot;
+    for (u32 i = 0; i < (u32)slots.size(); ++i) {
+      if (slots[i].lastUsed < frame && (victim == kNoSlot || slots[i].lastUsed < slots[victim].lastUsed))
+        victim = i;
+    }
+
+    // Everything in the cache is on screen, retry once something frees up
+    if (victim == kNoSlot)
+      break;
+
+    if (tableStaging == nullptr)
+      tableStaging = uploads.allocate((VkDeviceSize)table.size() * sizeof(u32), 16, tableOffset);
+
+    // The upload buffer of this frame is full, the page waits for the next
+    VkDeviceSize pageOffset;
+    u8* pageStaging = tableStaging != nullptr ? uploads.allocate((VkDeviceSize)layers.size() * kPageBytes, 16, pageOffset) : nullptr;
+    if (pageStaging == nullptr)
+      break;
+
+    memcpy(pageStaging, job->second->texels.data(), layers.size() * kPageBytes);
+
+    for (u32 l = 0; l < (u32)layers.size(); ++l) {
+
+      VkBufferImageCopy region = {};
+      region.bufferOffset = pageOffset + l * kPageBytes;
+      region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+      region.imageOffset.x = (s32)((victim % cacheSide) * kPageStride);
+      region.imageOffset.y = (s32)((victim / cacheSide) * kPageStride);
+      region.imageExtent = { kPageStride, kPageStride, 1 };
+      pageRegions[l].push_back(region);
+    }
+
+    const u32 evicted = slots[victim].page;
+    if (evicted != kNoPage)
+      resident.erase(evicted);
+
+    slots[victim] = { job->first, frame };
+    resident[job->first] = victim;
+
+    if (evicted != kNoPage)
+      refreshTable(evicted, dirty);
+    refreshTable(job->first, dirty);
+
+    finished.push_back(std::move(job->second));
+    job = pending.erase(job);
+  }
+
+  if (!finished.empty()) {
+
+    for (u32 l = 0; l < (u32)layers.size(); ++l)
+      recordUpload(cmd, uploads.buffer(), layers[l].cache, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, pageRegions[l]);
+
+    // Only the texels that changed, packed level after level
+    std::vector<VkBufferImageCopy> tableRegions;
+    VkDeviceSize packed = 0;
+
+    for (u32 mip = 0; mip <= tailMip; ++mip) {
+
+      const Region& region = dirty[mip];
+      if (region.x0 >= region.x1)
+        continue;
+
+      const u32 width = pagesAt(mip, pagesX);
+      const u32 rowTexels = region.x1 - region.x0;
+
+      VkBufferImageCopy copy = {};
+      copy.bufferOffset = tableOffset + packed;
+      copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+      copy.imageOffset = { (s32)region.x0, (s32)region.y0, 0 };
+      copy.imageExtent = { rowTexels, region.y1 - region.y0, 1 };
+      tableRegions.push_back(copy);
+
+      for (u32 y = region.y0; y < region.y1; ++y) {
+        memcpy(tableStaging + packed, &table[levelOffsets[mip] + y * width + region.x0], rowTexels * sizeof(u32));
+        packed += rowTexels * sizeof(u32);
+      }
+    }
+
+    if (!tableRegions.empty())
+      recordUpload(cmd, uploads.buffer(), pageTable, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, tableRegions);
+  }
+
+  // Start the missing pages, coarse ones first so the fallback improves quickly
+  std::sort(missing.begin(), missing.end(), [](u32 a, u32 b) { return (a >> 24) > (b >> 24); });
+
+  for (u32 key : missing) {
+
+    if (pending.size() >= kMaxPendingPages)
+      break;
+
+    std::unique_ptr<PageJob> job(new PageJob());
+    std::vector<u8>* texels = &job->texels;
+    job->done = workers->submit([this, key, texels]() { buildPage(key, *texels); });
+    pending[key] = std::move(job);
+  }
+
+  // Each frame samples a different pixel of every feedback block
+  const u32 sample = (u32)((frame * 29) % (kFeedbackScale * kFeedbackScale));
+  const PackEntry& base = layers[0].entry;
+
+  VirtualTextureParams values = {};
+  values.size[0] = (float)base.width;
+  values.size[1] = (float)base.height;
+  values.size[2] = (float)kPageSize;
+  values.size[3] = (float)kPageBorder;
+  values.cache[0] = 1.0f / (float)(cacheSide * kPageStride);
+  values.cache[1] = (float)kPageStride;
+  values.cache[2] = (float)tailMip;
+  values.feedback[0] = feedbackWidth;
+  values.feedback[1] = kFeedbackScale;
+  values.feedback[2] = sample % kFeedbackScale;
+  values.feedback[3] = sample / kFeedbackScale;
+
+  uploads.write(params.buffer, 0, &values, sizeof(values));
+}
+
+u32 Reignite::VirtualTexture::pagesAt(u32 mip, u32 pages) const {
+
+  return (std::max)(pages >> mip, 1u);
+}
+
+void Reignite::VirtualTexture::buildPage(u32 page, std::vector<u8>& texels) const {
+
+  const s32 x = (s32)(page & 0xfff);
+  const s32 y = (s32)((page >> 12) & 0xfff);
+  const u32 mip = (page >> 24) & 0xf;
+
+  texels.resize(layers.size() * kPageBytes);
+
+  for (u32 l = 0; l < (u32)layers.size(); ++l) {
+
+    const PackEntry& entry = layers[l].entry;
+    const s32 width = (s32)(std::max)(entry.width >> mip, 1u);
+    const s32 height = (s32)(std::max)(entry.height >> mip, 1u);
+    const u32* source = (const u32*)(layers[l].texels + entry.mipOffset[mip]);
+    u32* target = (u32*)(texels.data() + l * kPageBytes);
+
+    // Borders wrap like the repeat sampler of a regular texture
+    const s32 left = x * (s32)kPageSize - (s32)kPageBorder;
+    const s32 top = y * (s32)kPageSize - (s32)kPageBorder;
+
+    for (u32 row = 0; row < kPageStride; ++row) {
+
+      const s32 sy = ((top + (s32)row) % height + height) % height;
+      const u32* sourceRow = source + (u64)sy * width;
+
+      for (u32 col = 0; col < kPageStride; ++col) {
+
+        const s32 sx = ((left + (s32)col) % width + width) % width;
+        target[row * kPageStride + col] = sourceRow[sx];
+      }
+    }
+  }
+}
+
+u32 Reignite::VirtualTexture::slotEntry(u32 slot, u32 mip) const {
+
+  return (slot % cacheSide) | ((slot / cacheSide) << 8) | (mip << 16) | (0xffu << 24);
+}
+
+void Reignite::VirtualTexture::refreshTable(u32 page, std::vector<Region>& dirty) {
+
+  const u32 pageX = page & 0xfff;
+  const u32 pageY = (page >> 12) & 0xfff;
+  const u32 pageMip = (page >> 24) & 0xf;
+
+  // Coarse to fine over the texels the page covers, missing pages inherit
+  // their parent's entry
+  for (s32 mip = (s32)pageMip; mip >= 0; --mip) {
+
+    const u32 shift = pageMip - (u32)mip;
+    const u32 width = pagesAt(mip, pagesX);
+    const u32 height = pagesAt(mip, pagesY);
+    const u32 x0 = (std::min)(pageX << shift, width);
+    const u32 y0 = (std::min)(pageY << shift, height);
+    const u32 x1 = (std::min)((pageX + 1) << shift, width);
+    const u32 y1 = (std::min)((pageY + 1) << shift, height);
+
+    Region& region = dirty[mip];
+
+    for (u32 y = y0; y < y1; ++y) {
+      for (u32 x = x0; x < x1; ++x) {
+
+        u32 value;
+        auto slot = resident.find(pageKey(x, y, (u32)mip));
+        if (slot != resident.end()) {
+          value = slotEntry(slot->second, (u32)mip);
+        }
+        else {
+          assert(mip < (s32)tailMip);
+          const u32 parentWidth = pagesAt(mip + 1, pagesX);
+          const u32 parentHeight = pagesAt(mip + 1, pagesY);
+          const u32 px = (std::min)(x >> 1, parentWidth - 1);
+          const u32 py = (std::min)(y >> 1, parentHeight - 1);
+          value = table[levelOffsets[mip + 1] + py * parentWidth + px];
+        }
+
+        u32& texel = table[levelOffsets[mip] + y * width + x];
+        if (texel == value)
+          continue;
+
+        texel = value;
+        region.x0 = (std::min)(region.x0, x);
+        region.y0 = (std::min)(region.y0, y);
+        region.x1 = (std::max)(region.x1, x + 1);
+        region.y1 = (std::max)(region.y1, y + 1);
+      }
+    }
+  }
+}
+
+void Reignite::VirtualTexture::recordUpload(VkCommandBuffer cmd, VkBuffer staging, vk::Texture2D& texture,
+  VkImageLayout oldLayout, const std::vector<VkBufferImageCopy>& regions) const {
+
+  // Frames in flight are done with the image, the upload command buffer
+  // starts after them
+  VkImageSubresourceRange range = {};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = texture.mipLevels;
+  range.layerCount = 1;
+
+  vk::tools::SetImageLayout(cmd, texture.image, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  vkCmdCopyBufferToImage(cmd, staging, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    static_cast<u32>(regions.size()), regions.data());
+
+  vk::tools::SetImageLayout(cmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+  texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  texture.updateDescriptor();
+}
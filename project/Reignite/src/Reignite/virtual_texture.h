@@ -0,0 +1,155 @@
+#ifndef _RI_VIRTUAL_TEXTURE_
+#define _RI_VIRTUAL_TEXTURE_ 1
+
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "basic_types.h"
+#include "asset_pack.h"
+
+#include "Vulkan/vulkan_texture.h"
+#include "Vulkan/vulkan_buffer.h"
+
+
+namespace vk {
+  class VulkanState;
+  class UploadRing;
+}
+
+namespace Reignite {
+
+  class ThreadPool;
+
+  // Page based virtual texturing for large unique textures. The layers
+  // (color, normal, ...) share one virtual address space cut in pages and one
+  // page table, and each has a physical page cache sized from the screen, so
+  // memory follows resolution instead of content. The G-buffer pass writes
+  // the pages it samples into a low resolution feedback buffer, every frame
+  // copies it to a host buffer of its own that is read once the frame is
+  // done. Missing pages are cut out of the mip chains on the workers and
+  // mapped once they are done, until then coarser pages stand in. Pages and
+  // the page table texels they change go through the frame's uploads.
+  class VirtualTexture {
+   public:
+
+    static const u32 kPageSize = 128;     // payload texels per page side
+    static const u32 kPageBorder = 4;     // filtering border around each page
+    static const u32 kFeedbackScale = 8;  // screen pixels per feedback texel side
+    static const u32 kMaxLayers = 4;
+
+    // Set layout of mrt_vt.frag: caches, page table, feedback, parameters
+    enum Binding {
+      kBinding_Cache = 0,
+      kBinding_PageTable = kMaxLayers,
+      kBinding_Feedback,
+      kBinding_Params
+    };
+
+    static std::vector<VkDescriptorSetLayoutBinding> DescriptorSetLayoutBindings();
+
+    void init(vk::VulkanState* vulkanState, ThreadPool* workers, u32 frameCount);
+
+    // Layers are RGBA8 mip chains of one power of two size, texels may
+    // point into storage or into the mapped asset pack. False when the
+    // layer does not fit.
+    bool addLayer(const PackEntry& entry, const u8* texels, std::vector<u8>&& storage);
+
+    // Page table, caches and feedback for a screen size, the mip tail is
+    // copied by cmd. False when the layers cannot make a virtual texture,
+    // nothing is created then.
+    bool create(u32 screenWidth, u32 screenHeight, VkCommandBuffer cmd, vk::UploadRing& uploads);
+    void destroy();
+
+    // Feedback and readbacks for a new screen size, with the device idle.
+    // Pending requests are dropped, writeDescriptors has to follow.
+    void resizeFeedback(u32 screenWidth, u32 screenHeight);
+
+    void writeDescriptors(VkDescriptorSet descriptorSet);
+
+    // Around the G-buffer pass: clear the requests, then make them readable
+    void recordFeedbackClear(VkCommandBuffer cmd);
+    void recordFeedbackBarrier(VkCommandBuffer cmd);
+
+    // After the G-buffer pass, copies the requests to the host buffer of a
+    // frame slot, read when the slot comes around again
+    void recordFeedbackCopy(VkCommandBuffer cmd, u32 frameSlot);
+
+    // Reads the requests of the slot's last frame, whose fence has signalled,
+    // maps finished pages and starts the missing ones. Pages, page table
+    // texels and parameters are staged in uploads and copied by cmd.
+    void update(u32 frameSlot, VkCommandBuffer cmd, vk::UploadRing& uploads);
+
+    u32 residentPages() const { return (u32)resident.size(); }
+    u32 cachePages() const { return cacheSide * cacheSide; }
+
+   private:
+
+    struct Layer {
+      PackEntry entry;
+      const u8* texels = nullptr;
+      std::vector<u8> storage;
+      vk::Texture2D cache;
+    };
+
+    struct Slot {
+      u32 page;
+      u64 lastUsed;
+    };
+
+    struct PageJob {
+      std::vector<u8> texels;
+      std::future<void> done;
+    };
+
+    // Changed texels of a page table level, empty while x0 >= x1
+    struct Region {
+      u32 x0, y0, x1, y1;
+    };
+
+    void createFeedback(u32 screenWidth, u32 screenHeight);
+    void destroyFeedback();
+    u32 pagesAt(u32 mip, u32 pages) const;
+    u32 slotEntry(u32 slot, u32 mip) const;
+    void buildPage(u32 page, std::vector<u8>& texels) const;
+    void refreshTable(u32 page, std::vector<Region>& dirty);
+    void recordUpload(VkCommandBuffer cmd, VkBuffer staging, vk::Texture2D& texture, VkImageLayout oldLayout,
+      const std::vector<VkBufferImageCopy>& regions) const;
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    ThreadPool* workers = nullptr;
+
+    std::vector<Layer> layers;
+
+    // Page table texel (x, y) of level m holds the cache slot and mip of the
+    // finest resident page covering virtual page (x, y) of mip m. The host
+    // copy keeps the levels one after another.
+    vk::Texture2D pageTable;
+    std::vector<u32> table;
+    std::vector<u32> levelOffsets;
+    u32 pagesX = 0;
+    u32 pagesY = 0;
+    u32 tailMip = 0;
+
+    u32 cacheSide = 0;
+    std::vector<Slot> slots;
+    std::unordered_map<u32, u32> resident;
+    std::unordered_map<u32, std::unique_ptr<PageJob>> pending;
+
+    // Written by the G-buffer pass, copied to the readback of the frame slot.
+    // readbackFrame is the frame a readback holds the requests of, 0 if none.
+    vk::Buffer feedback;
+    std::vector<vk::Buffer> readback;
+    std::vector<u64> readbackFrame;
+    vk::Buffer params;
+    u32 feedbackWidth = 0;
+    u32 feedbackHeight = 0;
+
+    u64 frame = 0;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_VIRTUAL_TEXTURE_
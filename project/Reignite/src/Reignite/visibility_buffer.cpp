@@ -0,0 +1,563 @@
+#include "visibility_buffer.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "log.h"
+#include "tools.h"
+#include "light_clusters.h"
+
+#include "GfxResources/geometry_resource.h"
+
+#include "Vulkan/vulkan_state.h"
+#include "Vulkan/vulkan_tools.h"
+#include "Vulkan/vulkan_initializers.h"
+#include "Vulkan/vulkan_descriptors.h"
+#include "Vulkan/vulkan_framebuffer.h"
+#include "Vulkan/vulkan_upload_ring.h"
+
+
+void Reignite::VisibilityBuffer::create(vk::VulkanState* state, VkPipelineCache cache,
+  VkRenderPass renderPass, vk::DescriptorAllocator& descriptors, VkDescriptorSetLayout viewLayout,
+  VkDescriptorSetLayout modelLayout, u32 width, u32 height, u32 maxDraws) {
+
+  vulkanState = state;
+  device = state->device;
+  pipelineCache = cache;
+
+  createTargets(width, height);
+
+  // Draw table, copied in from the host copy every frame
+  drawCount = (std::min)(maxDraws, kMaxDraws);
+  entries.assign(drawCount, DrawEntry());
+
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    (VkDeviceSize)drawCount * sizeof(DrawEntry), &draws));
+
+  // Visibility: positions only, the draw id pushed per draw
+  {
+    std::array<VkDescriptorSetLayout, 2> setLayouts = { viewLayout, modelLayout };
+    VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(u32), 0);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(
+      setLayouts.data(), static_cast<u32>(setLayouts.size()));
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &visibilityPipelineLayout));
+
+    VkVertexInputBindingDescription vertexInputBinding =
+      vk::initializers::VertexInputBindingDescription(0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX);
+    VkVertexInputAttributeDescription vertexInputAttribute =
+      vk::initializers::VertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
+    vertexInputState.vertexAttributeDescriptionCount = 1;
+    vertexInputState.pVertexAttributeDescriptions = &vertexInputAttribute;
+
+    PipelineCreateInfo info;
+    info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    info.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+    info.filenames = { "visibility.vert", "visibility.frag" };
+    info.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    info.pipelineLayout = visibilityPipelineLayout;
+    info.renderPass = visibility->renderPass;
+    info.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+      VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+    info.vertexInputState = vertexInputState;
+    info.pipelineCache = pipelineCache;
+
+    VK_CHECK(CreateGraphicsPipeline(device, visibilityPipeline, info));
+  }
+
+  // Resolve set, the material pipelines add their own set before it
+  std::vector<VkDescriptorSetLayoutBinding> bindings = {
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Visibility),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Vertices),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Indices),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Draws),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_View),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_ShadowLights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_ShadowMap),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_PointLights),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_Clusters),
+    vk::initializers::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, kResolveBinding_ClusterParams)
+  };
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(
+    bindings.data(), static_cast<u32>(bindings.size()));
+  VK_CHECK(descriptors.createLayout(layoutInfo, &resolveSetLayout));
+
+  VK_CHECK(descriptors.allocate(resolveSetLayout, &resolveSet));
+
+  // Composite
+  VkDescriptorSetLayoutBinding compositeBinding = vk::initializers::DescriptorSetLayoutBinding(
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+  layoutInfo = vk::initializers::DescriptorSetLayoutCreateInfo(&compositeBinding, 1);
+  VK_CHECK(descriptors.createLayout(layoutInfo, &compositeSetLayout));
+
+  // Size of the drawn area for the bicubic filter
+  VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(vec2f), 0);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(&compositeSetLayout, 1);
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &compositePipelineLayout));
+
+  PipelineCreateInfo compositeInfo;
+  compositeInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  compositeInfo.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  compositeInfo.filenames = { "deferred_pbr.vert", "composite.frag" };
+  compositeInfo.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  compositeInfo.pipelineLayout = compositePipelineLayout;
+  compositeInfo.renderPass = renderPass;
+  compositeInfo.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  compositeInfo.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  compositeInfo.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, compositePipeline, compositeInfo));
+
+  VK_CHECK(descriptors.allocate(compositeSetLayout, &compositeSet));
+
+  writeCompositeDescriptor();
+
+  RI_INFO("Visibility buffer {}x{}, {} draws", width, height, drawCount);
+}
+
+void Reignite::VisibilityBuffer::destroy() {
+
+  for (MaterialPipeline& material : materials) {
+    vkDestroyPipeline(device, material.pipeline, nullptr);
+    vkDestroyPipelineLayout(device, material.layout, nullptr);
+  }
+  materials.clear();
+
+  vkDestroyPipeline(device, skyboxPipeline, nullptr);
+  skyboxPipeline = VK_NULL_HANDLE;
+
+  vkDestroyPipeline(device, visibilityPipeline, nullptr);
+  vkDestroyPipelineLayout(device, visibilityPipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, resolveSetLayout, nullptr);
+
+  vkDestroyPipeline(device, compositePipeline, nullptr);
+  vkDestroyPipelineLayout(device, compositePipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, compositeSetLayout, nullptr);
+
+  draws.destroy();
+
+  if (!pooled.empty()) {
+    vertexPool.destroy();
+    indexPool.destroy();
+  }
+  pooled.clear();
+  ranges.clear();
+  spareResolveSets.clear();
+
+  destroyTargets();
+
+  // The sets go back with the allocator's pools
+  resolveSet = VK_NULL_HANDLE;
+  compositeSet = VK_NULL_HANDLE;
+}
+
+void Reignite::VisibilityBuffer::resize(u32 width, u32 height) {
+
+  destroyTargets();
+  createTargets(width, height);
+  writeCompositeDescriptor();
+
+  RI_INFO("Visibility buffer resized to {}x{}", width, height);
+}
+
+void Reignite::VisibilityBuffer::setRenderArea(u32 width, u32 height) {
+
+  area = { width, height };
+}
+
+void Reignite::VisibilityBuffer::createTargets(u32 width, u32 height) {
+
+  // Ids, sampled by the resolve, and a depth that is only tested
+  visibility = new vk::Framebuffer(vulkanState);
+  visibility->width = width;
+  visibility->height = height;
+  area = { width, height };
+
+  vk::AttachmentCreateInfo attachmentCreateInfo = {};
+  attachmentCreateInfo.width = width;
+  attachmentCreateInfo.height = height;
+  attachmentCreateInfo.layerCount = 1;
+
+  attachmentCreateInfo.format = VK_FORMAT_R32_UINT;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  visibility->addAttachment(attachmentCreateInfo);
+
+  attachmentCreateInfo.format = VK_FORMAT_D32_SFLOAT;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  visibility->addAttachment(attachmentCreateInfo);
+
+  // Integer ids are fetched, never filtered
+  VK_CHECK(visibility->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+  VK_CHECK(visibility->createRenderPass());
+
+  // Shaded color, sampled by the composite
+  shaded = new vk::Framebuffer(vulkanState);
+  shaded->width = width;
+  shaded->height = height;
+
+  attachmentCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  attachmentCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  shaded->addAttachment(attachmentCreateInfo);
+
+  VK_CHECK(shaded->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+  VK_CHECK(shaded->createRenderPass());
+}
+
+void Reignite::VisibilityBuffer::destroyTargets() {
+
+  // The pipelines made with their render passes work with the replacements
+  delete visibility;
+  visibility = nullptr;
+  delete shaded;
+  shaded = nullptr;
+}
+
+void Reignite::VisibilityBuffer::writeCompositeDescriptor() {
+
+  VkDescriptorImageInfo color = vk::initializers::DescriptorImageInfo(shaded->sampler,
+    shaded->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  VkWriteDescriptorSet write = vk::initializers::WriteDescriptorSet(compositeSet,
+    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &color);
+  vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+}
+
+void Reignite::VisibilityBuffer::addMaterial(u32 material, VkDescriptorSetLayout materialLayout,
+  const std::string& resolveShader) {
+
+  if (materials.size() <= material)
+    materials.resize(material + 1);
+
+  MaterialPipeline& resolve = materials[material];
+  assert(resolve.pipeline == VK_NULL_HANDLE);
+
+  // Only the pixels of this material's draws pass
+  std::array<VkDescriptorSetLayout, 2> setLayouts = { materialLayout, resolveSetLayout };
+  VkPushConstantRange pushConstantRange = vk::initializers::PushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(u32), 0);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk::initializers::PipelineLayoutCreateInfo(
+    setLayouts.data(), static_cast<u32>(setLayouts.size()));
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &resolve.layout));
+
+  PipelineCreateInfo info;
+  info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  info.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  info.filenames = { "deferred_pbr.vert", resolveShader };
+  info.stages = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  info.pipelineLayout = resolve.layout;
+  info.renderPass = shaded->renderPass;
+  info.depthStencilState = vk::initializers::PipelineDepthStencilStateCreateInfo(
+    VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+  info.vertexInputState = vk::initializers::PipelineVertexInputStateCreateInfo();
+  info.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, resolve.pipeline, info));
+}
+
+void Reignite::VisibilityBuffer::addSkybox(PipelineCreateInfo info) {
+
+  assert(skyboxPipeline == VK_NULL_HANDLE);
+
+  info.blendAttachmentStates = { vk::initializers::PipelineColorBlendAttachmentState(0xf, VK_FALSE) };
+  info.renderPass = shaded->renderPass;
+  info.pipelineCache = pipelineCache;
+
+  VK_CHECK(CreateGraphicsPipeline(device, skyboxPipeline, info));
+}
+
+void Reignite::VisibilityBuffer::writeDescriptors(const VkDescriptorBufferInfo& view,
+  const VkDescriptorBufferInfo& shadowLights, const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters) {
+
+  VkDescriptorImageInfo ids = vk::initializers::DescriptorImageInfo(visibility->sampler,
+    visibility->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kResolveBinding_Visibility, &ids),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kResolveBinding_Draws, &draws.descriptor),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kResolveBinding_View, &view),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kResolveBinding_ShadowLights, &shadowLights),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kResolveBinding_ShadowMap, &shadowMap),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kResolveBinding_PointLights, &clusters.lightsDescriptor()),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kResolveBinding_Clusters, &clusters.clustersDescriptor()),
+    vk::initializers::WriteDescriptorSet(resolveSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kResolveBinding_ClusterParams, &clusters.paramsDescriptor())
+  };
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+}
+
+bool Reignite::VisibilityBuffer::updateGeometry(const std::vector<u32>& handles,
+  const std::vector<const GeometryResource*>& geometries, VkCommandBuffer cmd, vk::DescriptorAllocator& descriptors,
+  std::vector<vk::Buffer>& replaced, VkDescriptorSet& replacedSet) {
+
+  assert(handles.size() == geometries.size());
+
+  // Generations tell a reloaded slot apart, unlike the buffer handles
+  if (handles == pooled)
+    return false;
+
+  // Frames in flight still read the old pool, the caller retires it
+  if (!pooled.empty()) {
+    replaced.push_back(vertexPool);
+    replaced.push_back(indexPool);
+    vertexPool = vk::Buffer();
+    indexPool = vk::Buffer();
+  }
+  pooled.clear();
+  ranges.clear();
+
+  if (geometries.empty())
+    return true;
+
+  VkDeviceSize vertexBytes = 0;
+  VkDeviceSize indexBytes = 0;
+  for (const GeometryResource* geometry : geometries) {
+    vertexBytes += (VkDeviceSize)geometry->vertexSize * sizeof(Vertex);
+    indexBytes += (VkDeviceSize)geometry->indicesSize * sizeof(u32);
+  }
+
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBytes, &vertexPool));
+  VK_CHECK(vulkanState->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBytes, &indexPool));
+
+  // Every geometry back to back, indices stay relative to their geometry
+  PoolRange range = { 0, 0 };
+  for (const GeometryResource* geometry : geometries) {
+
+    ranges.push_back(range);
+
+    VkBufferCopy vertexCopy = { 0, (VkDeviceSize)range.vertexOffset * sizeof(Vertex), (VkDeviceSize)geometry->vertexSize * sizeof(Vertex) };
+    vkCmdCopyBuffer(cmd, geometry->vertexBuffer.buffer, vertexPool.buffer, 1, &vertexCopy);
+
+    VkBufferCopy indexCopy = { 0, (VkDeviceSize)range.firstIndex * sizeof(u32), (VkDeviceSize)geometry->indicesSize * sizeof(u32) };
+    vkCmdCopyBuffer(cmd, geometry->indexBuffer.buffer, indexPool.buffer, 1, &indexCopy);
+
+    range.vertexOffset += geometry->vertexSize;
+    range.firstIndex += geometry->indicesSize;
+  }
+
+  std::array<VkBufferMemoryBarrier, 2> barriers = {};
+  const std::array<VkBuffer, 2> pools = { vertexPool.buffer, indexPool.buffer };
+  for (u32 i = 0; i < (u32)barriers.size(); ++i) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].buffer = pools[i];
+    barriers[i].offset = 0;
+    barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+    0, NULL, static_cast<u32>(barriers.size()), barriers.data(), 0, NULL);
+
+  pooled = handles;
+
+  // The resolve set of the frames in flight keeps pointing at the old pool,
+  // the new one starts as a copy of it with the pool bindings replaced
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  if (!spareResolveSets.empty()) {
+    set = spareResolveSets.back();
+    spareResolveSets.pop_back();
+  }
+  else {
+    VK_CHECK(descriptors.allocate(resolveSetLayout, &set));
+  }
+
+  std::vector<VkCopyDescriptorSet> copies;
+  for (u32 binding = 0; binding <= kResolveBinding_ClusterParams; ++binding) {
+    if (binding == kResolveBinding_Vertices || binding == kResolveBinding_Indices)
+      continue;
+
+    VkCopyDescriptorSet copy = {};
+    copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+    copy.srcSet = resolveSet;
+    copy.srcBinding = binding;
+    copy.dstSet = set;
+    copy.dstBinding = binding;
+    copy.descriptorCount = 1;
+    copies.push_back(copy);
+  }
+
+  std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = {
+    vk::initializers::WriteDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kResolveBinding_Vertices, &vertexPool.descriptor),
+    vk::initializers::WriteDescriptorSet(set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kResolveBinding_Indices, &indexPool.descriptor)
+  };
+
+  vkUpdateDescriptorSets(device, static_cast<u32>(writeDescriptorSets.size()), writeDescriptorSets.data(),
+    static_cast<u32>(copies.size()), copies.data());
+
+  replacedSet = resolveSet;
+  resolveSet = set;
+
+  RI_INFO("Visibility buffer pool: {} geometries, {} vertices, {} indices",
+    (u32)geometries.size(), range.vertexOffset, range.firstIndex);
+
+  return true;
+}
+
+void Reignite::VisibilityBuffer::recycleResolveSet(VkDescriptorSet set) {
+
+  spareResolveSets.push_back(set);
+}
+
+void Reignite::VisibilityBuffer::setDraw(u32 draw, u32 geometry, u32 material) {
+
+  assert(draw < drawCount && geometry < ranges.size());
+
+  DrawEntry* entry = &entries[draw];
+  entry->firstIndex = ranges[geometry].firstIndex;
+  entry->vertexOffset = ranges[geometry].vertexOffset;
+  entry->material = material;
+}
+
+void Reignite::VisibilityBuffer::setTransform(u32 draw, const mat4f& model) {
+
+  assert(draw < drawCount);
+
+  // The normal matrix once per draw instead of per pixel
+  DrawEntry* entry = &entries[draw];
+  entry->model = model;
+  entry->normal = mat4f(glm::transpose(glm::inverse(glm::mat3(model))));
+}
+
+void Reignite::VisibilityBuffer::uploadDraws(vk::UploadRing& uploads) {
+
+  if (drawCount > 0)
+    uploads.write(draws.buffer, 0, entries.data(), (VkDeviceSize)drawCount * sizeof(DrawEntry));
+}
+
+void Reignite::VisibilityBuffer::beginVisibilityPass(VkCommandBuffer cmd, VkDescriptorSet view) {
+
+  std::array<VkClearValue, 2> clearValues = {};
+  clearValues[0].color.uint32[0] = 0;
+  clearValues[1].depthStencil = { 1.0f, 0 };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = visibility->renderPass;
+  renderPassBeginInfo.framebuffer = visibility->framebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = static_cast<u32>(clearValues.size());
+  renderPassBeginInfo.pClearValues = clearValues.data();
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, visibilityPipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, visibilityPipelineLayout, 0, 1, &view, 0, NULL);
+}
+
+void Reignite::VisibilityBuffer::bindDraw(VkCommandBuffer cmd, u32 draw, VkDescriptorSet model) {
+
+  assert(draw < drawCount);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, visibilityPipelineLayout, 1, 1, &model, 0, NULL);
+  vkCmdPushConstants(cmd, visibilityPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(u32), &draw);
+}
+
+void Reignite::VisibilityBuffer::endVisibilityPass(VkCommandBuffer cmd) {
+
+  vkCmdEndRenderPass(cmd);
+
+  // Ids to the resolve fragments
+  VkImageMemoryBarrier idsBarrier = vk::initializers::ImageMemoryBarrier();
+  idsBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  idsBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  idsBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  idsBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  idsBarrier.image = visibility->attachments[0].image;
+  idsBarrier.subresourceRange = visibility->attachments[0].subresourceRange;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &idsBarrier);
+}
+
+void Reignite::VisibilityBuffer::beginResolvePass(VkCommandBuffer cmd) {
+
+  VkClearValue clearValue;
+  clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+
+  VkRenderPassBeginInfo renderPassBeginInfo = vk::initializers::RenderPassBeginInfo();
+  renderPassBeginInfo.renderPass = shaded->renderPass;
+  renderPassBeginInfo.framebuffer = shaded->framebuffer;
+  renderPassBeginInfo.renderArea.extent = area;
+  renderPassBeginInfo.clearValueCount = 1;
+  renderPassBeginInfo.pClearValues = &clearValue;
+
+  vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = vk::initializers::Viewport((float)area.width, (float)area.height, 0.0f, 1.0f);
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+  VkRect2D scissor = vk::initializers::Rect2D(area.width, area.height, 0, 0);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void Reignite::VisibilityBuffer::bindSkybox(VkCommandBuffer cmd) {
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipeline);
+}
+
+void Reignite::VisibilityBuffer::recordResolve(VkCommandBuffer cmd, u32 material, VkDescriptorSet materialSet) {
+
+  // Without a pool there is nothing drawn to resolve
+  if (pooled.empty())
+    return;
+
+  const MaterialPipeline& resolve = materials[material];
+  std::array<VkDescriptorSet, 2> sets = { materialSet, resolveSet };
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, resolve.pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, resolve.layout, 0, static_cast<u32>(sets.size()), sets.data(), 0, NULL);
+  vkCmdPushConstants(cmd, resolve.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(u32), &material);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
+
+void Reignite::VisibilityBuffer::endResolvePass(VkCommandBuffer cmd) {
+
+  vkCmdEndRenderPass(cmd);
+
+  // Color to the composite of the swapchain pass
+  VkImageMemoryBarrier colorBarrier = vk::initializers::ImageMemoryBarrier();
+  colorBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  colorBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  colorBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  colorBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  colorBarrier.image = shaded->attachments[0].image;
+  colorBarrier.subresourceRange = shaded->attachments[0].subresourceRange;
+
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    0, 0, nullptr, 0, nullptr, 1, &colorBarrier);
+}
+
+void Reignite::VisibilityBuffer::recordComposite(VkCommandBuffer cmd) {
+
+  const vec2f size((float)area.width, (float)area.height);
+
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &compositeSet, 0, NULL);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+  vkCmdPushConstants(cmd, compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(size), &size);
+  vkCmdDraw(cmd, 6, 1, 0, 0);
+}
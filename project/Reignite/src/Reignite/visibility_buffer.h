@@ -0,0 +1,175 @@
+#ifndef _RI_VISIBILITY_BUFFER_
+#define _RI_VISIBILITY_BUFFER_ 1
+
+#include <string>
+#include <vector>
+
+#include "basic_types.h"
+
+#include "Vulkan/vulkan_impl.h"
+#include "Vulkan/vulkan_buffer.h"
+
+
+namespace vk {
+  class VulkanState;
+  class DescriptorAllocator;
+  class Framebuffer;
+  class UploadRing;
+}
+
+namespace Reignite {
+
+  class LightClusters;
+  struct GeometryResource;
+
+  // Visibility buffer shading. The scene is drawn once writing only a
+  // 32 bit id per pixel, its draw and triangle, whatever its material. A
+  // full screen pass per material then fetches the triangle of every pixel
+  // from a pool of the drawn geometry, interpolates its attributes with
+  // analytic barycentrics, samples the material with their gradients and
+  // shades with the clustered lights. Overdraw only costs the id write and
+  // each pixel is shaded once. The composition copies the result.
+  class VisibilityBuffer {
+   public:
+
+    // Draw + 1 in the high bits, 0 is the sky, then the triangle
+    static const u32 kTriangleBits = 22;
+    static const u32 kMaxDraws = (1u << (32 - kTriangleBits)) - 1;
+
+    // Set layout of visibility_resolve.frag, after the material set
+    enum ResolveBinding {
+      kResolveBinding_Visibility = 0,
+      kResolveBinding_Vertices,
+      kResolveBinding_Indices,
+      kResolveBinding_Draws,
+      kResolveBinding_View,
+      kResolveBinding_ShadowLights,
+      kResolveBinding_ShadowMap,
+      kResolveBinding_PointLights,
+      kResolveBinding_Clusters,
+      kResolveBinding_ClusterParams
+    };
+
+    // Targets of width x height and a draw table of maxDraws entries. The
+    // visibility pass binds the view then the model sets, the composite
+    // pipeline draws in renderPass.
+    void create(vk::VulkanState* vulkanState, VkPipelineCache pipelineCache, VkRenderPass renderPass,
+      vk::DescriptorAllocator& descriptors, VkDescriptorSetLayout viewLayout, VkDescriptorSetLayout modelLayout,
+      u32 width, u32 height, u32 maxDraws);
+    void destroy();
+
+    // Targets for a new size, writeDescriptors has to follow
+    void resize(u32 width, u32 height);
+
+    // Pixels drawn from the top left of the targets, the whole of them after
+    // create or resize. Recorded commands have to be rebuilt.
+    void setRenderArea(u32 width, u32 height);
+
+    // Resolve pipeline of a material whose set 0 binds its textures like
+    // mrt.frag, or like mrt_vt.frag for visibility_resolve_vt.frag
+    void addMaterial(u32 material, VkDescriptorSetLayout materialLayout,
+      const std::string& resolveShader = "visibility_resolve.frag");
+
+    // Pipeline drawn behind the resolve, from the info of its own
+    void addSkybox(PipelineCreateInfo info);
+
+    void writeDescriptors(const VkDescriptorBufferInfo& view, const VkDescriptorBufferInfo& shadowLights,
+      const VkDescriptorImageInfo& shadowMap, const LightClusters& clusters);
+
+    // Pools the geometries of handles when they are not the pooled ones, the
+    // copies are recorded into cmd. The pool and resolve set they replace go
+    // to replaced and replacedSet for the caller to retire once no frame in
+    // flight uses them, the set back through recycleResolveSet. Draws refer
+    // to the geometries by their index in the list.
+    bool updateGeometry(const std::vector<u32>& handles, const std::vector<const GeometryResource*>& geometries,
+      VkCommandBuffer cmd, vk::DescriptorAllocator& descriptors, std::vector<vk::Buffer>& replaced,
+      VkDescriptorSet& replacedSet);
+    void recycleResolveSet(VkDescriptorSet set);
+
+    // Set on the host copy of the draw table, uploadDraws stages it for the frame
+    void setDraw(u32 draw, u32 geometry, u32 material);
+    void setTransform(u32 draw, const mat4f& model);
+    void uploadDraws(vk::UploadRing& uploads);
+
+    // Visibility pass, the caller binds the geometry and draws
+    void beginVisibilityPass(VkCommandBuffer cmd, VkDescriptorSet view);
+    void bindDraw(VkCommandBuffer cmd, u32 draw, VkDescriptorSet model);
+    void endVisibilityPass(VkCommandBuffer cmd);
+
+    // Resolve pass, the skybox is bound here and drawn by the caller
+    void beginResolvePass(VkCommandBuffer cmd);
+    void bindSkybox(VkCommandBuffer cmd);
+    void recordResolve(VkCommandBuffer cmd, u32 material, VkDescriptorSet materialSet);
+    void endResolvePass(VkCommandBuffer cmd);
+
+    // Full screen draw of the shaded target inside the swapchain render pass
+    void recordComposite(VkCommandBuffer cmd);
+
+    bool hasMaterial(u32 material) const { return material < materials.size() && materials[material].pipeline != VK_NULL_HANDLE; }
+    bool hasGeometry() const { return !pooled.empty(); }
+    u32 maxDraws() const { return drawCount; }
+
+   private:
+
+    struct MaterialPipeline {
+      VkPipelineLayout layout = VK_NULL_HANDLE;
+      VkPipeline pipeline = VK_NULL_HANDLE;
+    };
+
+    // Where a geometry starts in the pool
+    struct PoolRange {
+      u32 firstIndex;
+      u32 vertexOffset;
+    };
+
+    // std430 layout of the draw table
+    struct DrawEntry {
+      mat4f model;
+      mat4f normal;
+      u32 firstIndex;
+      u32 vertexOffset;
+      u32 material;
+      u32 padding;
+    };
+
+    void createTargets(u32 width, u32 height);
+    void destroyTargets();
+    void writeCompositeDescriptor();
+
+    vk::VulkanState* vulkanState = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    // Ids and depth, then the shaded color
+    vk::Framebuffer* visibility = nullptr;
+    vk::Framebuffer* shaded = nullptr;
+    VkExtent2D area = {};
+
+    // Vertices and indices of the pooled geometries, by their handles
+    vk::Buffer vertexPool;
+    vk::Buffer indexPool;
+    std::vector<u32> pooled;
+    std::vector<PoolRange> ranges;
+
+    vk::Buffer draws;
+    std::vector<DrawEntry> entries;
+    u32 drawCount = 0;
+
+    VkPipelineLayout visibilityPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline visibilityPipeline = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout resolveSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet resolveSet = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> spareResolveSets;
+    std::vector<MaterialPipeline> materials;
+    VkPipeline skyboxPipeline = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout compositePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline compositePipeline = VK_NULL_HANDLE;
+    VkDescriptorSet compositeSet = VK_NULL_HANDLE;
+  };
+
+} // end of Reignite namespace
+
+#endif // _RI_VISIBILITY_BUFFER_
@@ -0,0 +1,112 @@
+#version 450
+
+// Lists the point lights touching each cluster of the view frustum. One
+// invocation per cluster, a group is a depth slice and loads the lights in
+// batches through shared memory.
+
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define MAX_CLUSTER_LIGHTS 128
+#define BATCH_SIZE (CLUSTERS_X * CLUSTERS_Y)
+
+layout (local_size_x = CLUSTERS_X, local_size_y = CLUSTERS_Y, local_size_z = 1) in;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (binding = 0) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 depth;   // near, far, slice scale, slice bias
+	uvec4 grid;   // clusters x, y, z, light count
+} params;
+
+layout (std430, binding = 1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+layout (std430, binding = 2) writeonly buffer Clusters {
+	uint lightCount[CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z];
+	uint lightIndex[];
+} clusters;
+
+// Most lights touching a cluster this frame: clusters, tiled deferred, forward+
+layout (std430, binding = 3) buffer Peaks {
+	uint peaks[4];
+} overflow;
+
+shared vec4 batch[BATCH_SIZE]; // view space center, radius
+
+// View space point at distance depth along the ray through ndc
+vec3 viewPoint(vec2 ndc, float depth) {
+
+	vec4 p = params.inverseProjection * vec4(ndc, 1.0, 1.0);
+	p.xyz /= p.w;
+	return p.xyz * (depth / -p.z);
+}
+
+float sliceDepth(uint slice) {
+
+	return params.depth.x * pow(params.depth.y / params.depth.x, float(slice) / float(CLUSTERS_Z));
+}
+
+void main() {
+
+	uvec3 cluster = gl_GlobalInvocationID;
+	uint index = (cluster.z * CLUSTERS_Y + cluster.y) * CLUSTERS_X + cluster.x;
+
+	// Bounding box of the cluster in view space, the corners of its near and
+	// far faces along the two diagonal rays give every extreme
+	vec2 ndcMin = vec2(cluster.xy) / vec2(CLUSTERS_X, CLUSTERS_Y) * 2.0 - 1.0;
+	vec2 ndcMax = vec2(cluster.xy + 1) / vec2(CLUSTERS_X, CLUSTERS_Y) * 2.0 - 1.0;
+	float near = sliceDepth(cluster.z);
+	float far = sliceDepth(cluster.z + 1);
+
+	vec3 a = viewPoint(ndcMin, near);
+	vec3 b = viewPoint(ndcMax, near);
+	vec3 c = viewPoint(ndcMin, far);
+	vec3 d = viewPoint(ndcMax, far);
+	vec3 boxMin = min(min(a, b), min(c, d));
+	vec3 boxMax = max(max(a, b), max(c, d));
+
+	uint lightTotal = params.grid.w;
+	uint first = index * MAX_CLUSTER_LIGHTS;
+	uint count = 0;
+	uint touching = 0;
+
+	for (uint start = 0; start < lightTotal; start += BATCH_SIZE) {
+
+		uint i = start + gl_LocalInvocationIndex;
+		if (i < lightTotal) {
+
+			// Lights live in G-buffer space, y is flipped there
+			vec4 light = lights[i].position;
+			batch[gl_LocalInvocationIndex] = vec4((params.view * vec4(light.x, -light.y, light.z, 1.0)).xyz, light.w);
+		}
+
+		barrier();
+
+		uint batchCount = min(uint(BATCH_SIZE), lightTotal - start);
+		for (uint j = 0; j < batchCount; ++j) {
+
+			vec3 center = batch[j].xyz;
+			vec3 delta = clamp(center, boxMin, boxMax) - center;
+			if (dot(delta, delta) <= batch[j].w * batch[j].w) {
+
+				if (count < MAX_CLUSTER_LIGHTS)
+					clusters.lightIndex[first + count++] = start + j;
+				++touching;
+			}
+		}
+
+		barrier();
+	}
+
+	clusters.lightCount[index] = count;
+
+	// Lights past the list are not shaded, the host warns about them
+	atomicMax(overflow.peaks[0], touching);
+}
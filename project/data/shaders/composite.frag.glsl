@@ -0,0 +1,52 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerColor;
+
+// Texels rendered this frame, from the top left of the target
+layout (push_constant) uniform Area {
+	vec2 size;
+} area;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Catmull-Rom weights of the four texels around a sample, t is how far
+// past the second one it is
+vec4 catmullRom(float t) {
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return vec4(
+		-0.5 * t3 + t2 - 0.5 * t,
+		1.5 * t3 - 2.5 * t2 + 1.0,
+		-1.5 * t3 + 2.0 * t2 + 0.5 * t,
+		0.5 * t3 - 0.5 * t2);
+}
+
+void main() {
+
+	// With dynamic resolution the color is smaller than the screen, a
+	// bicubic keeps the edges sharper than a bilinear would. At the screen
+	// size every sample lands on a texel center and copies it. Texels past
+	// the rendered area hold an older frame and are never read.
+	ivec2 size = ivec2(area.size);
+	vec2 texel = inUV * vec2(size) - 0.5;
+	ivec2 base = ivec2(floor(texel));
+	vec2 f = texel - vec2(base);
+
+	vec4 wx = catmullRom(f.x);
+	vec4 wy = catmullRom(f.y);
+
+	vec4 color = vec4(0.0);
+	for (int y = 0; y < 4; ++y) {
+		vec4 row = vec4(0.0);
+		for (int x = 0; x < 4; ++x) {
+			ivec2 coord = clamp(base + ivec2(x - 1, y - 1), ivec2(0), size - 1);
+			row += texelFetch(samplerColor, coord, 0) * wx[x];
+		}
+		color += row * wy[y];
+	}
+
+	// The negative lobes ring a little past the neighbours
+	outFragColor = clamp(color, 0.0, 1.0);
+}
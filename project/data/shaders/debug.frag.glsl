@@ -1,23 +1,55 @@
 #version 450
 
-layout (binding = 0) uniform sampler2D samplerPosition;
+layout (binding = 0) uniform sampler2D samplerDepth;
 layout (binding = 1) uniform sampler2D samplerNormal;
 layout (binding = 2) uniform sampler2D samplerAlbedo;
-layout (binding = 3) uniform sampler2D samplerRoughness;
-layout (binding = 4) uniform sampler2D samplerMetallic;
+layout (binding = 3) uniform sampler2D samplerMaterial;
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+layout (binding = 4) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+	vec4 renderArea; // pixels rendered, their fraction of the targets
+} ubo;
 
 layout (location = 0) in vec3 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
+vec3 decodeNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() 
 {
+	// Only the top left of the targets is rendered with dynamic resolution
+	vec2 uv = inUV.st * ubo.renderArea.zw;
+
+	// Position rebuilt from the depth, as the composition does
+	vec4 position = ubo.inverseViewProjection * vec4(inUV.st * 2.0 - 1.0, texture(samplerDepth, uv).r, 1.0);
+	position /= position.w;
+	position.y = -position.y;
+
 	vec3 components[3];
-	components[0] = texture(samplerPosition, inUV.st).rgb;  
-	components[1] = texture(samplerNormal, inUV.st).rgb;  
-	components[2] = texture(samplerAlbedo, inUV.st).rgb;  
+	components[0] = position.xyz;  
+	components[1] = decodeNormal(texture(samplerNormal, uv).rg);  
+	components[2] = texture(samplerAlbedo, uv).rgb;  
 	// Uncomment to display specular component
-	//components[2] = vec3(texture(samplerAlbedo, inUV.st).a);  
+	//components[2] = vec3(texture(samplerAlbedo, uv).a);  
 	
 	// Select component depending on z coordinate of quad
 	/*highp*/ int index = int(inUV.z);
@@ -1,11 +1,6 @@
 #version 450
 
-layout (binding = 0) uniform sampler2D samplerPosition;
-layout (binding = 1) uniform sampler2D samplerNormal;
-layout (binding = 2) uniform sampler2D samplerAlbedo;
-layout (binding = 3) uniform sampler2D samplerRoughness;
-layout (binding = 4) uniform sampler2D samplerMetallic;
-layout (binding = 6) uniform sampler2DArray samplerDepth;
+layout (binding = 5) uniform sampler2DArray samplerDepth;
 
 layout (location = 0) in vec3 inUV;
 
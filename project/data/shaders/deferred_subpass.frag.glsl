@@ -0,0 +1,105 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// deferred_pbr.frag as the second subpass of the G-buffer pass, the
+// targets are read as input attachments at this pixel only.
+
+layout (input_attachment_index = 0, binding = 0, set = 0) uniform subpassInput inputDepth;
+layout (input_attachment_index = 1, binding = 1, set = 0) uniform subpassInput inputNormal;   // octahedral
+layout (input_attachment_index = 2, binding = 2, set = 0) uniform subpassInput inputAlbedo;
+layout (input_attachment_index = 3, binding = 3, set = 0) uniform subpassInput inputMaterial; // roughness, metallic, ao
+
+struct Light {
+	vec4 position;
+  vec4 target;
+	vec4 color;
+	//float radius;
+  mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 4, set = 0) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+  uint numbLights;
+  uint useShadows;
+} ubo;
+
+layout (binding = 5, set = 0) uniform sampler2DArray samplerShadowMap;
+
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define MAX_CLUSTER_LIGHTS 128
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 6, set = 0) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+layout (std430, binding = 7, set = 0) readonly buffer Clusters {
+	uint lightCount[CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z];
+	uint lightIndex[];
+} clusters;
+
+layout (binding = 8, set = 0) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 depth;   // near, far, slice scale, slice bias
+	uvec4 grid;   // clusters x, y, z, light count
+} clusterParams;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+#define POINT_LIGHTS
+
+#include "include/pbr_common.glsl"
+
+uint clusterIndex(vec3 fragPos) {
+
+	// Depth along the view, from the unflipped world position
+	float depth = -(clusterParams.view * vec4(fragPos.x, -fragPos.y, fragPos.z, 1.0)).z;
+	uint slice = uint(clamp(log(max(depth, clusterParams.depth.x)) * clusterParams.depth.z - clusterParams.depth.w, 0.0, float(CLUSTERS_Z - 1)));
+	uvec2 tile = min(uvec2(inUV * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+
+	return (slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x;
+}
+
+void main() {
+
+	// Get G-Buffer values
+	float depth = subpassLoad(inputDepth).r;
+
+	// Nothing was drawn but the sky, it is not lit
+	if (depth >= 1.0) {
+		outFragcolor = vec4(subpassLoad(inputAlbedo).rgb, 1.0);
+		return;
+	}
+
+	vec3 fragPos = worldPosition(inUV, depth);
+	vec3 N = decodeNormal(subpassLoad(inputNormal).rg);
+	vec3 albedo = pow(subpassLoad(inputAlbedo).rgb, vec3(2.2));
+  vec4 surface = subpassLoad(inputMaterial); // roughness, metallic, ao
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos); 	// Viewer to fragment
+	
+  // Only the lights listed for the cluster of this fragment
+  uint cluster = clusterIndex(fragPos);
+  uint clusterLights = clusters.lightCount[cluster];
+
+  vec3 Lo = vec3(0.0);
+  for (uint i = 0; i < clusterLights; ++i)
+    Lo += shadeLight(pointLights[clusters.lightIndex[cluster * MAX_CLUSTER_LIGHTS + i]], fragPos, N, V, albedo, surface.rgb);
+
+  outFragcolor = vec4(composeColor(fragPos, albedo, surface.b, Lo), 1.0);
+}
@@ -0,0 +1,6 @@
+#version 450
+
+// Depth prepass, the depth test is all the work
+
+void main() {
+}
@@ -0,0 +1,96 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Forward+ shading of a textured material, the same lighting as the
+// deferred composition with the lights listed for the screen tile.
+
+layout (binding = 0, set = 0) uniform sampler2D samplerColor;
+layout (binding = 1, set = 0) uniform sampler2D samplerNormalMap;
+layout (binding = 2, set = 0) uniform sampler2D samplerRoughness;
+layout (binding = 3, set = 0) uniform sampler2D samplerMetallic;
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 0, set = 3) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+} ubo;
+
+layout (binding = 1, set = 3) uniform sampler2DArray samplerShadowMap;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 2, set = 3) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+#define MAX_TILE_LIGHTS 128
+
+// Per tile: light count, then MAX_TILE_LIGHTS indices
+layout (std430, binding = 3, set = 3) readonly buffer Tiles {
+	uvec4 grid;   // tiles x, y, tile size, unused
+	uint lists[];
+} tiles;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+#define POINT_LIGHTS
+
+#include "include/pbr_common.glsl"
+
+void main() {
+
+	// Surface, as the G-buffer pass would have written it
+	vec3 fragPos = inWorldPos;
+
+	vec3 N = normalize(inNormal);
+	N.y = -N.y;
+	vec3 T = normalize(inTangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	// Normal maps are two channel (BC5), rebuild z from the unit length
+	vec3 normalMap;
+	normalMap.xy = texture(samplerNormalMap, inUV).xy * 2.0 - vec2(1.0);
+	normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+	N = normalize(TBN * normalMap);
+
+	vec3 albedo = pow(texture(samplerColor, inUV).rgb, vec3(2.2));
+	float roughness = texture(samplerRoughness, inUV).r;
+	float metallic = texture(samplerMetallic, inUV).r;
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	// Only the lights listed for the tile of this fragment
+	uvec2 tile = uvec2(gl_FragCoord.xy) / tiles.grid.z;
+	uint first = (tile.y * tiles.grid.x + tile.x) * (MAX_TILE_LIGHTS + 1);
+	uint lightCount = tiles.lists[first];
+
+	vec3 rma = vec3(roughness, metallic, 1.0);
+
+	vec3 Lo = vec3(0.0);
+	for (uint i = 0; i < lightCount; ++i)
+		Lo += shadeLight(pointLights[tiles.lists[first + 1 + i]], fragPos, N, V, albedo, rma);
+
+	outFragColor = vec4(composeColor(fragPos, albedo, 1.0, Lo), 1.0);
+}
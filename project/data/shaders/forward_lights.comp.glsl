@@ -0,0 +1,140 @@
+#version 450
+
+// Forward+ light lists. A group is a 16x16 tile of the prepass depth: it
+// finds the depth range of the tile and lists the point lights touching the
+// box between its nearest and farthest pixel. Tiles with only sky list none.
+
+#define TILE_SIZE 16
+#define THREAD_COUNT (TILE_SIZE * TILE_SIZE)
+#define MAX_TILE_LIGHTS 128
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE, local_size_z = 1) in;
+
+layout (binding = 0) uniform sampler2D samplerDepth;
+
+layout (binding = 1) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 depth;   // near, far, slice scale, slice bias
+	uvec4 grid;   // clusters x, y, z, light count
+} camera;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 2) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+// Per tile: light count, then MAX_TILE_LIGHTS indices
+layout (std430, binding = 3) writeonly buffer Tiles {
+	uvec4 grid;   // tiles x, y, tile size, unused
+	uint lists[];
+} tiles;
+
+// Pixels rendered, from the top left of the depth
+layout (push_constant) uniform Area {
+	uvec2 size;
+} area;
+
+// Most lights touching a tile this frame: clusters, tiled deferred, forward+
+layout (std430, binding = 4) buffer Peaks {
+	uint peaks[4];
+} overflow;
+
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileLightCount;
+
+// View space point at distance depth along the ray through ndc
+vec3 viewPoint(vec2 ndc, float depth) {
+
+	vec4 p = camera.inverseProjection * vec4(ndc, 1.0, 1.0);
+	p.xyz /= p.w;
+	return p.xyz * (depth / -p.z);
+}
+
+void main() {
+
+	ivec2 size = ivec2(area.size);
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+
+	if (gl_LocalInvocationIndex == 0) {
+		tileMinDepth = 0xffffffffu;
+		tileMaxDepth = 0;
+		tileLightCount = 0;
+	}
+
+	if (gl_GlobalInvocationID.xy == uvec2(0))
+		tiles.grid = uvec4(gl_NumWorkGroups.xy, TILE_SIZE, 0);
+
+	barrier();
+
+	// Depth range of the tile, positive floats sort like their bits
+	if (all(lessThan(pixel, size))) {
+
+		float z = texelFetch(samplerDepth, pixel, 0).r;
+		if (z < 1.0) {
+
+			vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+			vec4 p = camera.inverseProjection * vec4(ndc, z, 1.0);
+			float depth = max(-p.z / p.w, 0.0);
+
+			atomicMin(tileMinDepth, floatBitsToUint(depth));
+			atomicMax(tileMaxDepth, floatBitsToUint(depth));
+		}
+	}
+
+	barrier();
+
+	uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+	uint first = tile * (MAX_TILE_LIGHTS + 1);
+
+	// Only sky in the tile, no light can reach it
+	if (tileMinDepth > tileMaxDepth) {
+
+		if (gl_LocalInvocationIndex == 0)
+			tiles.lists[first] = 0;
+		return;
+	}
+
+	// Bounding box of the tile between its nearest and farthest pixel
+	vec2 tileMin = vec2(gl_WorkGroupID.xy * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+	vec2 tileMax = vec2((gl_WorkGroupID.xy + 1u) * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+	float near = uintBitsToFloat(tileMinDepth);
+	float far = uintBitsToFloat(tileMaxDepth);
+
+	vec3 a = viewPoint(tileMin, near);
+	vec3 b = viewPoint(tileMax, near);
+	vec3 c = viewPoint(tileMin, far);
+	vec3 d = viewPoint(tileMax, far);
+	vec3 boxMin = min(min(a, b), min(c, d));
+	vec3 boxMax = max(max(a, b), max(c, d));
+
+	// Each invocation tests one light per pass
+	uint lightTotal = camera.grid.w;
+	for (uint i = gl_LocalInvocationIndex; i < lightTotal; i += THREAD_COUNT) {
+
+		// Lights live in G-buffer space, y is flipped there
+		vec4 light = pointLights[i].position;
+		vec3 center = (camera.view * vec4(light.x, -light.y, light.z, 1.0)).xyz;
+		vec3 delta = clamp(center, boxMin, boxMax) - center;
+
+		if (dot(delta, delta) <= light.w * light.w) {
+
+			uint slot = atomicAdd(tileLightCount, 1u);
+			if (slot < MAX_TILE_LIGHTS)
+				tiles.lists[first + 1 + slot] = i;
+		}
+	}
+
+	barrier();
+
+	// Lights past the list are not shaded, the host warns about them
+	if (gl_LocalInvocationIndex == 0) {
+		tiles.lists[first] = min(tileLightCount, uint(MAX_TILE_LIGHTS));
+		atomicMax(overflow.peaks[2], tileLightCount);
+	}
+}
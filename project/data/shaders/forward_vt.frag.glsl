@@ -0,0 +1,154 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Forward+ shading of the virtual textured terrain, forward.frag sampling
+// through the page table and reporting the pages it needs.
+
+// Physical page caches, one per layer
+layout (binding = 0, set = 0) uniform sampler2D cacheColor;
+layout (binding = 1, set = 0) uniform sampler2D cacheNormalMap;
+layout (binding = 2, set = 0) uniform sampler2D cacheRoughness;
+layout (binding = 3, set = 0) uniform sampler2D cacheMetallic;
+
+// Per virtual page and mip: cache slot xy, resident mip, valid
+layout (binding = 4, set = 0) uniform usampler2D pageTable;
+
+layout (binding = 5, set = 0) buffer Feedback {
+	uint requests[];
+} feedback;
+
+layout (binding = 6, set = 0) uniform VirtualTexture {
+	vec4 size;      // virtual width, height, page size, page border
+	vec4 cache;     // 1 / cache size, page stride, tail mip, unused
+	uvec4 feedback; // width, scale, sample offset x, y
+} vt;
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 0, set = 3) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+} ubo;
+
+layout (binding = 1, set = 3) uniform sampler2DArray samplerShadowMap;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 2, set = 3) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+#define MAX_TILE_LIGHTS 128
+
+// Per tile: light count, then MAX_TILE_LIGHTS indices
+layout (std430, binding = 3, set = 3) readonly buffer Tiles {
+	uvec4 grid;   // tiles x, y, tile size, unused
+	uint lists[];
+} tiles;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+#define POINT_LIGHTS
+
+#include "include/pbr_common.glsl"
+
+vec2 cacheUV;
+vec2 cacheDx;
+vec2 cacheDy;
+
+void translate() {
+
+	// Mip from the virtual texel footprint, as the hardware would pick it
+	vec2 texel = inUV * vt.size.xy;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float mip = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, vt.cache.z);
+	int level = int(mip);
+
+	vec2 uv = fract(inUV);
+	ivec2 page = ivec2(uv * vt.size.xy / vt.size.z) >> level;
+
+	// One pixel of every feedback block reports its page, the pixel moves each frame
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if (all(equal(pixel % vt.feedback.y, vt.feedback.zw))) {
+		uvec2 block = pixel / vt.feedback.y;
+		feedback.requests[block.y * vt.feedback.x + block.x] =
+			0x80000000u | (uint(level) << 24) | (uint(page.y) << 12) | uint(page.x);
+	}
+
+	// Missing pages resolve to a coarser resident one
+	uvec4 entry = texelFetch(pageTable, page, level);
+	float scale = exp2(-float(entry.z));
+
+	vec2 inPage = fract(uv * vt.size.xy * scale / vt.size.z);
+	vec2 slot = vec2(entry.xy) * vt.cache.y + vt.size.w;
+	cacheUV = (slot + inPage * vt.size.z) * vt.cache.x;
+
+	// Gradients of the resident mip, unaffected by the wrap at page edges
+	cacheDx = dx * scale * vt.cache.x;
+	cacheDy = dy * scale * vt.cache.x;
+}
+
+vec4 sampleCache(sampler2D cache) {
+
+	return textureGrad(cache, cacheUV, cacheDx, cacheDy);
+}
+
+void main() {
+
+	translate();
+
+	// Surface, as the G-buffer pass would have written it
+	vec3 fragPos = inWorldPos;
+
+	vec3 N = normalize(inNormal);
+	N.y = -N.y;
+	vec3 T = normalize(inTangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	// Normal maps are two channel, rebuild z from the unit length
+	vec3 normalMap;
+	normalMap.xy = sampleCache(cacheNormalMap).xy * 2.0 - vec2(1.0);
+	normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+	N = normalize(TBN * normalMap);
+
+	vec3 albedo = pow(sampleCache(cacheColor).rgb, vec3(2.2));
+	float roughness = sampleCache(cacheRoughness).r;
+	float metallic = sampleCache(cacheMetallic).r;
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	// Only the lights listed for the tile of this fragment
+	uvec2 tile = uvec2(gl_FragCoord.xy) / tiles.grid.z;
+	uint first = (tile.y * tiles.grid.x + tile.x) * (MAX_TILE_LIGHTS + 1);
+	uint lightCount = tiles.lists[first];
+
+	vec3 rma = vec3(roughness, metallic, 1.0);
+
+	vec3 Lo = vec3(0.0);
+	for (uint i = 0; i < lightCount; ++i)
+		Lo += shadeLight(pointLights[tiles.lists[first + 1 + i]], fragPos, N, V, albedo, rma);
+
+	outFragColor = vec4(composeColor(fragPos, albedo, 1.0, Lo), 1.0);
+}
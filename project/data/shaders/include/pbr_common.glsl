@@ -0,0 +1,160 @@
+// Lighting helpers of the PBR shaders, included after their bindings. They
+// read the lights block as ubo; the shadow helpers are there when the shader
+// defines SHADOW_FACTOR and AMBIENT_LIGHT and declares samplerShadowMap,
+// shadeLight when it defines POINT_LIGHTS and declares PointLight.
+
+const float PI = 3.14159265359;
+
+#ifdef SHADOW_FACTOR
+
+float textureProj(vec4 P, float layer, vec2 offset) {
+
+	float shadow = 1.0;
+	vec4 shadowCoord = P / P.w;
+	shadowCoord.st = shadowCoord.st * 0.5 + 0.5;
+
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) {
+
+		// The shadow map has a single level, which also suits compute
+		float dist = textureLod(samplerShadowMap, vec3(shadowCoord.st + offset, layer), 0.0).r;
+		if (shadowCoord.w > 0.0 && dist < shadowCoord.z) {
+
+			shadow = SHADOW_FACTOR;
+		}
+	}
+
+	return shadow;
+}
+
+float filterPCF(vec4 sc, float layer) {
+
+	ivec2 texDim = textureSize(samplerShadowMap, 0).xy;
+	float scale = 1.5;
+	float dx = scale * 1.0 / float(texDim.x);
+	float dy = scale * 1.0 / float(texDim.y);
+
+	float shadowFactor = 0.0;
+	int count = 0;
+	int range = 1;
+
+	for (int x = -range; x <= range; x++) {
+
+		for (int y = -range; y <= range; y++) {
+
+			shadowFactor += textureProj(sc, layer, vec2(dx*x, dy*y));
+			count++;
+		}
+	}
+
+	return shadowFactor / count;
+}
+
+// Ambient plus the lights summed at P, tonemapped, then darkened by the
+// shadow casting lights
+vec3 composeColor(vec3 P, vec3 albedo, float ao, vec3 Lo) {
+
+	vec3 color = vec3(AMBIENT_LIGHT) * albedo * ao + Lo;
+
+	color = color / (color + vec3(1.0));
+	color = pow(color, vec3(1.0 / 2.2));
+
+	if (ubo.useShadows > 0) {
+
+		for (uint i = 0; i < ubo.numbLights; ++i) {
+
+			vec4 shadowClip = ubo.lights[i].view * vec4(P, 1.0);
+			color *= filterPCF(shadowClip, float(i));
+		}
+	}
+
+	return color;
+}
+
+#endif
+
+// Normal distribution
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+
+	float NdotH = max(dot(N, H), 0.0);
+	float NdotH2 = NdotH * NdotH;
+
+	float denom = (NdotH2 * (alpha2 - 1.0) + 1.0);
+	return alpha2 / (PI * denom * denom);
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+
+	float r = (roughness + 1.0);
+	float k = (r * r) / 8.0;
+
+	return NdotV / (NdotV * (1.0 - k) + k);
+}
+
+// Geometric shadowing
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+
+	float NdotV = max(dot(N, V), 0.0);
+	float NdotL = max(dot(N, L), 0.0);
+
+	return GeometrySchlickGGX(NdotL, roughness) * GeometrySchlickGGX(NdotV, roughness);
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0) {
+
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+#ifdef POINT_LIGHTS
+
+// Light reflected towards V by the surface at P, rma holds its roughness,
+// metallic and ambient occlusion
+vec3 shadeLight(PointLight light, vec3 P, vec3 N, vec3 V, vec3 albedo, vec3 rma) {
+
+	float roughness = rma.r;
+	float metallic = rma.g;
+	vec3 F0 = mix(vec3(0.04), albedo, metallic);
+
+	vec3 L = normalize(light.position.xyz - P);
+	vec3 H = normalize(V + L);
+
+	// Inverse square falloff, windowed to reach zero at the radius
+	float dist = length(light.position.xyz - P);
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	float attenuation = window * window / (dist * dist);
+	vec3 radiance = light.color.xyz * attenuation;
+
+	float NDF = DistributionGGX(N, H, roughness);     // Normal distribution (of the microfacets)
+	float G = GeometrySmith(N, V, L, roughness);      // Geometric shadowing term (microfacets shadowing)
+	vec3 F = FresnelSchlick(max(dot(H, V), 0.0), F0); // Reflectance depending on the angle of incidence
+
+	vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+
+	float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0);
+	vec3 specular = NDF * G * F / max(denominator, 0.001) * 3.0;
+
+	float NdotL = max(dot(N, L), 0.0);
+	return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+#endif
+
+// Octahedral G-buffer normal
+vec3 decodeNormal(vec2 e) {
+
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// G-buffer space position of the pixel at uv with the given depth
+vec3 worldPosition(vec2 uv, float depth) {
+
+	vec4 p = ubo.inverseViewProjection * vec4(uv * 2.0 - 1.0, depth, 1.0);
+	p /= p.w;
+	return vec3(p.x, -p.y, p.z);
+}
@@ -0,0 +1,283 @@
+// Body of visibility_resolve.frag and visibility_resolve_vt.frag. With
+// VIRTUAL_TEXTURE defined the material set is the one of mrt_vt.frag and the
+// samplers are its page caches.
+
+layout (binding = 0, set = 0) uniform sampler2D samplerColor;
+layout (binding = 1, set = 0) uniform sampler2D samplerNormalMap;
+layout (binding = 2, set = 0) uniform sampler2D samplerRoughness;
+layout (binding = 3, set = 0) uniform sampler2D samplerMetallic;
+
+#ifdef VIRTUAL_TEXTURE
+
+// Per virtual page and mip: cache slot xy, resident mip, valid
+layout (binding = 4, set = 0) uniform usampler2D pageTable;
+
+layout (binding = 5, set = 0) buffer Feedback {
+	uint requests[];
+} feedback;
+
+layout (binding = 6, set = 0) uniform VirtualTexture {
+	vec4 size;      // virtual width, height, page size, page border
+	vec4 cache;     // 1 / cache size, page stride, tail mip, unused
+	uvec4 feedback; // width, scale, sample offset x, y
+} vt;
+
+#endif
+
+#define TRIANGLE_BITS 22
+#define VERTEX_FLOATS 14
+
+layout (binding = 0, set = 1) uniform usampler2D samplerVisibility;
+
+layout (std430, binding = 1, set = 1) readonly buffer Vertices {
+	float vertices[];
+};
+
+layout (std430, binding = 2, set = 1) readonly buffer Indices {
+	uint indices[];
+};
+
+struct Draw {
+	mat4 model;
+	mat4 normal;
+	uvec4 geometry; // first index, vertex offset, material
+};
+
+layout (std430, binding = 3, set = 1) readonly buffer Draws {
+	Draw draws[];
+};
+
+layout (binding = 4, set = 1) uniform UBOView {
+	mat4 projection;
+	mat4 view;
+} view;
+
+struct Light {
+	vec4 position;
+  vec4 target;
+	vec4 color;
+	//float radius;
+  mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 5, set = 1) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+  uint numbLights;
+  uint useShadows;
+  vec4 renderArea; // pixels rendered, their fraction of the targets
+} ubo;
+
+layout (binding = 6, set = 1) uniform sampler2DArray samplerShadowMap;
+
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define MAX_CLUSTER_LIGHTS 128
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 7, set = 1) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+layout (std430, binding = 8, set = 1) readonly buffer Clusters {
+	uint lightCount[CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z];
+	uint lightIndex[];
+} clusters;
+
+layout (binding = 9, set = 1) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 depth;   // near, far, slice scale, slice bias
+	uvec4 grid;   // clusters x, y, z, light count
+} clusterParams;
+
+layout (push_constant) uniform Resolve {
+	uint material;
+} resolve;
+
+layout (location = 0) out vec4 outFragcolor;
+
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+#define POINT_LIGHTS
+
+#include "pbr_common.glsl"
+
+vec3 fetchVec3(uint vertex, uint offset) {
+
+	uint base = vertex * VERTEX_FLOATS + offset;
+	return vec3(vertices[base], vertices[base + 1], vertices[base + 2]);
+}
+
+vec2 fetchVec2(uint vertex, uint offset) {
+
+	uint base = vertex * VERTEX_FLOATS + offset;
+	return vec2(vertices[base], vertices[base + 1]);
+}
+
+// Perspective correct barycentrics of the pixel in the triangle of the clip
+// space positions, and their change one pixel right and one pixel down
+vec3 barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 pixel, vec2 size, out vec3 ddx, out vec3 ddy) {
+
+	vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+	vec2 ndc0 = p0.xy * invW.x;
+	vec2 ndc1 = p1.xy * invW.y;
+	vec2 ndc2 = p2.xy * invW.z;
+
+	// Screen space derivatives of each barycentric over w
+	float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+	ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+	float ddxSum = dot(ddx, vec3(1.0));
+	float ddySum = dot(ddy, vec3(1.0));
+
+	vec2 delta = pixel - ndc0;
+	float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+	float interpW = 1.0 / interpInvW;
+
+	vec3 lambda;
+	lambda.x = interpW * (invW.x + delta.x * ddx.x + delta.y * ddy.x);
+	lambda.y = interpW * (delta.x * ddx.y + delta.y * ddy.y);
+	lambda.z = interpW * (delta.x * ddx.z + delta.y * ddy.z);
+
+	// One pixel is 2 / size in NDC, y grows downwards in both
+	ddx *= 2.0 / size.x;
+	ddy *= 2.0 / size.y;
+	ddxSum *= 2.0 / size.x;
+	ddySum *= 2.0 / size.y;
+
+	float interpWx = 1.0 / (interpInvW + ddxSum);
+	float interpWy = 1.0 / (interpInvW + ddySum);
+	ddx = interpWx * (lambda * interpInvW + ddx) - lambda;
+	ddy = interpWy * (lambda * interpInvW + ddy) - lambda;
+
+	return lambda;
+}
+
+#ifdef VIRTUAL_TEXTURE
+
+// Moves a virtual uv and its gradients into the page caches, like
+// translate() of mrt_vt.frag with the analytic gradients for the
+// derivatives, and reports the page of the pixel
+void translate(inout vec2 uv, inout vec2 dx, inout vec2 dy) {
+
+	vec2 texelDx = dx * vt.size.xy;
+	vec2 texelDy = dy * vt.size.xy;
+	float mip = clamp(floor(0.5 * log2(max(dot(texelDx, texelDx), dot(texelDy, texelDy)))), 0.0, vt.cache.z);
+	int level = int(mip);
+
+	vec2 wrapped = fract(uv);
+	ivec2 page = ivec2(wrapped * vt.size.xy / vt.size.z) >> level;
+
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if (all(equal(pixel % vt.feedback.y, vt.feedback.zw))) {
+		uvec2 block = pixel / vt.feedback.y;
+		feedback.requests[block.y * vt.feedback.x + block.x] =
+			0x80000000u | (uint(level) << 24) | (uint(page.y) << 12) | uint(page.x);
+	}
+
+	uvec4 entry = texelFetch(pageTable, page, level);
+	float scale = exp2(-float(entry.z));
+
+	vec2 inPage = fract(wrapped * vt.size.xy * scale / vt.size.z);
+	vec2 slot = vec2(entry.xy) * vt.cache.y + vt.size.w;
+	uv = (slot + inPage * vt.size.z) * vt.cache.x;
+
+	dx = texelDx * scale * vt.cache.x;
+	dy = texelDy * scale * vt.cache.x;
+}
+
+#endif
+
+uint clusterIndex(vec3 fragPos, vec2 uv) {
+
+	// Depth along the view, from the unflipped world position
+	float depth = -(clusterParams.view * vec4(fragPos.x, -fragPos.y, fragPos.z, 1.0)).z;
+	uint slice = uint(clamp(log(max(depth, clusterParams.depth.x)) * clusterParams.depth.z - clusterParams.depth.w, 0.0, float(CLUSTERS_Z - 1)));
+	uvec2 tile = min(uvec2(uv * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+
+	return (slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x;
+}
+
+void main() {
+
+	// The sky and the draws of other materials are left alone
+	uint id = texelFetch(samplerVisibility, ivec2(gl_FragCoord.xy), 0).r;
+	if (id == 0)
+		discard;
+
+	Draw draw = draws[(id >> TRIANGLE_BITS) - 1];
+	if (draw.geometry.z != resolve.material)
+		discard;
+
+	uint triangle = id & ((1u << TRIANGLE_BITS) - 1);
+	uint first = draw.geometry.x + triangle * 3;
+	uvec3 vertex = uvec3(indices[first], indices[first + 1], indices[first + 2]) + draw.geometry.y;
+
+	// Vertex layout: position 0, normal 3, uv 6, color 8, tangent 11
+	vec3 pos0 = fetchVec3(vertex.x, 0);
+	vec3 pos1 = fetchVec3(vertex.y, 0);
+	vec3 pos2 = fetchVec3(vertex.z, 0);
+
+	mat4 mvp = view.projection * view.view * draw.model;
+	vec2 size = ubo.renderArea.xy;
+	vec2 uv = gl_FragCoord.xy / size;
+
+	vec3 ddx;
+	vec3 ddy;
+	vec3 lambda = barycentrics(mvp * vec4(pos0, 1.0), mvp * vec4(pos1, 1.0),
+		mvp * vec4(pos2, 1.0), uv * 2.0 - 1.0, size, ddx, ddy);
+
+	// Attributes as mrt.vert passes them
+	vec3 fragPos = vec3(draw.model * vec4(mat3(pos0, pos1, pos2) * lambda, 1.0));
+	fragPos.y = -fragPos.y;
+
+	mat3 texcoords = mat3(vec3(fetchVec2(vertex.x, 6), 0.0), vec3(fetchVec2(vertex.y, 6), 0.0), vec3(fetchVec2(vertex.z, 6), 0.0));
+	vec2 texUV = (texcoords * lambda).xy;
+	texUV.t = 1.0 - texUV.t;
+	vec2 dUVdx = (texcoords * ddx).xy * vec2(1.0, -1.0);
+	vec2 dUVdy = (texcoords * ddy).xy * vec2(1.0, -1.0);
+
+#ifdef VIRTUAL_TEXTURE
+	translate(texUV, dUVdx, dUVdy);
+#endif
+
+	mat3 mNormal = mat3(draw.normal);
+	vec3 normal = mNormal * (mat3(normalize(fetchVec3(vertex.x, 3)), normalize(fetchVec3(vertex.y, 3)), normalize(fetchVec3(vertex.z, 3))) * lambda);
+	vec3 tangent = mNormal * (mat3(normalize(fetchVec3(vertex.x, 11)), normalize(fetchVec3(vertex.y, 11)), normalize(fetchVec3(vertex.z, 11))) * lambda);
+
+	// Material as mrt.frag samples it, with the analytic gradients
+	vec3 N = normalize(normal);
+	N.y = -N.y;
+	vec3 T = normalize(tangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	vec3 normalMap;
+	normalMap.xy = textureGrad(samplerNormalMap, texUV, dUVdx, dUVdy).xy * 2.0 - vec2(1.0);
+	normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+	N = normalize(TBN * normalMap);
+
+	vec3 albedo = pow(textureGrad(samplerColor, texUV, dUVdx, dUVdy).rgb, vec3(2.2));
+	float roughness = textureGrad(samplerRoughness, texUV, dUVdx, dUVdy).r;
+	float metallic = textureGrad(samplerMetallic, texUV, dUVdx, dUVdy).r;
+	vec4 surface = vec4(roughness, metallic, 1.0, 0.0);
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos); 	// Viewer to fragment
+	
+  // Only the lights listed for the cluster of this fragment
+  uint cluster = clusterIndex(fragPos, uv);
+  uint clusterLights = clusters.lightCount[cluster];
+
+  vec3 Lo = vec3(0.0);
+  for (uint i = 0; i < clusterLights; ++i)
+    Lo += shadeLight(pointLights[clusters.lightIndex[cluster * MAX_CLUSTER_LIGHTS + i]], fragPos, N, V, albedo, surface.rgb);
+
+  outFragColor = vec4(composeColor(fragPos, albedo, surface.b, Lo), 1.0);
+}
@@ -0,0 +1,60 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Resolve of the light volumes: the summed point lights of the light buffer
+// plus the ambient, tonemapped, then darkened by the shadow casting lights.
+
+layout (binding = 0) uniform sampler2D samplerDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;   // octahedral
+layout (binding = 2) uniform sampler2D samplerAlbedo;
+layout (binding = 3) uniform sampler2D samplerMaterial; // roughness, metallic, ao
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 4) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+	vec4 renderArea; // pixels rendered, their fraction of the targets
+} ubo;
+
+layout (binding = 5) uniform sampler2DArray samplerShadowMap;
+
+layout (binding = 6) uniform sampler2D samplerLights;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+
+#include "include/pbr_common.glsl"
+
+void main() {
+
+	// Only the top left of the targets is rendered with dynamic resolution
+	vec2 uv = inUV * ubo.renderArea.zw;
+	float depth = texture(samplerDepth, uv).r;
+
+	// Nothing was drawn but the sky, it is not lit
+	if (depth >= 1.0) {
+		outFragColor = vec4(texture(samplerAlbedo, uv).rgb, 1.0);
+		return;
+	}
+
+	vec3 fragPos = worldPosition(inUV, depth);
+	vec3 albedo = pow(texture(samplerAlbedo, uv).rgb, vec3(2.2));
+	float ao = texture(samplerMaterial, uv).b;
+
+	outFragColor = vec4(composeColor(fragPos, albedo, ao, texture(samplerLights, uv).rgb), 1.0);
+}
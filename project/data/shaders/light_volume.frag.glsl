@@ -0,0 +1,68 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Light of one point light on the G-buffer pixels inside its sphere, added
+// to the light buffer. Ambient, tonemapping and shadows wait for the resolve.
+
+layout (binding = 0) uniform sampler2D samplerDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;   // octahedral
+layout (binding = 2) uniform sampler2D samplerAlbedo;
+layout (binding = 3) uniform sampler2D samplerMaterial; // roughness, metallic, ao
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+// Lights casting shadows, only the view position and matrix are read here
+layout (binding = 4) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+	vec4 renderArea; // pixels rendered, their fraction of the targets
+} ubo;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 5) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+layout (location = 0) flat in uint inLight;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define POINT_LIGHTS
+
+#include "include/pbr_common.glsl"
+
+void main() {
+
+	// The light buffer and the G-buffer share their size
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	float depth = texelFetch(samplerDepth, pixel, 0).r;
+
+	// Sky, nothing to light
+	if (depth >= 1.0) {
+		outFragColor = vec4(0.0);
+		return;
+	}
+
+	vec3 fragPos = worldPosition(gl_FragCoord.xy / ubo.renderArea.xy, depth);
+	vec3 N = decodeNormal(texelFetch(samplerNormal, pixel, 0).rg);
+	vec3 albedo = pow(texelFetch(samplerAlbedo, pixel, 0).rgb, vec3(2.2));
+	vec4 surface = texelFetch(samplerMaterial, pixel, 0); // roughness, metallic, ao
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	outFragColor = vec4(shadeLight(pointLights[inLight], fragPos, N, V, albedo, surface.rgb), 0.0);
+}
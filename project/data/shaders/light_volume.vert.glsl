@@ -0,0 +1,44 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Bounding sphere of the point light of this instance, the proxy mesh
+// scaled to its radius around its position.
+
+layout (location = 0) in vec3 inPos;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 5) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+layout (binding = 6) uniform UBOView {
+	mat4 projection;
+	mat4 view;
+} view;
+
+// Proxy center, scale to a unit sphere
+layout (push_constant) uniform Proxy {
+	vec4 sphere;
+} proxy;
+
+layout (location = 0) flat out uint outLight;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+void main() {
+
+	vec4 light = pointLights[gl_InstanceIndex].position;
+
+	// Lights live in G-buffer space, y is flipped there
+	vec3 center = vec3(light.x, -light.y, light.z);
+	vec3 offset = (inPos - proxy.sphere.xyz) * proxy.sphere.w * light.w;
+
+	gl_Position = view.projection * view.view * vec4(center + offset, 1.0);
+	outLight = gl_InstanceIndex;
+}
@@ -12,26 +12,34 @@ layout (location = 2) in vec3 inColor;
 layout (location = 3) in vec3 inWorldPos;
 layout (location = 4) in vec3 inTangent;
 
-layout (location = 0) out vec4 outPosition;
-layout (location = 1) out vec4 outNormal;
-layout (location = 2) out vec4 outAlbedo;
-layout (location = 3) out vec4 outRoughness;
-layout (location = 4) out vec4 outMetallic;
+// The position comes back from the depth
+layout (location = 0) out vec2 outNormal;
+layout (location = 1) out vec4 outAlbedo;
+layout (location = 2) out vec4 outMaterial; // roughness, metallic, ao
 
-void main() 
+// Octahedral mapping, the unit sphere folded onto [-1, 1]^2
+vec2 encodeNormal(vec3 n)
 {
-	outPosition = vec4(inWorldPos, 1.0);
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * s;
+}
 
+void main() 
+{
 	// Calculate normal in tangent space
 	vec3 N = normalize(inNormal);
 	N.y = -N.y;
 	vec3 T = normalize(inTangent);
 	vec3 B = cross(N, T);
 	mat3 TBN = mat3(T, B, N);
-	vec3 tnorm = TBN * normalize(texture(samplerNormalMap, inUV).xyz * 2.0 - vec3(1.0));
-	outNormal = vec4(tnorm, 1.0);
+	// Normal maps are two channel (BC5), rebuild z from the unit length
+	vec3 normalMap;
+	normalMap.xy = texture(samplerNormalMap, inUV).xy * 2.0 - vec2(1.0);
+	normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+	vec3 tnorm = TBN * normalMap;
+	outNormal = encodeNormal(normalize(tnorm));
 
 	outAlbedo = texture(samplerColor, inUV);
-	outRoughness = texture(samplerRoughness, inUV);
-	outMetallic = texture(samplerMetallic, inUV);
+	outMaterial = vec4(texture(samplerRoughness, inUV).r, texture(samplerMetallic, inUV).r, 1.0, 0.0);
 }
\ No newline at end of file
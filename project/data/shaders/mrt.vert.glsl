@@ -26,6 +26,9 @@ out gl_PerVertex {
 	vec4 gl_Position;
 };
 
+// The depth prepass draws with this shader too, the G-buffer pass tests EQUAL
+invariant gl_Position;
+
 void main() {
 
 	vec4 tmpPos = inPos; // + view.instancePos[gl_InstanceIndex];
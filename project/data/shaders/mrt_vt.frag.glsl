@@ -0,0 +1,103 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Physical page caches, one per layer
+layout (binding = 0, set = 0) uniform sampler2D cacheColor;
+layout (binding = 1, set = 0) uniform sampler2D cacheNormalMap;
+layout (binding = 2, set = 0) uniform sampler2D cacheRoughness;
+layout (binding = 3, set = 0) uniform sampler2D cacheMetallic;
+
+// Per virtual page and mip: cache slot xy, resident mip, valid
+layout (binding = 4, set = 0) uniform usampler2D pageTable;
+
+layout (binding = 5, set = 0) buffer Feedback {
+	uint requests[];
+} feedback;
+
+layout (binding = 6, set = 0) uniform VirtualTexture {
+	vec4 size;      // virtual width, height, page size, page border
+	vec4 cache;     // 1 / cache size, page stride, tail mip, unused
+	uvec4 feedback; // width, scale, sample offset x, y
+} vt;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+// The position comes back from the depth
+layout (location = 0) out vec2 outNormal;
+layout (location = 1) out vec4 outAlbedo;
+layout (location = 2) out vec4 outMaterial; // roughness, metallic, ao
+
+vec2 cacheUV;
+vec2 cacheDx;
+vec2 cacheDy;
+
+void translate()
+{
+	// Mip from the virtual texel footprint, as the hardware would pick it
+	vec2 texel = inUV * vt.size.xy;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float mip = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, vt.cache.z);
+	int level = int(mip);
+
+	vec2 uv = fract(inUV);
+	ivec2 page = ivec2(uv * vt.size.xy / vt.size.z) >> level;
+
+	// One pixel of every feedback block reports its page, the pixel moves each frame
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if (all(equal(pixel % vt.feedback.y, vt.feedback.zw))) {
+		uvec2 block = pixel / vt.feedback.y;
+		feedback.requests[block.y * vt.feedback.x + block.x] =
+			0x80000000u | (uint(level) << 24) | (uint(page.y) << 12) | uint(page.x);
+	}
+
+	// Missing pages resolve to a coarser resident one
+	uvec4 entry = texelFetch(pageTable, page, level);
+	float scale = exp2(-float(entry.z));
+
+	vec2 inPage = fract(uv * vt.size.xy * scale / vt.size.z);
+	vec2 slot = vec2(entry.xy) * vt.cache.y + vt.size.w;
+	cacheUV = (slot + inPage * vt.size.z) * vt.cache.x;
+
+	// Gradients of the resident mip, unaffected by the wrap at page edges
+	cacheDx = dx * scale * vt.cache.x;
+	cacheDy = dy * scale * vt.cache.x;
+}
+
+vec4 sampleCache(sampler2D cache)
+{
+	return textureGrad(cache, cacheUV, cacheDx, cacheDy);
+}
+
+// Octahedral mapping, the unit sphere folded onto [-1, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * s;
+}
+
+void main()
+{
+	translate();
+
+	// Calculate normal in tangent space
+	vec3 N = normalize(inNormal);
+	N.y = -N.y;
+	vec3 T = normalize(inTangent);
+	vec3 B = cross(N, T);
+	mat3 TBN = mat3(T, B, N);
+	// Normal maps are two channel, rebuild z from the unit length
+	vec3 normalMap;
+	normalMap.xy = sampleCache(cacheNormalMap).xy * 2.0 - vec2(1.0);
+	normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+	vec3 tnorm = TBN * normalMap;
+	outNormal = encodeNormal(normalize(tnorm));
+
+	outAlbedo = sampleCache(cacheColor);
+	outMaterial = vec4(sampleCache(cacheRoughness).r, sampleCache(cacheMetallic).r, 1.0, 0.0);
+}
@@ -4,11 +4,10 @@ layout (binding = 1) uniform samplerCube samplerCubeMap;
 
 layout (location = 0) in vec3 inUVW;
 
-layout (location = 0) out vec4 outPosition;
-layout (location = 1) out vec4 outNormal;
-layout (location = 2) out vec4 outAlbedo;
-layout (location = 3) out vec4 outRoughness;
-layout (location = 4) out vec4 outMetallic;
+// Only the color, the sky is told apart by the cleared depth
+layout (location = 0) out vec2 outNormal;
+layout (location = 1) out vec4 outAlbedo;
+layout (location = 2) out vec4 outMaterial;
 
 void main() {
 
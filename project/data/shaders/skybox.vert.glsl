@@ -20,5 +20,7 @@ void main()
 {
 	outUVW = inPos;
 	outUVW.x *= -1.0;
-	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	// On the far plane, depth tests keep it behind everything
+	vec4 pos = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	gl_Position = pos.xyww;
 }
@@ -0,0 +1,176 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Tiled deferred shading. A group is a 16x16 tile of the G-buffer: it finds
+// the depth range of the tile, culls the point lights against that range in
+// shared memory and shades its pixels with the survivors. Tiles with nothing
+// but sky only copy it.
+
+#define TILE_SIZE 16
+#define THREAD_COUNT (TILE_SIZE * TILE_SIZE)
+#define MAX_TILE_LIGHTS 256
+#define SHADOW_FACTOR 0.25
+#define AMBIENT_LIGHT 0.4
+#define POINT_LIGHTS
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE, local_size_z = 1) in;
+
+layout (binding = 0) uniform sampler2D samplerDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;   // octahedral
+layout (binding = 2) uniform sampler2D samplerAlbedo;
+layout (binding = 3) uniform sampler2D samplerMaterial; // roughness, metallic, ao
+
+struct Light {
+	vec4 position;
+	vec4 target;
+	vec4 color;
+	mat4 view;
+};
+
+// Lights casting shadows, the first ones of the scene
+layout (binding = 4) uniform UBO {
+	vec4 viewPos;
+	mat4 inverseViewProjection;
+	Light lights[3];
+	uint numbLights;
+	uint useShadows;
+	vec4 renderArea; // pixels rendered, their fraction of the targets
+} ubo;
+
+layout (binding = 5) uniform sampler2DArray samplerShadowMap;
+
+struct PointLight {
+	vec4 position; // xyz, radius
+	vec4 color;
+};
+
+layout (std430, binding = 6) readonly buffer Lights {
+	PointLight pointLights[];
+};
+
+layout (binding = 7) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 depth;   // near, far, slice scale, slice bias
+	uvec4 grid;   // clusters x, y, z, light count
+} camera;
+
+layout (binding = 8, rgba8) uniform writeonly image2D outputImage;
+
+// Most lights touching a tile this frame: clusters, tiled deferred, forward+
+layout (std430, binding = 9) buffer Peaks {
+	uint peaks[4];
+} overflow;
+
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileGeometry;
+shared uint tileLightCount;
+shared uint tileLights[MAX_TILE_LIGHTS];
+
+#include "include/pbr_common.glsl"
+
+// View space point at distance depth along the ray through ndc
+vec3 viewPoint(vec2 ndc, float depth) {
+
+	vec4 p = camera.inverseProjection * vec4(ndc, 1.0, 1.0);
+	p.xyz /= p.w;
+	return p.xyz * (depth / -p.z);
+}
+
+void main() {
+
+	// Only the top left of the targets is rendered with dynamic resolution
+	ivec2 size = ivec2(ubo.renderArea.xy);
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	bool inside = all(lessThan(pixel, size));
+
+	if (gl_LocalInvocationIndex == 0) {
+		tileMinDepth = 0xffffffffu;
+		tileMaxDepth = 0;
+		tileGeometry = 0;
+		tileLightCount = 0;
+	}
+
+	barrier();
+
+	// Depth range of the tile, positive floats sort like their bits
+	float sampleDepth = inside ? texelFetch(samplerDepth, pixel, 0).r : 1.0;
+	vec3 fragPos = worldPosition((vec2(pixel) + 0.5) / vec2(size), sampleDepth);
+	bool geometry = sampleDepth < 1.0;
+
+	if (geometry) {
+
+		// G-buffer positions are y flipped
+		float depth = -(camera.view * vec4(fragPos.x, -fragPos.y, fragPos.z, 1.0)).z;
+		atomicMin(tileMinDepth, floatBitsToUint(max(depth, 0.0)));
+		atomicMax(tileMaxDepth, floatBitsToUint(max(depth, 0.0)));
+		atomicAdd(tileGeometry, 1u);
+	}
+
+	barrier();
+
+	// Only sky in the tile, no light can reach it
+	if (tileGeometry == 0) {
+
+		if (inside)
+			imageStore(outputImage, pixel, vec4(texelFetch(samplerAlbedo, pixel, 0).rgb, 1.0));
+		return;
+	}
+
+	// Bounding box of the tile between its nearest and farthest pixel
+	vec2 tileMin = vec2(gl_WorkGroupID.xy * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+	vec2 tileMax = vec2((gl_WorkGroupID.xy + 1u) * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+	float near = uintBitsToFloat(tileMinDepth);
+	float far = uintBitsToFloat(tileMaxDepth);
+
+	vec3 a = viewPoint(tileMin, near);
+	vec3 b = viewPoint(tileMax, near);
+	vec3 c = viewPoint(tileMin, far);
+	vec3 d = viewPoint(tileMax, far);
+	vec3 boxMin = min(min(a, b), min(c, d));
+	vec3 boxMax = max(max(a, b), max(c, d));
+
+	// Each invocation tests one light per pass
+	uint lightTotal = camera.grid.w;
+	for (uint i = gl_LocalInvocationIndex; i < lightTotal; i += THREAD_COUNT) {
+
+		vec4 light = pointLights[i].position;
+		vec3 center = (camera.view * vec4(light.x, -light.y, light.z, 1.0)).xyz;
+		vec3 delta = clamp(center, boxMin, boxMax) - center;
+
+		if (dot(delta, delta) <= light.w * light.w) {
+
+			uint slot = atomicAdd(tileLightCount, 1u);
+			if (slot < MAX_TILE_LIGHTS)
+				tileLights[slot] = i;
+		}
+	}
+
+	barrier();
+
+	// Lights past the list are not shaded, the host warns about them
+	if (gl_LocalInvocationIndex == 0)
+		atomicMax(overflow.peaks[1], tileLightCount);
+
+	if (!inside)
+		return;
+
+	if (!geometry) {
+		imageStore(outputImage, pixel, vec4(texelFetch(samplerAlbedo, pixel, 0).rgb, 1.0));
+		return;
+	}
+
+	vec3 N = decodeNormal(texelFetch(samplerNormal, pixel, 0).rg);
+	vec3 albedo = pow(texelFetch(samplerAlbedo, pixel, 0).rgb, vec3(2.2));
+	vec4 surface = texelFetch(samplerMaterial, pixel, 0); // roughness, metallic, ao
+
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+
+	vec3 Lo = vec3(0.0);
+	uint lightCount = min(tileLightCount, uint(MAX_TILE_LIGHTS));
+	for (uint i = 0; i < lightCount; ++i)
+		Lo += shadeLight(pointLights[tileLights[i]], fragPos, N, V, albedo, surface.rgb);
+
+	imageStore(outputImage, pixel, vec4(composeColor(fragPos, albedo, surface.b, Lo), 1.0));
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// Draw + 1 in the high bits, 0 stays the sky, then the triangle of the draw
+
+#define TRIANGLE_BITS 22
+
+layout (push_constant) uniform Draw {
+	uint index;
+} draw;
+
+layout (location = 0) out uint outVisibility;
+
+void main() {
+
+	outVisibility = ((draw.index + 1) << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Visibility pass, positions only
+
+layout (location = 0) in vec4 inPos;
+
+layout (binding = 0, set = 0) uniform UBOView {
+	mat4 projection;
+	mat4 view;
+} view;
+
+layout (binding = 0, set = 1) uniform Models {
+  mat4 matrix;
+} model;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+void main() {
+
+	gl_Position = view.projection * view.view * model.matrix * vec4(inPos.xyz, 1.0);
+}
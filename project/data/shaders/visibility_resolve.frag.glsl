@@ -0,0 +1,10 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Visibility buffer resolve of one material. Every pixel of its draws
+// fetches its triangle from the geometry pool, rebuilds the attributes
+// mrt.vert would have interpolated, samples the material like mrt.frag and
+// shades like deferred_pbr.frag.
+
+#include "include/visibility_resolve.glsl"